@@ -26,6 +26,7 @@ extern "C" {
 #include "niwa/demolib/IEffect.h"
 #include "niwa/demolib/LuaRef.h"
 
+#include "niwa/system/KernelDispatch.h"
 #include "niwa/system/ProcessorInfo.h"
 
 #include "niwa/logging/Level.h"
@@ -330,6 +331,9 @@ namespace {
             log.info() << "logical processor count: "
                 << info.getLogicalProcessorCount();
 
+            log.info() << "SIMD level: " << niwa::system::KernelDispatch::getSimdLevelName(
+                niwa::system::KernelDispatch::getSimdLevel());
+
             engine.start();
             return 0;
         }
@@ -10,6 +10,10 @@
 #include "niwa/demolib/IGraphics.h"
 #include "niwa/demolib/IEffect.h"
 
+#include "niwa/system/AlignedMemory.h"
+#include "niwa/system/FrameArena.h"
+#include "niwa/system/LockStatistics.h"
+#include "niwa/system/Profiler.h"
 #include "niwa/system/Timer.h"
 
 #include "niwa/logging/Logger.h"
@@ -31,6 +35,11 @@ extern "C" {
 #define INITIAL_WINDOW_WIDTH 640
 #define INITIAL_WINDOW_HEIGHT 480
 
+/**
+ * Written when a profiling capture ends.
+ */
+#define TRACE_PATH "trace.json"
+
 namespace {
     class Graphics : public niwa::demolib::IGraphics {
     public:
@@ -144,6 +153,8 @@ namespace niwa {
         }
 
         void Engine::render() {
+            NIWA_PROFILE_ZONE("frame");
+
             double timeSeconds = 0;
 
             if(!gTimer || !gTimer->measureTime(timeSeconds)) {
@@ -198,6 +209,9 @@ namespace niwa {
             }
 
             glutSwapBuffers();
+
+            // Frame-lifetime allocations end here.
+            niwa::system::FrameArena::forThread().reset();
         }
 
         void Engine::processNormalKeys(unsigned char key, int /*x*/, int /*y*/) {
@@ -218,6 +232,32 @@ namespace niwa {
         }
 
         void Engine::processSpecialKeys(int key, int x, int y) {
+#ifdef NIWA_SYSTEM_PROFILING
+            // F12 starts and ends a profiling capture.
+            if(key == GLUT_KEY_F12) {
+                if(!niwa::system::Profiler::isRecording()) {
+                    niwa::system::Profiler::clear();
+                    niwa::logging::Logger::getLockStatistics().reset();
+                    niwa::system::Profiler::start();
+                } else {
+                    niwa::system::Profiler::stop();
+
+                    log.info() << "logger lock: "
+                        << niwa::logging::Logger::getLockStatistics();
+
+                    log.info() << "aligned memory: "
+                        << niwa::system::AlignedMemory::getStatistics();
+
+                    if(!niwa::system::Profiler::writeChromeTrace(TRACE_PATH)) {
+                        log.warn() << "cannot write " << TRACE_PATH;
+                    } else {
+                        log.info() << "wrote " << TRACE_PATH;
+                    }
+                }
+                return;
+            }
+#endif
+
             double timeSeconds;
 
             if(gTimer && gTimer->measureTime(timeSeconds)) {
@@ -57,8 +57,15 @@ local raytrace = raytrace_effect{
     photon_count = 25000 * 1 * 0,
     photon_query_type = "range_query",
     --photon_query_type = "neighbor_query",
+    --photon_query_type = "knn_tree",
     photon_query_radius = 0.3,
     photon_query_neighbor_count = 30,
+    --photon_irradiance_stride = 4,
+    --importon_stride = 8,
+    --caustic_photon_count = 10000,
+    --caustic_query_radius = 0.1,
+    --pipelined = 1,
+    --progressive_radius = 0.1,
     objects={
         --[[mesh{
             model="data/models/knot.3ds",
@@ -14,6 +14,10 @@
 #include "niwa/math/blas.h"
 #include "niwa/math/ConjugateGradient.h"
 
+#include "niwa/system/FrameArena.h"
+#include "niwa/system/IParallelizer.h"
+#include "niwa/system/Profiler.h"
+
 #include <algorithm>
 
 #define GRAVITY 9.81f
@@ -22,6 +26,11 @@
 
 //#define USE_SSE_STRAIN_LIMITING
 
+/**
+ * Number of particles per parallel collision range.
+ */
+#define COLLISION_STRIDE 256
+
 namespace niwa {
     namespace dynamics {
         using namespace math::blas;
@@ -55,6 +64,27 @@ namespace niwa {
             delete[] packedSprings_;
         }
 
+        class Cloth::CollisionTask : public system::IParallelizer::IRangeCallback {
+        public:
+            CollisionTask(Cloth& parent, float timeSeconds)
+                : parent_(parent), timeSeconds_(timeSeconds) {
+                // ignored
+            }
+
+            void __fastcall invokeRange(int begin, int end) {
+                parent_.collideParticles(begin, end, timeSeconds_);
+            }
+
+        private: // prevent copying
+            CollisionTask(CollisionTask const&);
+            CollisionTask& operator = (CollisionTask const&);
+
+        private:
+            Cloth& parent_;
+
+            float const timeSeconds_;
+        };
+
         struct ImplicitOperatorArg {
             ImplicitOperatorArg(Cloth const* cloth_, float timeSeconds_)
                 : cloth(cloth_), timeSeconds(timeSeconds_) {
@@ -133,8 +163,17 @@ namespace niwa {
         }
 
         void Cloth::simulate(float timeSeconds) {
+            int const n = static_cast<int>(3 * particles_.size());
+
+            // The temporaries of a step come from the arena,
+            // so that stepping does not touch the heap.
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
             Vector forceVector(
-                3 * particles_.size(), 
+                n,
+                static_cast<float*>(arena.allocate(n * sizeof(float), 16)),
                 Vector::Zero);
 
             vec3f* forces = reinterpret_cast<vec3f*>(forceVector.getRaw());
@@ -142,7 +181,12 @@ namespace niwa {
             accumulateForces(forces);
 
             Vector deltaVelocityVector(
-                3 * particles_.size(), Vector::Zero);
+                n,
+                static_cast<float*>(arena.allocate(n * sizeof(float), 16)),
+                Vector::Zero);
+
+            float* workspace = static_cast<float*>(arena.allocate(
+                math::ConjugateGradient::getWorkspaceSize(n) * sizeof(float), 16));
 
             math::ConjugateGradient cg(64, .001f);
 
@@ -152,10 +196,15 @@ namespace niwa {
                 forces[i] *= timeSeconds * particles_[i].invMass_;
             }
 
-            cg.solve(
-                3 * particles_.size(), 
-                implicitOperator, &arg,
-                forceVector, deltaVelocityVector);
+            {
+                NIWA_PROFILE_ZONE("conjugate gradient");
+
+                cg.solve(
+                    n,
+                    implicitOperator, &arg,
+                    forceVector, deltaVelocityVector,
+                    workspace);
+            }
 
             vec3f* deltaVelocity = reinterpret_cast<vec3f*>(deltaVelocityVector.getRaw());
 
@@ -182,42 +231,54 @@ namespace niwa {
             if(collider_) {
                 // Modify velocities so that interpenetration won't occur.
 
-                levelset::ILevelSet const& levelSet = collider_->levelSet();
+                CollisionTask task(*this, timeSeconds);
 
-                const float halfThickness = thickness_ / 2.0f;
+                int const n = static_cast<int>(particles_.size());
 
-                for(size_t i=0; i<particles_.size(); ++i) {
-                    vec3f p(particles_[i].position_ + particles_[i].velocity_ * timeSeconds);
+                if(parallelizer_) {
+                    parallelizer_->loopRange(task, 0, n, COLLISION_STRIDE);
+                } else {
+                    task.invokeRange(0, n);
+                }
+            }
+
+            for(size_t i=0; i<particles_.size(); ++i) {
+                ClothParticle& particle = particles_[i];
+
+                particle.position_ += particle.velocity_ * timeSeconds;
+            }
+        }
 
-                    float d = levelSet.value(p);
+        void Cloth::collideParticles(int begin, int end, float timeSeconds) {
+            levelset::ILevelSet const& levelSet = collider_->levelSet();
 
-                    if(d < halfThickness) {
-                        vec3f n = levelSet.gradient(p);
+            const float halfThickness = thickness_ / 2.0f;
 
-                        float dot = vec3f::dot(particles_[i].velocity_, n);
+            for(int i=begin; i<end; ++i) {
+                vec3f p(particles_[i].position_ + particles_[i].velocity_ * timeSeconds);
 
-                        if(dot < 0) {
-                            vec3f vNormal  = n * dot;
-                            vec3f vTangent = particles_[i].velocity_ - vNormal;
+                float d = levelSet.value(p);
 
-                            if(vTangent.length() > 0) {
-                                vTangent *= std::max(
-                                    0.0f,
-                                    1.0f - collider_->frictionCoefficient() 
-                                         * (-dot) / vTangent.length());
-                            }
+                if(d < halfThickness) {
+                    vec3f n = levelSet.gradient(p);
 
-                            particles_[i].velocity_ = vTangent;
+                    float dot = vec3f::dot(particles_[i].velocity_, n);
+
+                    if(dot < 0) {
+                        vec3f vNormal  = n * dot;
+                        vec3f vTangent = particles_[i].velocity_ - vNormal;
+
+                        if(vTangent.length() > 0) {
+                            vTangent *= std::max(
+                                0.0f,
+                                1.0f - collider_->frictionCoefficient() 
+                                     * (-dot) / vTangent.length());
                         }
+
+                        particles_[i].velocity_ = vTangent;
                     }
                 }
             }
-
-            for(size_t i=0; i<particles_.size(); ++i) {
-                ClothParticle& particle = particles_[i];
-
-                particle.position_ += particle.velocity_ * timeSeconds;
-            }
         }
 
         std::vector<ClothParticle> const& Cloth::getParticles() const {
@@ -89,6 +89,12 @@ namespace niwa {
                 math::blas::Vector const& src, math::blas::Vector& dst,
                 float timeSeconds) const;
 
+            /**
+             * Modifies the velocities of the particles in the range
+             * so that they won't penetrate the collider.
+             */
+            void collideParticles(int begin, int end, float timeSeconds);
+
         private:
             Cloth(
                 std::vector<ClothParticle> const& particles,
@@ -103,6 +109,8 @@ namespace niwa {
         private:
             class AccumulationTask;
 
+            class CollisionTask;
+
         private:
             std::vector<ClothParticle> particles_;
 
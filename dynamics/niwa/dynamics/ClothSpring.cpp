@@ -9,6 +9,8 @@
 
 #include "niwa/math/packed_vec3f.h"
 
+#include "niwa/system/AlignedMemory.h"
+
 //#define USE_PROJECTIVE_DAMPING
 
 #define MAX_SPRING_COMPRESSION 0.0f
@@ -17,26 +19,7 @@
 
 using niwa::math::packed_vec3f;
 
-/**
- * This compilation unit uses only packed SSE operations,
- * so we'll use operator overloading as a shorthand.
- */
-namespace {
-    static __forceinline __m128 __fastcall operator * (
-        __m128 const& lhs, __m128 const& rhs) {
-        return _mm_mul_ps(lhs, rhs);
-    }
-
-    static __forceinline __m128 __fastcall operator - (
-        __m128 const& lhs, __m128 const& rhs) {
-            return _mm_sub_ps(lhs, rhs);
-    }
-
-    static __forceinline __m128 __fastcall operator / (
-        __m128 const& lhs, __m128 const& rhs) {
-            return _mm_div_ps(lhs, rhs);
-    }
-}
+typedef niwa::math::simd<float, 4> simd4f;
 
 namespace niwa {
     namespace dynamics {
@@ -106,20 +89,18 @@ namespace niwa {
             packed_vec3f relativePosition = pos[0] - pos[1];
             packed_vec3f relativeVelocity = vel[0] - vel[1];
 
-            __m128 invLength = _mm_rsqrt_ps(relativePosition.squareLength());
-
-            __declspec(align(16)) static const float ones[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+            simd4f const invLength = inverseSqrtApproximate(relativePosition.squareLength());
 
-            __m128 const* one = reinterpret_cast<__m128 const*>(ones);
+            simd4f const one(1.0f);
 
 #ifdef USE_PROJECTIVE_DAMPING
             packed_vec3f force(
-                relativePosition * (stiffness_ * (restLength_ * invLength - *one)
+                relativePosition * (stiffness_ * (restLength_ * invLength - one)
                 - dampingCoefficient_ * relativeVelocity.dot(relativePosition) * 
                 (invLength * invLength)));
 #else
             packed_vec3f force(
-                relativePosition * (stiffness_ * (restLength_ * invLength - *one))
+                relativePosition * (stiffness_ * (restLength_ * invLength - one))
                 - relativeVelocity * dampingCoefficient_);
 #endif
 
@@ -214,9 +195,9 @@ namespace niwa {
                 indices_[i*2  ] = it->indices_[0];
                 indices_[i*2+1] = it->indices_[1];
 
-                restLength_.m128_f32[i] = it->restLength_;
-                stiffness_.m128_f32[i] = it->stiffness_;
-                dampingCoefficient_.m128_f32[i] = it->dampingCoefficient_;
+                restLength_.set(i, it->restLength_);
+                stiffness_.set(i, it->stiffness_);
+                dampingCoefficient_.set(i, it->dampingCoefficient_);
             }
         }
 
@@ -312,29 +293,29 @@ namespace niwa {
             packed_vec3f relativePositions(pos[0] - pos[1]);
             packed_vec3f relativeVelocitys(vel[0] - vel[1]);
 
-            __m128 lengths = relativePositions.length();
+            simd4f const lengths = relativePositions.length();
 
-            __m128 invLengths = _mm_rcp_ps(lengths);
+            simd4f const invLengths = reciprocalApproximate(lengths);
 
             // We use the word "speed" to denote
             // one-dimensional (projected) velocity.
-            __m128 tangentialSpeeds = relativePositions.dot(
+            simd4f const tangentialSpeeds = relativePositions.dot(
                 relativeVelocitys) * invLengths;
 
-            __m128 invTangentialSpeeds = _mm_rcp_ps(tangentialSpeeds);
+            simd4f const invTangentialSpeeds = reciprocalApproximate(tangentialSpeeds);
 
-            __m128 maxLengths = 
-                restLength_ * _mm_set_ps1(1 + MAX_SPRING_EXTENSION);
+            simd4f const maxLengths = 
+                restLength_ * simd4f(1 + MAX_SPRING_EXTENSION);
 
-            __m128 minLengths = 
-                restLength_ * _mm_set_ps1(1 - MAX_SPRING_EXTENSION);
+            simd4f const minLengths = 
+                restLength_ * simd4f(1 - MAX_SPRING_EXTENSION);
 
-            __m128 extensionTimes =
-                _mm_max_ps(maxLengths - lengths, _mm_setzero_ps())
+            simd4f const extensionTimes =
+                maximum(maxLengths - lengths, simd4f::zero())
                 * invTangentialSpeeds;
 
-            __m128 compressionTimes =
-                _mm_min_ps(minLengths - lengths, _mm_setzero_ps())
+            simd4f const compressionTimes =
+                minimum(minLengths - lengths, simd4f::zero())
                 * invTangentialSpeeds;
 
             for(int i=0; i<4; ++i) {
@@ -343,19 +324,19 @@ namespace niwa {
                 // strain.
                 float maxTime = timeSeconds;
 
-                float tangentialSpeed = tangentialSpeeds.m128_f32[i];
+                float tangentialSpeed = tangentialSpeeds[i];
 
                 if(tangentialSpeed > 0) {
-                    maxTime = extensionTimes.m128_f32[i];
+                    maxTime = extensionTimes[i];
                 } else if(tangentialSpeed < 0) {
-                    maxTime = compressionTimes.m128_f32[i];
+                    maxTime = compressionTimes[i];
                 }
 
                 if(maxTime < timeSeconds) {
                     ClothParticle& p0 = particles[indices_[i*2]];
                     ClothParticle& p1 = particles[indices_[i*2+1]];
 
-                    float invLength = invLengths.m128_f32[i];
+                    float invLength = invLengths[i];
 
                     vec3f relativePosition = relativePositions.get(i);
 
@@ -384,17 +365,11 @@ namespace niwa {
         }
 
         void* ClothPackedSpring::operator new[] (size_t sz) {
-            void* result = _mm_malloc(sz, 16);
-
-            if(!result) {
-                throw std::bad_alloc();
-            } else {
-                return result;
-            }
+            return system::AlignedMemory::allocate(sz, 16, system::MEMORY_DYNAMICS);
         }
 
         void ClothPackedSpring::operator delete[] (void* p) {
-            _mm_free(p);
+            system::AlignedMemory::free(p);
         }
 
         bool ClothSpring::operator < (ClothSpring const& rhs) const {
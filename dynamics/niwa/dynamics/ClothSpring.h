@@ -10,7 +10,7 @@
 
 #include "ClothParticle.h"
 
-#include <xmmintrin.h>
+#include "niwa/math/simd.h"
 
 #include <vector>
 
@@ -119,11 +119,11 @@ namespace niwa {
         private:
             int indices_[2*4];
 
-            __m128 restLength_;
+            math::simd<float, 4> restLength_;
 
-            __m128 stiffness_;
+            math::simd<float, 4> stiffness_;
 
-            __m128 dampingCoefficient_;
+            math::simd<float, 4> dampingCoefficient_;
         };
     }
 }
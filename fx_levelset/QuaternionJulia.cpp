@@ -22,8 +22,23 @@
 #define N_JULIA_ITERATIONS 10
 #define SSE
 
+/**
+ * Samples per step of the slice kernel; 8 or 16
+ * need a unit compiled for AVX or AVX-512 and a grid
+ * whose x dimension is divisible accordingly.
+ */
+#define SLICE_WIDTH 4
+
+/**
+ * Granularity of the slice task, in slices. Guided
+ * parallelizers (NiwaParallelizer) hand out larger
+ * ranges first, and never fewer slices than this
+ * except at the end of the grid.
+ */
+#define SLICES_PER_RANGE 4
+
 #ifdef SSE
-#include <xmmintrin.h>
+#include "niwa/math/simd.h"
 #endif
 
 #define NOMINMAX
@@ -52,36 +67,85 @@ QuaternionJulia::QuaternionJulia() : timeSeconds_(0) {
     parallelizer_ = boost::shared_ptr<IParallelizer>(NiwaParallelizer::create());
 }
 
-/**
- * This compilation unit uses only packed SSE operations,
- * so we'll use operator overloading for shorthand.
- */
+#ifdef SSE
 namespace {
-    static __forceinline __m128 __fastcall operator + (
-            __m128 const& lhs, __m128 const& rhs) {
-        return _mm_add_ps(lhs, rhs);
-    }
+    /**
+     * Evaluates the Julia set on the slices [zBegin, zEnd)
+     * of the grid, N samples at a time. The grid's x dimension
+     * must be divisible by N.
+     */
+    template<int N>
+    static void fEvaluateSlices(Grid& grid, int zBegin, int zEnd, double t) {
+        typedef simd<float, N> simdf;
 
-    static __forceinline __m128 __fastcall operator - (
-            __m128 const& lhs, __m128 const& rhs) {
-        return _mm_sub_ps(lhs, rhs);
-    }
+        const vec3i dim = grid.getDimensions();
+
+        simdf const cr(-0.2f);
+        simdf const ca(0.8f);
+        //simdf const cb(0.0f);
+        //simdf const cc(0.0f);
+
+        simdf const cInitial(static_cast<float>(sin(t*0.1f)) * .75f);
+
+        simdf const threshold(THRESHOLD);
+
+        simdf const xFactor(1.0f / dim.x * 2 * WINDOW_SIZE);
+
+        float offsets[N];
+
+        for(int i=0; i<N; ++i) {
+            offsets[i] = ((i + .5f) / dim.x * 2 - 1) * WINDOW_SIZE;
+        }
+
+        simdf const xOffset = simdf::loadUnaligned(offsets);
+
+        for(int z=zBegin; z<zEnd; ++z) {
+            float* out = &grid.elementAt(0,0,z);
+
+            simdf const bInitial(((z+.5f) / dim.z * 2 - 1) * WINDOW_SIZE);
+
+            for(int y=0; y<dim.y; ++y) {
+                simdf const aInitial(((y+.5f) / dim.y * 2 - 1) * WINDOW_SIZE);
+
+                for(int x=0; x<dim.x; x += N) {
+                    simdf r = simdf(static_cast<float>(x)) * xFactor + xOffset;
+
+                    simdf a = aInitial;
+                    simdf b = bInitial;
+                    simdf c = cInitial;
+
+                    for(int i=0; i<N_JULIA_ITERATIONS; ++i) {
+                        simdf dr = r+r;
+
+                        r = (r*r-a*a) - (b*b+c*c) + cr;
+                        a = dr*a + ca;
+                        b = dr*b; // + cb;
+                        c = dr*c; // + cc;
+                    }
 
-    static __forceinline __m128 __fastcall operator * (
-            __m128 const& lhs, __m128 const& rhs) {
-        return _mm_mul_ps(lhs, rhs);
+                    (r*r + a*a + b*b + c*c - threshold).storeUnaligned(out);
+
+                    out += N;
+                }
+            }
+        }
     }
 }
+#endif
 
 namespace {
-    class SliceTask : public IParallelizer::ICallback {
+    /**
+     * Evaluates a range of slices per call, so that
+     * the per-frame constants are set up once per range.
+     */
+    class SliceTask : public IParallelizer::IRangeCallback {
     public:
         explicit SliceTask(Grid& grid, double timeSeconds) 
                 : grid_(grid), timeSeconds_(timeSeconds) {
             // ignored
         }
 
-        void __fastcall invoke(int z);
+        void __fastcall invokeRange(int zBegin, int zEnd);
 
     private: // prevent copying
         SliceTask(SliceTask const&);
@@ -93,56 +157,14 @@ namespace {
         double timeSeconds_;
     };
 
-    void SliceTask::invoke(int z) {
-        const vec3i dim = grid_.getDimensions();
-
+    void SliceTask::invokeRange(int zBegin, int zEnd) {
         const double t = timeSeconds_ * 10;
 
 #ifdef SSE
-        __m128 cr = _mm_set_ps1(-0.2f);
-        __m128 ca = _mm_set_ps1(0.8f);
-        //__m128 cb = _mm_set_ps1(0.0f);
-        //__m128 cc = _mm_set_ps1(0.0f);
-
-        __m128 cInitial = _mm_set_ps1(static_cast<float>(sin(t*0.1f)) * .75f);
-
-        __m128 threshold = _mm_set_ps1(THRESHOLD);
-
-        __m128 xFactor = _mm_set_ps1(1.0f / dim.x * 2 * WINDOW_SIZE);
-
-        __m128 xOffset = _mm_set_ps(
-            (3.5f / dim.x * 2 - 1) * WINDOW_SIZE,
-            (2.5f / dim.x * 2 - 1) * WINDOW_SIZE,
-            (1.5f / dim.x * 2 - 1) * WINDOW_SIZE,
-            (0.5f / dim.x * 2 - 1) * WINDOW_SIZE);
-
-        __m128* out = reinterpret_cast<__m128*>(&grid_.elementAt(0,0,z));
-
-        __m128 bInitial = _mm_set_ps1(((z+.5f) / dim.z * 2 - 1) * WINDOW_SIZE);
-
-        for(int y=0; y<dim.y; ++y) {
-            __m128 aInitial = _mm_set_ps1(((y+.5f) / dim.y * 2 - 1) * WINDOW_SIZE);
-
-            for(int x=0; x<dim.x; x += 4) {
-                __m128 r = _mm_set_ps1(static_cast<float>(x)) * xFactor + xOffset;
-
-                __m128 a = aInitial;
-                __m128 b = bInitial;
-                __m128 c = cInitial;
-
-                for(int i=0; i<N_JULIA_ITERATIONS; ++i) {
-                    __m128 dr = r+r;
-
-                    r = (r*r-a*a) - (b*b+c*c) + cr;
-                    a = dr*a + ca;
-                    b = dr*b; // + cb;
-                    c = dr*c; // + cc;
-                }
-
-                (*out++) = r*r + a*a + b*b + c*c - threshold;
-            }
-        }
+        fEvaluateSlices<SLICE_WIDTH>(grid_, zBegin, zEnd, t);
 #else
+        const vec3i dim = grid_.getDimensions();
+
         const float cr = -0.2f;
         const float ca = 0.8f;
         //const float cb = 0.0f;
@@ -150,23 +172,25 @@ namespace {
 
         const float tt = static_cast<float>(sin(t * .1f)) * .75f;
 
-        for(int y=0; y<dim.y; ++y) {
-            for(int x=0; x<dim.x; ++x) {
-                float r = ((x+.5f) / dim.x * 2 - 1) * WINDOW_SIZE;
-                float a = ((y+.5f) / dim.y * 2 - 1) * WINDOW_SIZE;
-                float b = ((z+.5f) / dim.z * 2 - 1) * WINDOW_SIZE;
-                float c = tt;
+        for(int z=zBegin; z<zEnd; ++z) {
+            for(int y=0; y<dim.y; ++y) {
+                for(int x=0; x<dim.x; ++x) {
+                    float r = ((x+.5f) / dim.x * 2 - 1) * WINDOW_SIZE;
+                    float a = ((y+.5f) / dim.y * 2 - 1) * WINDOW_SIZE;
+                    float b = ((z+.5f) / dim.z * 2 - 1) * WINDOW_SIZE;
+                    float c = tt;
 
-                for(int i = 0; i<N_JULIA_ITERATIONS; ++i) {
-                    float dr = r+r;
+                    for(int i = 0; i<N_JULIA_ITERATIONS; ++i) {
+                        float dr = r+r;
 
-                    r = (r*r - a*a) - (b*b + c*c) + cr;
-                    a = dr*a + ca;
-                    b = dr*b;// + cb;
-                    c = dr*c;// + cc;
-                }
+                        r = (r*r - a*a) - (b*b + c*c) + cr;
+                        a = dr*a + ca;
+                        b = dr*b;// + cb;
+                        c = dr*c;// + cc;
+                    }
 
-                grid_.gridElementAt(x,y,z) = r*r + a*a + b*b + c*c - THRESHOLD;
+                    grid_.gridElementAt(x,y,z) = r*r + a*a + b*b + c*c - THRESHOLD;
+                }
             }
         }
 #endif
@@ -178,7 +202,7 @@ void QuaternionJulia::render(niwa::demolib::IGraphics const& g) const {
 
     SliceTask task(*grid_, timeSeconds_);
 
-    parallelizer_->loop(task, 0, grid_->getDimensions().z);
+    parallelizer_->loopRange(task, 0, grid_->getDimensions().z, SLICES_PER_RANGE);
 
     glViewport(0, 0, g.getWidth(), g.getHeight());
         
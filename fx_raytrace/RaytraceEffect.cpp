@@ -24,6 +24,7 @@
 #include "niwa/photonmap/IPhotonMap.h"
 #include "niwa/photonmap/PhotonHash.h"
 #include "niwa/photonmap/HilbertPhotonHash.h"
+#include "niwa/photonmap/PhotonKdTree.h"
 
 #pragma warning(disable:4505)
 #include <glut.h>
@@ -45,8 +46,49 @@ using boost::shared_ptr;
 #define DEFAULT_PHOTON_RADIUS 0.3f
 #define DEFAULT_PHOTON_NEIGHBOR_COUNT 10
 
+#define DEFAULT_CAUSTIC_RADIUS 0.1f
+
 #define PHOTON_CAPACITY 500000
 
+namespace {
+    /**
+     * @return The photon map chosen by the arguments,
+     *         or null if no query type is given.
+     */
+    static shared_ptr<IPhotonMap> createPhotonMap(
+            niwa::demolib::CheckableArguments const& args) {
+        std::string queryType = args.get("photon_query_type").asString();
+
+        shared_ptr<IPhotonMap> photonMap;
+
+        if(queryType == "range_query") {
+            float radius = args.get("photon_query_radius").asNumber<float>(DEFAULT_PHOTON_RADIUS);
+
+            photonMap = shared_ptr<IPhotonMap>(new PhotonHash(PHOTON_CAPACITY, radius));
+        } else if(queryType == "neighbor_query") {
+            int neighbor_count = args.get("photon_query_neighbor_count").asNumber<int>(DEFAULT_PHOTON_NEIGHBOR_COUNT);
+
+            photonMap = shared_ptr<IPhotonMap>(new HilbertPhotonHash(PHOTON_CAPACITY, neighbor_count));
+        } else if(queryType == "knn_tree") {
+            int neighbor_count = args.get("photon_query_neighbor_count").asNumber<int>(DEFAULT_PHOTON_NEIGHBOR_COUNT);
+
+            float radius = args.get("photon_query_radius").asNumber<float>(DEFAULT_PHOTON_RADIUS);
+
+            int irradianceStride = args.get("photon_irradiance_stride").asNumber<int>(0);
+
+            shared_ptr<PhotonKdTree> kdTree(new PhotonKdTree(PHOTON_CAPACITY, neighbor_count, radius));
+
+            kdTree->setIrradianceStride(irradianceStride);
+
+            photonMap = kdTree;
+        } else if(!queryType.empty()) {
+            args.error("unsupported photon query type '%s'", queryType.c_str());
+        }
+
+        return photonMap;
+    }
+}
+
 RaytraceEffect::RaytraceEffect(niwa::demolib::CheckableArguments const& args) 
 : timeSeconds_(0) {
     std::vector<shared_ptr<ITraceable>> objects;
@@ -108,23 +150,9 @@ RaytraceEffect::RaytraceEffect(niwa::demolib::CheckableArguments const& args)
 
     float aspectRatio = windowSize.first / static_cast<float>(windowSize.second);
 
-    std::string queryType = args.get("photon_query_type").asString();
-
     int photonCount = args.get("photon_count").asNumber<int>(DEFAULT_PHOTON_COUNT);
 
-    shared_ptr<IPhotonMap> photonMap;
-
-    if(queryType == "range_query") {
-        float radius = args.get("photon_query_radius").asNumber<float>(DEFAULT_PHOTON_RADIUS);
-
-        photonMap = shared_ptr<IPhotonMap>(new PhotonHash(PHOTON_CAPACITY, radius));
-    } else if(queryType == "neighbor_query") {
-        int neighbor_count = args.get("photon_query_neighbor_count").asNumber<int>(DEFAULT_PHOTON_NEIGHBOR_COUNT);
-
-        photonMap = shared_ptr<IPhotonMap>(new HilbertPhotonHash(PHOTON_CAPACITY, neighbor_count));
-    } else if(!queryType.empty()) {
-        args.error("unsupported photon query type '%s'", queryType.c_str());
-    }
+    shared_ptr<IPhotonMap> photonMap = createPhotonMap(args);
 
     camera_->setBackplaneDimensions(vec2f(aspectRatio, 1.0f));
 
@@ -134,6 +162,29 @@ RaytraceEffect::RaytraceEffect(niwa::demolib::CheckableArguments const& args)
     renderer_->setScene(compositeObject_);
     renderer_->setLight(compositeLight_);
     renderer_->setToneMapper(toneMapper_);
+
+    int importonStride = args.get("importon_stride").asNumber<int>(0);
+
+    if(importonStride > 0) {
+        renderer_->setImportance(
+            importonStride,
+            args.get("photon_query_radius").asNumber<float>(DEFAULT_PHOTON_RADIUS));
+    }
+
+    int causticPhotonCount = args.get("caustic_photon_count").asNumber<int>(0);
+
+    if(causticPhotonCount > 0) {
+        renderer_->setCaustics(
+            causticPhotonCount,
+            args.get("caustic_query_radius").asNumber<float>(DEFAULT_CAUSTIC_RADIUS));
+    }
+
+    if(args.get("pipelined").asNumber<int>(0) != 0) {
+        renderer_->setPipelined(createPhotonMap(args));
+    }
+
+    renderer_->setProgressiveRadius(
+        args.get("progressive_radius").asNumber<float>(DEFAULT_PHOTON_RADIUS));
 }
 
 RaytraceEffect::~RaytraceEffect() {
@@ -185,7 +236,10 @@ void RaytraceEffect::render(niwa::demolib::IGraphics const& g) const {
 }
 
 void RaytraceEffect::update(double secondsElapsed) {
-    timeSeconds_ += secondsElapsed;
+    // Progressive rendering requires a static view.
+    if(!renderer_->getProgressive()) {
+        timeSeconds_ += secondsElapsed;
+    }
 }
 
 void RaytraceEffect::onNormalKeys(unsigned char key, int /*modifiers*/) {
@@ -196,5 +250,8 @@ void RaytraceEffect::onNormalKeys(unsigned char key, int /*modifiers*/) {
         renderer_->setUseMultithreading(false);
     } else if(key == '2') {
         renderer_->setUseMultithreading(true);
+    } else if(key == 'p') {
+        renderer_->setProgressive(
+            !renderer_->getProgressive());
     }
 }
@@ -72,6 +72,11 @@ namespace niwa {
         private:
             static size_t calc_P(int i, HilbertPoint<DIM,ORDER> const& H);
 
+            /**
+             * Adds the DIM bits of P to H, starting from bit i.
+             */
+            static void add_P(int i, size_t P, HilbertPoint<DIM,ORDER>& H);
+
             static size_t calc_P2(size_t S);
 
             static size_t calc_J(size_t P);
@@ -80,6 +85,11 @@ namespace niwa {
 
             static size_t calc_tS_tT(size_t xJ, size_t val);
 
+            /**
+             * Inverts calc_tS_tT (rotates the other way).
+             */
+            static size_t calc_inverse_tS_tT(size_t xJ, size_t val);
+
             static size_t g_mask(size_t index);
 
         private: // prevent instantiation
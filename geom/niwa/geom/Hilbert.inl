@@ -9,7 +9,6 @@
 #define NIWA_GEOM_HILBERT_INL
 
 #include <cassert>
-#include <iostream>
 
 namespace niwa {
     namespace geom {
@@ -57,31 +56,10 @@ namespace niwa {
 
             size_t P = calc_P2(A);
 
-            // Add in DIM bits to h.
-
             // Must be signed (for condition-testing).
             int i = ORDER * DIM - DIM;
 
-            {
-                size_t element = i / ORDER;
-                if((i % ORDER) > 
-                        static_cast<int>(ORDER) - static_cast<int>(DIM)) {
-                    h.elements[element  ] |= P << (i % ORDER);
-                    h.elements[element+1] |= P >> (ORDER - i % ORDER);
-
-                    assert(h.elements[element  ] < (1U << ORDER));
-                    assert(h.elements[element+1] < (1U << ORDER));
-                } else {
-                    assert(i - element * ORDER >= 0);
-
-                    std::cout << "A: " << A << std::endl;
-                    std::cout << "P: " << P << ", i: " << i << ", elt: " << element << std::endl;
-
-                    h.elements[element  ] |= P << (i - element * ORDER);
-
-                    assert(h.elements[element  ] < (1U << ORDER));
-                }
-            }
+            add_P(i, P, h);
 
             size_t W = 0;
             size_t J = calc_J(P);
@@ -103,21 +81,7 @@ namespace niwa {
                 size_t S = calc_tS_tT(xJ, tS);
                 P = calc_P2(S);
 
-                // Add in DIM bits to hcode.
-                {
-                    size_t element = i / ORDER;
-                    if(i % ORDER > static_cast<int>(ORDER) - static_cast<int>(DIM)) {
-                        h.elements[element  ] |= P << (i % ORDER);
-                        h.elements[element+1] |= P >> (ORDER - i % ORDER);
-
-                        assert(h.elements[element  ] < (1U << ORDER));
-                        assert(h.elements[element+1] < (1U << ORDER));
-                    } else {
-                        h.elements[element  ] |= P << (i - element * ORDER);
-
-                        assert(h.elements[element  ] < (1U << ORDER));
-                    }
-                }
+                add_P(i, P, h);
 
                 if(i > 0) {
                     T   = calc_T(P);
@@ -150,8 +114,10 @@ namespace niwa {
             size_t T = calc_T(P);
             size_t tT = T;
 
-            for(int j=DIM-1; P > 0; P >>= 1U, --j) {
-                if(P & 1) {
+            // Distribute bits to coordinates. The top level is not
+            // transformed, so its bits are the Gray code of P.
+            for(int j=DIM-1; A > 0; A >>= 1U, --j) {
+                if(A & 1U) {
                     pt.elements[j] |= mask;
                 }
             }
@@ -161,7 +127,7 @@ namespace niwa {
             for(i -= DIM, mask >>= 1U; i >= 0; i -= DIM, mask >>= 1U) {
                 P = calc_P(i, H);
                 S = P ^ (P / 2U);
-                tS = calc_tS_tT(xJ, S);
+                tS = calc_inverse_tS_tT(xJ, S);
                 W ^= tT;
                 A = W ^ tS;
 
@@ -199,27 +165,28 @@ namespace niwa {
 
         template <size_t DIM, size_t ORDER>
         size_t Hilbert<DIM, ORDER>::calc_P(int i, HilbertPoint<DIM,ORDER> const& H) {
-            int const element = i / ORDER;
+            size_t P = 0;
 
-            size_t P = H.elements[element];
+            // The DIM bits may straddle any number of elements.
+            for(size_t bit=0; bit<DIM; ++bit) {
+                size_t const position = i + bit;
 
-            if (i % ORDER > static_cast<int>(ORDER) - static_cast<int>(DIM)) {
-                size_t temp1 = H.elements[element + 1];
-                P >>= i % ORDER;
-                temp1 <<= ORDER - i % ORDER;
-                P |= temp1;
-            } else {
-                P >>= i % ORDER; // P is a DIM bit point
-            }
-
-            // the & masks out spurious highbit values
-            if(DIM < ORDER) {
-                P &= (1U << DIM) - 1U;
+                P |= (H.elements[position / ORDER] >> (position % ORDER) & 1U) << bit;
             }
 
             return P;
         }
 
+        template <size_t DIM, size_t ORDER>
+        void Hilbert<DIM, ORDER>::add_P(int i, size_t P, HilbertPoint<DIM,ORDER>& H) {
+            // The DIM bits may straddle any number of elements.
+            for(size_t bit=0; bit<DIM; ++bit) {
+                size_t const position = i + bit;
+
+                H.elements[position / ORDER] |= (P >> bit & 1U) << (position % ORDER);
+            }
+        }
+
         template <size_t DIM, size_t ORDER>
         size_t Hilbert<DIM, ORDER>::calc_P2(size_t S) {
             size_t P = S & g_mask(0);
@@ -282,6 +249,21 @@ namespace niwa {
             return retval;
         }
 
+        template <size_t DIM, size_t ORDER>
+        size_t Hilbert<DIM, ORDER>::calc_inverse_tS_tT(size_t xJ, size_t val) {
+            size_t retval = val;
+
+            if((xJ % DIM) != 0) {
+                size_t temp1 = val << (xJ % DIM);
+                size_t temp2 = val >> (DIM - (xJ % DIM));
+
+                retval = temp1 | temp2;
+                retval &= (1U << DIM) - 1U;
+            }
+
+            return retval;
+        }
+
         template <size_t DIM, size_t ORDER>
         size_t Hilbert<DIM, ORDER>::g_mask(size_t index) {
             assert(index >= 0 && index < DIM);
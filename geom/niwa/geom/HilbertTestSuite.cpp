@@ -155,12 +155,61 @@ namespace niwa {
             }
         };
 
+        /**
+         * Tests 3-dimensional Hilbert curves whose orders are not
+         * multiples of the dimension, so that the DIM bits added
+         * per level straddle two elements of the encoded point.
+         * Encoding must invert decoding.
+         */
+        class Hilbert3Straddle : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(Hilbert3Straddle);
+            }
+
+            void test(ITestContext& context) const {
+                // All 4096 indices.
+                testOrder<4>(context, 1);
+
+                // Every 4099th of the 2^30 indices.
+                testOrder<10>(context, 4099);
+            }
+
+            template <size_t ORDER>
+            void testOrder(ITestContext& context, size_t step) const {
+                size_t const orderPow2 = 1 << ORDER;
+                size_t const nIndices = orderPow2 * orderPow2 * orderPow2;
+
+                for(size_t index=0; index<nIndices; index += step) {
+                    HilbertPoint<3,ORDER> const point = decodeIndex<ORDER>(index);
+
+                    context.assertEquals<size_t>(index,
+                        Hilbert<3,ORDER>::encode(point).index(),
+                        "encoding does not invert decoding");
+                }
+            }
+
+            /**
+             * @return The point at the given Hilbert index.
+             */
+            template <size_t ORDER>
+            static HilbertPoint<3,ORDER> decodeIndex(size_t index) {
+                HilbertPoint<3,ORDER> encoded;
+
+                for(size_t i=0; i<3; ++i) {
+                    encoded.elements[i] = (index >> (i * ORDER)) & ((1U << ORDER) - 1U);
+                }
+
+                return Hilbert<3,ORDER>::decode(encoded);
+            }
+        };
+
         std::type_info const& HilbertTestSuite::getType() const {
             return typeid(HilbertTestSuite);
         }
 
         size_t HilbertTestSuite::nCases() const {
-            return 3;
+            return 4;
         }
 
         ITestCase* HilbertTestSuite::newCase(size_t index) const {
@@ -171,6 +220,8 @@ namespace niwa {
                 return new Hilbert22();
             case 2:
                 return new Hilbert3();
+            case 3:
+                return new Hilbert3Straddle();
             default:
                 assert(false);
                 return 0;
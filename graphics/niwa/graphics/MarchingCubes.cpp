@@ -14,9 +14,12 @@
 #include "niwa/math/vec3f.h"
 #include "niwa/math/vec3i.h"
 #include "niwa/math/FastMath.h"
+#include "niwa/math/simd.h"
 
 #include "niwa/levelset/objects/Grid.h"
 
+#include "niwa/system/Profiler.h"
+
 #define NOMINMAX
 #include <windows.h>
 #include <gl/gl.h>
@@ -311,6 +314,8 @@ namespace niwa {
 
         void MarchingCubes::render(
                 levelset::objects::Grid const& grid) const {
+            NIWA_PROFILE_ZONE("marching cubes");
+
             __declspec(align(16)) const aabb bounds = grid.getBounds();
 
             __declspec(align(16)) const vec3i dimensions = grid.getDimensions();
@@ -470,7 +475,7 @@ namespace niwa {
                                 if(useVertexNormals_) {
                                     vec3f& normal = *triangles[i].normals[j];
 
-                                    normal *= invLengths.m128_f32[j];
+                                    normal *= math::simd<float, 4>(invLengths)[j];
 
                                     if(useOpenGl_) {
                                         glColor3fv(normal.getRaw());
@@ -8,35 +8,40 @@
 #ifndef NIWA_GRAPHICS_PACKEDSPECTRUM_H
 #define NIWA_GRAPHICS_PACKEDSPECTRUM_H
 
-#include <xmmintrin.h>
+#include "niwa/math/simd.h"
 
 #include "Spectrum.h"
 
+#include <new>
+
 namespace niwa {
     namespace graphics {
         /**
-        * A collection of four spectra
-        * (optimized for SSE). Must be aligned at 16-byte boundaries.
+        * A collection of N spectra, one math::simd<float, N>
+        * per channel. Must be aligned like math::simd<float, N>.
         */
-        __declspec(align(16)) class PackedSpectrum {
+        template<int N>
+        class BasicPackedSpectrum {
         public:
+            typedef math::simd<float, N> value_type;
+
             /**
              * Creates a zero spectrum.
              */
-            __forceinline PackedSpectrum();
+            __forceinline BasicPackedSpectrum();
 
-            __forceinline PackedSpectrum(
-                __m128 const& r_, __m128 const& g_, __m128 const& b_);
+            __forceinline BasicPackedSpectrum(
+                value_type const& r_, value_type const& g_, value_type const& b_);
 
             __forceinline void set(int i, Spectrum const& spectrum);
 
             __forceinline Spectrum get(int i) const;
 
-            __forceinline PackedSpectrum& operator += (PackedSpectrum const&);
+            __forceinline BasicPackedSpectrum& operator += (BasicPackedSpectrum const&);
 
-            __forceinline PackedSpectrum const operator * (__m128 const&) const;
+            __forceinline BasicPackedSpectrum const operator * (value_type const&) const;
 
-            __forceinline PackedSpectrum const operator & (__m128 const&) const;
+            __forceinline BasicPackedSpectrum const operator & (value_type const&) const;
 
         private: // prevent (trivial) heap instantiation
             void* operator new (size_t sz);
@@ -48,10 +53,16 @@ namespace niwa {
             void* operator new[] (size_t sz, void*);
 
         public:
-            __m128 r;
-            __m128 g;
-            __m128 b;
+            value_type r;
+            value_type g;
+            value_type b;
         };
+
+        /**
+        * A collection of four spectra
+        * (optimized for SSE). Must be aligned at 16-byte boundaries.
+        */
+        typedef BasicPackedSpectrum<4> PackedSpectrum;
     }
 }
 
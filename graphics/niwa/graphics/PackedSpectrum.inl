@@ -10,46 +10,46 @@
 
 namespace niwa {
     namespace graphics {
-        PackedSpectrum::PackedSpectrum()
-            : r(_mm_setzero_ps()), g(_mm_setzero_ps()), b(_mm_setzero_ps()) {
-            // ignored
+        template<int N>
+        BasicPackedSpectrum<N>::BasicPackedSpectrum() {
+            // ignored (value_type is zeroed)
         }
 
-        PackedSpectrum::PackedSpectrum(
-            __m128 const& r_, __m128 const& g_, __m128 const& b_) 
+        template<int N>
+        BasicPackedSpectrum<N>::BasicPackedSpectrum(
+            value_type const& r_, value_type const& g_, value_type const& b_) 
             : r(r_), g(g_), b(b_) {
             // ignored
         }
 
-        void PackedSpectrum::set(int i, Spectrum const& spectrum) {
-            r.m128_f32[i] = spectrum.r;
-            g.m128_f32[i] = spectrum.g;
-            b.m128_f32[i] = spectrum.b;
+        template<int N>
+        void BasicPackedSpectrum<N>::set(int i, Spectrum const& spectrum) {
+            r.set(i, spectrum.r);
+            g.set(i, spectrum.g);
+            b.set(i, spectrum.b);
         }
 
-        Spectrum PackedSpectrum::get(int i) const {
-            return Spectrum(r.m128_f32[i], g.m128_f32[i], b.m128_f32[i]);
+        template<int N>
+        Spectrum BasicPackedSpectrum<N>::get(int i) const {
+            return Spectrum(r[i], g[i], b[i]);
         }    
 
-        PackedSpectrum& PackedSpectrum::operator += (PackedSpectrum const& rhs) {
-            r = _mm_add_ps(r, rhs.r);
-            g = _mm_add_ps(g, rhs.g);
-            b = _mm_add_ps(b, rhs.b);
+        template<int N>
+        BasicPackedSpectrum<N>& BasicPackedSpectrum<N>::operator += (BasicPackedSpectrum const& rhs) {
+            r += rhs.r;
+            g += rhs.g;
+            b += rhs.b;
             return *this;
         } 
 
-        PackedSpectrum const PackedSpectrum::operator * (__m128 const& rhs) const {
-            return PackedSpectrum(
-                _mm_mul_ps(r, rhs),
-                _mm_mul_ps(g, rhs),
-                _mm_mul_ps(b, rhs));
+        template<int N>
+        BasicPackedSpectrum<N> const BasicPackedSpectrum<N>::operator * (value_type const& rhs) const {
+            return BasicPackedSpectrum(r * rhs, g * rhs, b * rhs);
         }
 
-        PackedSpectrum const PackedSpectrum::operator & (__m128 const& rhs) const {
-            return PackedSpectrum(
-                _mm_and_ps(r, rhs),
-                _mm_and_ps(g, rhs),
-                _mm_and_ps(b, rhs));
+        template<int N>
+        BasicPackedSpectrum<N> const BasicPackedSpectrum<N>::operator & (value_type const& rhs) const {
+            return BasicPackedSpectrum(r & rhs, g & rhs, b & rhs);
         }
     }
 }
@@ -12,5 +12,9 @@ namespace niwa {
         ILevelSet::~ILevelSet() {
             // ignored
         }
+
+        bool ILevelSet::getSurfaceBounds(geom::aabb& /*bounds*/) const {
+            return false;
+        }
     }
 }
\ No newline at end of file
@@ -11,6 +11,10 @@
 #include "niwa/math/vec3f.h"
 
 namespace niwa {
+    namespace geom {
+        class aabb;
+    }
+
     namespace levelset {
         /**
          * A level set (isosurface from an implicit function).
@@ -42,6 +46,15 @@ namespace niwa {
              *         fields, the gradient must have unit length.
              */
             virtual math::vec3f __fastcall gradient(math::vec3f const& position) const = 0;
+
+            /**
+             * The default implementation knows no bounds.
+             *
+             * @param bounds Receives a box containing the surface.
+             *
+             * @return Whether the bounds are known.
+             */
+            virtual bool getSurfaceBounds(geom::aabb& bounds) const;
         };
     }
 }
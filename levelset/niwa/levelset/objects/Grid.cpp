@@ -10,6 +10,8 @@
 #include "niwa/autodesk/Model.h"
 #include "niwa/autodesk/Object.h"
 
+#include "niwa/system/AlignedMemory.h"
+
 #include <boost/array.hpp>
 
 #include <queue>
@@ -61,7 +63,7 @@ namespace niwa {
             using geom::aabb;
 
             Grid::~Grid() {
-                _mm_free(values_);
+                system::AlignedMemory::free(values_);
             }
 
             bool Grid::isDistanceField() const {
@@ -190,6 +192,12 @@ namespace niwa {
                 return gradient;
             }
 
+            bool Grid::getSurfaceBounds(geom::aabb& bounds) const {
+                bounds = bounds_;
+
+                return true;
+            }
+
             Grid::Grid(
                     aabb const& bounds, vec3i const& dimensions, 
                     float* values, bool isDistanceField)
@@ -36,6 +36,8 @@ namespace niwa {
 
                 math::vec3f __fastcall gradient(math::vec3f const& position) const;
 
+                bool getSurfaceBounds(geom::aabb& bounds) const;
+
             public: // new functions
                 geom::aabb const& getBounds() const;
 
@@ -15,6 +15,8 @@
 
 #include "niwa/logging/Logger.h"
 
+#include "niwa/system/AlignedMemory.h"
+
 #include <limits>
 #include <map>
 #include <vector>
@@ -369,11 +371,8 @@ namespace {
 
 namespace {
     static float* allocateFloatArray(int size) {
-        void* p = _mm_malloc(size * sizeof(float), 16);
-        if(!p) {
-            throw std::bad_alloc(); // ansi-iso compliant
-        }
-        return static_cast<float*>(p);
+        return static_cast<float*>(niwa::system::AlignedMemory::allocate(
+            size * sizeof(float), 16, niwa::system::MEMORY_LEVELSET));
     }
 }
 
@@ -7,6 +7,8 @@
 
 #include "niwa/levelset/objects/Sphere.h"
 
+#include "niwa/geom/aabb.h"
+
 namespace niwa {
     namespace levelset {
         namespace objects {
@@ -44,6 +46,14 @@ namespace niwa {
             bool Sphere::isDistanceField() const {
                 return true;
             }
+
+            bool Sphere::getSurfaceBounds(geom::aabb& bounds) const {
+                vec3f const extent(radius_, radius_, radius_);
+
+                bounds = geom::aabb(position_ - extent, position_ + extent);
+
+                return true;
+            }
         }
     }
 }
\ No newline at end of file
@@ -32,6 +32,8 @@ namespace niwa {
 
                 bool isDistanceField() const;
 
+                bool getSurfaceBounds(geom::aabb& bounds) const;
+
             private:
                 math::vec3f position_;
 
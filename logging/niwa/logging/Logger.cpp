@@ -10,7 +10,9 @@
 #include "IAppender.h"
 #include "Level.h"
 
-#include "niwa/system/SpinLock.h"
+#include "niwa/system/LockStatistics.h"
+#include "niwa/system/Profiler.h"
+#include "niwa/system/TicketLock.h"
 #include "niwa/system/ScopedAcquire.h"
 
 #include <set>
@@ -21,7 +23,28 @@ namespace {
     static const niwa::logging::Level* volatile gLevel = 
         &niwa::logging::Level::info();
 
-    static niwa::system::SpinLock gLock;
+    /**
+     * Held while appending, which may take a while,
+     * so the waiters are served in order.
+     */
+    static niwa::system::TicketLock gLock;
+
+    static niwa::system::LockStatistics gLockStatistics;
+
+#ifdef NIWA_SYSTEM_PROFILING
+    /**
+     * Attaches the statistics to the lock
+     * during static initialization.
+     */
+    class LockStatisticsAttacher {
+    public:
+        LockStatisticsAttacher() {
+            gLock.setStatistics(&gLockStatistics);
+        }
+    };
+
+    static LockStatisticsAttacher gLockStatisticsAttacher;
+#endif
 
     /**
      * Elements not owned.
@@ -94,6 +117,11 @@ namespace niwa {
             gAppenders.erase(appender);
         }
 
+        __declspec(dllexport)
+        system::LockStatistics& Logger::getLockStatistics() {
+            return gLockStatistics;
+        }
+
         void Logger::append(
                 Logger const& logger,
                 Level const& level, std::string const& str) {
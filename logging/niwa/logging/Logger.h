@@ -14,6 +14,12 @@ namespace std {
     class type_info;
 }
 
+namespace niwa {
+    namespace system {
+        class LockStatistics;
+    }
+}
+
 namespace niwa {
     namespace logging {
         class IAppender;
@@ -136,6 +142,13 @@ namespace niwa {
             __declspec(dllexport)
             static void removeAppender(IAppender* appender);
 
+            /**
+             * The contention of the lock held while appending;
+             * counted only if NIWA_SYSTEM_PROFILING is defined.
+             */
+            __declspec(dllexport)
+            static system::LockStatistics& getLockStatistics();
+
             __declspec(dllexport)
             Line debug();
 
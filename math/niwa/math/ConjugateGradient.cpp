@@ -20,6 +20,22 @@ namespace niwa {
             // ignored
         }
 
+        void ConjugateGradient::solve(
+                int n,
+                void (*op)(Vector const&, Vector &, void*),
+                void* arg,
+                Vector const& b,
+                Vector& x) {
+            Vector workspace(getWorkspaceSize(n), Vector::Uninitialized);
+
+            solve(n, op, arg, b, x, workspace.getRaw());
+        }
+
+        int ConjugateGradient::getWorkspaceSize(int n) {
+            // Three vectors, each padded to whole SSE registers.
+            return 3 * ((n + 3) & ~3);
+        }
+
         /**
          * After Shewchuk's paper
          * "Introduction to The Conjugate Gradient Method
@@ -30,10 +46,13 @@ namespace niwa {
                 void (*op)(Vector const&, Vector &, void*),
                 void* arg,
                 Vector const& b,
-                Vector& x) {
-            Vector r(n, Vector::Uninitialized);
-            Vector d(n, Vector::Uninitialized);
-            Vector q(n, Vector::Uninitialized);
+                Vector& x,
+                float* workspace) {
+            int const stride = (n + 3) & ~3;
+
+            Vector r(n, workspace, Vector::Uninitialized);
+            Vector d(n, workspace + stride, Vector::Uninitialized);
+            Vector q(n, workspace + 2 * stride, Vector::Uninitialized);
 
             op(x, r, arg);
             
@@ -40,6 +40,28 @@ namespace niwa {
                 blas::Vector const& b,
                 blas::Vector& x);
 
+            /**
+             * Like the other solve, but with caller-provided
+             * temporaries, so that repeated solves need not
+             * allocate.
+             *
+             * @param workspace At least getWorkspaceSize(n)
+             *                  floats, aligned to 16 bytes.
+             */
+            void solve(
+                int n,
+                void (*op)(blas::Vector const&, blas::Vector&, void* arg),
+                void* arg,
+                blas::Vector const& b,
+                blas::Vector& x,
+                float* workspace);
+
+            /**
+             * @return The number of floats in the workspace
+             *         of an n-dimensional problem.
+             */
+            static int getWorkspaceSize(int n);
+
         private:
             int maxIterations_;
 
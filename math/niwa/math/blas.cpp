@@ -7,13 +7,15 @@
 
 #include "blas.h"
 
+#include "simd.h"
+
 #include <xmmintrin.h>
 #include <memory>
 
 namespace niwa {
     namespace math {
         namespace blas {
-            Vector::Vector(int n, Initialization initialization) {
+            Vector::Vector(int n, Initialization initialization) : isOwner_(true) {
                 data_ = static_cast<float*>(_mm_malloc(n * sizeof(float), 16));
 
                 if(!data_) {
@@ -25,8 +27,17 @@ namespace niwa {
                 }
             }
 
+            Vector::Vector(int n, float* storage, Initialization initialization)
+                : data_(storage), isOwner_(false) {
+                if(initialization == Zero) {
+                    szero(n, *this);
+                }
+            }
+
             Vector::~Vector() {
-                _mm_free(data_);
+                if(isOwner_) {
+                    _mm_free(data_);
+                }
             }
 
             float const* Vector::getRaw() const {
@@ -128,11 +139,7 @@ namespace niwa {
                     dot128 = _mm_add_ps(dot128, _mm_mul_ps(x128[i], y128[i]));
                 }
               
-                float dot = 0;
-
-                for(int i=0; i<4; ++i) {
-                    dot += dot128.m128_f32[i];
-                }
+                float dot = horizontalSum(simd<float, 4>(dot128));
 
                 for(int i=m*4; i<n; ++i) {
                     dot += x[i] * y[i];
@@ -24,6 +24,15 @@ namespace niwa {
             public:
                 Vector(int n, Initialization initialization);
 
+                /**
+                 * A vector over the given storage, e.g., from a
+                 * frame arena; the storage is not owned.
+                 *
+                 * @param storage At least n floats,
+                 *                aligned to 16 bytes.
+                 */
+                Vector(int n, float* storage, Initialization initialization);
+
                 ~Vector();
 
                 __forceinline float operator[] (int index) const;
@@ -39,7 +48,9 @@ namespace niwa {
                 Vector& operator = (Vector const&);
 
             private:
-                float* data_; // owned
+                float* data_; // owned if isOwner_
+
+                bool isOwner_;
             };
 
             void szero(int n, Vector& x);
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2009.
+ */
+
+#ifndef NIWA_MATH_PACKED_VEC3_H
+#define NIWA_MATH_PACKED_VEC3_H
+
+#include "simd.h"
+#include "vec3f.h"
+
+#include <new>
+
+namespace niwa {
+    namespace math {
+        /**
+         * A collection of N three-dimensional vectors,
+         * one simd<float, N> per coordinate. Must be
+         * aligned like simd<float, N>.
+         */
+        template<int N>
+        class packed_vec3 {
+        public:
+            typedef simd<float, N> value_type;
+
+            static const int WIDTH = N;
+
+            static packed_vec3 __forceinline createUninitialized();
+
+            /**
+             * Creates a zero vector.
+             */
+            __forceinline packed_vec3();
+
+            /**
+             * Creates a packed vector with equal components.
+             *
+             * @param vec The equal component.
+             */
+            __forceinline explicit packed_vec3(vec3f const& vec);
+
+            __forceinline packed_vec3(value_type const& x_, value_type const& y_, value_type const& z_);
+
+            /**
+             * Sets a component of the packed vector.
+             *
+             * @param i Between zero (inclusive) and N (exclusive).
+             */
+            __forceinline void set(int i, vec3f const& vec);
+
+            /**
+             * Gets a component of the packed vector.
+             *
+             * @param i Between zero (inclusive) and N (exclusive).
+             */
+            __forceinline vec3f get(int i) const;
+
+            __forceinline value_type length() const;
+
+            __forceinline value_type squareLength() const;
+
+            __forceinline const packed_vec3 operator + (packed_vec3 const& rhs) const;
+            __forceinline const packed_vec3 operator - (packed_vec3 const& rhs) const;
+            __forceinline const packed_vec3 operator * (value_type const& rhs) const;
+
+            __forceinline const value_type dot(packed_vec3 const& rhs) const;
+
+            __forceinline packed_vec3& operator *= (value_type const& rhs);
+            __forceinline packed_vec3& operator /= (value_type const& rhs);
+
+            __forceinline void normalizeApproximate();
+
+            __forceinline void normalizeAccurate();
+
+        private: // prevent (trivial) heap instantiation
+            void* operator new (size_t sz);
+            void* operator new (size_t sz, std::nothrow_t);
+            void* operator new (size_t sz, void*);
+
+            void* operator new[] (size_t sz);
+            void* operator new[] (size_t sz, std::nothrow_t);
+            void* operator new[] (size_t sz, void*);
+
+        public:
+            value_type x;
+            value_type y;
+            value_type z;
+        };
+    }
+}
+
+#include "packed_vec3.inl"
+
+#endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2009.
+ */
+
+#ifndef NIWA_MATH_PACKED_VEC3_INL
+#define NIWA_MATH_PACKED_VEC3_INL
+
+namespace niwa {
+    namespace math {
+        template<int N>
+        packed_vec3<N> packed_vec3<N>::createUninitialized() {
+            // TODO: the uninitialized version fails with debugging; find a workaround.
+            return packed_vec3();
+        }
+
+        template<int N>
+        packed_vec3<N>::packed_vec3() {
+            // ignored (value_type is zeroed)
+        }
+
+        template<int N>
+        packed_vec3<N>::packed_vec3(vec3f const& vec) 
+            : x(vec.x), y(vec.y), z(vec.z) {
+            // ignored
+        }
+
+        template<int N>
+        packed_vec3<N>::packed_vec3(
+            value_type const& x_, value_type const& y_, value_type const& z_) 
+            : x(x_), y(y_), z(z_) {
+            // ignored
+        }
+
+        template<int N>
+        void packed_vec3<N>::set(int i, vec3f const& vec) {
+            x.set(i, vec.x);
+            y.set(i, vec.y);
+            z.set(i, vec.z);
+        }
+
+        template<int N>
+        vec3f packed_vec3<N>::get(int i) const {
+            return vec3f(x[i], y[i], z[i]);
+        }
+
+        template<int N>
+        typename packed_vec3<N>::value_type packed_vec3<N>::length() const {
+            return squareRoot(squareLength());
+        }
+
+        template<int N>
+        typename packed_vec3<N>::value_type packed_vec3<N>::squareLength() const {
+            return x*x + (y*y + z*z);
+        }
+
+        template<int N>
+        const packed_vec3<N> packed_vec3<N>::operator + (packed_vec3 const& rhs) const {
+            return packed_vec3(x + rhs.x, y + rhs.y, z + rhs.z);
+        }
+
+        template<int N>
+        const packed_vec3<N> packed_vec3<N>::operator - (packed_vec3 const& rhs) const {
+            return packed_vec3(x - rhs.x, y - rhs.y, z - rhs.z);
+        }
+
+        template<int N>
+        const packed_vec3<N> packed_vec3<N>::operator * (value_type const& rhs) const {
+            return packed_vec3(x * rhs, y * rhs, z * rhs);
+        }
+
+        template<int N>
+        const typename packed_vec3<N>::value_type packed_vec3<N>::dot(packed_vec3 const& rhs) const {
+            return x*rhs.x + (y*rhs.y + z*rhs.z);
+        }
+
+        template<int N>
+        packed_vec3<N>& packed_vec3<N>::operator *= (value_type const& rhs) {
+            x *= rhs;
+            y *= rhs;
+            z *= rhs;
+            return *this;
+        }
+
+        template<int N>
+        packed_vec3<N>& packed_vec3<N>::operator /= (value_type const& rhs) {
+            return *this *= reciprocalApproximate(rhs);
+        }
+
+        template<int N>
+        void packed_vec3<N>::normalizeApproximate() {
+            *this *= inverseSqrtApproximate(squareLength());
+        }
+
+        template<int N>
+        void packed_vec3<N>::normalizeAccurate() {
+            *this *= value_type(1.0f) / length();
+        }
+    }
+}
+
+#endif
\ No newline at end of file
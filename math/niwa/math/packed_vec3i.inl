@@ -39,13 +39,32 @@ namespace niwa {
         }
 
         void packed_vec3i::set(int i, vec3i const& vec) {
-            x.m128_i32[i] = vec.x;
-            y.m128_i32[i] = vec.y;
-            z.m128_i32[i] = vec.z;
+            // The lanes go through memory; m128_i32 is MSVC only.
+            __declspec(align(16)) int lanes[4];
+
+            _mm_store_ps(reinterpret_cast<float*>(lanes), x);
+            lanes[i] = vec.x;
+            x = _mm_load_ps(reinterpret_cast<float const*>(lanes));
+
+            _mm_store_ps(reinterpret_cast<float*>(lanes), y);
+            lanes[i] = vec.y;
+            y = _mm_load_ps(reinterpret_cast<float const*>(lanes));
+
+            _mm_store_ps(reinterpret_cast<float*>(lanes), z);
+            lanes[i] = vec.z;
+            z = _mm_load_ps(reinterpret_cast<float const*>(lanes));
         }
 
         vec3i packed_vec3i::get(int i) const {
-            return vec3i(x.m128_i32[i], y.m128_i32[i], z.m128_i32[i]);
+            __declspec(align(16)) int xs[4];
+            __declspec(align(16)) int ys[4];
+            __declspec(align(16)) int zs[4];
+
+            _mm_store_ps(reinterpret_cast<float*>(xs), x);
+            _mm_store_ps(reinterpret_cast<float*>(ys), y);
+            _mm_store_ps(reinterpret_cast<float*>(zs), z);
+
+            return vec3i(xs[i], ys[i], zs[i]);
         }
     }
 }
@@ -0,0 +1,321 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_MATH_SIMD_H
+#define NIWA_MATH_SIMD_H
+
+#include <emmintrin.h>
+
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/**
+ * The widest simd<float, N> compiled into this translation
+ * unit. Wider backends exist only in units compiled for them
+ * (e.g., /arch:AVX2 or -mavx2), and code from those units may
+ * only run when the processor supports them (see KernelTable).
+ */
+#if defined(__AVX512F__)
+#define NIWA_MATH_SIMD_MAX_WIDTH 16
+#elif defined(__AVX__)
+#define NIWA_MATH_SIMD_MAX_WIDTH 8
+#else
+#define NIWA_MATH_SIMD_MAX_WIDTH 4
+#endif
+
+/**
+ * The inline namespace of the backends. Their code depends on
+ * the instruction set of the unit, so each set gets names of its
+ * own; otherwise the linker could keep, e.g., the AVX copy of an
+ * inline function that was not inlined for SSE callers too.
+ * FMA changes multiplyAdd, so it counts as AVX2.
+ */
+#if defined(__AVX512F__)
+#define NIWA_MATH_SIMD_ISA avx512
+#elif defined(__AVX2__) || defined(__FMA__)
+#define NIWA_MATH_SIMD_ISA avx2
+#elif defined(__AVX__)
+#define NIWA_MATH_SIMD_ISA avx
+#else
+#define NIWA_MATH_SIMD_ISA sse2
+#endif
+
+namespace niwa {
+    namespace math {
+        inline namespace NIWA_MATH_SIMD_ISA {
+            /**
+             * N lanes of T in one SIMD register. Kernels written
+             * against simd<float, N> compile at any width; widening
+             * one is a change of the template argument.
+             *
+             * Comparisons return masks with all bits of a lane
+             * set or clear, for use with operator & and select.
+             *
+             * Converts implicitly to and from the native register
+             * type, so intrinsics can still be mixed in.
+             */
+            template<typename T, int N>
+            class simd;
+
+            /**
+             * Four floats in an SSE register.
+             */
+            template<>
+            class simd<float, 4> {
+            public:
+                typedef __m128 native_type;
+
+                static const int WIDTH = 4;
+
+                static __forceinline simd zero();
+
+                /**
+                 * @param values Aligned to sizeof(simd).
+                 */
+                static __forceinline simd load(float const* values);
+
+                static __forceinline simd loadUnaligned(float const* values);
+
+                /**
+                 * Creates a zero vector.
+                 */
+                __forceinline simd();
+
+                /**
+                 * Creates a vector with equal lanes.
+                 */
+                __forceinline explicit simd(float value);
+
+                __forceinline simd(native_type const& native);
+
+                __forceinline operator native_type () const;
+
+                /**
+                 * @param values Aligned to sizeof(simd).
+                 */
+                __forceinline void store(float* values) const;
+
+                __forceinline void storeUnaligned(float* values) const;
+
+                /**
+                 * @param i Between zero (inclusive) and WIDTH (exclusive).
+                 */
+                __forceinline float operator [] (int i) const;
+
+                /**
+                 * @param i Between zero (inclusive) and WIDTH (exclusive).
+                 */
+                __forceinline void set(int i, float value);
+
+                /**
+                 * @return The sign bits of the lanes; bit i for lane i.
+                 */
+                __forceinline int getMask() const;
+
+                __forceinline simd operator + (simd const& rhs) const;
+                __forceinline simd operator - (simd const& rhs) const;
+                __forceinline simd operator * (simd const& rhs) const;
+                __forceinline simd operator / (simd const& rhs) const;
+
+                __forceinline simd operator & (simd const& rhs) const;
+                __forceinline simd operator | (simd const& rhs) const;
+                __forceinline simd operator ^ (simd const& rhs) const;
+
+                __forceinline simd operator < (simd const& rhs) const;
+                __forceinline simd operator <= (simd const& rhs) const;
+                __forceinline simd operator > (simd const& rhs) const;
+                __forceinline simd operator >= (simd const& rhs) const;
+                __forceinline simd operator == (simd const& rhs) const;
+                __forceinline simd operator != (simd const& rhs) const;
+
+                __forceinline simd& operator += (simd const& rhs);
+                __forceinline simd& operator -= (simd const& rhs);
+                __forceinline simd& operator *= (simd const& rhs);
+                __forceinline simd& operator /= (simd const& rhs);
+
+            public:
+                native_type v;
+            };
+
+            __forceinline simd<float, 4> minimum(simd<float, 4> const& a, simd<float, 4> const& b);
+            __forceinline simd<float, 4> maximum(simd<float, 4> const& a, simd<float, 4> const& b);
+            __forceinline simd<float, 4> squareRoot(simd<float, 4> const& a);
+
+            /**
+             * @return About 12 bits of 1/a.
+             */
+            __forceinline simd<float, 4> reciprocalApproximate(simd<float, 4> const& a);
+
+            /**
+             * @return About 12 bits of 1/sqrt(a).
+             */
+            __forceinline simd<float, 4> inverseSqrtApproximate(simd<float, 4> const& a);
+
+            /**
+             * @return a*b+c, fused if the unit is compiled for FMA.
+             */
+            __forceinline simd<float, 4> multiplyAdd(
+                simd<float, 4> const& a, simd<float, 4> const& b, simd<float, 4> const& c);
+
+            /**
+             * @return ifTrue in the lanes set in mask, ifFalse elsewhere.
+             */
+            __forceinline simd<float, 4> select(
+                simd<float, 4> const& mask, simd<float, 4> const& ifTrue, simd<float, 4> const& ifFalse);
+
+            /**
+             * @return The sum of the lanes.
+             */
+            __forceinline float horizontalSum(simd<float, 4> const& a);
+
+#if NIWA_MATH_SIMD_MAX_WIDTH >= 8
+            /**
+             * Eight floats in an AVX register.
+             */
+            template<>
+            class simd<float, 8> {
+            public:
+                typedef __m256 native_type;
+
+                static const int WIDTH = 8;
+
+                static __forceinline simd zero();
+                static __forceinline simd load(float const* values);
+                static __forceinline simd loadUnaligned(float const* values);
+
+                __forceinline simd();
+                __forceinline explicit simd(float value);
+                __forceinline simd(native_type const& native);
+
+                __forceinline operator native_type () const;
+
+                __forceinline void store(float* values) const;
+                __forceinline void storeUnaligned(float* values) const;
+
+                __forceinline float operator [] (int i) const;
+                __forceinline void set(int i, float value);
+
+                __forceinline int getMask() const;
+
+                __forceinline simd operator + (simd const& rhs) const;
+                __forceinline simd operator - (simd const& rhs) const;
+                __forceinline simd operator * (simd const& rhs) const;
+                __forceinline simd operator / (simd const& rhs) const;
+
+                __forceinline simd operator & (simd const& rhs) const;
+                __forceinline simd operator | (simd const& rhs) const;
+                __forceinline simd operator ^ (simd const& rhs) const;
+
+                __forceinline simd operator < (simd const& rhs) const;
+                __forceinline simd operator <= (simd const& rhs) const;
+                __forceinline simd operator > (simd const& rhs) const;
+                __forceinline simd operator >= (simd const& rhs) const;
+                __forceinline simd operator == (simd const& rhs) const;
+                __forceinline simd operator != (simd const& rhs) const;
+
+                __forceinline simd& operator += (simd const& rhs);
+                __forceinline simd& operator -= (simd const& rhs);
+                __forceinline simd& operator *= (simd const& rhs);
+                __forceinline simd& operator /= (simd const& rhs);
+
+            public:
+                native_type v;
+            };
+
+            __forceinline simd<float, 8> minimum(simd<float, 8> const& a, simd<float, 8> const& b);
+            __forceinline simd<float, 8> maximum(simd<float, 8> const& a, simd<float, 8> const& b);
+            __forceinline simd<float, 8> squareRoot(simd<float, 8> const& a);
+            __forceinline simd<float, 8> reciprocalApproximate(simd<float, 8> const& a);
+            __forceinline simd<float, 8> inverseSqrtApproximate(simd<float, 8> const& a);
+
+            __forceinline simd<float, 8> multiplyAdd(
+                simd<float, 8> const& a, simd<float, 8> const& b, simd<float, 8> const& c);
+
+            __forceinline simd<float, 8> select(
+                simd<float, 8> const& mask, simd<float, 8> const& ifTrue, simd<float, 8> const& ifFalse);
+
+            __forceinline float horizontalSum(simd<float, 8> const& a);
+#endif
+
+#if NIWA_MATH_SIMD_MAX_WIDTH >= 16
+            /**
+             * Sixteen floats in an AVX-512 register. Only AVX-512F
+             * instructions are used; masks are kept in vectors,
+             * as with the narrower widths.
+             */
+            template<>
+            class simd<float, 16> {
+            public:
+                typedef __m512 native_type;
+
+                static const int WIDTH = 16;
+
+                static __forceinline simd zero();
+                static __forceinline simd load(float const* values);
+                static __forceinline simd loadUnaligned(float const* values);
+
+                __forceinline simd();
+                __forceinline explicit simd(float value);
+                __forceinline simd(native_type const& native);
+
+                __forceinline operator native_type () const;
+
+                __forceinline void store(float* values) const;
+                __forceinline void storeUnaligned(float* values) const;
+
+                __forceinline float operator [] (int i) const;
+                __forceinline void set(int i, float value);
+
+                __forceinline int getMask() const;
+
+                __forceinline simd operator + (simd const& rhs) const;
+                __forceinline simd operator - (simd const& rhs) const;
+                __forceinline simd operator * (simd const& rhs) const;
+                __forceinline simd operator / (simd const& rhs) const;
+
+                __forceinline simd operator & (simd const& rhs) const;
+                __forceinline simd operator | (simd const& rhs) const;
+                __forceinline simd operator ^ (simd const& rhs) const;
+
+                __forceinline simd operator < (simd const& rhs) const;
+                __forceinline simd operator <= (simd const& rhs) const;
+                __forceinline simd operator > (simd const& rhs) const;
+                __forceinline simd operator >= (simd const& rhs) const;
+                __forceinline simd operator == (simd const& rhs) const;
+                __forceinline simd operator != (simd const& rhs) const;
+
+                __forceinline simd& operator += (simd const& rhs);
+                __forceinline simd& operator -= (simd const& rhs);
+                __forceinline simd& operator *= (simd const& rhs);
+                __forceinline simd& operator /= (simd const& rhs);
+
+            public:
+                native_type v;
+            };
+
+            __forceinline simd<float, 16> minimum(simd<float, 16> const& a, simd<float, 16> const& b);
+            __forceinline simd<float, 16> maximum(simd<float, 16> const& a, simd<float, 16> const& b);
+            __forceinline simd<float, 16> squareRoot(simd<float, 16> const& a);
+            __forceinline simd<float, 16> reciprocalApproximate(simd<float, 16> const& a);
+            __forceinline simd<float, 16> inverseSqrtApproximate(simd<float, 16> const& a);
+
+            __forceinline simd<float, 16> multiplyAdd(
+                simd<float, 16> const& a, simd<float, 16> const& b, simd<float, 16> const& c);
+
+            __forceinline simd<float, 16> select(
+                simd<float, 16> const& mask, simd<float, 16> const& ifTrue, simd<float, 16> const& ifFalse);
+
+            __forceinline float horizontalSum(simd<float, 16> const& a);
+#endif
+        }
+    }
+}
+
+#include "simd.inl"
+
+#endif
\ No newline at end of file
@@ -0,0 +1,538 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_MATH_SIMD_INL
+#define NIWA_MATH_SIMD_INL
+
+namespace niwa {
+    namespace math {
+        inline namespace NIWA_MATH_SIMD_ISA {
+            // simd<float, 4>
+
+            simd<float, 4> simd<float, 4>::zero() {
+                return simd(_mm_setzero_ps());
+            }
+
+            simd<float, 4> simd<float, 4>::load(float const* values) {
+                return simd(_mm_load_ps(values));
+            }
+
+            simd<float, 4> simd<float, 4>::loadUnaligned(float const* values) {
+                return simd(_mm_loadu_ps(values));
+            }
+
+            simd<float, 4>::simd() : v(_mm_setzero_ps()) {
+                // ignored
+            }
+
+            simd<float, 4>::simd(float value) : v(_mm_set_ps1(value)) {
+                // ignored
+            }
+
+            simd<float, 4>::simd(native_type const& native) : v(native) {
+                // ignored
+            }
+
+            simd<float, 4>::operator __m128 () const {
+                return v;
+            }
+
+            void simd<float, 4>::store(float* values) const {
+                _mm_store_ps(values, v);
+            }
+
+            void simd<float, 4>::storeUnaligned(float* values) const {
+                _mm_storeu_ps(values, v);
+            }
+
+            float simd<float, 4>::operator [] (int i) const {
+                float lanes[WIDTH];
+                _mm_storeu_ps(lanes, v);
+                return lanes[i];
+            }
+
+            void simd<float, 4>::set(int i, float value) {
+                float lanes[WIDTH];
+                _mm_storeu_ps(lanes, v);
+                lanes[i] = value;
+                v = _mm_loadu_ps(lanes);
+            }
+
+            int simd<float, 4>::getMask() const {
+                return _mm_movemask_ps(v);
+            }
+
+            simd<float, 4> simd<float, 4>::operator + (simd const& rhs) const {
+                return simd(_mm_add_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator - (simd const& rhs) const {
+                return simd(_mm_sub_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator * (simd const& rhs) const {
+                return simd(_mm_mul_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator / (simd const& rhs) const {
+                return simd(_mm_div_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator & (simd const& rhs) const {
+                return simd(_mm_and_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator | (simd const& rhs) const {
+                return simd(_mm_or_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator ^ (simd const& rhs) const {
+                return simd(_mm_xor_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator < (simd const& rhs) const {
+                return simd(_mm_cmplt_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator <= (simd const& rhs) const {
+                return simd(_mm_cmple_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator > (simd const& rhs) const {
+                return simd(_mm_cmpgt_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator >= (simd const& rhs) const {
+                return simd(_mm_cmpge_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator == (simd const& rhs) const {
+                return simd(_mm_cmpeq_ps(v, rhs.v));
+            }
+
+            simd<float, 4> simd<float, 4>::operator != (simd const& rhs) const {
+                return simd(_mm_cmpneq_ps(v, rhs.v));
+            }
+
+            simd<float, 4>& simd<float, 4>::operator += (simd const& rhs) {
+                v = _mm_add_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 4>& simd<float, 4>::operator -= (simd const& rhs) {
+                v = _mm_sub_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 4>& simd<float, 4>::operator *= (simd const& rhs) {
+                v = _mm_mul_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 4>& simd<float, 4>::operator /= (simd const& rhs) {
+                v = _mm_div_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 4> minimum(simd<float, 4> const& a, simd<float, 4> const& b) {
+                return simd<float, 4>(_mm_min_ps(a.v, b.v));
+            }
+
+            simd<float, 4> maximum(simd<float, 4> const& a, simd<float, 4> const& b) {
+                return simd<float, 4>(_mm_max_ps(a.v, b.v));
+            }
+
+            simd<float, 4> squareRoot(simd<float, 4> const& a) {
+                return simd<float, 4>(_mm_sqrt_ps(a.v));
+            }
+
+            simd<float, 4> reciprocalApproximate(simd<float, 4> const& a) {
+                return simd<float, 4>(_mm_rcp_ps(a.v));
+            }
+
+            simd<float, 4> inverseSqrtApproximate(simd<float, 4> const& a) {
+                return simd<float, 4>(_mm_rsqrt_ps(a.v));
+            }
+
+            simd<float, 4> multiplyAdd(
+                    simd<float, 4> const& a, simd<float, 4> const& b, simd<float, 4> const& c) {
+#if defined(__FMA__) || defined(__AVX2__)
+                return simd<float, 4>(_mm_fmadd_ps(a.v, b.v, c.v));
+#else
+                return simd<float, 4>(_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v));
+#endif
+            }
+
+            simd<float, 4> select(
+                    simd<float, 4> const& mask, simd<float, 4> const& ifTrue, simd<float, 4> const& ifFalse) {
+                return simd<float, 4>(_mm_or_ps(
+                    _mm_and_ps(mask.v, ifTrue.v),
+                    _mm_andnot_ps(mask.v, ifFalse.v)));
+            }
+
+            float horizontalSum(simd<float, 4> const& a) {
+                __m128 const pairs = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+
+                return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+            }
+
+#if NIWA_MATH_SIMD_MAX_WIDTH >= 8
+            // simd<float, 8>
+
+            simd<float, 8> simd<float, 8>::zero() {
+                return simd(_mm256_setzero_ps());
+            }
+
+            simd<float, 8> simd<float, 8>::load(float const* values) {
+                return simd(_mm256_load_ps(values));
+            }
+
+            simd<float, 8> simd<float, 8>::loadUnaligned(float const* values) {
+                return simd(_mm256_loadu_ps(values));
+            }
+
+            simd<float, 8>::simd() : v(_mm256_setzero_ps()) {
+                // ignored
+            }
+
+            simd<float, 8>::simd(float value) : v(_mm256_set1_ps(value)) {
+                // ignored
+            }
+
+            simd<float, 8>::simd(native_type const& native) : v(native) {
+                // ignored
+            }
+
+            simd<float, 8>::operator __m256 () const {
+                return v;
+            }
+
+            void simd<float, 8>::store(float* values) const {
+                _mm256_store_ps(values, v);
+            }
+
+            void simd<float, 8>::storeUnaligned(float* values) const {
+                _mm256_storeu_ps(values, v);
+            }
+
+            float simd<float, 8>::operator [] (int i) const {
+                float lanes[WIDTH];
+                _mm256_storeu_ps(lanes, v);
+                return lanes[i];
+            }
+
+            void simd<float, 8>::set(int i, float value) {
+                float lanes[WIDTH];
+                _mm256_storeu_ps(lanes, v);
+                lanes[i] = value;
+                v = _mm256_loadu_ps(lanes);
+            }
+
+            int simd<float, 8>::getMask() const {
+                return _mm256_movemask_ps(v);
+            }
+
+            simd<float, 8> simd<float, 8>::operator + (simd const& rhs) const {
+                return simd(_mm256_add_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator - (simd const& rhs) const {
+                return simd(_mm256_sub_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator * (simd const& rhs) const {
+                return simd(_mm256_mul_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator / (simd const& rhs) const {
+                return simd(_mm256_div_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator & (simd const& rhs) const {
+                return simd(_mm256_and_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator | (simd const& rhs) const {
+                return simd(_mm256_or_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator ^ (simd const& rhs) const {
+                return simd(_mm256_xor_ps(v, rhs.v));
+            }
+
+            simd<float, 8> simd<float, 8>::operator < (simd const& rhs) const {
+                return simd(_mm256_cmp_ps(v, rhs.v, _CMP_LT_OQ));
+            }
+
+            simd<float, 8> simd<float, 8>::operator <= (simd const& rhs) const {
+                return simd(_mm256_cmp_ps(v, rhs.v, _CMP_LE_OQ));
+            }
+
+            simd<float, 8> simd<float, 8>::operator > (simd const& rhs) const {
+                return simd(_mm256_cmp_ps(v, rhs.v, _CMP_GT_OQ));
+            }
+
+            simd<float, 8> simd<float, 8>::operator >= (simd const& rhs) const {
+                return simd(_mm256_cmp_ps(v, rhs.v, _CMP_GE_OQ));
+            }
+
+            simd<float, 8> simd<float, 8>::operator == (simd const& rhs) const {
+                return simd(_mm256_cmp_ps(v, rhs.v, _CMP_EQ_OQ));
+            }
+
+            simd<float, 8> simd<float, 8>::operator != (simd const& rhs) const {
+                return simd(_mm256_cmp_ps(v, rhs.v, _CMP_NEQ_UQ));
+            }
+
+            simd<float, 8>& simd<float, 8>::operator += (simd const& rhs) {
+                v = _mm256_add_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 8>& simd<float, 8>::operator -= (simd const& rhs) {
+                v = _mm256_sub_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 8>& simd<float, 8>::operator *= (simd const& rhs) {
+                v = _mm256_mul_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 8>& simd<float, 8>::operator /= (simd const& rhs) {
+                v = _mm256_div_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 8> minimum(simd<float, 8> const& a, simd<float, 8> const& b) {
+                return simd<float, 8>(_mm256_min_ps(a.v, b.v));
+            }
+
+            simd<float, 8> maximum(simd<float, 8> const& a, simd<float, 8> const& b) {
+                return simd<float, 8>(_mm256_max_ps(a.v, b.v));
+            }
+
+            simd<float, 8> squareRoot(simd<float, 8> const& a) {
+                return simd<float, 8>(_mm256_sqrt_ps(a.v));
+            }
+
+            simd<float, 8> reciprocalApproximate(simd<float, 8> const& a) {
+                return simd<float, 8>(_mm256_rcp_ps(a.v));
+            }
+
+            simd<float, 8> inverseSqrtApproximate(simd<float, 8> const& a) {
+                return simd<float, 8>(_mm256_rsqrt_ps(a.v));
+            }
+
+            simd<float, 8> multiplyAdd(
+                    simd<float, 8> const& a, simd<float, 8> const& b, simd<float, 8> const& c) {
+#if defined(__FMA__) || defined(__AVX2__)
+                return simd<float, 8>(_mm256_fmadd_ps(a.v, b.v, c.v));
+#else
+                return simd<float, 8>(_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v));
+#endif
+            }
+
+            simd<float, 8> select(
+                    simd<float, 8> const& mask, simd<float, 8> const& ifTrue, simd<float, 8> const& ifFalse) {
+                return simd<float, 8>(_mm256_blendv_ps(ifFalse.v, ifTrue.v, mask.v));
+            }
+
+            float horizontalSum(simd<float, 8> const& a) {
+                return horizontalSum(simd<float, 4>(_mm_add_ps(
+                    _mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1))));
+            }
+#endif
+
+#if NIWA_MATH_SIMD_MAX_WIDTH >= 16
+            // simd<float, 16>
+
+            namespace {
+                /**
+                 * @return All bits set in the lanes of the mask.
+                 */
+                static __forceinline __m512 fExpandMask(__mmask16 mask) {
+                    return _mm512_castsi512_ps(_mm512_maskz_set1_epi32(mask, -1));
+                }
+
+                /**
+                 * @return The lanes whose sign bit is set.
+                 */
+                static __forceinline __mmask16 fCompressMask(__m512 mask) {
+                    return _mm512_cmplt_epi32_mask(_mm512_castps_si512(mask), _mm512_setzero_si512());
+                }
+            }
+
+            simd<float, 16> simd<float, 16>::zero() {
+                return simd(_mm512_setzero_ps());
+            }
+
+            simd<float, 16> simd<float, 16>::load(float const* values) {
+                return simd(_mm512_load_ps(values));
+            }
+
+            simd<float, 16> simd<float, 16>::loadUnaligned(float const* values) {
+                return simd(_mm512_loadu_ps(values));
+            }
+
+            simd<float, 16>::simd() : v(_mm512_setzero_ps()) {
+                // ignored
+            }
+
+            simd<float, 16>::simd(float value) : v(_mm512_set1_ps(value)) {
+                // ignored
+            }
+
+            simd<float, 16>::simd(native_type const& native) : v(native) {
+                // ignored
+            }
+
+            simd<float, 16>::operator __m512 () const {
+                return v;
+            }
+
+            void simd<float, 16>::store(float* values) const {
+                _mm512_store_ps(values, v);
+            }
+
+            void simd<float, 16>::storeUnaligned(float* values) const {
+                _mm512_storeu_ps(values, v);
+            }
+
+            float simd<float, 16>::operator [] (int i) const {
+                float lanes[WIDTH];
+                _mm512_storeu_ps(lanes, v);
+                return lanes[i];
+            }
+
+            void simd<float, 16>::set(int i, float value) {
+                v = _mm512_mask_mov_ps(v, static_cast<__mmask16>(1 << i), _mm512_set1_ps(value));
+            }
+
+            int simd<float, 16>::getMask() const {
+                return fCompressMask(v);
+            }
+
+            simd<float, 16> simd<float, 16>::operator + (simd const& rhs) const {
+                return simd(_mm512_add_ps(v, rhs.v));
+            }
+
+            simd<float, 16> simd<float, 16>::operator - (simd const& rhs) const {
+                return simd(_mm512_sub_ps(v, rhs.v));
+            }
+
+            simd<float, 16> simd<float, 16>::operator * (simd const& rhs) const {
+                return simd(_mm512_mul_ps(v, rhs.v));
+            }
+
+            simd<float, 16> simd<float, 16>::operator / (simd const& rhs) const {
+                return simd(_mm512_div_ps(v, rhs.v));
+            }
+
+            simd<float, 16> simd<float, 16>::operator & (simd const& rhs) const {
+                return simd(_mm512_castsi512_ps(_mm512_and_si512(
+                    _mm512_castps_si512(v), _mm512_castps_si512(rhs.v))));
+            }
+
+            simd<float, 16> simd<float, 16>::operator | (simd const& rhs) const {
+                return simd(_mm512_castsi512_ps(_mm512_or_si512(
+                    _mm512_castps_si512(v), _mm512_castps_si512(rhs.v))));
+            }
+
+            simd<float, 16> simd<float, 16>::operator ^ (simd const& rhs) const {
+                return simd(_mm512_castsi512_ps(_mm512_xor_si512(
+                    _mm512_castps_si512(v), _mm512_castps_si512(rhs.v))));
+            }
+
+            simd<float, 16> simd<float, 16>::operator < (simd const& rhs) const {
+                return simd(fExpandMask(_mm512_cmp_ps_mask(v, rhs.v, _CMP_LT_OQ)));
+            }
+
+            simd<float, 16> simd<float, 16>::operator <= (simd const& rhs) const {
+                return simd(fExpandMask(_mm512_cmp_ps_mask(v, rhs.v, _CMP_LE_OQ)));
+            }
+
+            simd<float, 16> simd<float, 16>::operator > (simd const& rhs) const {
+                return simd(fExpandMask(_mm512_cmp_ps_mask(v, rhs.v, _CMP_GT_OQ)));
+            }
+
+            simd<float, 16> simd<float, 16>::operator >= (simd const& rhs) const {
+                return simd(fExpandMask(_mm512_cmp_ps_mask(v, rhs.v, _CMP_GE_OQ)));
+            }
+
+            simd<float, 16> simd<float, 16>::operator == (simd const& rhs) const {
+                return simd(fExpandMask(_mm512_cmp_ps_mask(v, rhs.v, _CMP_EQ_OQ)));
+            }
+
+            simd<float, 16> simd<float, 16>::operator != (simd const& rhs) const {
+                return simd(fExpandMask(_mm512_cmp_ps_mask(v, rhs.v, _CMP_NEQ_UQ)));
+            }
+
+            simd<float, 16>& simd<float, 16>::operator += (simd const& rhs) {
+                v = _mm512_add_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 16>& simd<float, 16>::operator -= (simd const& rhs) {
+                v = _mm512_sub_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 16>& simd<float, 16>::operator *= (simd const& rhs) {
+                v = _mm512_mul_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 16>& simd<float, 16>::operator /= (simd const& rhs) {
+                v = _mm512_div_ps(v, rhs.v);
+                return *this;
+            }
+
+            simd<float, 16> minimum(simd<float, 16> const& a, simd<float, 16> const& b) {
+                return simd<float, 16>(_mm512_min_ps(a.v, b.v));
+            }
+
+            simd<float, 16> maximum(simd<float, 16> const& a, simd<float, 16> const& b) {
+                return simd<float, 16>(_mm512_max_ps(a.v, b.v));
+            }
+
+            simd<float, 16> squareRoot(simd<float, 16> const& a) {
+                return simd<float, 16>(_mm512_sqrt_ps(a.v));
+            }
+
+            simd<float, 16> reciprocalApproximate(simd<float, 16> const& a) {
+                return simd<float, 16>(_mm512_rcp14_ps(a.v));
+            }
+
+            simd<float, 16> inverseSqrtApproximate(simd<float, 16> const& a) {
+                return simd<float, 16>(_mm512_rsqrt14_ps(a.v));
+            }
+
+            simd<float, 16> multiplyAdd(
+                    simd<float, 16> const& a, simd<float, 16> const& b, simd<float, 16> const& c) {
+                return simd<float, 16>(_mm512_fmadd_ps(a.v, b.v, c.v));
+            }
+
+            simd<float, 16> select(
+                    simd<float, 16> const& mask, simd<float, 16> const& ifTrue, simd<float, 16> const& ifFalse) {
+                return simd<float, 16>(_mm512_mask_blend_ps(fCompressMask(mask.v), ifFalse.v, ifTrue.v));
+            }
+
+            float horizontalSum(simd<float, 16> const& a) {
+                __m256 const low = _mm512_castps512_ps256(a.v);
+
+                __m256 const high = _mm256_castpd_ps(
+                    _mm512_extractf64x4_pd(_mm512_castps_pd(a.v), 1));
+
+                return horizontalSum(simd<float, 8>(_mm256_add_ps(low, high)));
+            }
+#endif
+        }
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/photonmap/CompactPhoton.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    static __forceinline float fSign(float x) {
+        return x >= 0 ? 1.0f : -1.0f;
+    }
+
+    static __forceinline unsigned int fQuantize(float x) {
+        return static_cast<unsigned int>(
+            std::max(0.0f, std::min(255.0f, (x * .5f + .5f) * 255 + .5f)));
+    }
+}
+
+namespace niwa {
+    namespace photonmap {
+        using graphics::Spectrum;
+
+        using math::vec3f;
+
+        unsigned short CompactPhoton::encodeNormal(vec3f const& normal) {
+            // Octahedral mapping; see Meyer et al.,
+            // "On Floating-Point Normal Vectors" (EGSR 2010).
+
+            float const l1 = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+
+            float u = normal.x / l1;
+            float v = normal.y / l1;
+
+            if(normal.z < 0) {
+                float const foldedU = (1 - fabs(v)) * fSign(u);
+                float const foldedV = (1 - fabs(u)) * fSign(v);
+
+                u = foldedU;
+                v = foldedV;
+            }
+
+            return static_cast<unsigned short>(fQuantize(u) | (fQuantize(v) << 8));
+        }
+
+        vec3f CompactPhoton::decodeNormal(unsigned short encoded) {
+            float u = (encoded & 0xFF) * (2.0f / 255) - 1;
+            float v = (encoded >> 8) * (2.0f / 255) - 1;
+
+            float const w = 1 - fabs(u) - fabs(v);
+
+            if(w < 0) {
+                u -= -w * fSign(u);
+                v -= -w * fSign(v);
+            }
+
+            vec3f result(u, v, w);
+
+            result /= sqrt(u*u + v*v + w*w);
+
+            return result;
+        }
+
+        void CompactPhoton::encodePower(Spectrum const& power, unsigned char rgbe[4]) {
+            // Ward's RGBE format; see Graphics Gems II, "Real Pixels".
+
+            float const value = std::max(power.r, std::max(power.g, power.b));
+
+            int exponent = 0;
+
+            if(value > 0) {
+                frexp(value, &exponent);
+            }
+
+            if(value <= 0 || exponent < -118) {
+                rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+                return;
+            }
+
+            float const scale = static_cast<float>(ldexp(1.0, 8 - exponent));
+
+            float const channels[3] = { power.r, power.g, power.b };
+
+            for(int i=0; i<3; ++i) {
+                rgbe[i] = static_cast<unsigned char>(
+                    std::max(0.0f, std::min(255.0f, channels[i] * scale + .5f)));
+            }
+
+            rgbe[3] = static_cast<unsigned char>(exponent + 128);
+        }
+
+        Spectrum CompactPhoton::decodePower(unsigned char const rgbe[4]) {
+            if(rgbe[3] == 0) {
+                return Spectrum(0,0,0);
+            }
+
+            float const scale = static_cast<float>(ldexp(1.0, rgbe[3] - 136));
+
+            return Spectrum(rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale);
+        }
+    }
+}
\ No newline at end of file
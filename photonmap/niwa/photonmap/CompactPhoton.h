@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_PHOTONMAP_COMPACTPHOTON_H
+#define NIWA_PHOTONMAP_COMPACTPHOTON_H
+
+#include "Photon.h"
+
+#include "niwa/math/packed_vec3f.h"
+
+#include "niwa/graphics/PackedSpectrum.h"
+
+#include <emmintrin.h>
+
+namespace niwa {
+    namespace photonmap {
+        /**
+         * Four photons in a compact encoding of 12 bytes per photon
+         * (optimized for SSE2). Must be aligned at 16-byte boundaries.
+         *
+         * Positions are quantized to 16 bits per axis relative to
+         * a box given by the owner (e.g., a grid cell), normals are
+         * octahedral-mapped to 8+8 bits, and powers are stored in
+         * Ward's shared-exponent RGBE format. The photons are decoded
+         * on the fly with SSE2, four at a time.
+         */
+        __declspec(align(16)) class CompactPhoton {
+        public:
+            /**
+             * Sets all four photons to zero power.
+             */
+            __forceinline void clear();
+
+            /**
+             * Encodes a photon.
+             *
+             * @param i Between zero (inclusive) and four (exclusive).
+             *
+             * @param origin Minimum corner of the quantization box.
+             *
+             * @param invExtent Inverse of the edge length of the box.
+             */
+            __forceinline void set(
+                int i, Photon const& photon,
+                math::vec3f const& origin, float invExtent);
+
+            /**
+             * Decodes a photon (the normal is unit length).
+             *
+             * @param i Between zero (inclusive) and four (exclusive).
+             *
+             * @param origin Minimum corner of the quantization box.
+             *
+             * @param extent Edge length of the box.
+             */
+            __forceinline Photon get(
+                int i, math::vec3f const& origin, float extent) const;
+
+            /**
+             * Decodes the positions relative to a given offset.
+             *
+             * @param offset The position of the quantization box
+             *               relative to the desired origin.
+             *
+             * @param scale Edge length of the box divided by
+             *              POSITION_STEPS.
+             */
+            __forceinline math::packed_vec3f position(
+                math::packed_vec3f const& offset, __m128 const& scale) const;
+
+            /**
+             * @return Dot products of the decoded (non-normalized)
+             *         normals with the given vectors; the signs
+             *         are exact.
+             */
+            __forceinline __m128 normalDot(math::packed_vec3f const& rhs) const;
+
+            __forceinline graphics::PackedSpectrum power() const;
+
+        public:
+            static unsigned short encodeNormal(math::vec3f const& normal);
+
+            static math::vec3f decodeNormal(unsigned short encoded);
+
+            /**
+             * Values below 2^-119 are flushed to zero.
+             */
+            static void encodePower(
+                graphics::Spectrum const& power, unsigned char rgbe[4]);
+
+            static graphics::Spectrum decodePower(unsigned char const rgbe[4]);
+
+        public:
+            static const int POSITION_STEPS = 65535;
+
+        public:
+            unsigned short x[4];
+            unsigned short y[4];
+            unsigned short z[4];
+
+            /**
+             * Octahedral normals; the low byte is
+             * the first coordinate.
+             */
+            unsigned short normal[4];
+
+            /**
+             * Power mantissas and shared exponents,
+             * in this order (sixteen bytes).
+             */
+            unsigned char rgbe[4][4];
+        };
+    }
+}
+
+#include "CompactPhoton.inl"
+
+#endif
\ No newline at end of file
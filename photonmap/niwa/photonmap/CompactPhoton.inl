@@ -0,0 +1,150 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_PHOTONMAP_COMPACTPHOTON_INL
+#define NIWA_PHOTONMAP_COMPACTPHOTON_INL
+
+#include <algorithm>
+#include <cstring>
+
+namespace niwa {
+    namespace photonmap {
+        void CompactPhoton::clear() {
+            // Zero exponents encode zero power.
+            memset(this, 0, sizeof(CompactPhoton));
+        }
+
+        void CompactPhoton::set(
+                int i, Photon const& photon,
+                math::vec3f const& origin, float invExtent) {
+            unsigned short* const coordinates[3] = { x, y, z };
+
+            for(int j=0; j<3; ++j) {
+                float const t = std::max(0.0f, std::min(1.0f,
+                    (photon.position()[j] - origin[j]) * invExtent));
+
+                coordinates[j][i] = static_cast<unsigned short>(
+                    t * POSITION_STEPS + .5f);
+            }
+
+            normal[i] = encodeNormal(photon.normal());
+
+            unsigned char encoded[4];
+
+            encodePower(photon.power(), encoded);
+
+            for(int j=0; j<4; ++j) {
+                rgbe[j][i] = encoded[j];
+            }
+        }
+
+        Photon CompactPhoton::get(
+                int i, math::vec3f const& origin, float extent) const {
+            float const step = extent / POSITION_STEPS;
+
+            math::vec3f const position(
+                origin.x + x[i] * step,
+                origin.y + y[i] * step,
+                origin.z + z[i] * step);
+
+            unsigned char const encoded[4] = {
+                rgbe[0][i], rgbe[1][i], rgbe[2][i], rgbe[3][i]
+            };
+
+            return Photon(
+                position, decodeNormal(normal[i]), decodePower(encoded));
+        }
+
+        math::packed_vec3f CompactPhoton::position(
+                math::packed_vec3f const& offset, __m128 const& scale) const {
+            __m128i const zero = _mm_setzero_si128();
+
+            __m128 const px = _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(x)), zero));
+
+            __m128 const py = _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(y)), zero));
+
+            __m128 const pz = _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(z)), zero));
+
+            return math::packed_vec3f(
+                _mm_add_ps(_mm_mul_ps(px, scale), offset.x),
+                _mm_add_ps(_mm_mul_ps(py, scale), offset.y),
+                _mm_add_ps(_mm_mul_ps(pz, scale), offset.z));
+        }
+
+        __m128 CompactPhoton::normalDot(math::packed_vec3f const& rhs) const {
+            __m128i const n = _mm_unpacklo_epi16(
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(normal)),
+                _mm_setzero_si128());
+
+            __m128 const toSigned = _mm_set_ps1(2.0f / 255);
+            __m128 const one = _mm_set_ps1(1.0f);
+            __m128 const zero = _mm_setzero_ps();
+
+            __m128 const signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+            __m128 u = _mm_sub_ps(
+                _mm_mul_ps(
+                    _mm_cvtepi32_ps(_mm_and_si128(n, _mm_set1_epi32(0xFF))),
+                    toSigned),
+                one);
+
+            __m128 v = _mm_sub_ps(
+                _mm_mul_ps(
+                    _mm_cvtepi32_ps(_mm_srli_epi32(n, 8)),
+                    toSigned),
+                one);
+
+            // z = 1 - |u| - |v|.
+            __m128 const w = _mm_sub_ps(
+                _mm_sub_ps(one, _mm_andnot_ps(signMask, u)),
+                _mm_andnot_ps(signMask, v));
+
+            // Unfold the lower hemisphere: u -= copysign(t, u),
+            // and likewise for v, where t = max(-z, 0).
+            __m128 const t = _mm_max_ps(_mm_sub_ps(zero, w), zero);
+
+            u = _mm_sub_ps(u, _mm_or_ps(t, _mm_and_ps(u, signMask)));
+            v = _mm_sub_ps(v, _mm_or_ps(t, _mm_and_ps(v, signMask)));
+
+            return _mm_add_ps(
+                _mm_mul_ps(u, rhs.x),
+                _mm_add_ps(
+                  _mm_mul_ps(v, rhs.y),
+                  _mm_mul_ps(w, rhs.z)));
+        }
+
+        graphics::PackedSpectrum CompactPhoton::power() const {
+            __m128i const zero = _mm_setzero_si128();
+
+            __m128i const bytes = _mm_load_si128(
+                reinterpret_cast<__m128i const*>(rgbe));
+
+            __m128i const rg = _mm_unpacklo_epi8(bytes, zero);
+            __m128i const be = _mm_unpackhi_epi8(bytes, zero);
+
+            // The scale is 2^(e - 136), built directly as the
+            // float exponent field (e - 136 + 127). Zero exponents
+            // give a finite scale, and come with zero mantissas.
+            __m128 const scale = _mm_castsi128_ps(
+                _mm_slli_epi32(
+                    _mm_sub_epi32(
+                        _mm_unpackhi_epi16(be, zero),
+                        _mm_set1_epi32(9)),
+                    23));
+
+            return graphics::PackedSpectrum(
+                _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(rg, zero)), scale),
+                _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(rg, zero)), scale),
+                _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(be, zero)), scale));
+        }
+    }
+}
+
+#endif
\ No newline at end of file
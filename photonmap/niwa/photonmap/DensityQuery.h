@@ -0,0 +1,38 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_PHOTONMAP_DENSITYQUERY_H
+#define NIWA_PHOTONMAP_DENSITYQUERY_H
+
+#include "niwa/graphics/Spectrum.h"
+#include "niwa/math/vec3f.h"
+
+namespace niwa {
+    namespace photonmap {
+        /**
+         * A single query of a batched density estimate.
+         *
+         * Mutable for the same reasons as raytrace::HitInfo:
+         * batches are large and filled in place.
+         */
+        struct DensityQuery {
+            math::vec3f position;
+
+            /**
+             * Unit surface normal at the query position.
+             */
+            math::vec3f normal;
+
+            /**
+             * The result; set by IPhotonMap::powerDensities.
+             */
+            graphics::Spectrum density;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -11,11 +11,14 @@
 
 #include "niwa/geom/Hilbert.h"
 
+#include "niwa/system/IParallelizer.h"
+
 #include "niwa/math/Constants.h"
 
 using niwa::math::constants::PI_F;
 
 #include <algorithm>
+#include <new>
 
 namespace {
     /**
@@ -41,22 +44,22 @@ namespace {
 
             if(elt < 0) {
                 point.elements[i] = 0;
-            } else if(elt >= ORDER_POW2) {
-                point.elements[i] = ORDER_POW2;
+            } else if(elt >= static_cast<int>(ORDER_POW2)) {
+                point.elements[i] = ORDER_POW2 - 1;
             } else {
                 point.elements[i] = elt;
             }
         }
     }
 
-    static __forceinline size_t fGetHilbertIndex(niwa::math::vec3f const& vec) {
+    static __forceinline unsigned int fGetHilbertIndex(niwa::math::vec3f const& vec) {
         niwa::geom::HilbertPoint<3, ORDER_BITS> point;
 
         fGetGridPosition(vec, point);
 
         point = niwa::geom::Hilbert<3, ORDER_BITS>::encode(point);
 
-        return point.index();
+        return static_cast<unsigned int>(point.index());
     }
 
     /**
@@ -72,31 +75,186 @@ namespace {
             return lhs - rhs;
         }
     }
-}
 
-namespace niwa {
-    namespace photonmap {
-        struct HilbertPhotonHash::IndexPhotonPair {
-            IndexPhotonPair() : hilbertIndex(0) {
-                // ignored
+    /**
+     * Bits per radix sort digit; three passes
+     * cover the 30-bit Hilbert indices.
+     */
+    static const unsigned int RADIX_BITS = 10;
+
+    static const size_t RADIX_SIZE = 1U << RADIX_BITS;
+
+    static const unsigned int RADIX_PASSES = (3 * ORDER_BITS + RADIX_BITS - 1) / RADIX_BITS;
+
+    /**
+     * The keys are sorted in contiguous blocks, each
+     * handled by a single thread. Small blocks are not
+     * worth the per-block digit counts.
+     */
+    static const size_t MAX_SORT_BLOCKS = 64;
+
+    static const size_t MIN_SORT_BLOCK_SIZE = 4096;
+
+    /**
+     * A single pass of the radix sort: moves the keys
+     * and their photon indices from the source
+     * to the destination, stably by one digit.
+     */
+    struct RadixPass {
+        unsigned int const* srcKeys;
+        unsigned int const* srcIndices;
+
+        unsigned int* dstKeys;
+        unsigned int* dstIndices;
+
+        unsigned int shift;
+
+        size_t nKeys;
+        size_t blockSize;
+
+        /**
+         * RADIX_SIZE counts for each block.
+         */
+        size_t* digitCounts;
+    };
+
+    /**
+     * Counts the digits of each block.
+     */
+    class HistogramTask : public niwa::system::IParallelizer::ICallback {
+    public:
+        explicit HistogramTask(RadixPass const& pass) : pass_(pass) {
+            // ignored
+        }
+
+        void __fastcall invoke(int block) {
+            size_t* const counts = pass_.digitCounts + block * RADIX_SIZE;
+
+            std::fill(counts, counts + RADIX_SIZE, 0);
+
+            size_t const start = block * pass_.blockSize;
+            size_t const end = std::min(start + pass_.blockSize, pass_.nKeys);
+
+            for(size_t i=start; i<end; ++i) {
+                ++counts[(pass_.srcKeys[i] >> pass_.shift) & (RADIX_SIZE-1)];
+            }
+        }
+
+    private: // prevent copying
+        HistogramTask(HistogramTask const&);
+        HistogramTask& operator = (HistogramTask const&);
+
+    private:
+        RadixPass const& pass_;
+    };
+
+    /**
+     * Scatters each block to the offsets
+     * given by the prefix-summed digit counts.
+     */
+    class ScatterTask : public niwa::system::IParallelizer::ICallback {
+    public:
+        explicit ScatterTask(RadixPass const& pass) : pass_(pass) {
+            // ignored
+        }
+
+        void __fastcall invoke(int block) {
+            size_t* const offsets = pass_.digitCounts + block * RADIX_SIZE;
+
+            size_t const start = block * pass_.blockSize;
+            size_t const end = std::min(start + pass_.blockSize, pass_.nKeys);
+
+            for(size_t i=start; i<end; ++i) {
+                unsigned int const key = pass_.srcKeys[i];
+
+                size_t const offset =
+                    offsets[(key >> pass_.shift) & (RADIX_SIZE-1)]++;
+
+                pass_.dstKeys[offset] = key;
+                pass_.dstIndices[offset] = pass_.srcIndices[i];
             }
+        }
+
+    private: // prevent copying
+        ScatterTask(ScatterTask const&);
+        ScatterTask& operator = (ScatterTask const&);
+
+    private:
+        RadixPass const& pass_;
+    };
+
+    /**
+     * Moves the photons into sorted order.
+     */
+    class GatherTask : public niwa::system::IParallelizer::ICallback {
+    public:
+        GatherTask(
+                niwa::photonmap::Photon const* src,
+                unsigned int const* indices,
+                niwa::photonmap::Photon* dst,
+                size_t nPhotons, size_t blockSize)
+            : src_(src), indices_(indices), dst_(dst),
+              nPhotons_(nPhotons), blockSize_(blockSize) {
+            // ignored
+        }
+
+        void __fastcall invoke(int block) {
+            size_t const start = block * blockSize_;
+            size_t const end = std::min(start + blockSize_, nPhotons_);
 
-            IndexPhotonPair(size_t aHilbertIndex, Photon const& aPhoton)
-                : hilbertIndex(aHilbertIndex), photon(aPhoton) {
-                // ignored
+            for(size_t i=start; i<end; ++i) {
+                dst_[i] = src_[indices_[i]];
             }
+        }
+
+    private: // prevent copying
+        GatherTask(GatherTask const&);
+        GatherTask& operator = (GatherTask const&);
 
-            size_t hilbertIndex;
-            Photon photon;
-        };
+    private:
+        niwa::photonmap::Photon const* src_;
+        unsigned int const* indices_;
+        niwa::photonmap::Photon* dst_;
+
+        size_t nPhotons_;
+        size_t blockSize_;
+    };
+}
 
+namespace niwa {
+    namespace photonmap {
         HilbertPhotonHash::HilbertPhotonHash(size_t capacity, size_t nNeighbors) 
-            : capacity_(capacity), nNeighbors_(nNeighbors), pairs_(0), size_(0) {
-            pairs_ = new IndexPhotonPair[capacity_];
+            : capacity_(capacity), nNeighbors_(nNeighbors), size_(0),
+              keys_(0), photons_(0), keyBuffer_(0), indices_(0),
+              indexBuffer_(0), photonBuffer_(0) {
+            try {
+                keys_ = new unsigned int[capacity_];
+                photons_ = new Photon[capacity_];
+
+                keyBuffer_ = new unsigned int[capacity_];
+                indices_ = new unsigned int[capacity_];
+                indexBuffer_ = new unsigned int[capacity_];
+                photonBuffer_ = new Photon[capacity_];
+            } catch(std::bad_alloc const&) {
+                delete[] photonBuffer_;
+                delete[] indexBuffer_;
+                delete[] indices_;
+                delete[] keyBuffer_;
+                delete[] photons_;
+                delete[] keys_;
+                throw;
+            }
+
+            digitCounts_.resize(MAX_SORT_BLOCKS * RADIX_SIZE);
         }
 
         HilbertPhotonHash::~HilbertPhotonHash() {
-            delete[] pairs_;
+            delete[] photonBuffer_;
+            delete[] indexBuffer_;
+            delete[] indices_;
+            delete[] keyBuffer_;
+            delete[] photons_;
+            delete[] keys_;
         }
 
         void HilbertPhotonHash::clear() {
@@ -104,12 +262,13 @@ namespace niwa {
         }
 
         bool __fastcall HilbertPhotonHash::add(Photon const& photon) {
-            size_t const hilbertIndex = fGetHilbertIndex(photon.position());
+            unsigned int const hilbertIndex = fGetHilbertIndex(photon.position());
 
             size_t next = InterlockedIncrement(&size_) - 1;
 
             if(next < capacity_) {
-                pairs_[next] = IndexPhotonPair(hilbertIndex, photon);
+                keys_[next] = hilbertIndex;
+                photons_[next] = photon;
                 return true;
             } else {
                 size_ = capacity_ - 1;
@@ -117,40 +276,89 @@ namespace niwa {
             }
         }
 
-        void HilbertPhotonHash::buildStructure() {
-            size_t const nPairs = static_cast<size_t>(size_);
+        void HilbertPhotonHash::buildStructure(system::IParallelizer& parallelizer) {
+            size_t const nPhotons = std::min<size_t>(size_, capacity_);
+
+            if(nPhotons == 0) {
+                return;
+            }
+
+            size_t const blockSize = std::max(
+                MIN_SORT_BLOCK_SIZE,
+                (nPhotons + MAX_SORT_BLOCKS - 1) / MAX_SORT_BLOCKS);
+
+            int const nBlocks = static_cast<int>(
+                (nPhotons + blockSize - 1) / blockSize);
+
+            for(size_t i=0; i<nPhotons; ++i) {
+                indices_[i] = static_cast<unsigned int>(i);
+            }
+
+            // Only the keys and photon indices move during
+            // the radix passes; the (much larger) photons
+            // are moved once, after the last pass.
+
+            RadixPass pass;
+
+            pass.nKeys = nPhotons;
+            pass.blockSize = blockSize;
+            pass.digitCounts = &digitCounts_[0];
+
+            HistogramTask histogramTask(pass);
+            ScatterTask scatterTask(pass);
+
+            for(unsigned int i=0; i<RADIX_PASSES; ++i) {
+                pass.srcKeys = keys_;
+                pass.srcIndices = indices_;
+                pass.dstKeys = keyBuffer_;
+                pass.dstIndices = indexBuffer_;
+                pass.shift = i * RADIX_BITS;
 
-            struct SortingPair {
-                SortingPair(size_t aHilbertIndex, size_t aPairIndex)
-                    : hilbertIndex(aHilbertIndex), pairIndex(aPairIndex) {
-                    // ignored
+                parallelizer.loop(histogramTask, 0, nBlocks);
+
+                // Skip the pass if all keys share the digit,
+                // as is common for the most significant digits
+                // of clustered photons.
+
+                size_t const firstDigit = (keys_[0] >> pass.shift) & (RADIX_SIZE-1);
+
+                size_t firstDigitCount = 0;
+
+                for(int j=0; j<nBlocks; ++j) {
+                    firstDigitCount += digitCounts_[j * RADIX_SIZE + firstDigit];
                 }
 
-                bool const operator < (SortingPair const& rhs) const {
-                    return hilbertIndex < rhs.hilbertIndex;
+                if(firstDigitCount == nPhotons) {
+                    continue;
                 }
 
-                size_t hilbertIndex;
-                size_t pairIndex;
-            };
+                // Convert the counts to scatter offsets; the digits
+                // of a block follow those of the preceding blocks.
 
-            std::vector<SortingPair> sortingPairs;
+                size_t offset = 0;
 
-            for(size_t i=0; i<nPairs; ++i) {
-                sortingPairs.push_back(SortingPair(pairs_[i].hilbertIndex, i));
-            }
+                for(size_t digit=0; digit<RADIX_SIZE; ++digit) {
+                    for(int j=0; j<nBlocks; ++j) {
+                        size_t& count = digitCounts_[j * RADIX_SIZE + digit];
 
-            std::sort(sortingPairs.begin(), sortingPairs.end());
+                        size_t const temp = count;
+                        count = offset;
+                        offset += temp;
+                    }
+                }
 
-            std::vector<IndexPhotonPair> sortedPairs;
+                parallelizer.loop(scatterTask, 0, nBlocks);
 
-            for(size_t i=0; i<nPairs; ++i) {
-                sortedPairs.push_back(pairs_[sortingPairs[i].pairIndex]);
+                std::swap(keys_, keyBuffer_);
+                std::swap(indices_, indexBuffer_);
             }
 
-            for(size_t i=0; i<nPairs; ++i) {
-                pairs_[i] = sortedPairs[i];
-            }
+            GatherTask gatherTask(
+                photons_, indices_, photonBuffer_, nPhotons, blockSize);
+
+            parallelizer.loop(gatherTask, 0, nBlocks);
+
+            std::swap(photons_, photonBuffer_);
         }
 
         graphics::Spectrum __fastcall HilbertPhotonHash::powerDensity(
@@ -168,7 +376,7 @@ namespace niwa {
             size_t end = size_;
             size_t mid = (start + end) / 2;
 
-            size_t val = pairs_[mid].hilbertIndex;
+            size_t val = keys_[mid];
 
             // Notice that the start position has to be compared
             // with the mid-position; comparing with the end position
@@ -182,7 +390,7 @@ namespace niwa {
                 }
 
                 mid = (start + end) / 2;
-                val = pairs_[mid].hilbertIndex;
+                val = keys_[mid];
             }
 
             // Phase two: extend the Hilbert-nearest photon to a range
@@ -200,10 +408,10 @@ namespace niwa {
                 start = end - nNeighbors;
             } else {
                 size_t startDistance = fIndexDistance(
-                    hilbertIndex, pairs_[start].hilbertIndex);
+                    hilbertIndex, keys_[start]);
 
                 size_t endDistance = fIndexDistance(
-                    hilbertIndex, pairs_[end-1].hilbertIndex);
+                    hilbertIndex, keys_[end-1]);
 
                 for(size_t i=0; i<nNeighbors; ++i) {
                     if(startDistance < endDistance) {
@@ -212,7 +420,7 @@ namespace niwa {
                             break;
                         } else {
                             startDistance = fIndexDistance(
-                                hilbertIndex, pairs_[start].hilbertIndex);
+                                hilbertIndex, keys_[start]);
                         }
                     } else {
                         if(++end == static_cast<size_t>(size_)) {
@@ -220,7 +428,7 @@ namespace niwa {
                             break;
                         } else {
                             endDistance = fIndexDistance(
-                                hilbertIndex, pairs_[end-1].hilbertIndex);
+                                hilbertIndex, keys_[end-1]);
                         }
                     }
                 }
@@ -229,7 +437,7 @@ namespace niwa {
             niwa::graphics::Spectrum powerScore(0,0,0);
 
             for(size_t i=start; i<end; ++i) {
-                Photon const& photon = pairs_[i].photon;
+                Photon const& photon = photons_[i];
 
                 if(math::vec3f::dot(normal, photon.normal()) >= 0) {
                     powerScore += photon.power();
@@ -20,10 +20,17 @@ namespace niwa {
         class vec3f;
     }
 
+    namespace system {
+        class IParallelizer;
+    }
+
     namespace photonmap {
         /**
          * An approximate photon hash based
          * on the Hilbert space-filling curve.
+         *
+         * The photons are sorted by their 30-bit Hilbert indices
+         * with a parallel least-significant-digit radix sort.
          */
         class HilbertPhotonHash : public IPhotonMap {
         public:
@@ -35,7 +42,7 @@ namespace niwa {
 
             bool __fastcall add(Photon const& photon);
 
-            void buildStructure();
+            void buildStructure(system::IParallelizer& parallelizer);
 
             graphics::Spectrum __fastcall powerDensity(
                 math::vec3f const& position,
@@ -45,9 +52,6 @@ namespace niwa {
             HilbertPhotonHash(HilbertPhotonHash const&);
             HilbertPhotonHash& operator = (HilbertPhotonHash const&);
 
-        private:
-            struct IndexPhotonPair;
-
         private:
             size_t const capacity_;
 
@@ -56,7 +60,27 @@ namespace niwa {
         public: // Thread-safe store for photons before structure-building.
             LONG volatile size_;
 
-            IndexPhotonPair* pairs_; // owned
+            /**
+             * Hilbert indices of the photons; owned.
+             */
+            unsigned int* keys_;
+
+            Photon* photons_; // owned
+
+        private: // Scratch buffers for sorting, all owned.
+            unsigned int* keyBuffer_;
+
+            unsigned int* indices_;
+
+            unsigned int* indexBuffer_;
+
+            Photon* photonBuffer_;
+
+            /**
+             * Digit counts (and then scatter offsets) of each
+             * sorting block, one radix after another.
+             */
+            std::vector<size_t> digitCounts_;
         };
     }
 }
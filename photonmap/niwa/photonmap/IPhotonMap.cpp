@@ -7,10 +7,126 @@
 
 #include "niwa/photonmap/IPhotonMap.h"
 
+#include "niwa/photonmap/DensityQuery.h"
+
+#include "niwa/geom/Hilbert.h"
+
+#include "niwa/system/FrameArena.h"
+
+#include <algorithm>
+
+namespace {
+    /**
+     * Bits per axis; the resulting 30-bit
+     * Hilbert index fits in an unsigned integer.
+     */
+    static const size_t ORDER_BITS = 10;
+
+    static const size_t ORDER_POW2 = 1U << ORDER_BITS;
+
+    /**
+     * Plain data, so that it can live in a frame arena.
+     */
+    struct SortingPair {
+        bool const operator < (SortingPair const& rhs) const {
+            return hilbertIndex < rhs.hilbertIndex;
+        }
+
+        size_t hilbertIndex;
+        size_t queryIndex;
+    };
+}
+
 namespace niwa {
     namespace photonmap {
+        using math::vec3f;
+
         IPhotonMap::~IPhotonMap() {
             // ignored
         }
+
+        void IPhotonMap::precompute(system::IParallelizer& /*parallelizer*/) {
+            // ignored
+        }
+
+        void IPhotonMap::powerDensities(
+                DensityQuery* queries, size_t count) const {
+            if(count == 0) {
+                return;
+            }
+
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            size_t* order = static_cast<size_t*>(
+                arena.allocate(count * sizeof(size_t), sizeof(size_t)));
+
+            sortQueries(queries, count, order);
+
+            for(size_t i=0; i<count; ++i) {
+                DensityQuery& query = queries[order[i]];
+
+                query.density = powerDensity(query.position, query.normal);
+            }
+        }
+
+        void IPhotonMap::sortQueries(
+                DensityQuery const* queries, size_t count, size_t* order) {
+            if(count == 0) {
+                return;
+            }
+
+            // Quantize the query positions relative to their bounds.
+
+            vec3f boundsMin = queries[0].position;
+            vec3f boundsMax = boundsMin;
+
+            for(size_t i=1; i<count; ++i) {
+                vec3f const& position = queries[i].position;
+
+                for(int j=0; j<3; ++j) {
+                    boundsMin[j] = std::min(boundsMin[j], position[j]);
+                    boundsMax[j] = std::max(boundsMax[j], position[j]);
+                }
+            }
+
+            vec3f scale;
+
+            for(int j=0; j<3; ++j) {
+                float const extent = boundsMax[j] - boundsMin[j];
+
+                scale[j] = extent > 0 ? (ORDER_POW2 - 1) / extent : 0;
+            }
+
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            SortingPair* sortingPairs = static_cast<SortingPair*>(
+                arena.allocate(count * sizeof(SortingPair), sizeof(SortingPair)));
+
+            for(size_t i=0; i<count; ++i) {
+                vec3f const& position = queries[i].position;
+
+                geom::HilbertPoint<3, ORDER_BITS> point;
+
+                for(int j=0; j<3; ++j) {
+                    point.elements[j] = static_cast<size_t>(
+                        (position[j] - boundsMin[j]) * scale[j]);
+                }
+
+                point = geom::Hilbert<3, ORDER_BITS>::encode(point);
+
+                sortingPairs[i].hilbertIndex = point.index();
+                sortingPairs[i].queryIndex = i;
+            }
+
+            std::sort(sortingPairs, sortingPairs + count);
+
+            for(size_t i=0; i<count; ++i) {
+                order[i] = sortingPairs[i].queryIndex;
+            }
+        }
     }
 }
\ No newline at end of file
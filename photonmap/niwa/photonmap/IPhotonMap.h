@@ -15,10 +15,16 @@ namespace niwa {
         class vec3f;
     }
 
+    namespace system {
+        class IParallelizer;
+    }
+
     namespace photonmap {
         class Photon;
         class PhotonList;
 
+        struct DensityQuery;
+
         class IPhotonMap {
         public:
             virtual ~IPhotonMap();
@@ -36,9 +42,18 @@ namespace niwa {
             virtual bool __fastcall add(Photon const& photon) = 0;
 
             /**
-             * Not thread-safe.
+             * Not thread-safe, but may use the parallelizer.
+             */
+            virtual void buildStructure(system::IParallelizer& parallelizer) = 0;
+
+            /**
+             * Optional precomputation after buildStructure,
+             * e.g., caching of density estimates. The default
+             * implementation does nothing.
+             *
+             * Not thread-safe, but may use the parallelizer.
              */
-            virtual void buildStructure() = 0;
+            virtual void precompute(system::IParallelizer& parallelizer);
 
             /**
              * Thread-safe: can be called safely from multiple threads.
@@ -51,6 +66,33 @@ namespace niwa {
             virtual graphics::Spectrum __fastcall powerDensity(
                 math::vec3f const& position,
                 math::vec3f const& normal) const = 0;
+
+            /**
+             * Batched version of powerDensity.
+             * Thread-safe: can be called safely from multiple threads.
+             *
+             * The queries are processed in Hilbert order of their
+             * positions rather than in the given order, so that
+             * consecutive queries touch nearby photons. Implementations
+             * may override this to share work between queries.
+             *
+             * @param queries The queries; on return, each contains
+             *                the density at its position.
+             *
+             * @param count The number of queries.
+             */
+            virtual void __fastcall powerDensities(
+                DensityQuery* queries, size_t count) const;
+
+        protected:
+            /**
+             * Computes the Hilbert order of the query positions.
+             *
+             * @param order Receives the count query indices
+             *              in Hilbert order.
+             */
+            static void sortQueries(
+                DensityQuery const* queries, size_t count, size_t* order);
         };
     }
 }
@@ -8,6 +8,15 @@
 #include "niwa/photonmap/PhotonHash.h"
 
 #include "niwa/photonmap/Photon.h"
+#include "niwa/photonmap/CompactPhoton.h"
+#include "niwa/photonmap/PhotonHashGather.h"
+#include "niwa/photonmap/DensityQuery.h"
+
+#include "niwa/system/AlignedMemory.h"
+#include "niwa/system/FrameArena.h"
+#include "niwa/system/KernelDispatch.h"
+#include "niwa/system/ParallelReduce.h"
+#include "niwa/system/Profiler.h"
 
 #include "niwa/math/packed_vec3f.h"
 
@@ -23,145 +32,250 @@ using niwa::graphics::PackedSpectrum;
 using niwa::graphics::Spectrum;
 
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <new>
 
 #include <vector>
 
-/**
- * Photon filter. Zero for no filter;
- * one for Epanechnikov filter.
- */
-#define FILTER 0
+namespace {
+    /**
+     * Upper bound for the grid size along any axis;
+     * keeps cell coordinates well within integer range.
+     */
+    static const int MAX_GRID_SIZE = 1 << 20;
+
+    /**
+     * Indices per block in the parallel passes of the build.
+     */
+    static const int BUILD_STRIDE = 4096;
+
+    /**
+     * The number of cells gathered in one batch. Cells are at
+     * least as large as the radius, so three cells per axis
+     * suffice; rounding may add a fourth. Any excess cells
+     * are gathered in a further batch.
+     */
+    static const size_t MAX_GATHER_SPANS = 4 * 4 * 4;
+
+    /**
+     * The AVX gather loop reads photons as CompactPhotonBlocks;
+     * fails to compile (negative array size) unless the layouts agree.
+     */
+    typedef char CompactPhotonLayoutCheck[
+        sizeof(niwa::photonmap::CompactPhoton)
+            == sizeof(niwa::photonmap::CompactPhotonBlock)
+        && offsetof(niwa::photonmap::CompactPhoton, y)
+            == offsetof(niwa::photonmap::CompactPhotonBlock, y)
+        && offsetof(niwa::photonmap::CompactPhoton, z)
+            == offsetof(niwa::photonmap::CompactPhotonBlock, z)
+        && offsetof(niwa::photonmap::CompactPhoton, normal)
+            == offsetof(niwa::photonmap::CompactPhotonBlock, normal)
+        && offsetof(niwa::photonmap::CompactPhoton, rgbe)
+            == offsetof(niwa::photonmap::CompactPhotonBlock, rgbe) ? 1 : -1];
+
+    /**
+     * Spatial hash function after Teschner et al.,
+     * "Optimized Spatial Hashing for Collision Detection
+     * of Deformable Objects" (VMV 2003).
+     */
+    static __forceinline size_t fHashCell(int x, int y, int z) {
+        return (static_cast<size_t>(x) * 73856093U)
+             ^ (static_cast<size_t>(y) * 19349663U)
+             ^ (static_cast<size_t>(z) * 83492791U);
+    }
+
+    /**
+     * @return The smallest power of two not less than n.
+     */
+    static size_t fNextPowerOfTwo(size_t n) {
+        size_t result = 1;
+
+        while(result < n) {
+            result <<= 1;
+        }
+
+        return result;
+    }
+
+    /**
+     * A query tagged with its packed cell coordinates.
+     */
+    struct CellQuery {
+        bool const operator < (CellQuery const& rhs) const {
+            return key < rhs.key;
+        }
+
+        unsigned long long key;
+
+        size_t queryIndex;
+    };
+}
 
 namespace niwa {
     namespace photonmap {
         using math::vec3f;
 
-        __declspec(align(16)) struct PackedPhoton {
-            void set(int i, Photon const& photon) {
-                position.set(i, photon.position());
+        namespace {
+            struct PhotonBounds {
+                vec3f minPosition;
+                vec3f maxPosition;
+            };
 
-                normal.set(i, photon.normal());
+            /**
+             * Reduces blocks of photons to their bounds.
+             */
+            class PhotonBoundsBody {
+            public:
+                explicit PhotonBoundsBody(Photon const* photons)
+                    : photons_(photons) {
+                    // ignored
+                }
 
-                power.set(i, photon.power());
-            }
+                PhotonBounds operator () (int begin, int end) const {
+                    PhotonBounds bounds;
+                    bounds.minPosition = photons_[begin].position();
+                    bounds.maxPosition = bounds.minPosition;
 
-            packed_vec3f position;
+                    for(int i=begin+1; i<end; ++i) {
+                        vec3f const& position = photons_[i].position();
 
-            packed_vec3f normal;
+                        for(int j=0; j<3; ++j) {
+                            bounds.minPosition[j] = std::min(bounds.minPosition[j], position[j]);
+                            bounds.maxPosition[j] = std::max(bounds.maxPosition[j], position[j]);
+                        }
+                    }
 
-            PackedSpectrum power;
-        };
+                    return bounds;
+                }
 
-        class PhotonHash::GridElement {
-        public:
-            GridElement() : packedPhotons_(0), nPackedPhotons_(0) {
-                // ignored
-            }
+            private:
+                Photon const* photons_;
+            };
 
-            ~GridElement() {
-                _mm_free(packedPhotons_);
-            }
+            struct PhotonBoundsUnion {
+                PhotonBounds operator () (
+                        PhotonBounds const& lhs, PhotonBounds const& rhs) const {
+                    PhotonBounds bounds;
 
-            /**
-             * Not thread-safe.
-             */
-            void  clear() {
-                photons_.clear();
+                    for(int j=0; j<3; ++j) {
+                        bounds.minPosition[j] = std::min(lhs.minPosition[j], rhs.minPosition[j]);
+                        bounds.maxPosition[j] = std::max(lhs.maxPosition[j], rhs.maxPosition[j]);
+                    }
 
-                if(packedPhotons_) {
-                    _mm_free(packedPhotons_);
-                    packedPhotons_ = 0;
-                    nPackedPhotons_ = 0;
+                    return bounds;
                 }
-            }
+            };
+        }
 
+        /**
+         * An occupied grid cell. The photons of the cell
+         * are stored contiguously in the packed photon array.
+         */
+        struct PhotonHash::Cell {
             /**
-             * Not thread-safe.
+             * Cell coordinates; x is negative for empty table slots.
              */
-            void addPhoton(Photon const& photon) {
-                photons_.push_back(photon);
-            }
+            int x, y, z;
 
             /**
-             * Called after all photons have been added to the element.
-             * Not thread-safe.
+             * Number of photons in the cell.
              */
-            void buildStructure() {
-                if(packedPhotons_) {
-                    _mm_free(packedPhotons_);
-                    packedPhotons_ = 0;
-                    nPackedPhotons_ = 0;
-                }
-
-                nPackedPhotons_ = photons_.size() / 4;
+            size_t nPhotons;
 
-                if((photons_.size() % 4) != 0) {
-                    ++nPackedPhotons_;
-                }
+            /**
+             * Index of the first packed photon of the cell.
+             */
+            size_t firstPacked;
 
-                packedPhotons_ = static_cast<PackedPhoton*>(
-                    _mm_malloc(sizeof(PackedPhoton) * nPackedPhotons_, 16));
+            /**
+             * Number of packed photons of the cell.
+             */
+            size_t nPacked;
+        };
 
-                if((photons_.size() % 4) != 0) {
-                    // The packed photons were allocated
-                    // manually without placement new; therefore, their constructors
-                    // were not called. (This is actually good for performance.)
+        /**
+         * Counts the packed photons of blocks of occupied cells,
+         * then reserves them contiguously from the prefix.
+         */
+        struct PhotonHash::PackedCounter {
+            explicit PackedCounter(PhotonHash& parent) 
+                : parent_(parent) {
+                // ignored
+            }
 
-                    // Since some of the components of the padding
-                    // packed photon may be left undefined ("dummy" photons),
-                    // we must zero the last packed photon manually.
+            size_t operator () (int begin, int end) const {
+                size_t nPacked = 0;
 
-                    memset(
-                        &packedPhotons_[nPackedPhotons_ - 1], 0, 
-                        sizeof(PackedPhoton));
+                for(int i=begin; i<end; ++i) {
+                    nPacked += (parent_.table_[parent_.occupiedSlots_[i]].nPhotons + 3) / 4;
                 }
 
-                for(size_t i=0; i<nPackedPhotons_; ++i) {
-                    size_t bound = std::min<size_t>(4, photons_.size() - i*4);
+                return nPacked;
+            }
 
-                    for(size_t j=0; j<bound; ++j) {
-                        packedPhotons_[i].set(j, photons_[i*4+j]);
-                    }
+            void operator () (int begin, int end, size_t firstPacked) const {
+                for(int i=begin; i<end; ++i) {
+                    Cell& cell = parent_.table_[parent_.occupiedSlots_[i]];
+
+                    cell.firstPacked = firstPacked;
+
+                    firstPacked += (cell.nPhotons + 3) / 4;
                 }
             }
 
-        private: // prevent copying
-            GridElement(GridElement const&);
-            GridElement& operator = (GridElement const&);
-
         private:
-            std::vector<Photon> photons_;
+            PhotonHash& parent_;
+        };
 
-            size_t nPackedPhotons_;
+        PhotonHash::PhotonHash(size_t capacity, double searchRadius)
+            : capacity_(capacity),
+              radius_(static_cast<float>(searchRadius)), size_(0),
+              cellSize_(1), invCellSize_(1), nCells_(0), tableSize_(0), table_(0), occupiedSlots_(0),
+              nPackedPhotons_(0), packedCapacity_(0), packedPhotons_(0) {
+            gather_ = system::KernelTable<void (*)(GatherQuery const&, PhotonSpan const*, size_t, float*)>(
+                    gatherPhotonsSse)
+                .set(system::SIMD_AVX, gatherPhotonsAvx)
+                .select();
 
-            PackedPhoton* packedPhotons_;
+            photons_ = new Photon[capacity_];
 
-            friend class PhotonHash;
-        };
+            dims_[0] = dims_[1] = dims_[2] = 0;
 
-        PhotonHash::PhotonHash(size_t capacity, double searchRadius) 
-            : capacity_(capacity), 
-              radius_(static_cast<float>(searchRadius)), size_(0) {
-            photons_ = new Photon[capacity_];
+            // Cells can never outnumber photons, so a table
+            // of twice the capacity keeps the load factor at most 0.5.
+            tableSize_ = fNextPowerOfTwo(std::max<size_t>(1, 2 * capacity_));
+
+            table_ = new Cell[tableSize_];
 
-            double diameter = 2 * sqrt(2.0);
+            for(size_t i=0; i<tableSize_; ++i) {
+                table_[i].x = -1;
+            }
 
-            n_ = std::max(1, static_cast<int>(diameter / searchRadius));
+            occupiedSlots_ = new size_t[std::max<size_t>(1, capacity_)];
 
-            grid_ = new GridElement [n_ * n_ * n_];
+            clear();
         }
 
         PhotonHash::~PhotonHash() {
-            delete[] grid_;
+            system::AlignedMemory::free(packedPhotons_);
+            delete[] occupiedSlots_;
+            delete[] table_;
             delete[] photons_;
         }
 
         void PhotonHash::clear() {
             size_ = 0;
 
-            for(int i=0; i<n_ * n_ * n_; ++i) {
-                grid_[i].clear();
+            for(size_t i=0; i<nCells_; ++i) {
+                table_[occupiedSlots_[i]].x = -1;
             }
+
+            nCells_ = 0;
+            nPackedPhotons_ = 0;
+
+            dims_[0] = dims_[1] = dims_[2] = 0;
         }
 
         bool PhotonHash::add(Photon const& photon) {
@@ -179,33 +293,272 @@ namespace niwa {
         void PhotonHash::getGridPosition(
                 vec3f const& position,
                 int& x, int& y, int& z) const {
-            x = static_cast<int>((position.x + 1) * .5f * n_);
-            y = static_cast<int>((position.y + 1) * .5f * n_);
-            z = static_cast<int>((position.z + 1) * .5f * n_);
+            vec3f temp = (position - boundsMin_) * invCellSize_;
+
+            // Far-away positions would overflow the conversion.
+            for(int j=0; j<3; ++j) {
+                temp[j] = std::min(std::max(temp[j], -1.0f),
+                    static_cast<float>(MAX_GRID_SIZE));
+            }
 
-            x = std::max(0, std::min(n_-1, x));
-            y = std::max(0, std::min(n_-1, y));
-            z = std::max(0, std::min(n_-1, z));
+            // The floor is required for correct rounding
+            // of positions that lie below the bounds.
+            x = static_cast<int>(floor(temp.x));
+            y = static_cast<int>(floor(temp.y));
+            z = static_cast<int>(floor(temp.z));
         }
 
-        void PhotonHash::buildStructure() {
+        vec3f PhotonHash::getCellOrigin(int x, int y, int z) const {
+            return boundsMin_ + vec3f(
+                static_cast<float>(x),
+                static_cast<float>(y),
+                static_cast<float>(z)) * cellSize_;
+        }
+
+        PhotonHash::Cell const* PhotonHash::findCell(int x, int y, int z) const {
+            size_t const mask = tableSize_ - 1;
+
+            for(size_t i = fHashCell(x,y,z) & mask; ; i = (i+1) & mask) {
+                Cell const& cell = table_[i];
+
+                if(cell.x < 0) {
+                    return 0;
+                } else if(cell.x == x && cell.y == y && cell.z == z) {
+                    return &cell;
+                }
+            }
+        }
+
+        PhotonHash::Cell* PhotonHash::findOrInsertCell(int x, int y, int z) {
+            size_t const mask = tableSize_ - 1;
+
+            for(size_t i = fHashCell(x,y,z) & mask; ; i = (i+1) & mask) {
+                Cell& cell = table_[i];
+
+                if(cell.x < 0) {
+                    cell.x = x;
+                    cell.y = y;
+                    cell.z = z;
+                    cell.nPhotons = 0;
+                    cell.firstPacked = 0;
+                    cell.nPacked = 0;
+
+                    occupiedSlots_[nCells_++] = i;
+
+                    return &cell;
+                } else if(cell.x == x && cell.y == y && cell.z == z) {
+                    return &cell;
+                }
+            }
+        }
+
+        void PhotonHash::buildStructure(system::IParallelizer& parallelizer) {
+            NIWA_PROFILE_ZONE("photon hash build");
+
+            size_t const nPhotons = std::min<size_t>(size_, capacity_);
+
+            if(nPhotons == 0) {
+                return;
+            }
+
+            // First pass: compute photon bounds.
+
+            PhotonBounds initial;
+            initial.minPosition = photons_[0].position();
+            initial.maxPosition = initial.minPosition;
+
+            PhotonBounds const bounds = system::parallelReduce(
+                parallelizer, 0, static_cast<int>(nPhotons), BUILD_STRIDE,
+                initial, PhotonBoundsBody(photons_), PhotonBoundsUnion());
+
+            boundsMin_ = bounds.minPosition;
+
+            vec3f const boundsMax = bounds.maxPosition;
+
+            cellSize_ = radius_;
+
+            for(int j=0; j<3; ++j) {
+                cellSize_ = std::max(
+                    cellSize_, (boundsMax[j] - boundsMin_[j]) / (MAX_GRID_SIZE - 1));
+            }
+
+            invCellSize_ = 1 / cellSize_;
+
+            for(int j=0; j<3; ++j) {
+                dims_[j] = 1 + static_cast<int>(
+                    (boundsMax[j] - boundsMin_[j]) * invCellSize_);
+            }
+
+            // Second pass: insert the occupied cells
+            // and count their photons.
+
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            Cell** photonCells = static_cast<Cell**>(
+                arena.allocate(nPhotons * sizeof(Cell*), sizeof(Cell*)));
+
             int x,y,z;
 
-            for(int i=0; i<size_; ++i) {
-                getGridPosition(
-                    photons_[i].position(), x,y,z);
+            for(size_t i=0; i<nPhotons; ++i) {
+                getGridPosition(photons_[i].position(), x,y,z);
+
+                x = std::min(x, dims_[0]-1);
+                y = std::min(y, dims_[1]-1);
+                z = std::min(z, dims_[2]-1);
+
+                Cell* cell = findOrInsertCell(x,y,z);
+
+                ++cell->nPhotons;
+
+                photonCells[i] = cell;
+            }
+
+            // Reserve contiguous packed photons for each cell.
+
+            PackedCounter const counter(*this);
+
+            nPackedPhotons_ = system::parallelScan(
+                parallelizer, 0, static_cast<int>(nCells_), BUILD_STRIDE,
+                static_cast<size_t>(0), counter, std::plus<size_t>(), counter);
 
-                grid_[(z*n_ + y)*n_ + x].addPhoton(photons_[i]);
+            if(nPackedPhotons_ > packedCapacity_) {
+                system::AlignedMemory::free(packedPhotons_);
+                packedPhotons_ = 0;
+                packedCapacity_ = 0;
+
+                packedPhotons_ = static_cast<CompactPhoton*>(system::AlignedMemory::allocate(
+                    sizeof(CompactPhoton) * nPackedPhotons_, 16, system::MEMORY_PHOTONMAP));
+
+                packedCapacity_ = nPackedPhotons_;
             }
 
-            for(int i=0; i<n_ * n_ * n_; ++i) {
-                grid_[i].buildStructure();
+            // The padding lanes of the last packed photon
+            // of each cell must have zero power.
+
+            for(size_t i=0; i<nPackedPhotons_; ++i) {
+                packedPhotons_[i].clear();
+            }
+
+            // Third pass: scatter the photons into their cells,
+            // quantizing the positions relative to the cell corners.
+
+            for(size_t i=0; i<nPhotons; ++i) {
+                Cell& cell = *photonCells[i];
+
+                size_t const index = cell.nPacked++;
+
+                packedPhotons_[cell.firstPacked + index/4].set(
+                    static_cast<int>(index%4), photons_[i],
+                    getCellOrigin(cell.x, cell.y, cell.z), invCellSize_);
+            }
+
+            // The scatter counter doubles as the photon count;
+            // convert it back to packed photons.
+
+            for(size_t i=0; i<nCells_; ++i) {
+                Cell& cell = table_[occupiedSlots_[i]];
+
+                cell.nPacked = (cell.nPhotons + 3) / 4;
             }
         }
 
+        /**
+         * Lazily filled cell lookups around one grid cell.
+         */
+        struct PhotonHash::Neighborhood {
+            /**
+             * Cells per axis; the search sphere of a query spans
+             * at most two cells on either side of its own cell.
+             */
+            static const int SIZE = 5;
+
+            int xMin, yMin, zMin;
+
+            bool visited[SIZE*SIZE*SIZE];
+
+            Cell const* cells[SIZE*SIZE*SIZE];
+
+            void center(int x, int y, int z) {
+                xMin = x - SIZE/2;
+                yMin = y - SIZE/2;
+                zMin = z - SIZE/2;
+
+                std::fill(visited, visited + SIZE*SIZE*SIZE, false);
+            }
+        };
+
         Spectrum PhotonHash::powerDensity(
                 math::vec3f const& unpackedPosition,
                 math::vec3f const& unpackedNormal) const {
+            if(nCells_ == 0) {
+                return Spectrum(0,0,0);
+            }
+
+            return gather(unpackedPosition, unpackedNormal, NULL);
+        }
+
+        void PhotonHash::powerDensities(
+                DensityQuery* queries, size_t count) const {
+            if(nCells_ == 0) {
+                for(size_t i=0; i<count; ++i) {
+                    queries[i].density = Spectrum(0,0,0);
+                }
+
+                return;
+            }
+
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            CellQuery* cellQueries = static_cast<CellQuery*>(
+                arena.allocate(count * sizeof(CellQuery), sizeof(CellQuery)));
+
+            int x,y,z;
+
+            for(size_t i=0; i<count; ++i) {
+                getGridPosition(queries[i].position, x,y,z);
+
+                // Coordinates of at most MAX_GRID_SIZE+1 fit in 21 bits.
+                x = std::max(0, std::min(dims_[0]-1, x));
+                y = std::max(0, std::min(dims_[1]-1, y));
+                z = std::max(0, std::min(dims_[2]-1, z));
+
+                cellQueries[i].key =
+                    (static_cast<unsigned long long>(z) << 42) |
+                    (static_cast<unsigned long long>(y) << 21) |
+                     static_cast<unsigned long long>(x);
+
+                cellQueries[i].queryIndex = i;
+            }
+
+            std::sort(cellQueries, cellQueries + count);
+
+            Neighborhood neighborhood;
+
+            for(size_t i=0; i<count; ++i) {
+                if(i == 0 || cellQueries[i].key != cellQueries[i-1].key) {
+                    const unsigned long long key = cellQueries[i].key;
+                    const unsigned long long mask = (1ULL << 21) - 1;
+
+                    neighborhood.center(
+                        static_cast<int>(key & mask),
+                        static_cast<int>((key >> 21) & mask),
+                        static_cast<int>(key >> 42));
+                }
+
+                DensityQuery& query = queries[cellQueries[i].queryIndex];
+
+                query.density = gather(query.position, query.normal, &neighborhood);
+            }
+        }
+
+        Spectrum PhotonHash::gather(
+                math::vec3f const& unpackedPosition,
+                math::vec3f const& unpackedNormal,
+                Neighborhood* neighborhood) const {
             const float unpackedRadius = radius_;
 
             vec3f const radiusVector(unpackedRadius, unpackedRadius, unpackedRadius);
@@ -216,79 +569,163 @@ namespace niwa {
             getGridPosition(unpackedPosition - radiusVector, xMin, yMin, zMin);
             getGridPosition(unpackedPosition + radiusVector, xMax, yMax, zMax);
 
-            // The surface normal is deliberately modified
-            // to have negative z direction. This will later
-            // lead to savings when comparing dot products
-            // with the normal against zeros.
-            const vec3f modifiedUnpackedNormal(
-                unpackedNormal.x, unpackedNormal.y, -unpackedNormal.z);
+            // Cells outside the photon bounds are never occupied.
+            xMin = std::max(0, xMin);
+            yMin = std::max(0, yMin);
+            zMin = std::max(0, zMin);
+
+            xMax = std::min(dims_[0]-1, xMax);
+            yMax = std::min(dims_[1]-1, yMax);
+            zMax = std::min(dims_[2]-1, zMax);
 
             const float unpackedRadiusSquared = unpackedRadius * unpackedRadius;
-            const packed_vec3f position(unpackedPosition);
-            const __m128 radiusSquared = _mm_set_ps1(unpackedRadiusSquared);
-            const packed_vec3f modifiedNormal(modifiedUnpackedNormal);
-            PackedSpectrum powerScore;
 
-#if FILTER
-            const __m128 invRadiusSquared = _mm_set_ps1(1 / unpackedRadiusSquared);
+            GatherQuery query;
 
-            const __m128 one = _mm_set_ps1(1.0f);
-#endif
+            query.normal[0] = unpackedNormal.x;
+            query.normal[1] = unpackedNormal.y;
+            query.normal[2] = unpackedNormal.z;
+            query.radiusSquared = unpackedRadiusSquared;
+            query.positionScale = cellSize_ / CompactPhoton::POSITION_STEPS;
+
+            Spectrum unpackedPowerScore(0,0,0);
+
+            PhotonSpan spans[MAX_GATHER_SPANS];
+
+            size_t nSpans = 0;
+
+            const unsigned int size = Neighborhood::SIZE;
 
             for(int z=zMin; z<=zMax; ++z) {
                 for(int y=yMin; y<=yMax; ++y) {
-                    int gridPosition = (z*n_ + y)*n_ + xMin;
-
-                    for(int x=xMin; x<=xMax; ++x, ++gridPosition) {
-                        GridElement const& element = grid_[ gridPosition ];
+                    for(int x=xMin; x<=xMax; ++x) {
+                        Cell const* cell;
 
-                        const size_t m = element.nPackedPhotons_;
+                        const unsigned int nx = neighborhood ? x - neighborhood->xMin : size;
+                        const unsigned int ny = neighborhood ? y - neighborhood->yMin : size;
+                        const unsigned int nz = neighborhood ? z - neighborhood->zMin : size;
 
-                        PackedPhoton const*const photons = element.packedPhotons_;
+                        if(nx < size && ny < size && nz < size) {
+                            const size_t index = (nz*size + ny)*size + nx;
 
-                        for(size_t i=0; i<m; ++i) {
-                            PackedPhoton const& photon = photons[i];
+                            if(!neighborhood->visited[index]) {
+                                neighborhood->cells[index] = findCell(x,y,z);
+                                neighborhood->visited[index] = true;
+                            }
 
-                            const packed_vec3f delta(photon.position - position);
+                            cell = neighborhood->cells[index];
+                        }
+                        else {
+                            cell = findCell(x,y,z);
+                        }
 
-                            const __m128 squareLength = delta.squareLength();
+                        if(!cell) {
+                            continue;
+                        }
 
-                            const __m128 cond1 = _mm_cmple_ps(squareLength, radiusSquared);
+                        if(nSpans == MAX_GATHER_SPANS) {
+                            // More cells than the bound allows (only
+                            // possible through rounding): gather the
+                            // full batch and continue with a new one.
+                            float power[3];
 
-                            const __m128 cond2 = _mm_cmpgt_ps(
-                                _mm_add_ps(
-                                    _mm_mul_ps(
-                                        photon.normal.x, modifiedNormal.x),
-                                    _mm_mul_ps(
-                                        photon.normal.y, modifiedNormal.y)),
-                                _mm_mul_ps(
-                                    photon.normal.z, modifiedNormal.z));
+                            gather_(query, spans, nSpans, power);
 
-#if FILTER
-                            const __m128 weight = _mm_sub_ps(
-                                one, _mm_mul_ps(squareLength, invRadiusSquared));
+                            unpackedPowerScore += Spectrum(power);
 
-                            powerScore += 
-                                photon.power * _mm_and_ps(weight, _mm_and_ps(cond1, cond2));
-#else
-                            powerScore += photon.power & _mm_and_ps(cond1, cond2);
-#endif
+                            nSpans = 0;
                         }
+
+                        PhotonSpan& span = spans[nSpans++];
+
+                        span.photons = packedPhotons_ + cell->firstPacked;
+                        span.nPacked = cell->nPacked;
+                        vec3f const offset = getCellOrigin(x,y,z) - unpackedPosition;
+
+                        span.offset[0] = offset.x;
+                        span.offset[1] = offset.y;
+                        span.offset[2] = offset.z;
                     } // x-loop
                 } // y-loop
             } // z-loop
 
-            Spectrum unpackedPowerScore;
+            float power[3];
 
-            for(int i=0; i<4; ++i) {
-                unpackedPowerScore += powerScore.get(i);
-            }
+            gather_(query, spans, nSpans, power);
 
-#if FILTER
+            unpackedPowerScore += Spectrum(power);
+
+#if PHOTON_FILTER
             return unpackedPowerScore / ((0.5f * PI_F) * unpackedRadiusSquared);
 #else
             return unpackedPowerScore / (PI_F * unpackedRadiusSquared);
 #endif
         }
+
+        void gatherPhotonsSse(
+                GatherQuery const& query,
+                PhotonSpan const* spans, size_t nSpans,
+                float power[3]) {
+            const __m128 radiusSquared = _mm_set_ps1(query.radiusSquared);
+            const packed_vec3f normal(
+                vec3f(query.normal[0], query.normal[1], query.normal[2]));
+            const __m128 positionScale = _mm_set_ps1(query.positionScale);
+            const __m128 zero = _mm_setzero_ps();
+            PackedSpectrum powerScore;
+
+#if PHOTON_FILTER
+            const __m128 invRadiusSquared = _mm_set_ps1(1 / query.radiusSquared);
+
+            const __m128 one = _mm_set_ps1(1.0f);
+#endif
+
+            for(size_t j=0; j<nSpans; ++j) {
+                PhotonSpan const& span = spans[j];
+
+                const size_t m = span.nPacked;
+
+                CompactPhoton const*const photons = span.photons;
+
+                // Photon positions relative to the query position.
+                const packed_vec3f offset(
+                    vec3f(span.offset[0], span.offset[1], span.offset[2]));
+
+                for(size_t i=0; i<m; ++i) {
+                    CompactPhoton const& photon = photons[i];
+
+                    const packed_vec3f delta(
+                        photon.position(offset, positionScale));
+
+                    const __m128 squareLength = delta.squareLength();
+
+                    const __m128 cond1 = _mm_cmple_ps(squareLength, radiusSquared);
+
+                    const __m128 cond2 = _mm_cmpgt_ps(
+                        photon.normalDot(normal), zero);
+
+                    const PackedSpectrum power(photon.power());
+
+#if PHOTON_FILTER
+                    const __m128 weight = _mm_sub_ps(
+                        one, _mm_mul_ps(squareLength, invRadiusSquared));
+
+                    powerScore +=
+                        power * _mm_and_ps(weight, _mm_and_ps(cond1, cond2));
+#else
+                    powerScore += power & _mm_and_ps(cond1, cond2);
+#endif
+                }
+            }
+
+            Spectrum unpackedPowerScore;
+
+            for(int i=0; i<4; ++i) {
+                unpackedPowerScore += powerScore.get(i);
+            }
+
+            power[0] = unpackedPowerScore.r;
+            power[1] = unpackedPowerScore.g;
+            power[2] = unpackedPowerScore.b;
+        }
     }
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 /**
  * @file
  * @author Mikko Kauppila
- * 
+ *
  * Copyright (C) Mikko Kauppila 2009.
  */
 
@@ -10,15 +10,30 @@
 
 #include "IPhotonMap.h"
 
+#include "niwa/math/vec3f.h"
+
 #define NOMINMAX
 #include <windows.h>
 
 namespace niwa {
-    namespace math {
-        class vec3f;
-    }
-
     namespace photonmap {
+        class CompactPhoton;
+
+        struct GatherQuery;
+
+        struct PhotonSpan;
+
+        /**
+         * A sparse spatial hash for fixed-radius photon queries.
+         *
+         * Only occupied grid cells are stored, in an open-addressing
+         * hash table keyed by integer cell coordinates. The grid
+         * bounds are computed from the photons, so the memory use
+         * is linear in the photon count regardless of the search radius.
+         *
+         * Photons are stored in a compact encoding (see CompactPhoton),
+         * with positions quantized relative to their cell corners.
+         */
         class PhotonHash : public IPhotonMap {
         public:
             /**
@@ -27,6 +42,7 @@ namespace niwa {
              * @param searchRadius The radius used for searching photons in the hash.
              */
             PhotonHash(size_t capacity, double searchRadius);
+
             ~PhotonHash();
 
         public: // from IPhotonMap
@@ -34,36 +50,115 @@ namespace niwa {
 
             bool __fastcall add(Photon const& photon);
 
-            void buildStructure();
+            void buildStructure(system::IParallelizer& parallelizer);
 
             graphics::Spectrum __fastcall powerDensity(
                 math::vec3f const& position,
                 math::vec3f const& normal) const;
 
+            /**
+             * Sorts the queries by grid cell, so that queries
+             * in the same cell share their neighborhood lookups.
+             */
+            void __fastcall powerDensities(
+                DensityQuery* queries, size_t count) const;
+
+        private:
+            struct Cell;
+
+            struct Neighborhood;
+
+            struct PackedCounter;
+
         private:
+            /**
+             * Converts a position to cell coordinates, clamped
+             * to at most one cell outside the maximum grid.
+             */
             void getGridPosition(
                 math::vec3f const& position,
                 int& x, int& y, int& z) const;
 
+            /**
+             * @return The minimum corner of the given cell.
+             */
+            math::vec3f getCellOrigin(int x, int y, int z) const;
+
+            /**
+             * @return The cell at the given coordinates,
+             *         or NULL if the cell is empty.
+             */
+            Cell const* __fastcall findCell(int x, int y, int z) const;
+
+            /**
+             * @return The cell at the given coordinates;
+             *         inserts an empty cell if necessary.
+             */
+            Cell* __fastcall findOrInsertCell(int x, int y, int z);
+
+            /**
+             * Gathers the photons around a position.
+             *
+             * @param neighborhood Cached cells around the query;
+             *                     may be NULL.
+             */
+            graphics::Spectrum gather(
+                math::vec3f const& position,
+                math::vec3f const& normal,
+                Neighborhood* neighborhood) const;
+
         private: // prevent copying
             PhotonHash(PhotonHash const&);
             PhotonHash& operator = (PhotonHash const&);
 
-        private:
-            class GridElement;
-
         private:
             const size_t capacity_;
 
             const float radius_; // search radius
 
+            /**
+             * The widest gather loop the processor supports;
+             * see PhotonHashGather.h.
+             */
+            void (*gather_)(
+                GatherQuery const& query, PhotonSpan const* spans, size_t nSpans,
+                float power[3]);
+
             LONG volatile size_;
 
             Photon* photons_; // owned
 
-            int n_; // grid size
+            /**
+             * Minimum corner of the photon bounds.
+             */
+            math::vec3f boundsMin_;
+
+            float cellSize_;
+
+            float invCellSize_;
+
+            /**
+             * Grid size in cells along each axis.
+             */
+            int dims_[3];
+
+            size_t nCells_; // occupied cells
+
+            size_t tableSize_; // power of two
+
+            Cell* table_; // open-addressing hash table, owned
+
+            /**
+             * Table indices of the occupied cells, in insertion
+             * order, so that clearing touches only them; owned.
+             */
+            size_t* occupiedSlots_;
+
+            size_t nPackedPhotons_;
+
+            size_t packedCapacity_;
 
-            GridElement* grid_; // 3D grid, owned
+            CompactPhoton* packedPhotons_; // owned, 16-byte aligned
         };
     }
 }
@@ -0,0 +1,234 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * The AVX gather loop of PhotonHash. This file must be compiled
+ * with AVX code generation (/arch:AVX), so that the SSE2 helpers
+ * below are VEX-encoded and do not stall on AVX transitions.
+ * Nothing here may run unless ProcessorInfo reports AVX and FMA.
+ *
+ * Only plain data may be included: inline functions of shared types
+ * (vec3f, Spectrum, CompactPhoton and so on) instantiated here would
+ * be AVX code, and the linker may pick them for the SSE2 callers.
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/photonmap/PhotonHashGather.h"
+
+#include <immintrin.h>
+
+using niwa::photonmap::CompactPhotonBlock;
+
+namespace {
+    /**
+     * Pads odd spans; zero power never contributes.
+     */
+    static const CompactPhotonBlock ZERO_PHOTONS = {};
+
+    /**
+     * @return Sixteen-bit values of two photon blocks as floats.
+     */
+    static __forceinline __m256 fToFloats(
+            unsigned short const* lo, unsigned short const* hi) {
+        __m128i const zero = _mm_setzero_si128();
+
+        __m128i const loInts = _mm_unpacklo_epi16(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(lo)), zero);
+
+        __m128i const hiInts = _mm_unpacklo_epi16(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(hi)), zero);
+
+        return _mm256_cvtepi32_ps(
+            _mm256_insertf128_si256(_mm256_castsi128_si256(loInts), hiInts, 1));
+    }
+
+    /**
+     * @return The low and high bytes of the normals
+     *         of two photon blocks as floats.
+     */
+    static __forceinline void fNormalsToFloats(
+            unsigned short const* lo, unsigned short const* hi,
+            __m256& u, __m256& v) {
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const lowByte = _mm_set1_epi32(0xFF);
+
+        __m128i const loInts = _mm_unpacklo_epi16(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(lo)), zero);
+
+        __m128i const hiInts = _mm_unpacklo_epi16(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(hi)), zero);
+
+        u = _mm256_cvtepi32_ps(_mm256_insertf128_si256(
+            _mm256_castsi128_si256(_mm_and_si128(loInts, lowByte)),
+            _mm_and_si128(hiInts, lowByte), 1));
+
+        v = _mm256_cvtepi32_ps(_mm256_insertf128_si256(
+            _mm256_castsi128_si256(_mm_srli_epi32(loInts, 8)),
+            _mm_srli_epi32(hiInts, 8), 1));
+    }
+
+    /**
+     * Decodes the RGBE powers of a photon block (see CompactPhoton::power).
+     */
+    static __forceinline void fDecodePower(
+            unsigned char const (*rgbe)[4],
+            __m128i& r, __m128i& g, __m128i& b, __m128& scale) {
+        __m128i const zero = _mm_setzero_si128();
+
+        __m128i const bytes = _mm_load_si128(
+            reinterpret_cast<__m128i const*>(rgbe));
+
+        __m128i const rg = _mm_unpacklo_epi8(bytes, zero);
+        __m128i const be = _mm_unpackhi_epi8(bytes, zero);
+
+        r = _mm_unpacklo_epi16(rg, zero);
+        g = _mm_unpackhi_epi16(rg, zero);
+        b = _mm_unpacklo_epi16(be, zero);
+
+        scale = _mm_castsi128_ps(
+            _mm_slli_epi32(
+                _mm_sub_epi32(
+                    _mm_unpackhi_epi16(be, zero),
+                    _mm_set1_epi32(9)),
+                23));
+    }
+
+    static __forceinline __m256 fCombine(__m128i lo, __m128i hi) {
+        return _mm256_cvtepi32_ps(
+            _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+    }
+
+    static __forceinline __m256 fCombine(__m128 lo, __m128 hi) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    }
+
+    static __forceinline float fSum(__m256 x) {
+        __m128 const sum4 = _mm_add_ps(
+            _mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+
+        __m128 const sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+
+        return _mm_cvtss_f32(_mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1)));
+    }
+}
+
+namespace niwa {
+    namespace photonmap {
+        void gatherPhotonsAvx(
+                GatherQuery const& query,
+                PhotonSpan const* spans, size_t nSpans,
+                float power[3]) {
+            __m256 const radiusSquared = _mm256_set1_ps(query.radiusSquared);
+            __m256 const positionScale = _mm256_set1_ps(query.positionScale);
+
+            __m256 const normalX = _mm256_set1_ps(query.normal[0]);
+            __m256 const normalY = _mm256_set1_ps(query.normal[1]);
+            __m256 const normalZ = _mm256_set1_ps(query.normal[2]);
+
+            __m256 const zero = _mm256_setzero_ps();
+            __m256 const one = _mm256_set1_ps(1.0f);
+            __m256 const minusOne = _mm256_set1_ps(-1.0f);
+            __m256 const toSigned = _mm256_set1_ps(2.0f / 255);
+            __m256 const signMask = _mm256_set1_ps(-0.0f);
+
+#if PHOTON_FILTER
+            __m256 const invRadiusSquared = _mm256_set1_ps(1 / query.radiusSquared);
+#endif
+
+            __m256 powerR = zero;
+            __m256 powerG = zero;
+            __m256 powerB = zero;
+
+            for(size_t j=0; j<nSpans; ++j) {
+                PhotonSpan const& span = spans[j];
+
+                __m256 const offsetX = _mm256_set1_ps(span.offset[0]);
+                __m256 const offsetY = _mm256_set1_ps(span.offset[1]);
+                __m256 const offsetZ = _mm256_set1_ps(span.offset[2]);
+
+                CompactPhotonBlock const*const photons =
+                    reinterpret_cast<CompactPhotonBlock const*>(span.photons);
+
+                for(size_t i=0; i<span.nPacked; i+=2) {
+                    CompactPhotonBlock const& lo = photons[i];
+                    CompactPhotonBlock const& hi =
+                        i+1 < span.nPacked ? photons[i+1] : ZERO_PHOTONS;
+
+                    // Distance test.
+
+                    __m256 const dx = _mm256_fmadd_ps(
+                        fToFloats(lo.x, hi.x), positionScale, offsetX);
+                    __m256 const dy = _mm256_fmadd_ps(
+                        fToFloats(lo.y, hi.y), positionScale, offsetY);
+                    __m256 const dz = _mm256_fmadd_ps(
+                        fToFloats(lo.z, hi.z), positionScale, offsetZ);
+
+                    __m256 const squareLength = _mm256_fmadd_ps(
+                        dx, dx, _mm256_fmadd_ps(
+                            dy, dy, _mm256_mul_ps(dz, dz)));
+
+                    __m256 const cond1 = _mm256_cmp_ps(
+                        squareLength, radiusSquared, _CMP_LE_OQ);
+
+                    // Normal test; see CompactPhoton::normalDot.
+
+                    __m256 u, v;
+
+                    fNormalsToFloats(lo.normal, hi.normal, u, v);
+
+                    u = _mm256_fmadd_ps(u, toSigned, minusOne);
+                    v = _mm256_fmadd_ps(v, toSigned, minusOne);
+
+                    __m256 const w = _mm256_sub_ps(
+                        _mm256_sub_ps(one, _mm256_andnot_ps(signMask, u)),
+                        _mm256_andnot_ps(signMask, v));
+
+                    __m256 const t = _mm256_max_ps(_mm256_sub_ps(zero, w), zero);
+
+                    u = _mm256_sub_ps(u, _mm256_or_ps(t, _mm256_and_ps(u, signMask)));
+                    v = _mm256_sub_ps(v, _mm256_or_ps(t, _mm256_and_ps(v, signMask)));
+
+                    __m256 const normalDot = _mm256_fmadd_ps(
+                        u, normalX, _mm256_fmadd_ps(
+                            v, normalY, _mm256_mul_ps(w, normalZ)));
+
+                    __m256 const cond2 = _mm256_cmp_ps(
+                        normalDot, zero, _CMP_GT_OQ);
+
+#if PHOTON_FILTER
+                    __m256 const mask = _mm256_and_ps(
+                        _mm256_and_ps(cond1, cond2),
+                        _mm256_fnmadd_ps(squareLength, invRadiusSquared, one));
+#else
+                    __m256 const mask = _mm256_and_ps(cond1, cond2);
+#endif
+
+                    // Masked accumulation of the powers.
+
+                    __m128i loR, loG, loB, hiR, hiG, hiB;
+                    __m128 loScale, hiScale;
+
+                    fDecodePower(lo.rgbe, loR, loG, loB, loScale);
+                    fDecodePower(hi.rgbe, hiR, hiG, hiB, hiScale);
+
+#if PHOTON_FILTER
+                    __m256 const weight = _mm256_mul_ps(
+                        fCombine(loScale, hiScale), mask);
+#else
+                    __m256 const weight = _mm256_and_ps(
+                        fCombine(loScale, hiScale), mask);
+#endif
+
+                    powerR = _mm256_fmadd_ps(fCombine(loR, hiR), weight, powerR);
+                    powerG = _mm256_fmadd_ps(fCombine(loG, hiG), weight, powerG);
+                    powerB = _mm256_fmadd_ps(fCombine(loB, hiB), weight, powerB);
+                }
+            }
+
+            power[0] = fSum(powerR);
+            power[1] = fSum(powerG);
+            power[2] = fSum(powerB);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_PHOTONMAP_PHOTONHASHGATHER_H
+#define NIWA_PHOTONMAP_PHOTONHASHGATHER_H
+
+#include <cstddef>
+
+/**
+ * Photon filter. Zero for no filter;
+ * one for Epanechnikov filter.
+ */
+#define PHOTON_FILTER 0
+
+/*
+ * Only plain data is declared here: the gather loops are compiled
+ * with different code generation (see PhotonHashAvx.cpp), and must
+ * not instantiate the inline functions of the shared math types.
+ */
+
+namespace niwa {
+    namespace photonmap {
+        class CompactPhoton;
+
+        /**
+         * The memory layout of a CompactPhoton, as plain data.
+         * PhotonHash.cpp checks that the two agree.
+         */
+        __declspec(align(16)) struct CompactPhotonBlock {
+            unsigned short x[4];
+            unsigned short y[4];
+            unsigned short z[4];
+            unsigned short normal[4];
+            unsigned char rgbe[4][4];
+        };
+
+        /**
+         * The packed photons of a single grid cell.
+         */
+        struct PhotonSpan {
+            CompactPhoton const* photons;
+
+            size_t nPacked;
+
+            /**
+             * The cell origin relative to the query position.
+             */
+            float offset[3];
+        };
+
+        /**
+         * The parameters of a gather shared by all spans.
+         */
+        struct GatherQuery {
+            float normal[3];
+
+            float radiusSquared;
+
+            /**
+             * Scale of the quantized photon positions;
+             * see CompactPhoton::position.
+             */
+            float positionScale;
+        };
+
+        /**
+         * Gathers photons four at a time with SSE2.
+         *
+         * @param power Receives the sum of the (filtered) powers
+         *              of the photons within the radius, with
+         *              compatible normals (red, green, blue).
+         */
+        void gatherPhotonsSse(
+            GatherQuery const& query,
+            PhotonSpan const* spans, size_t nSpans,
+            float power[3]);
+
+        /**
+         * Gathers photons eight at a time with AVX and FMA.
+         * Only call if ProcessorInfo reports support for both.
+         *
+         * @param power See gatherPhotonsSse.
+         */
+        void gatherPhotonsAvx(
+            GatherQuery const& query,
+            PhotonSpan const* spans, size_t nSpans,
+            float power[3]);
+    }
+}
+
+#endif
\ No newline at end of file
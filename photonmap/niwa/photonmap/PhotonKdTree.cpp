@@ -0,0 +1,626 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/photonmap/PhotonKdTree.h"
+
+#include "niwa/photonmap/Photon.h"
+#include "niwa/photonmap/DensityQuery.h"
+
+#include "niwa/system/AlignedMemory.h"
+#include "niwa/system/FrameArena.h"
+#include "niwa/system/IParallelizer.h"
+#include "niwa/system/Profiler.h"
+#include "niwa/system/TaskScheduler.h"
+
+#include "niwa/math/Constants.h"
+#include "niwa/math/simd.h"
+
+using niwa::math::constants::PI_F;
+
+using niwa::graphics::Spectrum;
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <vector>
+
+namespace {
+    /**
+     * Upper bound for the neighbor count;
+     * the gather heap lives on the stack.
+     */
+    static const size_t MAX_NEIGHBORS = 256;
+
+    /**
+     * Minimum cosine between the query normal and the normal of
+     * a precomputed density estimate; the value is Christensen's.
+     */
+    static const float MIN_IRRADIANCE_NORMAL_DOT = 0.9f;
+
+    /**
+     * Smaller segments are balanced serially; below this,
+     * spawning a task costs more than it saves.
+     */
+    static const size_t MIN_PARALLEL_PHOTONS = 4096;
+
+    /**
+     * @return The squared distance between two points
+     *         whose fourth components are zero.
+     */
+    static __forceinline float fSquareDistance(__m128 const& a, __m128 const& b) {
+        __m128 d = _mm_sub_ps(a, b);
+
+        d = _mm_mul_ps(d, d);
+
+        // (x+z, y+w, ...), then (x+z) + (y+w).
+        __m128 s = _mm_add_ps(d, _mm_movehl_ps(d, d));
+
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1,1,1,1)));
+
+        return _mm_cvtss_f32(s);
+    }
+
+    /**
+     * Orders photons along a coordinate axis.
+     */
+    class AxisLess {
+    public:
+        explicit AxisLess(int axis) : axis_(axis) {
+            // ignored
+        }
+
+        bool operator () (
+                niwa::photonmap::Photon const* lhs,
+                niwa::photonmap::Photon const* rhs) const {
+            return lhs->position()[axis_] < rhs->position()[axis_];
+        }
+
+    private:
+        int axis_;
+    };
+}
+
+namespace niwa {
+    namespace photonmap {
+        using math::vec3f;
+
+        __declspec(align(16)) struct PhotonKdTree::Node {
+            /**
+             * Photon position; the fourth component is zero.
+             */
+            float position[4];
+
+            float normal[3];
+
+            /**
+             * Splitting axis; only meaningful for inner nodes.
+             */
+            int axis;
+
+            float power[3];
+        };
+
+        /**
+         * A max-heap of the nearest photons found so far.
+         */
+        struct PhotonKdTree::Gather {
+            struct Entry {
+                bool operator < (Entry const& rhs) const {
+                    return squareDistance < rhs.squareDistance;
+                }
+
+                float squareDistance;
+
+                size_t index;
+            };
+
+            Node const* nodes;
+
+            size_t nNodes;
+
+            __m128 position;
+
+            vec3f normal;
+
+            /**
+             * Photons whose normal has a smaller dot product
+             * with the query normal are ignored.
+             */
+            float minNormalDot;
+
+            /**
+             * The current squared search radius; shrinks
+             * once the heap is full.
+             */
+            float maxSquareDistance;
+
+            size_t nFound;
+
+            size_t nWanted;
+
+            Entry heap[MAX_NEIGHBORS];
+        };
+
+        class PhotonKdTree::PrecomputeTask : public system::IParallelizer::ICallback {
+        public:
+            explicit PrecomputeTask(PhotonKdTree& parent) : parent_(parent) {
+                // ignored
+            }
+
+            void __fastcall invoke(int i) {
+                Node const& node =
+                    parent_.nodes_[(i+1) * parent_.irradianceStride_];
+
+                vec3f const position(
+                    node.position[0], node.position[1], node.position[2]);
+
+                vec3f const normal(
+                    node.normal[0], node.normal[1], node.normal[2]);
+
+                float radius = parent_.maxRadius_;
+
+                parent_.irradiancePhotons_[i] = Photon(
+                    position, normal,
+                    parent_.estimateDensity(position, normal, radius));
+            }
+
+        private: // prevent copying
+            PrecomputeTask(PrecomputeTask const&);
+            PrecomputeTask& operator = (PrecomputeTask const&);
+
+        private:
+            PhotonKdTree& parent_;
+        };
+
+        /**
+         * Balances a segment of photons; see balanceSegment.
+         */
+        class PhotonKdTree::BalanceTask : public system::TaskScheduler::Task {
+        public:
+            BalanceTask(
+                    Node* nodes, Photon** photons,
+                    size_t index, size_t start, size_t end,
+                    system::TaskScheduler& scheduler)
+                : nodes_(nodes), photons_(photons),
+                  index_(index), start_(start), end_(end),
+                  scheduler_(scheduler) {
+                // ignored
+            }
+
+            void __fastcall run() {
+                balanceSegment(nodes_, photons_, index_, start_, end_, &scheduler_);
+            }
+
+        private: // prevent copying
+            BalanceTask(BalanceTask const&);
+            BalanceTask& operator = (BalanceTask const&);
+
+        private:
+            Node* const nodes_;
+            Photon** const photons_;
+            size_t const index_;
+            size_t const start_;
+            size_t const end_;
+            system::TaskScheduler& scheduler_;
+        };
+
+        PhotonKdTree::PhotonKdTree(size_t capacity, size_t nNeighbors, double maxRadius)
+            : capacity_(capacity),
+              nNeighbors_(std::max<size_t>(1, std::min(nNeighbors, MAX_NEIGHBORS))),
+              maxRadius_(static_cast<float>(maxRadius)),
+              size_(0), nNodes_(0), nodes_(0),
+              irradianceStride_(0), nIrradianceNodes_(0), irradianceNodes_(0) {
+            photons_ = new Photon[capacity_];
+
+            try {
+                nodes_ = static_cast<Node*>(system::AlignedMemory::allocate(
+                    sizeof(Node) * (capacity_ + 1), 16, system::MEMORY_PHOTONMAP));
+            } catch(std::bad_alloc const&) {
+                delete[] photons_;
+                throw;
+            }
+        }
+
+        PhotonKdTree::~PhotonKdTree() {
+            system::AlignedMemory::free(irradianceNodes_);
+            system::AlignedMemory::free(nodes_);
+            delete[] photons_;
+        }
+
+        void PhotonKdTree::setIrradianceStride(size_t stride) {
+            irradianceStride_ = stride;
+
+            system::AlignedMemory::free(irradianceNodes_);
+            irradianceNodes_ = 0;
+            nIrradianceNodes_ = 0;
+
+            if(irradianceStride_ > 0) {
+                try {
+                    irradianceNodes_ = static_cast<Node*>(system::AlignedMemory::allocate(
+                        sizeof(Node) * (capacity_ / irradianceStride_ + 1), 16,
+                        system::MEMORY_PHOTONMAP));
+                } catch(std::bad_alloc const&) {
+                    irradianceStride_ = 0;
+                    throw;
+                }
+            }
+        }
+
+        void PhotonKdTree::clear() {
+            size_ = 0;
+            nNodes_ = 0;
+            nIrradianceNodes_ = 0;
+        }
+
+        bool PhotonKdTree::add(Photon const& photon) {
+            size_t next = InterlockedIncrement(&size_) - 1;
+
+            if(next < capacity_) {
+                photons_[next] = photon;
+                return true;
+            } else {
+                size_ = capacity_ - 1;
+                return false;
+            }
+        }
+
+        void PhotonKdTree::buildStructure(system::IParallelizer& parallelizer) {
+            NIWA_PROFILE_ZONE("kd-tree build");
+
+            nNodes_ = std::min<size_t>(size_, capacity_);
+
+            // Precomputed densities refer to the previous photons.
+            nIrradianceNodes_ = 0;
+
+            // Only a task scheduler can balance subtrees in parallel;
+            // the tree is balanced serially on other parallelizers.
+            balance(nodes_, photons_, nNodes_,
+                dynamic_cast<system::TaskScheduler*>(&parallelizer));
+        }
+
+        void PhotonKdTree::precompute(system::IParallelizer& parallelizer) {
+            nIrradianceNodes_ = 0;
+
+            if(irradianceStride_ == 0 || nNodes_ == 0) {
+                return;
+            }
+
+            size_t const nIrradiancePhotons = nNodes_ / irradianceStride_;
+
+            irradiancePhotons_.resize(nIrradiancePhotons);
+
+            PrecomputeTask task(*this);
+
+            parallelizer.loop(task, 0, static_cast<int>(nIrradiancePhotons), 16);
+
+            if(nIrradiancePhotons > 0) {
+                balance(irradianceNodes_, &irradiancePhotons_[0], nIrradiancePhotons,
+                    dynamic_cast<system::TaskScheduler*>(&parallelizer));
+            }
+
+            // Enable lookups only after the tree is complete.
+            nIrradianceNodes_ = nIrradiancePhotons;
+        }
+
+        void PhotonKdTree::balance(
+                Node* nodes, Photon* photons, size_t nPhotons,
+                system::TaskScheduler* scheduler) {
+            if(nPhotons == 0) {
+                return;
+            }
+
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            // One-based array of photon pointers;
+            // balancing only permutes the pointers.
+            Photon** pointers = static_cast<Photon**>(
+                arena.allocate((nPhotons + 1) * sizeof(Photon*), sizeof(Photon*)));
+
+            for(size_t i=0; i<nPhotons; ++i) {
+                pointers[i+1] = &photons[i];
+            }
+
+            if(scheduler) {
+                BalanceTask task(nodes, pointers, 1, 1, nPhotons, *scheduler);
+
+                scheduler->run(task);
+            } else {
+                balanceSegment(nodes, pointers, 1, 1, nPhotons, NULL);
+            }
+        }
+
+        void PhotonKdTree::balanceSegment(
+                Node* nodes, Photon** photons,
+                size_t index, size_t start, size_t end,
+                system::TaskScheduler* scheduler) {
+            // Compute the left-balanced median so that
+            // the tree stays complete in heap order.
+
+            size_t const n = end - start + 1;
+
+            size_t median = 1;
+
+            while(4 * median <= n) {
+                median += median;
+            }
+
+            if(3 * median <= n) {
+                median += median;
+                median += start - 1;
+            } else {
+                median = end - median + 1;
+            }
+
+            // Split along the axis of largest extent.
+
+            vec3f boundsMin = photons[start]->position();
+            vec3f boundsMax = boundsMin;
+
+            for(size_t i=start+1; i<=end; ++i) {
+                vec3f const& position = photons[i]->position();
+
+                for(int j=0; j<3; ++j) {
+                    boundsMin[j] = std::min(boundsMin[j], position[j]);
+                    boundsMax[j] = std::max(boundsMax[j], position[j]);
+                }
+            }
+
+            vec3f const extent = boundsMax - boundsMin;
+
+            int axis = 2;
+
+            if(extent.x > extent.y && extent.x > extent.z) {
+                axis = 0;
+            } else if(extent.y > extent.z) {
+                axis = 1;
+            }
+
+            std::nth_element(
+                photons + start, photons + median, photons + end + 1,
+                AxisLess(axis));
+
+            Photon const& photon = *photons[median];
+
+            Node& node = nodes[index];
+
+            for(int j=0; j<3; ++j) {
+                node.position[j] = photon.position()[j];
+                node.normal[j] = photon.normal()[j];
+            }
+
+            node.position[3] = 0;
+
+            node.power[0] = photon.power().r;
+            node.power[1] = photon.power().g;
+            node.power[2] = photon.power().b;
+
+            node.axis = axis;
+
+            if(scheduler && median > start && median < end && n >= MIN_PARALLEL_PHOTONS) {
+                // The subtrees cover disjoint photons and nodes.
+                BalanceTask left(nodes, photons, 2 * index, start, median - 1, *scheduler);
+
+                system::TaskScheduler::TaskGroup group(*scheduler);
+
+                group.spawn(left);
+
+                balanceSegment(nodes, photons, 2 * index + 1, median + 1, end, scheduler);
+
+                group.sync();
+                return;
+            }
+
+            if(median > start) {
+                balanceSegment(nodes, photons, 2 * index, start, median - 1, scheduler);
+            }
+
+            if(median < end) {
+                balanceSegment(nodes, photons, 2 * index + 1, median + 1, end, scheduler);
+            }
+        }
+
+        void PhotonKdTree::locatePhotons(Gather& gather, size_t index) {
+            Node const& node = gather.nodes[index];
+
+            size_t const left = 2 * index;
+
+            if(left <= gather.nNodes) {
+                float const delta =
+                    math::simd<float, 4>(gather.position)[node.axis] - node.position[node.axis];
+
+                // Visit the near side first; the far side
+                // is visited only if the splitting plane is
+                // within the (possibly shrunk) search radius.
+
+                if(delta > 0) {
+                    if(left + 1 <= gather.nNodes) {
+                        locatePhotons(gather, left + 1);
+                    }
+
+                    if(delta * delta < gather.maxSquareDistance) {
+                        locatePhotons(gather, left);
+                    }
+                } else {
+                    locatePhotons(gather, left);
+
+                    if(delta * delta < gather.maxSquareDistance
+                            && left + 1 <= gather.nNodes) {
+                        locatePhotons(gather, left + 1);
+                    }
+                }
+            }
+
+            float const squareDistance = fSquareDistance(
+                _mm_load_ps(node.position), gather.position);
+
+            if(squareDistance >= gather.maxSquareDistance) {
+                return;
+            }
+
+            if(node.normal[0] * gather.normal.x
+                    + node.normal[1] * gather.normal.y
+                    + node.normal[2] * gather.normal.z < gather.minNormalDot) {
+                return;
+            }
+
+            Gather::Entry entry;
+
+            entry.squareDistance = squareDistance;
+            entry.index = index;
+
+            if(gather.nFound < gather.nWanted) {
+                gather.heap[gather.nFound++] = entry;
+
+                std::push_heap(gather.heap, gather.heap + gather.nFound);
+
+                if(gather.nFound == gather.nWanted) {
+                    gather.maxSquareDistance = gather.heap[0].squareDistance;
+                }
+            } else {
+                std::pop_heap(gather.heap, gather.heap + gather.nFound);
+
+                gather.heap[gather.nFound - 1] = entry;
+
+                std::push_heap(gather.heap, gather.heap + gather.nFound);
+
+                gather.maxSquareDistance = gather.heap[0].squareDistance;
+            }
+        }
+
+        Spectrum PhotonKdTree::powerDensity(
+                vec3f const& position,
+                vec3f const& normal) const {
+            float irradianceRadius = maxRadius_;
+            float photonRadius = maxRadius_;
+
+            return density(position, normal, irradianceRadius, photonRadius);
+        }
+
+        void PhotonKdTree::powerDensities(
+                DensityQuery* queries, size_t count) const {
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            size_t* order = static_cast<size_t*>(
+                arena.allocate(count * sizeof(size_t), sizeof(size_t)));
+
+            sortQueries(queries, count, order);
+
+            float irradianceRadius = maxRadius_;
+            float photonRadius = maxRadius_;
+
+            for(size_t i=0; i<count; ++i) {
+                DensityQuery& query = queries[order[i]];
+
+                if(i > 0) {
+                    // The neighbors of the previous query are at most
+                    // this much farther away; the slack covers rounding.
+                    const float step = 1.0001f *
+                        (query.position - queries[order[i-1]].position).length();
+
+                    irradianceRadius = 1.0001f * irradianceRadius + step;
+                    photonRadius = 1.0001f * photonRadius + step;
+                }
+
+                query.density = density(
+                    query.position, query.normal, irradianceRadius, photonRadius);
+            }
+        }
+
+        void PhotonKdTree::locateNearest(Gather& gather, float& radius) const {
+            if(radius < maxRadius_) {
+                gather.maxSquareDistance = radius * radius;
+                gather.nFound = 0;
+
+                locatePhotons(gather, 1);
+
+                if(gather.nFound == gather.nWanted) {
+                    radius = std::sqrt(gather.maxSquareDistance);
+                    return;
+                }
+
+                // The nearest photons of the previous query
+                // were incompatible with this one; search fully.
+            }
+
+            gather.maxSquareDistance = maxRadius_ * maxRadius_;
+            gather.nFound = 0;
+
+            locatePhotons(gather, 1);
+
+            radius = gather.nFound == gather.nWanted
+                ? std::sqrt(gather.maxSquareDistance) : maxRadius_;
+        }
+
+        Spectrum PhotonKdTree::density(
+                vec3f const& position,
+                vec3f const& normal,
+                float& irradianceRadius, float& photonRadius) const {
+            if(nIrradianceNodes_ > 0) {
+                Gather gather;
+
+                gather.nodes = irradianceNodes_;
+                gather.nNodes = nIrradianceNodes_;
+                gather.position = _mm_setr_ps(position.x, position.y, position.z, 0);
+                gather.normal = normal;
+                gather.minNormalDot = MIN_IRRADIANCE_NORMAL_DOT;
+                gather.nWanted = 1;
+
+                locateNearest(gather, irradianceRadius);
+
+                if(gather.nFound > 0) {
+                    return Spectrum(irradianceNodes_[gather.heap[0].index].power);
+                }
+
+                // No compatible estimate nearby: estimate directly.
+            }
+
+            return estimateDensity(position, normal, photonRadius);
+        }
+
+        Spectrum PhotonKdTree::estimateDensity(
+                vec3f const& position,
+                vec3f const& normal,
+                float& radius) const {
+            if(nNodes_ == 0) {
+                return Spectrum(0,0,0);
+            }
+
+            Gather gather;
+
+            gather.nodes = nodes_;
+            gather.nNodes = nNodes_;
+            gather.position = _mm_setr_ps(position.x, position.y, position.z, 0);
+            gather.normal = normal;
+            gather.minNormalDot = 0;
+            gather.nWanted = nNeighbors_;
+
+            locateNearest(gather, radius);
+
+            if(gather.nFound == 0) {
+                return Spectrum(0,0,0);
+            }
+
+            Spectrum powerScore(0,0,0);
+
+            for(size_t i=0; i<gather.nFound; ++i) {
+                Node const& node = nodes_[gather.heap[i].index];
+
+                powerScore += Spectrum(node.power);
+            }
+
+            // If the heap is full, the search radius has shrunk
+            // to the distance of the farthest gathered photon.
+            return powerScore / (PI_F * gather.maxSquareDistance);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_PHOTONMAP_PHOTONKDTREE_H
+#define NIWA_PHOTONMAP_PHOTONKDTREE_H
+
+#include "IPhotonMap.h"
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <vector>
+
+namespace niwa {
+    namespace math {
+        class vec3f;
+    }
+
+    namespace system {
+        class TaskScheduler;
+    }
+
+    namespace photonmap {
+        /**
+         * A left-balanced kd-tree of photons with exact
+         * k-nearest neighbor queries.
+         *
+         * The tree is stored implicitly (without pointers) as a heap:
+         * the children of the node at index i are at 2i and 2i+1.
+         * Implementation follows Jensen's "Realistic Image Synthesis
+         * Using Photon Mapping" (2001), Appendix B.
+         *
+         * Optionally, irradiance can be precomputed at a subset of
+         * the photons after building, as in Christensen's "Faster
+         * Photon Map Global Illumination" (JGT 1999). Density queries
+         * then look up the nearest precomputed estimate instead
+         * of gathering photons.
+         */
+        class PhotonKdTree : public IPhotonMap {
+        public:
+            /**
+             * @param capacity How many photons can be added to the tree.
+             *
+             * @param nNeighbors How many nearest photons are gathered
+             *                   for each density estimate.
+             *
+             * @param maxRadius The maximum search radius.
+             */
+            PhotonKdTree(size_t capacity, size_t nNeighbors, double maxRadius);
+            ~PhotonKdTree();
+
+            /**
+             * Sets how densely irradiance is precomputed.
+             *
+             * @param stride Irradiance is precomputed at every
+             *               stride-th photon; zero (the default)
+             *               disables precomputation.
+             */
+            void setIrradianceStride(size_t stride);
+
+        public: // from IPhotonMap
+            void clear();
+
+            bool __fastcall add(Photon const& photon);
+
+            void buildStructure(system::IParallelizer& parallelizer);
+
+            void precompute(system::IParallelizer& parallelizer);
+
+            graphics::Spectrum __fastcall powerDensity(
+                math::vec3f const& position,
+                math::vec3f const& normal) const;
+
+            /**
+             * Processes the queries in Hilbert order and starts each
+             * search from the radius of the previous query, grown by
+             * the distance between them.
+             */
+            void __fastcall powerDensities(
+                DensityQuery* queries, size_t count) const;
+
+        private:
+            struct Node;
+
+            struct Gather;
+
+            class PrecomputeTask;
+
+            class BalanceTask;
+
+        private:
+            /**
+             * Builds a tree of the given photons.
+             *
+             * @param nodes One-based heap of nodes, large enough
+             *              for the photons.
+             *
+             * @param scheduler Balances the subtrees in parallel;
+             *                  NULL to balance them serially.
+             */
+            static void balance(
+                Node* nodes, Photon* photons, size_t nPhotons,
+                system::TaskScheduler* scheduler);
+
+            /**
+             * Balances the photons [start, end] (inclusive,
+             * one-based) into the subtree rooted at the given index.
+             */
+            static void balanceSegment(
+                Node* nodes, Photon** photons,
+                size_t index, size_t start, size_t end,
+                system::TaskScheduler* scheduler);
+
+            /**
+             * Gathers the nearest photons below the given node.
+             */
+            static void locatePhotons(Gather& gather, size_t index);
+
+            /**
+             * Gathers the nearest photons, first within the hinted
+             * radius and then, if too few were found, within the
+             * maximum radius.
+             *
+             * @param radius In: the hinted search radius. Out: the
+             *               distance of the farthest wanted photon,
+             *               or the maximum radius if fewer were found.
+             */
+            void locateNearest(Gather& gather, float& radius) const;
+
+            /**
+             * Density estimate at a position; see locateNearest
+             * for the radius hints.
+             */
+            graphics::Spectrum density(
+                math::vec3f const& position,
+                math::vec3f const& normal,
+                float& irradianceRadius, float& photonRadius) const;
+
+            /**
+             * Density estimate from the nearest photons.
+             *
+             * @param radius See locateNearest.
+             */
+            graphics::Spectrum estimateDensity(
+                math::vec3f const& position,
+                math::vec3f const& normal,
+                float& radius) const;
+
+        private: // prevent copying
+            PhotonKdTree(PhotonKdTree const&);
+            PhotonKdTree& operator = (PhotonKdTree const&);
+
+        private:
+            size_t const capacity_;
+
+            size_t const nNeighbors_;
+
+            float const maxRadius_;
+
+            LONG volatile size_;
+
+            Photon* photons_; // owned
+
+            /**
+             * Number of photons in the tree.
+             */
+            size_t nNodes_;
+
+            /**
+             * One-based heap of nodes, owned and 16-byte aligned.
+             */
+            Node* nodes_;
+
+            size_t irradianceStride_;
+
+            /**
+             * Photons carrying precomputed densities instead of powers.
+             */
+            std::vector<Photon> irradiancePhotons_;
+
+            /**
+             * Number of precomputed densities in the tree;
+             * zero if not precomputed.
+             */
+            size_t nIrradianceNodes_;
+
+            /**
+             * One-based heap of precomputed densities,
+             * owned and 16-byte aligned.
+             */
+            Node* irradianceNodes_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
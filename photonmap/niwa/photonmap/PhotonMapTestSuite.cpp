@@ -0,0 +1,433 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "PhotonMapTestSuite.h"
+
+#include "niwa/testing/ITestCase.h"
+#include "niwa/testing/ITestContext.h"
+
+using niwa::testing::ITestCase;
+using niwa::testing::ITestContext;
+
+#include "CompactPhoton.h"
+#include "HilbertPhotonHash.h"
+#include "Photon.h"
+
+#include "niwa/system/SingleThreadedParallelizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+    /**
+     * Photons sorted by the radix sort must be in the order
+     * of a stable sort of their keys; sorting (key, index)
+     * pairs with std::sort gives the same order.
+     */
+    struct KeyIndex {
+        unsigned int key;
+        unsigned int index;
+
+        bool operator < (KeyIndex const& rhs) const {
+            if(key != rhs.key) {
+                return key < rhs.key;
+            }
+            return index < rhs.index;
+        }
+    };
+
+    /**
+     * A small deterministic generator, so that
+     * failures can be reproduced.
+     */
+    class Sequence {
+    public:
+        explicit Sequence(unsigned int seed) : state_(seed) {
+            // ignored
+        }
+
+        /**
+         * @return A number between zero (inclusive)
+         *         and one (exclusive).
+         */
+        float next() {
+            state_ = state_ * 1103515245U + 12345U;
+            return static_cast<float>(state_ >> 8) / 16777216.f;
+        }
+
+    private:
+        unsigned int state_;
+    };
+}
+
+namespace niwa {
+    namespace photonmap {
+        /**
+         * Sorts photons with HilbertPhotonHash and compares
+         * the result with std::sort. The photon powers hold
+         * the insertion indices, so that the moved photons
+         * can be told apart even when their keys are equal.
+         */
+        class HilbertSortCase : public ITestCase {
+        protected:
+            /**
+             * Photons are placed uniformly in the cube
+             * center +- halfExtent.
+             */
+            void testSort(
+                    ITestContext& context, size_t nPhotons,
+                    float center, float halfExtent) const {
+                std::auto_ptr<system::IParallelizer> parallelizer(
+                    system::SingleThreadedParallelizer::create());
+
+                HilbertPhotonHash hash(nPhotons, 1);
+
+                Sequence sequence(static_cast<unsigned int>(nPhotons));
+
+                for(size_t i=0; i<nPhotons; ++i) {
+                    math::vec3f position;
+
+                    position.x = center + halfExtent * (2.f * sequence.next() - 1.f);
+                    position.y = center + halfExtent * (2.f * sequence.next() - 1.f);
+                    position.z = center + halfExtent * (2.f * sequence.next() - 1.f);
+
+                    hash.add(Photon(
+                        position,
+                        math::vec3f(0, 0, 1),
+                        graphics::Spectrum(static_cast<float>(i), 0, 0)));
+                }
+
+                std::vector<KeyIndex> expected(nPhotons);
+
+                for(size_t i=0; i<nPhotons; ++i) {
+                    expected[i].key = hash.keys_[i];
+                    expected[i].index = static_cast<unsigned int>(i);
+                }
+
+                std::sort(expected.begin(), expected.end());
+
+                hash.buildStructure(*parallelizer);
+
+                for(size_t i=0; i<nPhotons; ++i) {
+                    context.assertEquals<unsigned int>(
+                        expected[i].key, hash.keys_[i],
+                        "keys not sorted");
+
+                    context.assertEquals<float>(
+                        static_cast<float>(expected[i].index),
+                        hash.photons_[i].power().r,
+                        "photons not in key order");
+                }
+            }
+
+            /**
+             * @return The number of distinct values of the given
+             *         key digit among the added photons.
+             */
+            static size_t nDigits(HilbertPhotonHash const& hash, unsigned int shift) {
+                std::vector<bool> seen(1U << 10, false);
+
+                size_t result = 0;
+
+                for(LONG i=0; i<hash.size_; ++i) {
+                    size_t const digit = (hash.keys_[i] >> shift) & ((1U << 10) - 1U);
+
+                    if(!seen[digit]) {
+                        seen[digit] = true;
+                        ++result;
+                    }
+                }
+
+                return result;
+            }
+        };
+
+        /**
+         * Photons spread over the whole grid, so that each radix
+         * pass moves keys across the digit counts of several
+         * sorting blocks (of at least 4096 keys each).
+         */
+        class HilbertSortScattered : public HilbertSortCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(HilbertSortScattered);
+            }
+
+            void test(ITestContext& context) const {
+                testSort(context, 1, 0.f, 1.f);
+                testSort(context, 4095, 0.f, 1.f);
+                testSort(context, 20000, 0.f, 1.f);
+            }
+        };
+
+        /**
+         * Photons clustered in a cube about ten grid cells wide,
+         * so that the keys share their most significant digit
+         * and its pass is skipped, while the others are not.
+         */
+        class HilbertSortClustered : public HilbertSortCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(HilbertSortClustered);
+            }
+
+            void test(ITestContext& context) const {
+                HilbertPhotonHash hash(20000, 1);
+
+                Sequence sequence(1);
+
+                for(size_t i=0; i<20000; ++i) {
+                    hash.add(Photon(
+                        math::vec3f(
+                            .03f + .02f * sequence.next(),
+                            .03f + .02f * sequence.next(),
+                            .03f + .02f * sequence.next()),
+                        math::vec3f(0, 0, 1),
+                        graphics::Spectrum(0, 0, 0)));
+                }
+
+                context.assertEquals<size_t>(1, nDigits(hash, 20),
+                    "cluster does not share the top digit");
+                context.assertEquals<bool>(true, nDigits(hash, 0) > 1,
+                    "cluster shares the bottom digit");
+
+                testSort(context, 20000, .04f, .01f);
+            }
+        };
+
+        /**
+         * Coincident photons share every digit, so
+         * that every pass is skipped.
+         */
+        class HilbertSortCoincident : public HilbertSortCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(HilbertSortCoincident);
+            }
+
+            void test(ITestContext& context) const {
+                testSort(context, 10000, .5f, 0.f);
+            }
+        };
+
+        /**
+         * Encodes photons into CompactPhoton blocks and decodes them
+         * again, both with the scalar accessors and with SSE2.
+         *
+         * Positions must be within half a quantization step, normals
+         * within the 8+8-bit octahedral precision, and powers within
+         * the 8-bit RGBE mantissa of their largest channel. The SSE2
+         * decoders must agree with the scalar ones.
+         */
+        class CompactPhotonRoundTrip : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(CompactPhotonRoundTrip);
+            }
+
+            void test(ITestContext& context) const {
+                math::vec3f const origin(-1.f, 2.f, .5f);
+                float const extent = 3.f;
+
+                Sequence sequence(3);
+
+                for(int block=0; block<256; ++block) {
+                    Photon photons[4];
+
+                    for(int i=0; i<4; ++i) {
+                        photons[i] = newPhoton(sequence, origin, extent, block * 4 + i);
+                    }
+
+                    CompactPhoton compact;
+
+                    compact.clear();
+
+                    for(int i=0; i<4; ++i) {
+                        compact.set(i, photons[i], origin, 1.f / extent);
+                    }
+
+                    for(int i=0; i<4; ++i) {
+                        testScalar(context, compact, i, photons[i], origin, extent);
+                    }
+
+                    testPacked(context, compact, origin, extent);
+                }
+            }
+
+        private:
+            /**
+             * Most photons are random; the first ones sit on the
+             * box corners and the axes, with extreme powers.
+             */
+            static Photon newPhoton(
+                    Sequence& sequence, math::vec3f const& origin,
+                    float extent, int index) {
+                static const float axes[6][3] = {
+                    { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 },
+                    { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }
+                };
+
+                if(index < 6) {
+                    float const t = index % 2 == 0 ? 0.f : 1.f;
+
+                    float const powers[6] = { 0.f, 1e-37f, 1.f, 1e6f, 255.f, .5f };
+
+                    return Photon(
+                        origin + math::vec3f(t, t, t) * extent,
+                        math::vec3f(axes[index][0], axes[index][1], axes[index][2]),
+                        graphics::Spectrum(powers[index], powers[index] * .25f, 0));
+                }
+
+                math::vec3f const position(
+                    origin.x + sequence.next() * extent,
+                    origin.y + sequence.next() * extent,
+                    origin.z + sequence.next() * extent);
+
+                // Uniform on the sphere, so both hemispheres
+                // of the octahedral map are covered.
+                float const z = 2.f * sequence.next() - 1.f;
+                float const phi = 6.2831853f * sequence.next();
+                float const r = std::sqrt(std::max(0.f, 1.f - z * z));
+
+                // Powers over some forty octaves.
+                float const scale = std::ldexp(1.f, static_cast<int>(sequence.next() * 40) - 20);
+
+                return Photon(
+                    position,
+                    math::vec3f(r * std::cos(phi), r * std::sin(phi), z),
+                    graphics::Spectrum(
+                        sequence.next() * scale,
+                        sequence.next() * scale,
+                        sequence.next() * scale));
+            }
+
+            static void testScalar(
+                    ITestContext& context, CompactPhoton const& compact, int i,
+                    Photon const& photon, math::vec3f const& origin, float extent) {
+                Photon const decoded = compact.get(i, origin, extent);
+
+                float const positionTolerance =
+                    .5f * extent / CompactPhoton::POSITION_STEPS + 1e-6f * extent;
+
+                for(int j=0; j<3; ++j) {
+                    context.assertEquals<bool>(true,
+                        std::fabs(decoded.position()[j] - photon.position()[j])
+                            <= positionTolerance,
+                        "position not within half a step");
+                }
+
+                float const cosine = decoded.normal().x * photon.normal().x
+                    + decoded.normal().y * photon.normal().y
+                    + decoded.normal().z * photon.normal().z;
+
+                context.assertEquals<bool>(true, cosine >= .9995f,
+                    "normal not within octahedral precision");
+
+                float const maxPower = std::max(photon.power().r,
+                    std::max(photon.power().g, photon.power().b));
+
+                // Powers below 2^-119 are flushed to zero.
+                float const powerTolerance = maxPower < 1e-35f
+                    ? maxPower : maxPower / 128;
+
+                float const original[3] = {
+                    photon.power().r, photon.power().g, photon.power().b
+                };
+
+                float const actual[3] = {
+                    decoded.power().r, decoded.power().g, decoded.power().b
+                };
+
+                for(int j=0; j<3; ++j) {
+                    context.assertEquals<bool>(true,
+                        std::fabs(actual[j] - original[j]) <= powerTolerance,
+                        "power not within the RGBE mantissa");
+                }
+            }
+
+            static void testPacked(
+                    ITestContext& context, CompactPhoton const& compact,
+                    math::vec3f const& origin, float extent) {
+                math::packed_vec3f const positions = compact.position(
+                    math::packed_vec3f(origin),
+                    _mm_set_ps1(extent / CompactPhoton::POSITION_STEPS));
+
+                // The dot products with the axes are the
+                // components of the non-normalized normals.
+                __m128 const nx = compact.normalDot(
+                    math::packed_vec3f(math::vec3f(1, 0, 0)));
+                __m128 const ny = compact.normalDot(
+                    math::packed_vec3f(math::vec3f(0, 1, 0)));
+                __m128 const nz = compact.normalDot(
+                    math::packed_vec3f(math::vec3f(0, 0, 1)));
+
+                math::packed_vec3f const normals(nx, ny, nz);
+
+                graphics::PackedSpectrum const powers = compact.power();
+
+                for(int i=0; i<4; ++i) {
+                    Photon const scalar = compact.get(i, origin, extent);
+
+                    math::vec3f const position = positions.get(i);
+
+                    for(int j=0; j<3; ++j) {
+                        context.assertEquals<bool>(true,
+                            std::fabs(position[j] - scalar.position()[j]) <= 1e-5f,
+                            "SSE2 position differs from scalar");
+                    }
+
+                    math::vec3f normal = normals.get(i);
+
+                    normal /= std::sqrt(
+                        normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+
+                    for(int j=0; j<3; ++j) {
+                        context.assertEquals<bool>(true,
+                            std::fabs(normal[j] - scalar.normal()[j]) <= 1e-5f,
+                            "SSE2 normal differs from scalar");
+                    }
+
+                    graphics::Spectrum const power = powers.get(i);
+
+                    context.assertEquals<float>(scalar.power().r, power.r,
+                        "SSE2 power differs from scalar");
+                    context.assertEquals<float>(scalar.power().g, power.g,
+                        "SSE2 power differs from scalar");
+                    context.assertEquals<float>(scalar.power().b, power.b,
+                        "SSE2 power differs from scalar");
+                }
+            }
+        };
+
+        std::type_info const& PhotonMapTestSuite::getType() const {
+            return typeid(PhotonMapTestSuite);
+        }
+
+        size_t PhotonMapTestSuite::nCases() const {
+            return 4;
+        }
+
+        ITestCase* PhotonMapTestSuite::newCase(size_t index) const {
+            switch(index) {
+            case 0:
+                return new HilbertSortScattered();
+            case 1:
+                return new HilbertSortClustered();
+            case 2:
+                return new HilbertSortCoincident();
+            case 3:
+                return new CompactPhotonRoundTrip();
+            default:
+                assert(false);
+                return 0;
+            }
+        }
+    }
+}
\ No newline at end of file
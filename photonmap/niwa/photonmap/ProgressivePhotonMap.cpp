@@ -0,0 +1,407 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/photonmap/ProgressivePhotonMap.h"
+
+#include "niwa/photonmap/Photon.h"
+
+#include "niwa/system/IParallelizer.h"
+#include "niwa/system/Profiler.h"
+#include "niwa/system/ScopedAcquire.h"
+
+#include "niwa/logging/Logger.h"
+
+#include "niwa/math/Constants.h"
+
+using niwa::math::constants::PI_F;
+
+using niwa::graphics::Spectrum;
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    /**
+     * Spatial hash function after Teschner et al.,
+     * "Optimized Spatial Hashing for Collision Detection
+     * of Deformable Objects" (VMV 2003).
+     */
+    static __forceinline size_t fHashCell(int x, int y, int z) {
+        return (static_cast<size_t>(x) * 73856093U)
+             ^ (static_cast<size_t>(y) * 19349663U)
+             ^ (static_cast<size_t>(z) * 83492791U);
+    }
+
+    /**
+     * @return The smallest power of two not less than n.
+     */
+    static size_t fNextPowerOfTwo(size_t n) {
+        size_t result = 1;
+
+        while(result < n) {
+            result <<= 1;
+        }
+
+        return result;
+    }
+}
+
+namespace niwa {
+    namespace photonmap {
+        static logging::Logger logger(typeid(ProgressivePhotonMap));
+
+        using math::vec3f;
+
+        struct ProgressivePhotonMap::VisiblePoint {
+            vec3f position;
+            vec3f normal;
+
+            float radiusSquared;
+
+            /**
+             * Accumulated (fractional) photon count.
+             */
+            float nPhotons;
+
+            /**
+             * Accumulated power, scaled with the radius.
+             */
+            Spectrum flux;
+
+            /**
+             * Statistics of the current pass;
+             * guarded by the point's lock.
+             */
+            size_t nPassPhotons;
+            Spectrum passFlux;
+        };
+
+        struct ProgressivePhotonMap::Cell {
+            /**
+             * Cell coordinates; only valid if the cell is occupied.
+             */
+            int x, y, z;
+
+            /**
+             * Range of the cell's visible points in cellPoints_;
+             * empty for unoccupied table slots.
+             */
+            size_t first, count;
+        };
+
+        /**
+         * Folds the pass statistics into the accumulated
+         * statistics and shrinks the radii as in progressive photon mapping.
+         */
+        class ProgressivePhotonMap::UpdateTask : public system::IParallelizer::ICallback {
+        public:
+            explicit UpdateTask(ProgressivePhotonMap& parent) : parent_(parent) {
+                // ignored
+            }
+
+            void __fastcall invoke(int i) {
+                VisiblePoint& point = parent_.visiblePoints_[i];
+
+                if(point.nPassPhotons > 0) {
+                    float const nPhotons =
+                        point.nPhotons + parent_.alpha_ * point.nPassPhotons;
+
+                    float const ratio =
+                        nPhotons / (point.nPhotons + point.nPassPhotons);
+
+                    point.radiusSquared *= ratio;
+                    point.flux = (point.flux + point.passFlux) * ratio;
+                    point.nPhotons = nPhotons;
+                }
+
+                point.nPassPhotons = 0;
+                point.passFlux = Spectrum(0,0,0);
+            }
+
+        private: // prevent copying
+            UpdateTask(UpdateTask const&);
+            UpdateTask& operator = (UpdateTask const&);
+
+        private:
+            ProgressivePhotonMap& parent_;
+        };
+
+        ProgressivePhotonMap::ProgressivePhotonMap(double initialRadius, double alpha)
+            : initialRadius_(static_cast<float>(initialRadius)),
+              alpha_(static_cast<float>(alpha)),
+              nPasses_(0), isGridBuilt_(false) {
+#ifdef NIWA_SYSTEM_PROFILING
+            for(size_t i=0; i<LOCK_COUNT; ++i) {
+                locks_[i].setStatistics(&lockStatistics_);
+            }
+#endif
+        }
+
+        ProgressivePhotonMap::~ProgressivePhotonMap() {
+#ifdef NIWA_SYSTEM_PROFILING
+            logger.debug() << "pass locks: " << lockStatistics_;
+#endif
+        }
+
+        void ProgressivePhotonMap::clearVisiblePoints() {
+            visiblePoints_.clear();
+            cellPoints_.clear();
+            table_.clear();
+
+            nPasses_ = 0;
+            isGridBuilt_ = false;
+        }
+
+        size_t ProgressivePhotonMap::addVisiblePoint(
+                vec3f const& position, vec3f const& normal) {
+            VisiblePoint point;
+
+            point.position = position;
+            point.normal = normal;
+            point.radiusSquared = initialRadius_ * initialRadius_;
+            point.nPhotons = 0;
+            point.flux = Spectrum(0,0,0);
+            point.nPassPhotons = 0;
+            point.passFlux = Spectrum(0,0,0);
+
+            visiblePoints_.push_back(point);
+
+            isGridBuilt_ = false;
+
+            return visiblePoints_.size() - 1;
+        }
+
+        size_t ProgressivePhotonMap::getVisiblePointCount() const {
+            return visiblePoints_.size();
+        }
+
+        size_t ProgressivePhotonMap::getPassCount() const {
+            return nPasses_;
+        }
+
+        void ProgressivePhotonMap::getGridPosition(
+                vec3f const& position, int& x, int& y, int& z) const {
+            vec3f const temp = position * (1 / initialRadius_);
+
+            x = static_cast<int>(floor(temp.x));
+            y = static_cast<int>(floor(temp.y));
+            z = static_cast<int>(floor(temp.z));
+        }
+
+        ProgressivePhotonMap::Cell const* ProgressivePhotonMap::findCell(
+                int x, int y, int z) const {
+            size_t const mask = table_.size() - 1;
+
+            for(size_t i = fHashCell(x,y,z) & mask; ; i = (i+1) & mask) {
+                Cell const& cell = table_[i];
+
+                if(cell.count == 0) {
+                    return 0;
+                } else if(cell.x == x && cell.y == y && cell.z == z) {
+                    return &cell;
+                }
+            }
+        }
+
+        void ProgressivePhotonMap::buildGrid() {
+            size_t const nPoints = visiblePoints_.size();
+
+            // Sort the points by cell; the hash table then
+            // only stores the ranges of the occupied cells.
+
+            struct SortingPair {
+                bool const operator < (SortingPair const& rhs) const {
+                    if(x != rhs.x) {
+                        return x < rhs.x;
+                    } else if(y != rhs.y) {
+                        return y < rhs.y;
+                    } else {
+                        return z < rhs.z;
+                    }
+                }
+
+                int x, y, z;
+
+                size_t point;
+            };
+
+            std::vector<SortingPair> pairs(nPoints);
+
+            for(size_t i=0; i<nPoints; ++i) {
+                getGridPosition(
+                    visiblePoints_[i].position,
+                    pairs[i].x, pairs[i].y, pairs[i].z);
+
+                pairs[i].point = i;
+            }
+
+            std::sort(pairs.begin(), pairs.end());
+
+            Cell emptyCell;
+
+            emptyCell.x = emptyCell.y = emptyCell.z = 0;
+            emptyCell.first = emptyCell.count = 0;
+
+            table_.assign(fNextPowerOfTwo(std::max<size_t>(1, 2 * nPoints)), emptyCell);
+
+            cellPoints_.resize(nPoints);
+
+            size_t const mask = table_.size() - 1;
+
+            for(size_t i=0; i<nPoints; ) {
+                size_t end = i+1;
+
+                while(end < nPoints && !(pairs[i] < pairs[end])) {
+                    ++end;
+                }
+
+                size_t slot = fHashCell(pairs[i].x, pairs[i].y, pairs[i].z) & mask;
+
+                while(table_[slot].count > 0) {
+                    slot = (slot+1) & mask;
+                }
+
+                Cell& cell = table_[slot];
+
+                cell.x = pairs[i].x;
+                cell.y = pairs[i].y;
+                cell.z = pairs[i].z;
+                cell.first = i;
+                cell.count = end - i;
+
+                for(; i<end; ++i) {
+                    cellPoints_[i] = pairs[i].point;
+                }
+            }
+
+            isGridBuilt_ = true;
+        }
+
+        void ProgressivePhotonMap::clear() {
+            if(!isGridBuilt_) {
+                buildGrid();
+            }
+        }
+
+        bool ProgressivePhotonMap::add(Photon const& photon) {
+            if(cellPoints_.empty()) {
+                return true;
+            }
+
+            vec3f const& position = photon.position();
+
+            int x,y,z;
+
+            getGridPosition(position, x,y,z);
+
+            // The radii never exceed the cell size,
+            // so the neighboring cells suffice.
+
+            for(int dz=-1; dz<=1; ++dz) {
+                for(int dy=-1; dy<=1; ++dy) {
+                    for(int dx=-1; dx<=1; ++dx) {
+                        Cell const* cell = findCell(x+dx, y+dy, z+dz);
+
+                        if(!cell) {
+                            continue;
+                        }
+
+                        for(size_t i=0; i<cell->count; ++i) {
+                            size_t const index = cellPoints_[cell->first + i];
+
+                            VisiblePoint& point = visiblePoints_[index];
+
+                            if((point.position - position).squareLength() > point.radiusSquared
+                                    || vec3f::dot(point.normal, photon.normal()) <= 0) {
+                                continue;
+                            }
+
+                            system::ScopedAcquire lock(&locks_[index % LOCK_COUNT]);
+
+                            ++point.nPassPhotons;
+                            point.passFlux += photon.power();
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        void ProgressivePhotonMap::buildStructure(system::IParallelizer& parallelizer) {
+            UpdateTask task(*this);
+
+            parallelizer.loop(task, 0, static_cast<int>(visiblePoints_.size()), 64);
+
+            ++nPasses_;
+        }
+
+        Spectrum ProgressivePhotonMap::powerDensity(size_t visiblePoint) const {
+            VisiblePoint const& point = visiblePoints_[visiblePoint];
+
+            if(nPasses_ == 0) {
+                return Spectrum(0,0,0);
+            }
+
+            // The photon powers of each pass sum up to the light power.
+            return point.flux / (PI_F * point.radiusSquared * nPasses_);
+        }
+
+        Spectrum ProgressivePhotonMap::powerDensity(
+                vec3f const& position, vec3f const& normal) const {
+            if(cellPoints_.empty()) {
+                return Spectrum(0,0,0);
+            }
+
+            int x,y,z;
+
+            getGridPosition(position, x,y,z);
+
+            size_t nearest = visiblePoints_.size();
+
+            float nearestSquareDistance = 0;
+
+            for(int dz=-1; dz<=1; ++dz) {
+                for(int dy=-1; dy<=1; ++dy) {
+                    for(int dx=-1; dx<=1; ++dx) {
+                        Cell const* cell = findCell(x+dx, y+dy, z+dz);
+
+                        if(!cell) {
+                            continue;
+                        }
+
+                        for(size_t i=0; i<cell->count; ++i) {
+                            size_t const index = cellPoints_[cell->first + i];
+
+                            VisiblePoint const& point = visiblePoints_[index];
+
+                            float const squareDistance =
+                                (point.position - position).squareLength();
+
+                            if(squareDistance > point.radiusSquared
+                                    || vec3f::dot(point.normal, normal) <= 0) {
+                                continue;
+                            }
+
+                            if(nearest == visiblePoints_.size()
+                                    || squareDistance < nearestSquareDistance) {
+                                nearest = index;
+                                nearestSquareDistance = squareDistance;
+                            }
+                        }
+                    }
+                }
+            }
+
+            if(nearest == visiblePoints_.size()) {
+                return Spectrum(0,0,0);
+            }
+
+            return powerDensity(nearest);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_PHOTONMAP_PROGRESSIVEPHOTONMAP_H
+#define NIWA_PHOTONMAP_PROGRESSIVEPHOTONMAP_H
+
+#include "IPhotonMap.h"
+
+#include "niwa/math/vec3f.h"
+
+#include "niwa/system/LockStatistics.h"
+#include "niwa/system/SpinLock.h"
+
+#include <vector>
+
+namespace niwa {
+    namespace photonmap {
+        /**
+         * Progressive photon mapping; see Hachisuka, Ogaki and
+         * Jensen, "Progressive Photon Mapping" (SIGGRAPH Asia 2008).
+         *
+         * Instead of photons, the map stores visible points, each
+         * with its own search radius. Added photons are deposited
+         * directly at the visible points within range, so the memory
+         * use does not depend on the photon count. After each pass
+         * of photons, buildStructure shrinks the radii and folds the
+         * pass into the per-point statistics; the estimates converge
+         * as more passes are traced.
+         *
+         * The visible points are fixed once added; they are not
+         * resampled between passes as in stochastic progressive
+         * photon mapping, so effects that need many eye samples
+         * per pixel (antialiasing, glossy reflection) do not
+         * converge. This matches the single pinhole eye ray per
+         * pixel of the renderer.
+         */
+        class ProgressivePhotonMap : public IPhotonMap {
+        public:
+            /**
+             * @param initialRadius The search radius of new visible points.
+             *
+             * @param alpha The fraction of new photons kept
+             *              in each pass (between zero and one).
+             */
+            ProgressivePhotonMap(double initialRadius, double alpha);
+            ~ProgressivePhotonMap();
+
+            /**
+             * Removes all visible points (and thus all progress).
+             * Not thread-safe.
+             */
+            void clearVisiblePoints();
+
+            /**
+             * Not thread-safe; all visible points must be
+             * added before the first pass of photons.
+             *
+             * @return The index of the visible point.
+             */
+            size_t addVisiblePoint(
+                math::vec3f const& position,
+                math::vec3f const& normal);
+
+            size_t getVisiblePointCount() const;
+
+            /**
+             * @return The number of completed passes.
+             */
+            size_t getPassCount() const;
+
+            /**
+             * Thread-safe.
+             *
+             * @return The power density at the given
+             *         visible point, averaged over the passes.
+             */
+            graphics::Spectrum powerDensity(size_t visiblePoint) const;
+
+        public: // from IPhotonMap
+            /**
+             * Starts a new pass of photons.
+             */
+            void clear();
+
+            bool __fastcall add(Photon const& photon);
+
+            /**
+             * Completes the pass of photons.
+             */
+            void buildStructure(system::IParallelizer& parallelizer);
+
+            /**
+             * @return The density at the nearest visible point
+             *         whose radius reaches the given position.
+             */
+            graphics::Spectrum __fastcall powerDensity(
+                math::vec3f const& position,
+                math::vec3f const& normal) const;
+
+        private:
+            struct VisiblePoint;
+
+            struct Cell;
+
+            class UpdateTask;
+
+        private:
+            void getGridPosition(
+                math::vec3f const& position,
+                int& x, int& y, int& z) const;
+
+            Cell const* __fastcall findCell(int x, int y, int z) const;
+
+            /**
+             * Hashes the visible points into cells
+             * of the initial radius.
+             */
+            void buildGrid();
+
+        private: // prevent copying
+            ProgressivePhotonMap(ProgressivePhotonMap const&);
+            ProgressivePhotonMap& operator = (ProgressivePhotonMap const&);
+
+        private:
+            /**
+             * Number of locks guarding the pass statistics;
+             * visible points share the locks by index.
+             */
+            static const size_t LOCK_COUNT = 64;
+
+        private:
+            float const initialRadius_;
+
+            float const alpha_;
+
+            std::vector<VisiblePoint> visiblePoints_;
+
+            size_t nPasses_;
+
+            bool isGridBuilt_;
+
+            /**
+             * Visible point indices sorted by cell.
+             */
+            std::vector<size_t> cellPoints_;
+
+            /**
+             * Open-addressing hash table of occupied
+             * cells; the size is a power of two.
+             */
+            std::vector<Cell> table_;
+
+            system::SpinLock locks_[LOCK_COUNT];
+
+            /**
+             * Shared by the locks; counted only if
+             * NIWA_SYSTEM_PROFILING is defined.
+             */
+            system::LockStatistics lockStatistics_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
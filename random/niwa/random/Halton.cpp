@@ -138,5 +138,9 @@ namespace niwa {
 
             return new RandomSet(dimension, components, isThreadSafe);
         }
+
+        double Halton::radicalInverse(unsigned int index, int base) {
+            return getHaltonAt(index, base, 1.0 / base);
+        }
     }
 }
\ No newline at end of file
@@ -55,6 +55,16 @@ namespace niwa {
              */
             static RandomSet* createHaltonHammersleySet(int dimension, int length, bool isThreadSafe);
 
+            /**
+             * Computes a value of a Halton sequence directly
+             * from its index (i.e., the radical inverse of the index).
+             * Thread-safe, since no state is shared.
+             *
+             * @param index Zero-based index of the value.
+             * @param base Greater than one, preferably a prime.
+             */
+            static double radicalInverse(unsigned int index, int base);
+
         private: // prevent copying
             Halton(Halton const&);
             Halton& operator = (Halton const&);
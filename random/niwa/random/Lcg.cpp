@@ -79,5 +79,16 @@ namespace niwa {
         Lcg& Lcg::global() {
             return globalInstance;
         }
+
+        long Lcg::hashSeed(unsigned int index) {
+            // The finalizer of MurmurHash3.
+            index ^= index >> 16;
+            index *= 0x85EBCA6BU;
+            index ^= index >> 13;
+            index *= 0xC2B2AE35U;
+            index ^= index >> 16;
+
+            return static_cast<long>(index);
+        }
     }
 }
\ No newline at end of file
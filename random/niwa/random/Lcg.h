@@ -48,6 +48,14 @@ namespace niwa {
              * @return A global, thread-safe LCG.
              */
             static Lcg& global();
+
+            /**
+             * Scrambles an index into a seed, so that LCGs
+             * seeded with consecutive indices are uncorrelated.
+             * Lets each task of a parallel loop use a private
+             * LCG instead of the global one.
+             */
+            static long hashSeed(unsigned int index);
         private:
             bool isThreadSafe_;
 
@@ -32,6 +32,16 @@ namespace niwa {
                 packed_ray3f const& ray,
                 __m128 cutoffDistance,
                 ILight const* light) const;
+
+            /**
+             * Adds no bounds: lights are not specular.
+             */
+            void getCausticBounds(std::vector<geom::aabb>& bounds) const;
+
+            /**
+             * Adds the light itself.
+             */
+            void getEmitters(std::vector<ILight const*>& emitters) const;
         };
     }
 }
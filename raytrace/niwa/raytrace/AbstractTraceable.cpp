@@ -11,6 +11,8 @@
 
 #include "HitInfo.h"
 
+#include "niwa/math/simd.h"
+
 namespace niwa {
     namespace raytrace {
         bool AbstractTraceable::raytraceShadow(
@@ -26,14 +28,19 @@ namespace niwa {
 
         __m128 AbstractTraceable::raytraceShadow(
                 packed_ray3f const& ray, __m128 cutoffDistance, ILight const* light) const {
-            __m128 result = _mm_setzero_ps();
+            math::simd<float, 4> const cutoffDistances(cutoffDistance);
+
+            int result[4];
 
             for(size_t i=0; i<4; ++i) {
-                if(raytraceShadow(ray.get(i), cutoffDistance.m128_f32[i], light)) {
-                    result.m128_u32[i] = ~result.m128_u32[i];
-                }
+                result[i] = raytraceShadow(ray.get(i), cutoffDistances[i], light) ? ~0 : 0;
             }
-            return result;
+            return _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(result)));
+        }
+
+        void AbstractTraceable::getCausticBounds(
+                std::vector<geom::aabb>& /*bounds*/) const {
+            // ignored
         }
     }
 }
@@ -32,6 +32,12 @@ namespace niwa {
                 packed_ray3f const& ray,
                 __m128 cutoffDistance,
                 ILight const* light) const;
+
+            /**
+             * Adds no bounds: the traceable has
+             * no specular or dielectric parts.
+             */
+            void getCausticBounds(std::vector<geom::aabb>& bounds) const;
         };
     }
 }
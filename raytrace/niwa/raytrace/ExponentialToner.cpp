@@ -7,9 +7,9 @@
 
 #include "niwa/raytrace/ExponentialToner.h"
 
-#include <cmath>
+#include "niwa/math/simd.h"
 
-#include <xmmintrin.h>
+#include <cmath>
 
 /**
  * Whether to use a rational
@@ -33,23 +33,23 @@ namespace niwa {
 
         const Spectrum ExponentialToner::toneMap(Spectrum const& irradiation) const {
 #if USE_APPROXIMATION
-            __m128 x = _mm_mul_ps(
-                _mm_setr_ps(
-                    irradiation.r, irradiation.g, irradiation.b, 0),
-                _mm_set_ps1(strength_));
+            typedef math::simd<float, 4> simd4f;
+
+            simd4f const x = simd4f(_mm_setr_ps(
+                irradiation.r, irradiation.g, irradiation.b, 0)) * simd4f(strength_);
+
+            simd4f e = multiplyAdd(x, simd4f(1/16.0f), simd4f(1.0f));
 
-            __m128 e = _mm_add_ps(
-                _mm_set_ps1(1.0f),
-                _mm_mul_ps(x, _mm_set_ps1(1/16.0f)));
+            e *= e;
+            e *= e;
+            e *= e;
+            e *= e;
 
-            e = _mm_mul_ps(e,e);
-            e = _mm_mul_ps(e,e);
-            e = _mm_mul_ps(e,e);
-            e = _mm_mul_ps(e,e);
+            float y[simd4f::WIDTH];
 
-            __m128 y = _mm_sub_ps(_mm_set_ps1(1.0f), _mm_rcp_ps(e));
+            (simd4f(1.0f) - reciprocalApproximate(e)).storeUnaligned(y);
 
-            return Spectrum(y.m128_f32);
+            return Spectrum(y);
 #else
             return Spectrum(
                 1 - expf(-irradiation.r * strength_),
@@ -50,6 +50,16 @@ namespace niwa {
             virtual const ray3f __fastcall samplePhoton(graphics::Spectrum& power,
                     math::vec2f const& positionParameter,
                     math::vec2f const& directionParameter) const = 0;
+
+            /**
+             * Collects the elementary lights that make up this
+             * light; photons can then be emitted from each
+             * of them separately.
+             *
+             * @param emitters Receives the lights (appended to).
+             */
+            virtual void getEmitters(
+                std::vector<ILight const*>& emitters) const = 0;
         };
     }
 }
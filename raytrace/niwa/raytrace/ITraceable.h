@@ -10,7 +10,13 @@
 
 #include <xmmintrin.h>
 
+#include <vector>
+
 namespace niwa {
+    namespace geom {
+        class aabb;
+    }
+
     namespace raytrace {
         class ray3f;
         class packed_ray3f;
@@ -75,6 +81,16 @@ namespace niwa {
                 __m128 cutoffDistance,
                 ILight const* light) const = 0;
 
+            /**
+             * Collects the bounds of the specular and dielectric
+             * parts of the traceable; caustic photons are only
+             * emitted toward these bounds.
+             *
+             * @param bounds Receives the bounds (appended to).
+             */
+            virtual void getCausticBounds(
+                std::vector<geom::aabb>& bounds) const = 0;
+
         private: // prevent slicing and copying
             ITraceable(ITraceable const&);
             ITraceable& operator = (ITraceable const&);
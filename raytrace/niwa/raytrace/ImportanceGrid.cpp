@@ -0,0 +1,125 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/raytrace/ImportanceGrid.h"
+
+#include "niwa/math/vec3f.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace niwa {
+    using math::vec3f;
+
+    namespace raytrace {
+        bool const ImportanceGrid::Cell::operator < (Cell const& rhs) const {
+            if(x != rhs.x) {
+                return x < rhs.x;
+            } else if(y != rhs.y) {
+                return y < rhs.y;
+            } else {
+                return z < rhs.z;
+            }
+        }
+
+        ImportanceGrid::ImportanceGrid(float cellSize, float minProbability)
+            : invCellSize_(1 / cellSize),
+              minProbability_(minProbability),
+              fullImportance_(0) {
+            // ignored
+        }
+
+        void ImportanceGrid::clear() {
+            cells_.clear();
+            fullImportance_ = 0;
+        }
+
+        void ImportanceGrid::getCell(vec3f const& position, Cell& cell) const {
+            cell.x = static_cast<int>(floor(position.x * invCellSize_));
+            cell.y = static_cast<int>(floor(position.y * invCellSize_));
+            cell.z = static_cast<int>(floor(position.z * invCellSize_));
+        }
+
+        void ImportanceGrid::add(vec3f const& position, float importance) {
+            Cell center;
+
+            getCell(position, center);
+
+            for(int dz=-1; dz<=1; ++dz) {
+                for(int dy=-1; dy<=1; ++dy) {
+                    for(int dx=-1; dx<=1; ++dx) {
+                        Cell cell;
+
+                        cell.x = center.x + dx;
+                        cell.y = center.y + dy;
+                        cell.z = center.z + dz;
+                        cell.importance = importance;
+
+                        cells_.push_back(cell);
+                    }
+                }
+            }
+        }
+
+        void ImportanceGrid::build() {
+            std::sort(cells_.begin(), cells_.end());
+
+            // Merge the duplicate cells.
+
+            size_t nCells = 0;
+
+            for(size_t i=0; i<cells_.size(); ++i) {
+                if(nCells > 0 && !(cells_[nCells-1] < cells_[i])) {
+                    cells_[nCells-1].importance += cells_[i].importance;
+                } else {
+                    cells_[nCells++] = cells_[i];
+                }
+            }
+
+            cells_.resize(nCells);
+
+            // Photons are stored with probability one in cells of
+            // at least average importance; typically, most of the
+            // visible cells.
+
+            float totalImportance = 0;
+
+            for(size_t i=0; i<nCells; ++i) {
+                totalImportance += cells_[i].importance;
+            }
+
+            fullImportance_ = nCells > 0 ? totalImportance / nCells : 0;
+        }
+
+        bool ImportanceGrid::isEmpty() const {
+            return cells_.empty();
+        }
+
+        float ImportanceGrid::storageProbability(vec3f const& position) const {
+            if(!(fullImportance_ > 0)) {
+                // No camera path carried importance: fall back
+                // to storing every photon, as without the grid.
+                return 1;
+            }
+
+            Cell cell;
+
+            getCell(position, cell);
+
+            std::vector<Cell>::const_iterator it =
+                std::lower_bound(cells_.begin(), cells_.end(), cell);
+
+            if(it == cells_.end() || cell < *it) {
+                return minProbability_;
+            }
+
+            return std::max(
+                minProbability_,
+                std::min(1.0f, it->importance / fullImportance_));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_RAYTRACE_IMPORTANCEGRID_H
+#define NIWA_RAYTRACE_IMPORTANCEGRID_H
+
+#include <vector>
+
+namespace niwa {
+    namespace math {
+        class vec3f;
+    }
+
+    namespace raytrace {
+        /**
+         * A coarse, sparse grid of visual importance,
+         * deposited by importons (camera paths).
+         *
+         * Photons are stored with a probability that follows the
+         * importance at their position, and their power is divided
+         * by the probability, so that the photon map remains unbiased
+         * while photons the camera cannot see are mostly rejected.
+         * See Peter and Pietrek, "Importance Driven Construction
+         * of Photon Maps" (EGWR 1998).
+         */
+        class ImportanceGrid {
+        public:
+            /**
+             * @param cellSize Edge length of the grid cells;
+             *                 should be at least the photon
+             *                 search radius.
+             *
+             * @param minProbability The storage probability
+             *                       of photons without importance.
+             */
+            ImportanceGrid(float cellSize, float minProbability);
+
+            /**
+             * Removes all importance. Not thread-safe.
+             */
+            void clear();
+
+            /**
+             * Deposits importance at the given position; the
+             * importance spreads to the neighboring cells, since
+             * photon searches reach over the cell boundaries.
+             * Not thread-safe.
+             */
+            void add(math::vec3f const& position, float importance);
+
+            /**
+             * Must be called after adding importance and
+             * before querying probabilities. Not thread-safe.
+             */
+            void build();
+
+            /**
+             * @return Whether any importance has been deposited.
+             */
+            bool isEmpty() const;
+
+            /**
+             * Thread-safe.
+             *
+             * @return The probability of storing a photon at the given
+             *         position, between the minimum probability and one;
+             *         one everywhere if the total importance is zero.
+             */
+            float storageProbability(math::vec3f const& position) const;
+
+        private:
+            struct Cell {
+                bool const operator < (Cell const& rhs) const;
+
+                int x, y, z;
+
+                float importance;
+            };
+
+        private:
+            void getCell(math::vec3f const& position, Cell& cell) const;
+
+        private:
+            float const invCellSize_;
+
+            float const minProbability_;
+
+            /**
+             * Importance of a cell, relative to which
+             * photons are stored with probability one.
+             */
+            float fullImportance_;
+
+            /**
+             * Sorted by coordinates after building.
+             */
+            std::vector<Cell> cells_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/raytrace/IndirectBatch.h"
+
+#include "niwa/photonmap/IPhotonMap.h"
+
+namespace niwa {
+    using graphics::Spectrum;
+
+    using math::vec3f;
+
+    using photonmap::DensityQuery;
+
+    namespace raytrace {
+        IndirectBatch::IndirectBatch() {
+            // ignored
+        }
+
+        void IndirectBatch::clear() {
+            queries_.clear();
+            weights_.clear();
+            pixels_.clear();
+        }
+
+        void IndirectBatch::add(
+                vec3f const& position,
+                vec3f const& normal,
+                Spectrum const& weight,
+                size_t pixel) {
+            DensityQuery query;
+
+            query.position = position;
+            query.normal = normal;
+
+            queries_.push_back(query);
+            weights_.push_back(weight);
+            pixels_.push_back(pixel);
+        }
+
+        size_t IndirectBatch::size() const {
+            return queries_.size();
+        }
+
+        DensityQuery const& IndirectBatch::getQuery(size_t i) const {
+            return queries_[i];
+        }
+
+        Spectrum const& IndirectBatch::getWeight(size_t i) const {
+            return weights_[i];
+        }
+
+        size_t IndirectBatch::getPixel(size_t i) const {
+            return pixels_[i];
+        }
+
+        void IndirectBatch::resolve(
+                photonmap::IPhotonMap const& photonMap,
+                Spectrum* radiances) {
+            if(queries_.empty()) {
+                return;
+            }
+
+            photonMap.powerDensities(&queries_[0], queries_.size());
+
+            for(size_t i=0; i<queries_.size(); ++i) {
+                radiances[pixels_[i]] += queries_[i].density * weights_[i];
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_RAYTRACE_INDIRECTBATCH_H
+#define NIWA_RAYTRACE_INDIRECTBATCH_H
+
+#include "niwa/photonmap/DensityQuery.h"
+
+#include <vector>
+
+namespace niwa {
+    namespace photonmap {
+        class IPhotonMap;
+    }
+
+    namespace raytrace {
+        /**
+         * Deferred photon map estimates of indirect radiance.
+         *
+         * Collecting the estimates of many pixels before resolving
+         * them lets the photon map process them in spatially
+         * coherent order. Not thread-safe; use one batch per thread.
+         */
+        class IndirectBatch {
+        public:
+            IndirectBatch();
+
+            /**
+             * Removes all estimates (but keeps the allocated memory).
+             */
+            void clear();
+
+            /**
+             * @param position The position of the estimate.
+             *
+             * @param normal Unit surface normal at the position.
+             *
+             * @param weight Converts the power density at the position
+             *               to radiance at the pixel.
+             *
+             * @param pixel Index of the radiance the estimate adds to.
+             */
+            void add(
+                math::vec3f const& position,
+                math::vec3f const& normal,
+                graphics::Spectrum const& weight,
+                size_t pixel);
+
+            size_t size() const;
+
+            photonmap::DensityQuery const& getQuery(size_t i) const;
+
+            graphics::Spectrum const& getWeight(size_t i) const;
+
+            size_t getPixel(size_t i) const;
+
+            /**
+             * Resolves the estimates with a single batched photon map query
+             * and adds the weighted densities to the pixel radiances.
+             */
+            void resolve(
+                photonmap::IPhotonMap const& photonMap,
+                graphics::Spectrum* radiances);
+
+        private: // prevent copying
+            IndirectBatch(IndirectBatch const&);
+            IndirectBatch& operator = (IndirectBatch const&);
+
+        private:
+            std::vector<photonmap::DensityQuery> queries_;
+
+            std::vector<graphics::Spectrum> weights_;
+
+            std::vector<size_t> pixels_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -10,29 +10,96 @@
 #include "niwa/raytrace/HitInfo.h"
 #include "niwa/raytrace/ILight.h"
 #include "niwa/raytrace/ITraceable.h"
+#include "niwa/raytrace/ImportanceGrid.h"
+#include "niwa/raytrace/ProjectionMap.h"
 #include "niwa/raytrace/Hemisphere.h"
 #include "niwa/raytrace/ray3f.h"
 
 #include "niwa/photonmap/IPhotonMap.h"
 #include "niwa/photonmap/Photon.h"
 
+#include "niwa/geom/aabb.h"
+
 #include "niwa/graphics/Spectrum.h"
 
 #include "niwa/math/vec2f.h"
 
 #include "niwa/random/Lcg.h"
-#include "niwa/random/RandomSet.h"
 #include "niwa/random/Halton.h"
 
 #include "niwa/system/IParallelizer.h"
+#include "niwa/system/Profiler.h"
+
+#include <vector>
 
 #define RANDOM_DIMENSION 4
 
+/**
+ * Resolution of the projection maps of caustic photons.
+ */
+#define PROJECTION_RESOLUTION 32
+
 namespace {
-    float randomAt(float* randomVector, int index) {
+    /**
+     * Bases of the Halton dimensions; the first
+     * dimension is the Hammersley one.
+     */
+    static const int HALTON_BASES[RANDOM_DIMENSION-1] = { 2, 3, 5 };
+
+    /**
+     * Bases of the Halton dimensions of caustic photons;
+     * distinct from the global ones, so that the caustic
+     * map does not repeat the directions of the global map.
+     */
+    static const int CAUSTIC_HALTON_BASES[RANDOM_DIMENSION-1] = { 11, 13, 17 };
+
+    /**
+     * Mixed into the seeds of caustic photons for the same reason.
+     */
+    static const long CAUSTIC_SEED_SALT = 0x2545F491;
+
+    /**
+     * Base of the per-pass offset of the Hammersley
+     * dimension; distinct from the Halton bases.
+     */
+    static const int PASS_BASE = 7;
+
+    /**
+     * @return The index of a photon in the sequence of all passes.
+     */
+    static unsigned int fGetSequenceIndex(
+            int index, int photonCount, unsigned int pass) {
+        return pass * static_cast<unsigned int>(photonCount)
+             + static_cast<unsigned int>(index);
+    }
+
+    /**
+     * Fills the quasi-random vector of a photon. The Hammersley
+     * dimension stays stratified within each pass, and each pass
+     * offsets the strata; the Halton dimensions continue
+     * from the previous passes.
+     */
+    static void fGetRandomVector(
+            int index, int photonCount, unsigned int pass,
+            int const* bases, float* randomVector) {
+        randomVector[0] = static_cast<float>(
+            (index + niwa::random::Halton::radicalInverse(pass, PASS_BASE))
+                / photonCount);
+
+        unsigned int const sequenceIndex =
+            fGetSequenceIndex(index, photonCount, pass);
+
+        for(int i=1; i<RANDOM_DIMENSION; ++i) {
+            randomVector[i] = static_cast<float>(
+                niwa::random::Halton::radicalInverse(
+                    sequenceIndex, bases[i-1]));
+        }
+    }
+
+    float randomAt(float* randomVector, int index, niwa::random::Lcg& lcg) {
         return index < RANDOM_DIMENSION 
             ? randomVector[index] 
-            : niwa::random::Lcg::global().nextf();
+            : lcg.nextf();
     }
 }
 
@@ -54,7 +121,8 @@ namespace niwa {
         public:
             TraceTask(
                 PhotonTracer const& parent, 
-                IPhotonMap& photonMap, int photonCount);
+                IPhotonMap& photonMap, int photonCount,
+                unsigned int pass, PhotonPaths paths);
 
             void __fastcall invoke(int i);
 
@@ -66,6 +134,32 @@ namespace niwa {
             PhotonTracer const& parent_;
             IPhotonMap& photonMap_;
             const int photonCount_;
+            const unsigned int pass_;
+            const PhotonPaths paths_;
+        };
+
+        class PhotonTracer::CausticTask : public system::IParallelizer::ICallback {
+        public:
+            CausticTask(
+                PhotonTracer const& parent,
+                IPhotonMap& photonMap,
+                ILight const& light,
+                ProjectionMap const& projection,
+                int photonCount, unsigned int pass);
+
+            void __fastcall invoke(int i);
+
+        private: // prevent copying
+            CausticTask(CausticTask const&);
+            CausticTask& operator = (CausticTask const&);
+
+        private:
+            PhotonTracer const& parent_;
+            IPhotonMap& photonMap_;
+            ILight const& light_;
+            ProjectionMap const& projection_;
+            const int photonCount_;
+            const unsigned int pass_;
         };
 
         PhotonTracer::PhotonTracer() {
@@ -84,26 +178,104 @@ namespace niwa {
             light_ = light;
         }
 
-        void PhotonTracer::tracePhotons(IPhotonMap& photonMap, int photonCount) const {
+        void PhotonTracer::tracePhotons(
+                IPhotonMap& photonMap, int photonCount, unsigned int pass) const {
+            tracePhotons(photonMap, photonCount, pass, PATHS_ALL);
+        }
+
+        void PhotonTracer::traceGlobalPhotons(
+                IPhotonMap& photonMap, int photonCount, unsigned int pass) const {
+            tracePhotons(photonMap, photonCount, pass, PATHS_GLOBAL);
+        }
+
+        void PhotonTracer::tracePhotons(
+                IPhotonMap& photonMap, int photonCount, unsigned int pass,
+                PhotonPaths paths) const {
+            NIWA_PROFILE_ZONE("trace photons");
+
             if(!scene_ || !light_ || !parallelizer_) {
                 return;
             }
 
-            TraceTask task(*this, photonMap, photonCount);
-
-            randomSet_ = std::auto_ptr<random::RandomSet>(
-                random::Halton::createHaltonHammersleySet(
-                    RANDOM_DIMENSION, photonCount, true));
+            TraceTask task(*this, photonMap, photonCount, pass, paths);
 
             parallelizer_->loop(task, 0, photonCount);
         }
 
+        void PhotonTracer::traceCausticPhotons(
+                IPhotonMap& photonMap, int photonCount, unsigned int pass) const {
+            NIWA_PROFILE_ZONE("trace caustic photons");
+
+            if(!scene_ || !light_ || !parallelizer_) {
+                return;
+            }
+
+            std::vector<geom::aabb> bounds;
+
+            scene_->getCausticBounds(bounds);
+
+            if(bounds.empty()) {
+                return;
+            }
+
+            std::vector<ILight const*> lights;
+
+            light_->getEmitters(lights);
+
+            float totalPower = 0;
+
+            for(size_t i=0; i<lights.size(); ++i) {
+                totalPower += lights[i]->getPower().average();
+            }
+
+            if(totalPower <= 0) {
+                return;
+            }
+
+            ProjectionMap projection(PROJECTION_RESOLUTION);
+
+            for(size_t i=0; i<lights.size(); ++i) {
+                int const lightPhotonCount = static_cast<int>(
+                    photonCount * lights[i]->getPower().average() / totalPower + 0.5f);
+
+                if(lightPhotonCount <= 0) {
+                    continue;
+                }
+
+                projection.build(*lights[i], bounds);
+
+                if(projection.isEmpty()) {
+                    continue;
+                }
+
+                CausticTask task(
+                    *this, photonMap, *lights[i], projection,
+                    lightPhotonCount, pass);
+
+                parallelizer_->loop(task, 0, lightPhotonCount);
+            }
+        }
+
         PhotonTracer::TraceTask::TraceTask(
                 PhotonTracer const& parent,
                 IPhotonMap& photonMap,
-                int photonCount)
+                int photonCount,
+                unsigned int pass,
+                PhotonPaths paths)
             : parent_(parent), photonMap_(photonMap), 
-              photonCount_(photonCount) {
+              photonCount_(photonCount), pass_(pass), paths_(paths) {
+            // ignored
+        }
+
+        PhotonTracer::CausticTask::CausticTask(
+                PhotonTracer const& parent,
+                IPhotonMap& photonMap,
+                ILight const& light,
+                ProjectionMap const& projection,
+                int photonCount,
+                unsigned int pass)
+            : parent_(parent), photonMap_(photonMap), light_(light),
+              projection_(projection), photonCount_(photonCount), pass_(pass) {
             // ignored
         }
 
@@ -111,48 +283,142 @@ namespace niwa {
             parallelizer_ = parallelizer;
         }
 
-        void PhotonTracer::TraceTask::invoke(int /*index*/) {
-            parent_.traceSinglePhoton(photonMap_, photonCount_);
+        void PhotonTracer::setImportance(shared_ptr<ImportanceGrid const> importance) {
+            importance_ = importance;
+        }
+
+        void PhotonTracer::TraceTask::invoke(int index) {
+            parent_.traceSinglePhoton(photonMap_, photonCount_, pass_, index, paths_);
         }
 
-        void PhotonTracer::traceSinglePhoton(IPhotonMap& photonMap, int photonCount) const {
+        void PhotonTracer::CausticTask::invoke(int index) {
+            parent_.traceCausticPhoton(
+                photonMap_, light_, projection_, photonCount_, pass_, index);
+        }
+
+        void PhotonTracer::traceSinglePhoton(
+                IPhotonMap& photonMap, int photonCount, unsigned int pass,
+                int index, PhotonPaths paths) const {
+            // All random numbers of the photon derive from its pass
+            // and index: no state is shared between threads, and the
+            // photons are the same regardless of the thread count.
+
             float randomVector[RANDOM_DIMENSION];
 
-            randomSet_->nextf(randomVector);
+            fGetRandomVector(index, photonCount, pass, HALTON_BASES, randomVector);
+
+            Lcg lcg(false);
+
+            lcg.setSeed(Lcg::hashSeed(
+                fGetSequenceIndex(index, photonCount, pass)));
 
             Spectrum power;
 
             ray3f ray(light_->samplePhoton(
                 power,
                 vec2f(
-                    Lcg::global().nextf(),
-                    Lcg::global().nextf()),
+                    lcg.nextf(),
+                    lcg.nextf()),
                 vec2f(
-                    randomAt(randomVector, 0), 
-                    randomAt(randomVector, 1))));
+                    randomAt(randomVector, 0, lcg), 
+                    randomAt(randomVector, 1, lcg))));
 
             power /= static_cast<float>(photonCount); // split power
 
+            tracePhotonPath(photonMap, ray, power, randomVector, lcg, paths);
+        }
+
+        void PhotonTracer::traceCausticPhoton(
+                IPhotonMap& photonMap,
+                ILight const& light,
+                ProjectionMap const& projection,
+                int photonCount, unsigned int pass, int index) const {
+            float randomVector[RANDOM_DIMENSION];
+
+            fGetRandomVector(
+                index, photonCount, pass, CAUSTIC_HALTON_BASES, randomVector);
+
+            Lcg lcg(false);
+
+            lcg.setSeed(Lcg::hashSeed(
+                fGetSequenceIndex(index, photonCount, pass)) ^ CAUSTIC_SEED_SALT);
+
+            Spectrum power;
+
+            ray3f ray(light.samplePhoton(
+                power,
+                vec2f(
+                    lcg.nextf(),
+                    lcg.nextf()),
+                projection.sampleDirectionParameter(vec2f(
+                    randomAt(randomVector, 0, lcg),
+                    randomAt(randomVector, 1, lcg)))));
+
+            // Only the marked fraction of the directions is sampled.
+            power *= projection.getCoverage() / photonCount;
+
+            tracePhotonPath(photonMap, ray, power, randomVector, lcg, PATHS_CAUSTIC);
+        }
+
+        void PhotonTracer::tracePhotonPath(
+                IPhotonMap& photonMap,
+                ray3f ray,
+                Spectrum power,
+                float* randomVector,
+                Lcg& lcg,
+                PhotonPaths paths) const {
             HitInfo hit = HitInfo::createUninitialized();
 
             float currentRefractiveIndex = 1;
 
             int bounceCount = 0;
 
+            // Whether all bounces so far have been specular.
+            bool causticPath = true;
+
             while( scene_->raytrace(ray, hit) ) {
-                if(bounceCount > 0) {
-                    Photon photon(
-                        hit.position(),
-                        hit.normal(),
-                        power);
+                Material const& material = hit.material();
+
+                bool const diffuse = material.getType() == Material::MATERIAL_DIFFUSE;
 
-                    photonMap.add(photon);
+                if(paths == PATHS_CAUSTIC && diffuse && bounceCount == 0) {
+                    break; // missed the specular objects
                 }
 
-                Material const& material = hit.material();
+                bool const store = bounceCount > 0
+                    && (paths == PATHS_ALL
+                        || (paths == PATHS_GLOBAL && !causticPath)
+                        || (paths == PATHS_CAUSTIC && diffuse));
+
+                if(store) {
+                    float const probability =
+                        importance_ && !importance_->isEmpty()
+                            ? importance_->storageProbability(hit.position())
+                            : 1.0f;
+
+                    // Russian roulette on storage; the surviving
+                    // photons compensate for the rejected ones.
+                    if(probability >= 1) {
+                        photonMap.add(Photon(
+                            hit.position(),
+                            hit.normal(),
+                            power));
+                    } else if(lcg.nextf() < probability) {
+                        photonMap.add(Photon(
+                            hit.position(),
+                            hit.normal(),
+                            power / probability));
+                    }
+                }
+
+                if(diffuse) {
+                    if(paths == PATHS_CAUSTIC) {
+                        break;
+                    }
+
+                    causticPath = false;
 
-                if(material.getType() == Material::MATERIAL_DIFFUSE) {
-                    float u = Lcg::global().nextf();
+                    float u = lcg.nextf();
 
                     // Russian roulette.
                     if(u <= material.getReflectance().average()) {
@@ -163,13 +429,13 @@ namespace niwa {
                             hit.position(),
                             Hemisphere::cosineWeightedDirection(
                                 hit.normal(),
-                                randomAt(randomVector, 2+2*bounceCount),
-                                randomAt(randomVector, 3+2*bounceCount)));
+                                randomAt(randomVector, 2+2*bounceCount, lcg),
+                                randomAt(randomVector, 3+2*bounceCount, lcg)));
                     } else {
                         break;
                     }
                 } else if(material.getType() == Material::MATERIAL_SPECULAR) {
-                    float u = Lcg::global().nextf();
+                    float u = lcg.nextf();
 
                     // Russian roulette.
                     if(u <= material.getReflectance().average()) {
@@ -190,7 +456,7 @@ namespace niwa {
                         currentRefractiveIndex,
                         material.getRefractiveIndex());
 
-                    float u = Lcg::global().nextf();
+                    float u = lcg.nextf();
 
                     if(u < 1 - fresnel) {
                         // refraction
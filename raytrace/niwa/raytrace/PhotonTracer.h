@@ -9,7 +9,6 @@
 #define NIWA_RAYTRACER_PHOTONTRACER_H
 
 #include <boost/shared_ptr.hpp>
-#include <memory>
 
 namespace niwa {
     namespace system {
@@ -20,13 +19,20 @@ namespace niwa {
         class IPhotonMap;
     }
 
+    namespace graphics {
+        class Spectrum;
+    }
+
     namespace random {
-        class RandomSet;
+        class Lcg;
     }
 
     namespace raytrace {
         class ITraceable;
         class ILight;
+        class ImportanceGrid;
+        class ProjectionMap;
+        class ray3f;
 
         class PhotonTracer {
         public:
@@ -40,15 +46,101 @@ namespace niwa {
             void setParallelizer(
                 boost::shared_ptr<system::IParallelizer> parallelizer);
 
+            /**
+             * @param importance Guides which photons are stored;
+             *                   null (the default) to store all photons.
+             *                   Must be built before tracing photons.
+             */
+            void setImportance(boost::shared_ptr<ImportanceGrid const> importance);
+
+            /**
+             * Traces photons along all paths.
+             *
+             * @param pass Selects the photons: the same pass always
+             *             gives the same photons, and successive passes
+             *             continue the quasi-random sequence, so that
+             *             progressive estimates converge.
+             */
             void tracePhotons(
-                photonmap::IPhotonMap& photonMap, int photonCount) const;
+                photonmap::IPhotonMap& photonMap,
+                int photonCount, unsigned int pass) const;
+
+            /**
+             * Traces photons for a global map that is used alongside
+             * a caustic map: the caustic paths (from the light via
+             * specular surfaces to a diffuse surface) are not stored.
+             *
+             * @param pass See tracePhotons.
+             */
+            void traceGlobalPhotons(
+                photonmap::IPhotonMap& photonMap,
+                int photonCount, unsigned int pass) const;
+
+            /**
+             * Traces photons only along the caustic paths. The photons
+             * are emitted toward the specular and dielectric objects
+             * using a projection map of each light, and the photon
+             * count is split among the lights by their power.
+             *
+             * @param pass See tracePhotons.
+             */
+            void traceCausticPhotons(
+                photonmap::IPhotonMap& photonMap,
+                int photonCount, unsigned int pass) const;
 
         private:
+            /**
+             * Which photon paths are stored.
+             */
+            enum PhotonPaths {
+                PATHS_ALL,
+                PATHS_GLOBAL, // all but the caustic paths
+                PATHS_CAUSTIC // only the caustic paths
+            };
+
+        private:
+            void tracePhotons(
+                photonmap::IPhotonMap& photonMap,
+                int photonCount, unsigned int pass,
+                PhotonPaths paths) const;
+
+            /**
+             * Traces the photon with the given index; the random
+             * numbers of the photon only depend on the pass
+             * and the index.
+             */
             void traceSinglePhoton(
-                photonmap::IPhotonMap& photonMap, int photonCount) const;
+                photonmap::IPhotonMap& photonMap,
+                int photonCount, unsigned int pass, int index,
+                PhotonPaths paths) const;
+
+            /**
+             * Traces a caustic photon of the given light.
+             *
+             * @param projection The projection map of the light.
+             */
+            void traceCausticPhoton(
+                photonmap::IPhotonMap& photonMap,
+                ILight const& light,
+                ProjectionMap const& projection,
+                int photonCount, unsigned int pass, int index) const;
+
+            /**
+             * Traces an emitted photon through the scene.
+             *
+             * @param randomVector Quasi-random numbers of the photon.
+             */
+            void tracePhotonPath(
+                photonmap::IPhotonMap& photonMap,
+                ray3f ray,
+                graphics::Spectrum power,
+                float* randomVector,
+                random::Lcg& lcg,
+                PhotonPaths paths) const;
 
         private:
             class TraceTask;
+            class CausticTask;
 
         private: // prevent copying
             PhotonTracer(PhotonTracer const&);
@@ -61,7 +153,7 @@ namespace niwa {
 
             boost::shared_ptr<system::IParallelizer> parallelizer_;
 
-            mutable std::auto_ptr<random::RandomSet> randomSet_;
+            boost::shared_ptr<ImportanceGrid const> importance_;
         };
     }
 }
@@ -0,0 +1,182 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/raytrace/ProjectionMap.h"
+
+#include "niwa/raytrace/ILight.h"
+#include "niwa/raytrace/ray3f.h"
+
+#include "niwa/geom/aabb.h"
+
+#include "niwa/graphics/Spectrum.h"
+
+#include "niwa/math/vec2f.h"
+#include "niwa/math/vec3f.h"
+
+#include <algorithm>
+#include <cfloat>
+
+/**
+ * Number of position parameter samples per axis;
+ * the samples include the edges of the light.
+ */
+#define POSITION_SAMPLES 3
+
+/**
+ * Number of direction parameter samples
+ * per axis within a single cell.
+ */
+#define DIRECTION_SAMPLES 2
+
+namespace {
+    using niwa::geom::aabb;
+    using niwa::math::vec3f;
+    using niwa::raytrace::ray3f;
+
+    /**
+     * @return Whether the ray hits the box at a non-negative distance.
+     */
+    static bool fHits(aabb const& bounds, ray3f const& ray) {
+        vec3f const* elt = bounds.getExtrema();
+
+        vec3f const& pos = ray.getPosition();
+        vec3f const& dir = ray.getDirection();
+
+        float tmin = 0;
+        float tmax = FLT_MAX;
+
+        for(int i=0; i<3; ++i) {
+            if(dir[i] == 0) {
+                if(pos[i] < elt[0][i] || pos[i] > elt[1][i]) {
+                    return false;
+                }
+            } else {
+                float t0 = (elt[0][i] - pos[i]) / dir[i];
+                float t1 = (elt[1][i] - pos[i]) / dir[i];
+
+                tmin = std::max(tmin, std::min(t0, t1));
+                tmax = std::min(tmax, std::max(t0, t1));
+
+                if(tmin > tmax) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Position parameters must stay below one.
+     */
+    static float fPositionSample(int i) {
+        return std::min(
+            static_cast<float>(i) / (POSITION_SAMPLES-1),
+            0.999f);
+    }
+}
+
+namespace niwa {
+    using geom::aabb;
+
+    using graphics::Spectrum;
+
+    using math::vec2f;
+
+    namespace raytrace {
+        ProjectionMap::ProjectionMap(int resolution)
+            : resolution_(resolution) {
+            // ignored
+        }
+
+        void ProjectionMap::build(
+                ILight const& light, std::vector<aabb> const& bounds) {
+            markedCells_.clear();
+
+            if(bounds.empty()) {
+                return;
+            }
+
+            int const n = resolution_;
+
+            std::vector<char> hits(n * n, 0);
+
+            for(int cy=0; cy<n; ++cy) {
+                for(int cx=0; cx<n; ++cx) {
+                    bool hit = false;
+
+                    for(int s=0; s<DIRECTION_SAMPLES*DIRECTION_SAMPLES && !hit; ++s) {
+                        vec2f const direction(
+                            (cx + (s % DIRECTION_SAMPLES + 0.5f) / DIRECTION_SAMPLES) / n,
+                            (cy + (s / DIRECTION_SAMPLES + 0.5f) / DIRECTION_SAMPLES) / n);
+
+                        for(int p=0; p<POSITION_SAMPLES*POSITION_SAMPLES && !hit; ++p) {
+                            vec2f const position(
+                                fPositionSample(p % POSITION_SAMPLES),
+                                fPositionSample(p / POSITION_SAMPLES));
+
+                            Spectrum power;
+
+                            ray3f const ray(light.samplePhoton(power, position, direction));
+
+                            for(size_t i=0; i<bounds.size() && !hit; ++i) {
+                                hit = fHits(bounds[i], ray);
+                            }
+                        }
+                    }
+
+                    hits[cy*n + cx] = hit ? 1 : 0;
+                }
+            }
+
+            for(int cy=0; cy<n; ++cy) {
+                for(int cx=0; cx<n; ++cx) {
+                    bool marked = false;
+
+                    for(int dy=-1; dy<=1 && !marked; ++dy) {
+                        for(int dx=-1; dx<=1 && !marked; ++dx) {
+                            int const x = cx + dx;
+                            int const y = cy + dy;
+
+                            marked = x >= 0 && x < n && y >= 0 && y < n
+                                && hits[y*n + x] != 0;
+                        }
+                    }
+
+                    if(marked) {
+                        markedCells_.push_back(cy*n + cx);
+                    }
+                }
+            }
+        }
+
+        bool ProjectionMap::isEmpty() const {
+            return markedCells_.empty();
+        }
+
+        float ProjectionMap::getCoverage() const {
+            return static_cast<float>(markedCells_.size())
+                / (resolution_ * resolution_);
+        }
+
+        vec2f ProjectionMap::sampleDirectionParameter(vec2f const& sample) const {
+            int const nMarked = static_cast<int>(markedCells_.size());
+
+            // The first coordinate picks the cell, and its
+            // fraction is the offset within the cell.
+
+            float const x = sample.x * nMarked;
+
+            int const k = std::min(static_cast<int>(x), nMarked-1);
+
+            int const cell = markedCells_[k];
+
+            return vec2f(
+                (cell % resolution_ + std::min(x - k, 0.999f)) / resolution_,
+                (cell / resolution_ + sample.y) / resolution_);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_RAYTRACE_PROJECTIONMAP_H
+#define NIWA_RAYTRACE_PROJECTIONMAP_H
+
+#include <vector>
+
+namespace niwa {
+    namespace geom {
+        class aabb;
+    }
+
+    namespace math {
+        class vec2f;
+    }
+
+    namespace raytrace {
+        class ILight;
+
+        /**
+         * A projection map of a light: a grid over the direction
+         * parameter of the light, marking the cells whose photons
+         * may hit the specular and dielectric objects of the scene.
+         * Caustic photons are only emitted from the marked cells,
+         * and their power is scaled by the marked fraction.
+         * See [Jensen] Section 9.4.
+         */
+        class ProjectionMap {
+        public:
+            /**
+             * @param resolution Number of cells along each
+             *                   axis of the direction parameter.
+             */
+            explicit ProjectionMap(int resolution);
+
+            /**
+             * Marks the cells by sampling photons of the light
+             * against the given bounds. The marked cells are
+             * dilated by one cell, since the sampling is sparse.
+             */
+            void build(ILight const& light, std::vector<geom::aabb> const& bounds);
+
+            /**
+             * @return Whether no cell is marked.
+             */
+            bool isEmpty() const;
+
+            /**
+             * @return The fraction of the marked cells, in [0,1].
+             */
+            float getCoverage() const;
+
+            /**
+             * Maps a point of the unit square uniformly onto
+             * the marked cells. Only valid for a non-empty map.
+             *
+             * @return A direction parameter, in [0,1) x [0,1).
+             */
+            math::vec2f sampleDirectionParameter(math::vec2f const& sample) const;
+
+        private:
+            int const resolution_;
+
+            /**
+             * Indices of the marked cells, in row-major order.
+             */
+            std::vector<int> markedCells_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
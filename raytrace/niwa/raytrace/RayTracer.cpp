@@ -8,6 +8,8 @@
 #include "niwa/raytrace/RayTracer.h"
 
 #include "niwa/raytrace/HitInfo.h"
+#include "niwa/raytrace/ImportanceGrid.h"
+#include "niwa/raytrace/IndirectBatch.h"
 #include "niwa/raytrace/ITraceable.h"
 #include "niwa/raytrace/Hemisphere.h"
 #include "niwa/raytrace/ILight.h"
@@ -48,15 +50,40 @@ namespace niwa {
             photonMap_ = photonMap;
         }
 
+        void RayTracer::setCausticMap(shared_ptr<IPhotonMap> causticMap) {
+            causticMap_ = causticMap;
+        }
+
         const Spectrum RayTracer::sampleIncidentRadiance(
                 ray3f const& ray) const {
-            return sampleIncidentRadiance(ray, 1, 0);
+            return sampleIncidentRadiance(ray, 1, 0, NULL, 0, Spectrum(1,1,1));
+        }
+
+        const Spectrum RayTracer::sampleIncidentRadiance(
+                ray3f const& ray,
+                IndirectBatch& batch,
+                size_t pixel) const {
+            return sampleIncidentRadiance(ray, 1, 0, &batch, pixel, Spectrum(1,1,1));
+        }
+
+        void RayTracer::resolveIndirectRadiance(
+                IndirectBatch& batch, Spectrum* radiances) const {
+            if(photonMap_) {
+                batch.resolve(*photonMap_, radiances);
+            }
+
+            if(causticMap_) {
+                batch.resolve(*causticMap_, radiances);
+            }
         }
 
         const Spectrum RayTracer::sampleIncidentRadiance(
                 ray3f const& ray, 
                 float currentRefractiveIndex, 
-                int depth) const {
+                int depth,
+                IndirectBatch* batch,
+                size_t pixel,
+                Spectrum const& weight) const {
             if(depth > MAX_DEPTH) {
                 return Spectrum(0,0,0);
             }
@@ -69,6 +96,19 @@ namespace niwa {
                 if(material.getType() == Material::MATERIAL_EMITTING) {
                     return material.getEmittedRadiance();
                 } else if(material.getType() == Material::MATERIAL_DIFFUSE) {
+                    if(batch) {
+                        if(photonMap_) {
+                            // AGI, Equation 2.23.
+                            Spectrum brdf( material.getReflectance() / PI_F );
+
+                            batch->add(
+                                hitInfo.position(), hitInfo.normal(),
+                                weight * brdf, pixel);
+                        }
+
+                        return sampleDirectRadiance(hitInfo);
+                    }
+
                     return sampleDirectRadiance(hitInfo)
                          + estimateIndirectRadiance(hitInfo);
                 } else if(material.getType() == Material::MATERIAL_SPECULAR) {
@@ -81,7 +121,8 @@ namespace niwa {
                     Spectrum radiance( 
                         sampleIncidentRadiance(
                             reflectedRay,
-                            currentRefractiveIndex, depth+1) );
+                            currentRefractiveIndex, depth+1,
+                            batch, pixel, weight * material.getReflectance()) );
 
                     return radiance * material.getReflectance();
                 } else if(material.getType() == Material::MATERIAL_DIELECTRIC) {
@@ -99,28 +140,33 @@ namespace niwa {
                             hitInfo.normal(),
                             ray.getDirection()));
 
-                    Spectrum reflectedRadiance( 
-                        sampleIncidentRadiance(
-                            reflectedRay,
-                            currentRefractiveIndex, depth+1) );
-
                     if(isTotalInternalReflection) {
-                        return reflectedRadiance;
+                        return sampleIncidentRadiance(
+                            reflectedRay,
+                            currentRefractiveIndex, depth+1,
+                            batch, pixel, weight);
                     } else {
                         ray3f refractedRay(
                             hitInfo.position(),
                             refractedDirection);
 
-                        Spectrum refractedRadiance(
-                            sampleIncidentRadiance(
-                                refractedRay,
-                                material.getRefractiveIndex(), depth+1));
-
                         float fresnelCoefficient = Hemisphere::fresnelCoefficient(
                             hitInfo.normal(), ray.getDirection(),
                             currentRefractiveIndex,
                             material.getRefractiveIndex());
 
+                        Spectrum reflectedRadiance( 
+                            sampleIncidentRadiance(
+                                reflectedRay,
+                                currentRefractiveIndex, depth+1,
+                                batch, pixel, weight * fresnelCoefficient) );
+
+                        Spectrum refractedRadiance(
+                            sampleIncidentRadiance(
+                                refractedRay,
+                                material.getRefractiveIndex(), depth+1,
+                                batch, pixel, weight * (1 - fresnelCoefficient)));
+
                         return reflectedRadiance * fresnelCoefficient
                             + refractedRadiance * (1 - fresnelCoefficient);
                     }
@@ -132,6 +178,81 @@ namespace niwa {
             }
         }
 
+        void RayTracer::traceImporton(
+                ray3f const& ray, ImportanceGrid& importance) const {
+            traceImporton(ray, 1, 0, 1, importance);
+        }
+
+        void RayTracer::traceImporton(
+                ray3f const& ray,
+                float currentRefractiveIndex,
+                int depth,
+                float weight,
+                ImportanceGrid& importance) const {
+            if(depth > MAX_DEPTH) {
+                return;
+            }
+
+            HitInfo hitInfo = HitInfo::createUninitialized();
+
+            if(!scene_->raytrace(ray, hitInfo)) {
+                return;
+            }
+
+            Material const& material = hitInfo.material();
+
+            // Follows sampleIncidentRadiance, which
+            // queries the photon map at diffuse surfaces.
+
+            if(material.getType() == Material::MATERIAL_DIFFUSE) {
+                importance.add(
+                    hitInfo.position(),
+                    weight * material.getReflectance().average());
+            } else if(material.getType() == Material::MATERIAL_SPECULAR) {
+                ray3f reflectedRay(
+                    hitInfo.position(),
+                    Hemisphere::mirrorReflection(
+                        hitInfo.normal(),
+                        ray.getDirection()));
+
+                traceImporton(
+                    reflectedRay, currentRefractiveIndex, depth+1,
+                    weight * material.getReflectance().average(),
+                    importance);
+            } else if(material.getType() == Material::MATERIAL_DIELECTRIC) {
+                vec3f refractedDirection;
+
+                ray3f reflectedRay(
+                    hitInfo.position(),
+                    Hemisphere::mirrorReflection(
+                        hitInfo.normal(),
+                        ray.getDirection()));
+
+                if(!Hemisphere::computeRefraction(
+                        hitInfo.normal(), ray.getDirection(),
+                        currentRefractiveIndex, material.getRefractiveIndex(),
+                        refractedDirection)) {
+                    traceImporton(
+                        reflectedRay, currentRefractiveIndex, depth+1,
+                        weight, importance);
+                } else {
+                    float fresnelCoefficient = Hemisphere::fresnelCoefficient(
+                        hitInfo.normal(), ray.getDirection(),
+                        currentRefractiveIndex,
+                        material.getRefractiveIndex());
+
+                    traceImporton(
+                        reflectedRay, currentRefractiveIndex, depth+1,
+                        weight * fresnelCoefficient, importance);
+
+                    traceImporton(
+                        ray3f(hitInfo.position(), refractedDirection),
+                        material.getRefractiveIndex(), depth+1,
+                        weight * (1 - fresnelCoefficient), importance);
+                }
+            }
+        }
+
         Spectrum RayTracer::sampleDirectRadiance(HitInfo const& hitInfo) const {
             Spectrum directIrradiance(
                 light_->sampleIrradiance(
@@ -157,6 +278,11 @@ namespace niwa {
             Spectrum powerDensity = photonMap_->powerDensity(
                 hitInfo.position(), hitInfo.normal());
 
+            if(causticMap_) {
+                powerDensity += causticMap_->powerDensity(
+                    hitInfo.position(), hitInfo.normal());
+            }
+
             // AGI, Equation 2.23.
             Spectrum brdf( hitInfo.material().getReflectance() / PI_F );
 
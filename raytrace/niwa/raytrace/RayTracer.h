@@ -19,6 +19,8 @@ namespace niwa {
 
     namespace raytrace {
         class HitInfo;
+        class ImportanceGrid;
+        class IndirectBatch;
         class ITraceable;
         class ILight;
         class ray3f;
@@ -33,12 +35,52 @@ namespace niwa {
 
             void setPhotonMap(boost::shared_ptr<photonmap::IPhotonMap> photonMap);
 
+            /**
+             * @param causticMap Queried in addition to the photon map;
+             *                   null (the default) for no caustic map.
+             */
+            void setCausticMap(boost::shared_ptr<photonmap::IPhotonMap> causticMap);
+
             /**
              * @param ray The ray along which radiance is sampled.
              */
             const graphics::Spectrum sampleIncidentRadiance(
                 ray3f const& ray) const;
 
+            /**
+             * Samples radiance, but defers the photon map estimates
+             * of indirect radiance to the given batch. The returned
+             * radiance lacks the deferred part until the batch
+             * is resolved with resolveIndirectRadiance.
+             *
+             * @param ray The ray along which radiance is sampled.
+             *
+             * @param batch Receives the deferred estimates.
+             *
+             * @param pixel Index of the radiance the deferred estimates add to.
+             */
+            const graphics::Spectrum sampleIncidentRadiance(
+                ray3f const& ray,
+                IndirectBatch& batch,
+                size_t pixel) const;
+
+            /**
+             * Resolves deferred estimates of indirect radiance
+             * and adds them to the given radiances.
+             */
+            void resolveIndirectRadiance(
+                IndirectBatch& batch,
+                graphics::Spectrum* radiances) const;
+
+            /**
+             * Traces an importon along the given ray and deposits
+             * its importance at the diffuse surfaces where the
+             * photon map would be queried.
+             */
+            void traceImporton(
+                ray3f const& ray,
+                ImportanceGrid& importance) const;
+
         private:
             /**
              * @param ray The ray along which radiance is sampled.
@@ -46,11 +88,32 @@ namespace niwa {
              * @param currentRefractiveIndex Initially one (air).
              *
              * @param depth Initially zero.
+             *
+             * @param batch Receives deferred indirect estimates,
+             *              or NULL for immediate estimates.
+             *
+             * @param pixel Only used with a batch.
+             *
+             * @param weight The factor by which the returned radiance
+             *               contributes to the pixel; only used with a batch.
              */
             const graphics::Spectrum sampleIncidentRadiance(
                 ray3f const& ray, 
                 float currentRefractiveIndex,
-                int depth) const;
+                int depth,
+                IndirectBatch* batch,
+                size_t pixel,
+                graphics::Spectrum const& weight) const;
+
+            /**
+             * @param weight The importance carried by the importon.
+             */
+            void traceImporton(
+                ray3f const& ray,
+                float currentRefractiveIndex,
+                int depth,
+                float weight,
+                ImportanceGrid& importance) const;
 
             graphics::Spectrum sampleDirectRadiance(
                 HitInfo const& hitInfo) const;
@@ -64,6 +127,8 @@ namespace niwa {
             boost::shared_ptr<ILight> light_;
 
             boost::shared_ptr<photonmap::IPhotonMap> photonMap_;
+
+            boost::shared_ptr<photonmap::IPhotonMap> causticMap_;
         };
     }
 }
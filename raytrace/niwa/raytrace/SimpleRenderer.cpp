@@ -15,24 +15,57 @@
 #include "niwa/raytrace/ray3f.h"
 #include "niwa/raytrace/Hemisphere.h"
 #include "niwa/raytrace/RayTracer.h"
+#include "niwa/raytrace/IndirectBatch.h"
+#include "niwa/raytrace/ImportanceGrid.h"
 #include "niwa/raytrace/PhotonTracer.h"
 
 #include "niwa/photonmap/PhotonHash.h"
+#include "niwa/photonmap/ProgressivePhotonMap.h"
 
+#include "niwa/system/ArenaAllocator.h"
+#include "niwa/system/FrameArena.h"
+#include "niwa/system/Future.h"
 #include "niwa/system/SingleThreadedParallelizer.h"
 #include "niwa/system/NiwaParallelizer.h"
 #include "niwa/system/OpenMpParallelizer.h"
+#include "niwa/system/TaskScheduler.h"
+#include "niwa/system/Profiler.h"
 
 #include "niwa/math/Constants.h"
 
 #include <boost/shared_array.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #define NOMINMAX
 #include <windows.h>
 #include <gl/gl.h>
 
 #define MAX_DEPTH 3
 
+/**
+ * The number of rows rendered (and batched
+ * for photon map queries) by a single task.
+ * Bands are tall enough that vertically adjacent
+ * pixels share photon map cells within a batch.
+ */
+#define BAND_HEIGHT 16
+
+/**
+ * Storage probability of photons that
+ * the importons did not reach.
+ */
+#define MIN_STORAGE_PROBABILITY 0.1f
+
+/**
+ * Fraction of photons kept in each progressive pass;
+ * the value is Hachisuka's.
+ */
+#define PROGRESSIVE_ALPHA 0.7
+
+#define DEFAULT_PROGRESSIVE_RADIUS 0.3f
+
 namespace {
     static niwa::system::IParallelizer* createMultithreadingParallelizer() {
         return niwa::system::SingleThreadedParallelizer::create();
@@ -40,6 +73,9 @@ namespace {
         //return niwa::system::NiwaParallelizer::create();
 
         //return niwa::system::OpenMpParallelizer::create();
+
+        // Also balances the photon kd-trees in parallel.
+        //return niwa::system::TaskScheduler::create();
     }
 }
 
@@ -73,23 +109,69 @@ namespace niwa {
             boost::shared_array<Spectrum> pixelColors_;
         };
 
+        /**
+         * Ray traces a frame into the given pixels.
+         */
+        class SimpleRenderer::RowStage : public niwa::system::Future::ICallable {
+        public:
+            RowStage(SimpleRenderer const& parent, boost::shared_array<Spectrum> pixelColors);
+
+            void call();
+
+        private: // prevent copying
+            RowStage(RowStage const&);
+            RowStage& operator = (RowStage const&);
+
+        private:
+            SimpleRenderer const& parent_;
+
+            boost::shared_array<Spectrum> pixelColors_;
+        };
+
+        /**
+         * Fills the back photon maps for the next frame.
+         */
+        class SimpleRenderer::PhotonStage : public niwa::system::Future::ICallable {
+        public:
+            explicit PhotonStage(SimpleRenderer const& parent);
+
+            void call();
+
+        private: // prevent copying
+            PhotonStage(PhotonStage const&);
+            PhotonStage& operator = (PhotonStage const&);
+
+        private:
+            SimpleRenderer const& parent_;
+        };
+
         SimpleRenderer::SimpleRenderer(
             std::pair<size_t, size_t> windowSize, int photonCount, shared_ptr<photonmap::IPhotonMap> photonMap)
             : windowSize_(windowSize),
               photonCount_(photonCount),
               useOpenGl_(true),
-              useMultithreading_(true) {
+              useMultithreading_(true),
+              importonStride_(0),
+              causticPhotonCount_(0),
+              causticRadius_(0),
+              isPipelinePrimed_(false),
+              progressiveRadius_(DEFAULT_PROGRESSIVE_RADIUS) {
             parallelizer_ = shared_ptr<system::IParallelizer>(
                 createMultithreadingParallelizer());
 
+            photonParallelizer_ = parallelizer_;
+
             rayTracer_ = auto_ptr<RayTracer>(new RayTracer());
 
+            pixelColors_ = boost::shared_array<Spectrum>(
+                new Spectrum[windowSize_.first * windowSize_.second]);
+
             if(photonCount_ > 0 && photonMap) {
                 photonMap_ = photonMap;
 
                 photonTracer_ = auto_ptr<PhotonTracer>(new PhotonTracer());
 
-                photonTracer_->setParallelizer(parallelizer_);
+                photonTracer_->setParallelizer(photonParallelizer_);
 
                 rayTracer_->setPhotonMap(photonMap_);
             } else {
@@ -112,11 +194,105 @@ namespace niwa {
                     niwa::system::SingleThreadedParallelizer::create());
             }
 
+            resetPhotonParallelizer();
+        }
+
+        void SimpleRenderer::resetPhotonParallelizer() {
+            if(backPhotonMap_ && useMultithreading_) {
+                photonParallelizer_ = shared_ptr<system::IParallelizer>(
+                    createMultithreadingParallelizer());
+            } else if(backPhotonMap_) {
+                photonParallelizer_ = shared_ptr<system::IParallelizer>(
+                    niwa::system::SingleThreadedParallelizer::create());
+            } else {
+                photonParallelizer_ = parallelizer_;
+            }
+
             if(photonTracer_.get()) {
-                photonTracer_->setParallelizer(parallelizer_);
+                photonTracer_->setParallelizer(photonParallelizer_);
             }
         }
 
+        void SimpleRenderer::setImportance(int importonStride, float cellSize) {
+            importonStride_ = importonStride;
+
+            if(importonStride_ > 0) {
+                importance_ = shared_ptr<ImportanceGrid>(
+                    new ImportanceGrid(cellSize, MIN_STORAGE_PROBABILITY));
+            } else {
+                importance_.reset();
+            }
+
+            if(photonTracer_.get()) {
+                photonTracer_->setImportance(importance_);
+            }
+        }
+
+        void SimpleRenderer::setCaustics(int causticPhotonCount, float queryRadius) {
+            causticPhotonCount_ = 0;
+            causticRadius_ = queryRadius;
+
+            causticMap_.reset();
+            backCausticMap_.reset();
+
+            if(causticPhotonCount > 0 && photonTracer_.get()) {
+                causticPhotonCount_ = causticPhotonCount;
+
+                // At most one photon is stored per caustic path.
+                causticMap_ = shared_ptr<photonmap::IPhotonMap>(
+                    new photonmap::PhotonHash(causticPhotonCount_, causticRadius_));
+
+                if(backPhotonMap_) {
+                    backCausticMap_ = shared_ptr<photonmap::IPhotonMap>(
+                        new photonmap::PhotonHash(causticPhotonCount_, causticRadius_));
+                }
+            }
+
+            rayTracer_->setCausticMap(causticMap_);
+
+            isPipelinePrimed_ = false;
+        }
+
+        void SimpleRenderer::setPipelined(shared_ptr<photonmap::IPhotonMap> backPhotonMap) {
+            backPhotonMap_.reset();
+            backCausticMap_.reset();
+
+            if(backPhotonMap && photonTracer_.get()) {
+                backPhotonMap_ = backPhotonMap;
+
+                if(causticMap_) {
+                    backCausticMap_ = shared_ptr<photonmap::IPhotonMap>(
+                        new photonmap::PhotonHash(causticPhotonCount_, causticRadius_));
+                }
+            }
+
+            isPipelinePrimed_ = false;
+
+            resetPhotonParallelizer();
+        }
+
+        void SimpleRenderer::setProgressiveRadius(float radius) {
+            progressiveRadius_ = radius;
+        }
+
+        void SimpleRenderer::setProgressive(bool progressive) {
+            progressiveMap_.reset();
+
+            directRadiances_.clear();
+            visibleWeights_.clear();
+            visiblePixels_.clear();
+
+            if(progressive && photonTracer_.get()) {
+                progressiveMap_ = shared_ptr<photonmap::ProgressivePhotonMap>(
+                    new photonmap::ProgressivePhotonMap(
+                        progressiveRadius_, PROGRESSIVE_ALPHA));
+            }
+        }
+
+        bool SimpleRenderer::getProgressive() const {
+            return progressiveMap_.get() != 0;
+        }
+
         void SimpleRenderer::setCamera(shared_ptr<Camera> camera) {
             camera_ = camera;
         }
@@ -153,11 +329,48 @@ namespace niwa {
             // ignored
         }
 
-        void SimpleRenderer::RowTask::invoke(int row) {
-            parent_.renderRow(row, pixelColors_);
+        void SimpleRenderer::RowTask::invoke(int band) {
+            NIWA_PROFILE_ZONE("rows");
+
+            int const rowEnd = std::min<int>(
+                (band + 1) * BAND_HEIGHT, parent_.windowSize_.second);
+
+            parent_.renderRows(band * BAND_HEIGHT, rowEnd, pixelColors_);
+        }
+
+        SimpleRenderer::RowStage::RowStage(
+            SimpleRenderer const& parent, boost::shared_array<Spectrum> pixelColors)
+            : parent_(parent), pixelColors_(pixelColors) {
+            // ignored
+        }
+
+        void SimpleRenderer::RowStage::call() {
+            RowTask rowTask(parent_, pixelColors_);
+
+            int const nBands = (parent_.windowSize_.second + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+            parent_.parallelizer_->loop(rowTask, 0, nBands);
+        }
+
+        SimpleRenderer::PhotonStage::PhotonStage(SimpleRenderer const& parent)
+            : parent_(parent) {
+            // ignored
+        }
+
+        void SimpleRenderer::PhotonStage::call() {
+            parent_.tracePhotonMaps(
+                *parent_.backPhotonMap_,
+                parent_.backCausticMap_.get(),
+                *parent_.photonParallelizer_);
         }
 
         void SimpleRenderer::renderRow(int y, boost::shared_array<Spectrum> pixelColors) const {
+            renderRows(y, y+1, pixelColors);
+        }
+
+        void SimpleRenderer::renderRows(
+                int rowStart, int rowEnd,
+                boost::shared_array<Spectrum> pixelColors) const {
             size_t windowWidth = windowSize_.first;
             size_t windowHeight = windowSize_.second;
 
@@ -169,62 +382,265 @@ namespace niwa {
 
             __m128 xOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
 
-            __m128 v = _mm_set_ps1(1 - (y+.5f) / windowHeight);
+            system::FrameArena& arena = system::FrameArena::forThread();
 
-            for(size_t pack = 0; pack < nPacks; ++pack) {
-                // The one minus stems from the fact
-                // that pinhole camera backplane produces
-                // the inverse image; we wish to render
-                // the non-inverted image instead.
+            system::FrameArena::Scope scope(arena);
 
-                __m128 u = _mm_sub_ps(
-                    _mm_set_ps1(1.0f),
-                    _mm_div_ps(
-                        _mm_add_ps(_mm_set_ps1(static_cast<float>(pack * 4)), xOffsets),
-                        _mm_set_ps1(static_cast<float>(windowWidth))));
+            // Radiances of the band, row-major.
+            std::vector<Spectrum, system::ArenaAllocator<Spectrum> > radiances(
+                windowWidth * (rowEnd - rowStart),
+                Spectrum(),
+                system::ArenaAllocator<Spectrum>(arena));
 
-                packed_ray3f eyeRay( camera_->getEyeRay(u,v) );
+            IndirectBatch batch;
 
-                size_t xStart = pack * 4;
-                size_t xEnd = std::min(xStart + 4, windowWidth);
+            for(int y=rowStart; y<rowEnd; ++y) {
+                __m128 v = _mm_set_ps1(1 - (y+.5f) / windowHeight);
 
-                for(size_t x=xStart; x<xEnd; ++x) {
-                    Spectrum radiance = rayTracer_->sampleIncidentRadiance(
-                        eyeRay.get(x-xStart));
+                for(size_t pack = 0; pack < nPacks; ++pack) {
+                    // The one minus stems from the fact
+                    // that pinhole camera backplane produces
+                    // the inverse image; we wish to render
+                    // the non-inverted image instead.
 
-                    // Our method of computing irradiation has several simplifications:
+                    __m128 u = _mm_sub_ps(
+                        _mm_set_ps1(1.0f),
+                        _mm_div_ps(
+                            _mm_add_ps(_mm_set_ps1(static_cast<float>(pack * 4)), xOffsets),
+                            _mm_set_ps1(static_cast<float>(windowWidth))));
 
-                    // 1) We are not integrating over the backplane area corresponding
-                    //    to the pixel, but use a single estimate (i.e., no antialising).
+                    packed_ray3f eyeRay( camera_->getEyeRay(u,v) );
 
-                    // 2) We are using a pinhole camera, which means the integral
-                    //    over solid angles is replaced by a dirac delta function,
-                    //    which equals radiance times hemispherical solid angle (2*PI).
+                    size_t xStart = pack * 4;
+                    size_t xEnd = std::min(xStart + 4, windowWidth);
 
-                    // 3) We ignore the cosine factor in the measure equation
-                    //    ("natural vignette"), assuming that the camera has some implicit 
-                    //    mechanism for compensating the cosine falloff.
+                    for(size_t x=xStart; x<xEnd; ++x) {
+                        size_t const pixel = (y - rowStart) * windowWidth + x;
 
-                    Spectrum irradiation = 
-                        radiance
-                            * (camera_->getShutterTime() * 2 * PI_F);
+                        radiances[pixel] = rayTracer_->sampleIncidentRadiance(
+                            eyeRay.get(x-xStart), batch, pixel);
+                    }
+                }
+            }
+
+            {
+                NIWA_PROFILE_ZONE("photon queries");
+
+                rayTracer_->resolveIndirectRadiance(batch, &radiances[0]);
+            }
+
+            for(int y=rowStart; y<rowEnd; ++y) {
+                for(size_t x=0; x<windowWidth; ++x) {
+                    pixelColors[y * windowWidth + x] = toneMap(
+                        radiances[(y - rowStart) * windowWidth + x]);
+                }
+            }
+        }
+
+        void SimpleRenderer::traceImportons() const {
+            size_t const windowWidth = windowSize_.first;
+            size_t const windowHeight = windowSize_.second;
+
+            size_t const stride = static_cast<size_t>(importonStride_);
+
+            importance_->clear();
+
+            for(size_t y=stride/2; y<windowHeight; y+=stride) {
+                float const v = 1 - (y+.5f) / windowHeight;
+
+                for(size_t x=stride/2; x<windowWidth; x+=stride) {
+                    // See renderRows for the one minus.
+                    float const u = 1 - (x+.5f) / windowWidth;
+
+                    rayTracer_->traceImporton(
+                        camera_->getEyeRay(u,v), *importance_);
+                }
+            }
+
+            importance_->build();
+        }
+
+        Spectrum SimpleRenderer::toneMap(Spectrum const& radiance) const {
+            // Our method of computing irradiation has several simplifications:
+
+            // 1) We are not integrating over the backplane area corresponding
+            //    to the pixel, but use a single estimate (i.e., no antialising).
+
+            // 2) We are using a pinhole camera, which means the integral
+            //    over solid angles is replaced by a dirac delta function,
+            //    which equals radiance times hemispherical solid angle (2*PI).
+
+            // 3) We ignore the cosine factor in the measure equation
+            //    ("natural vignette"), assuming that the camera has some implicit 
+            //    mechanism for compensating the cosine falloff.
+
+            Spectrum irradiation = 
+                radiance
+                    * (camera_->getShutterTime() * 2 * PI_F);
+
+            return toneMapper_->toneMap(irradiation);
+        }
+
+        void SimpleRenderer::traceVisiblePoints() const {
+            size_t const windowWidth = windowSize_.first;
+            size_t const windowHeight = windowSize_.second;
+
+            progressiveMap_->clearVisiblePoints();
+
+            directRadiances_.assign(windowWidth * windowHeight, Spectrum(0,0,0));
+
+            // The visible points are exactly the deferred
+            // photon map estimates of the radiance samples.
+
+            IndirectBatch batch;
+
+            for(size_t y=0; y<windowHeight; ++y) {
+                float const v = 1 - (y+.5f) / windowHeight;
+
+                for(size_t x=0; x<windowWidth; ++x) {
+                    // See renderRows for the one minus.
+                    float const u = 1 - (x+.5f) / windowWidth;
+
+                    size_t const pixel = y * windowWidth + x;
+
+                    directRadiances_[pixel] = rayTracer_->sampleIncidentRadiance(
+                        camera_->getEyeRay(u,v), batch, pixel);
+                }
+            }
+
+            visibleWeights_.resize(batch.size());
+            visiblePixels_.resize(batch.size());
+
+            for(size_t i=0; i<batch.size(); ++i) {
+                photonmap::DensityQuery const& query = batch.getQuery(i);
+
+                progressiveMap_->addVisiblePoint(query.position, query.normal);
+
+                visibleWeights_[i] = batch.getWeight(i);
+                visiblePixels_[i] = batch.getPixel(i);
+            }
+        }
+
+        void SimpleRenderer::renderProgressive(
+                boost::shared_array<Spectrum> pixelColors) const {
+            if(directRadiances_.empty()) {
+                traceVisiblePoints();
+            }
+
+            progressiveMap_->clear();
+
+            photonTracer_->tracePhotons(
+                *progressiveMap_, photonCount_,
+                static_cast<unsigned int>(progressiveMap_->getPassCount()));
 
-                    Spectrum tone = toneMapper_->toneMap(irradiation);
+            progressiveMap_->buildStructure(*parallelizer_);
 
-                    pixelColors[y * windowWidth + x] = tone;
+            system::FrameArena& arena = system::FrameArena::forThread();
+
+            system::FrameArena::Scope scope(arena);
+
+            std::vector<Spectrum, system::ArenaAllocator<Spectrum> > radiances(
+                directRadiances_.begin(), directRadiances_.end(),
+                system::ArenaAllocator<Spectrum>(arena));
+
+            for(size_t i=0; i<visiblePixels_.size(); ++i) {
+                radiances[visiblePixels_[i]] +=
+                    visibleWeights_[i] * progressiveMap_->powerDensity(i);
+            }
+
+            for(size_t i=0; i<radiances.size(); ++i) {
+                pixelColors[i] = toneMap(radiances[i]);
+            }
+        }
+
+        void SimpleRenderer::tracePhotonMaps(
+                photonmap::IPhotonMap& photonMap,
+                photonmap::IPhotonMap* causticMap,
+                system::IParallelizer& parallelizer) const {
+            NIWA_PROFILE_ZONE("photon maps");
+
+            if(importance_) {
+                traceImportons();
+            }
+
+            photonMap.clear();
+
+            // Every frame traces the same photons, so that the
+            // noise of the estimates does not flicker.
+
+            if(causticMap) {
+                photonTracer_->traceGlobalPhotons(photonMap, photonCount_, 0);
+            } else {
+                photonTracer_->tracePhotons(photonMap, photonCount_, 0);
+            }
+
+            photonMap.buildStructure(parallelizer);
+
+            photonMap.precompute(parallelizer);
+
+            if(causticMap) {
+                causticMap->clear();
+
+                photonTracer_->traceCausticPhotons(*causticMap, causticPhotonCount_, 0);
+
+                causticMap->buildStructure(parallelizer);
+
+                causticMap->precompute(parallelizer);
+            }
+        }
+
+        void SimpleRenderer::swapPhotonMaps() const {
+            std::swap(photonMap_, backPhotonMap_);
+            std::swap(causticMap_, backCausticMap_);
+
+            rayTracer_->setPhotonMap(photonMap_);
+            rayTracer_->setCausticMap(causticMap_);
+        }
+
+        void SimpleRenderer::uploadPixels(
+                boost::shared_array<Spectrum> const& pixelColors) const {
+            if(!useOpenGl_) {
+                return;
+            }
+
+            NIWA_PROFILE_ZONE("upload");
+
+            size_t windowWidth = windowSize_.first;
+            size_t windowHeight = windowSize_.second;
+
+            for(size_t y=0; y<windowHeight-1; ++y) {
+                glBegin(GL_TRIANGLE_STRIP);
+
+                for(size_t x=0; x<windowWidth; ++x) {
+                    Spectrum const& c1 = pixelColors[y * windowWidth + x];
+                    Spectrum const& c2 = pixelColors[(y+1) * windowWidth + x];
+
+                    glColor3f(c1.r, c1.g, c1.b);
+                    glVertex2i(x,y);
+
+                    glColor3f(c2.r, c2.g, c2.b);
+                    glVertex2i(x,y+1);
                 }
+
+                glEnd();
             }
         }
 
         bool SimpleRenderer::render() const {
+            NIWA_PROFILE_ZONE("render");
+
             glClear(GL_COLOR_BUFFER_BIT);
 
-            if(photonCount_ > 0) {
-                photonMap_->clear();
+            bool const isPipelined =
+                photonCount_ > 0 && !progressiveMap_ && backPhotonMap_;
 
-                   photonTracer_->tracePhotons(*photonMap_, photonCount_);
+            if(isPipelined && !isPipelinePrimed_) {
+                // There are no photons from a previous frame yet.
+                tracePhotonMaps(*photonMap_, causticMap_.get(), *photonParallelizer_);
 
-                photonMap_->buildStructure();
+                isPipelinePrimed_ = true;
+            } else if(photonCount_ > 0 && !progressiveMap_ && !isPipelined) {
+                tracePhotonMaps(*photonMap_, causticMap_.get(), *parallelizer_);
             }
 
             glDisable(GL_DEPTH_TEST);
@@ -243,30 +659,43 @@ namespace niwa {
             glTranslatef(-1, -1, 0);
             glScalef(2.0f / (windowWidth-1), 2.0f / (windowHeight-1), 1);
 
-            // row-major
-            boost::shared_array<Spectrum> pixelColors(new Spectrum[windowWidth * windowHeight]);
-
-            RowTask rowTask(*this, pixelColors);
+            if(progressiveMap_) {
+                renderProgressive(pixelColors_);
 
-            parallelizer_->loop(rowTask, 0, windowHeight, 4);
+                uploadPixels(pixelColors_);
+            } else if(isPipelined) {
+                if(!backPixelColors_) {
+                    backPixelColors_ = boost::shared_array<Spectrum>(
+                        new Spectrum[windowWidth * windowHeight]);
+                }
 
-            if(useOpenGl_) {
-                for(size_t y=0; y<windowHeight-1; ++y) {
-                    glBegin(GL_TRIANGLE_STRIP);
+                RowStage rowStage(*this, backPixelColors_);
 
-                    for(size_t x=0; x<windowWidth; ++x) {
-                        Spectrum const& c1 = pixelColors[y * windowWidth + x];
-                        Spectrum const& c2 = pixelColors[(y+1) * windowWidth + x];
+                PhotonStage photonStage(*this);
 
-                        glColor3f(c1.r, c1.g, c1.b);
-                        glVertex2i(x,y);
+                {
+                    // This frame is ray traced on the stage thread,
+                    // while the previous one is uploaded (OpenGL
+                    // must stay on this thread) and the photons of
+                    // the next frame are traced.
+                    system::Future rows(rowStage);
 
-                        glColor3f(c2.r, c2.g, c2.b);
-                        glVertex2i(x,y+1);
-                    }
+                    uploadPixels(pixelColors_);
 
-                    glEnd();
+                    photonStage.call();
                 }
+
+                swapPhotonMaps();
+
+                std::swap(pixelColors_, backPixelColors_);
+            } else {
+                RowTask rowTask(*this, pixelColors_);
+
+                int const nBands = (windowHeight + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+                parallelizer_->loop(rowTask, 0, nBands);
+
+                uploadPixels(pixelColors_);
             }
 
             glPopMatrix();
@@ -10,22 +10,22 @@
 
 #include "IRenderer.h"
 
+#include "niwa/graphics/Spectrum.h"
+
 #include <boost/shared_array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <memory>
+#include <vector>
 
 namespace niwa {
     namespace system {
         class IParallelizer;
     }
 
-    namespace graphics {
-        class Spectrum;
-    }
-
     namespace photonmap {
         class IPhotonMap;
         class PhotonList;
+        class ProgressivePhotonMap;
     }
 
     namespace raytrace {
@@ -33,6 +33,7 @@ namespace niwa {
         class ITraceable;
         class IToneMapper;
         class ILight;
+        class ImportanceGrid;
         class PhotonTracer;
         class ray3f;
         class RayTracer;
@@ -74,6 +75,71 @@ namespace niwa {
 
             void setUseMultithreading(bool useMultithreading);
 
+            /**
+             * Enables importance-driven photon storage: each frame,
+             * importons are traced from a coarse subset of the pixels,
+             * and photons are mostly stored where the importons land.
+             *
+             * @param importonStride Distance between the importon
+             *                       pixels; zero (the default) disables.
+             *
+             * @param cellSize Cell size of the importance grid;
+             *                 should be at least the photon search radius.
+             */
+            void setImportance(int importonStride, float cellSize);
+
+            /**
+             * Enables a separate caustic photon map: caustic photons
+             * are traced only toward specular and dielectric objects,
+             * and the caustic map is queried with its own (typically
+             * smaller) radius. The global photon map then leaves
+             * out the caustic paths. Has no effect without photon
+             * mapping or in progressive mode.
+             *
+             * @param causticPhotonCount Number of caustic photons
+             *                           per frame; zero (the default) disables.
+             *
+             * @param queryRadius Search radius of the caustic map.
+             */
+            void setCaustics(int causticPhotonCount, float queryRadius);
+
+            /**
+             * Enables pipelined photon mapping: the photons of the
+             * next frame are traced and built on a thread of their
+             * own while the current frame is ray traced, so the
+             * longer of the two stages bounds the frame time instead
+             * of their sum. The lighting lags the scene by a frame.
+             * The frame is ray traced on that thread, in turn, while
+             * the previous frame is uploaded; so the image shown
+             * lags by a frame too, and the first one is blank. Both
+             * stages finish before render returns, so the scene
+             * may be changed between frames as usual. Has no effect
+             * without photon mapping or in progressive mode.
+             *
+             * @param backPhotonMap A second photon map of the same
+             *                      kind as the renderer's, filled
+             *                      while the first one is queried;
+             *                      null (the default) disables.
+             */
+            void setPipelined(boost::shared_ptr<photonmap::IPhotonMap> backPhotonMap);
+
+            /**
+             * Sets the initial search radius of
+             * progressive photon mapping.
+             */
+            void setProgressiveRadius(float radius);
+
+            /**
+             * Sets whether to use progressive photon mapping, which
+             * assumes a static view: the visible points of the pixels
+             * are traced once, and each frame adds a pass of photons
+             * to their estimates. Enabling restarts the progress.
+             * Has no effect without photon mapping.
+             */
+            void setProgressive(bool progressive);
+
+            bool getProgressive() const;
+
             bool getUseMultithreading() const;
 
             /**
@@ -85,9 +151,76 @@ namespace niwa {
                 int row, 
                 boost::shared_array<graphics::Spectrum> pixelColors) const;
 
+            /**
+             * Renders a band of rows. The photon map estimates of
+             * the whole band are gathered as a single batch.
+             *
+             * @param rowStart First row (inclusive).
+             * @param rowEnd Last row (exclusive).
+             */
+            void renderRows(
+                int rowStart,
+                int rowEnd,
+                boost::shared_array<graphics::Spectrum> pixelColors) const;
+
             class RowTask;
 
         private:
+            class RowStage;
+
+            class PhotonStage;
+
+            /**
+             * Draws the pixels, unless OpenGL is disabled.
+             */
+            void uploadPixels(
+                boost::shared_array<graphics::Spectrum> const& pixelColors) const;
+
+            /**
+             * Fills the photon maps for a frame.
+             *
+             * @param causticMap Null if no caustic map is used.
+             */
+            void tracePhotonMaps(
+                photonmap::IPhotonMap& photonMap,
+                photonmap::IPhotonMap* causticMap,
+                system::IParallelizer& parallelizer) const;
+
+            /**
+             * Makes the back photon maps the ones queried.
+             */
+            void swapPhotonMaps() const;
+
+            /**
+             * Chooses the parallelizer of the photon tracing: one
+             * of its own when pipelined, as a parallelizer runs one
+             * loop at a time; otherwise the renderer's.
+             */
+            void resetPhotonParallelizer();
+
+            /**
+             * Deposits the importance of the current frame.
+             */
+            void traceImportons() const;
+
+            /**
+             * Traces the visible points for progressive
+             * photon mapping, along with direct radiances.
+             */
+            void traceVisiblePoints() const;
+
+            /**
+             * Adds a pass of photons to the progressive
+             * estimates and computes the pixel colors.
+             */
+            void renderProgressive(
+                boost::shared_array<graphics::Spectrum> pixelColors) const;
+
+            /**
+             * @return The color of a pixel with the given radiance.
+             */
+            graphics::Spectrum toneMap(graphics::Spectrum const& radiance) const;
+
             /**
              * @param ray The ray along which radiance is sampled.
              *
@@ -120,13 +253,81 @@ namespace niwa {
 
             std::auto_ptr<RayTracer> rayTracer_;
 
-            boost::shared_ptr<photonmap::IPhotonMap> photonMap_;
+            /**
+             * The photon maps are swapped with the back
+             * maps each frame when pipelined.
+             */
+            mutable boost::shared_ptr<photonmap::IPhotonMap> photonMap_;
 
             boost::shared_ptr<system::IParallelizer> parallelizer_;
 
+            int importonStride_;
+
+            boost::shared_ptr<ImportanceGrid> importance_;
+
+            int causticPhotonCount_;
+
+            /**
+             * Null unless a separate caustic map is used.
+             */
+            mutable boost::shared_ptr<photonmap::IPhotonMap> causticMap_;
+
+            float causticRadius_;
+
+            /**
+             * Null unless pipelined.
+             */
+            mutable boost::shared_ptr<photonmap::IPhotonMap> backPhotonMap_;
+
+            /**
+             * Null unless pipelined with a caustic map.
+             */
+            mutable boost::shared_ptr<photonmap::IPhotonMap> backCausticMap_;
+
+            /**
+             * Whether the photon maps hold the photons of
+             * the previous frame; false on the first frame.
+             */
+            mutable bool isPipelinePrimed_;
+
+            boost::shared_ptr<system::IParallelizer> photonParallelizer_;
+
+            float progressiveRadius_;
+
+            /**
+             * Null unless progressive photon mapping is used.
+             */
+            boost::shared_ptr<photonmap::ProgressivePhotonMap> progressiveMap_;
+
+            /**
+             * Direct radiances of the pixels; empty
+             * if the visible points are not traced.
+             */
+            mutable std::vector<graphics::Spectrum> directRadiances_;
+
+            /**
+             * Weight and pixel of each visible point.
+             */
+            mutable std::vector<graphics::Spectrum> visibleWeights_;
+            mutable std::vector<size_t> visiblePixels_;
+
             boost::shared_ptr<Camera> camera_;
 
             boost::shared_ptr<IToneMapper> toneMapper_;
+
+            /**
+             * The pixel colors, row-major; kept
+             * across frames to avoid reallocation.
+             * When pipelined, the colors of the
+             * frame that is shown next.
+             */
+            mutable boost::shared_array<graphics::Spectrum> pixelColors_;
+
+            /**
+             * The pixel colors being ray traced while
+             * pipelined; null until pipelining is used.
+             */
+            mutable boost::shared_array<graphics::Spectrum> backPixelColors_;
         };
     }
 }
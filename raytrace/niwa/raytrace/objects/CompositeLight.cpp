@@ -59,6 +59,13 @@ namespace niwa {
                 return power;
             }
 
+            void CompositeLight::getEmitters(
+                    std::vector<ILight const*>& emitters) const {
+                for(size_t i=0; i<lights_.size(); ++i) {
+                    lights_[i]->getEmitters(emitters);
+                }
+            }
+
             const ray3f CompositeLight::samplePhoton(
                     Spectrum& power,
                     vec2f const& positionParameter,
@@ -167,8 +174,7 @@ namespace niwa {
                         lights[i]->raytraceShadow(ray, cutoffDistance, light));
 
                     // If all rays are found to be shadowed, return early.
-                    if(mask.m128_i32[0] && mask.m128_i32[1]
-                        && mask.m128_i32[2] && mask.m128_i32[3]) {
+                    if(_mm_movemask_ps(mask) == 0xF) {
                         return mask;
                     }
                 }
@@ -45,6 +45,11 @@ namespace niwa {
                     math::vec2f const& positionParameter,
                     math::vec2f const& directionParameter) const;
 
+                /**
+                 * Adds the emitters of all lights.
+                 */
+                void getEmitters(std::vector<ILight const*>& emitters) const;
+
             private:
                 std::vector<boost::shared_ptr<ILight>> lights_;
             };
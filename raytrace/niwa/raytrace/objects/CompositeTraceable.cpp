@@ -79,13 +79,19 @@ namespace niwa {
                         objects[i]->raytraceShadow(ray, cutoffDistance, light));
 
                     // If all rays are found to be shadowed, return early.
-                    if(mask.m128_i32[0] && mask.m128_i32[1]
-                        && mask.m128_i32[2] && mask.m128_i32[3]) {
+                    if(_mm_movemask_ps(mask) == 0xF) {
                         return mask;
                     }
                 }
                 return mask;
             }
+
+            void CompositeTraceable::getCausticBounds(
+                    std::vector<geom::aabb>& bounds) const {
+                for(size_t i=0; i<objects_.size(); ++i) {
+                    objects_[i]->getCausticBounds(bounds);
+                }
+            }
         }
     }
 }
\ No newline at end of file
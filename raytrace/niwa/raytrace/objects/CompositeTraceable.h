@@ -38,6 +38,8 @@ namespace niwa {
 
                 __m128 __fastcall raytraceShadow(
                     packed_ray3f const& ray, __m128 cutoffDistance, ILight const* light) const;
+
+                void getCausticBounds(std::vector<geom::aabb>& bounds) const;
       
             private:
                 std::vector<boost::shared_ptr<ITraceable>> objects_;
@@ -14,11 +14,21 @@
 
 #include "niwa/geom/aabb.h"
 
+#include "niwa/system/AlignedMemory.h"
+#include "niwa/system/TaskScheduler.h"
+
 #include <algorithm>
+#include <new>
 
 #define MAX_DEPTH 20
 #define MAX_LEAF_TRIANGLES 32
 
+/**
+ * Smaller subtrees are built serially; below this,
+ * spawning a task costs more than it saves.
+ */
+#define MIN_PARALLEL_TRIANGLES 1024
+
 namespace {
     static inline int argmin(int n, float* xs) {
         float xmin = xs[0];
@@ -228,10 +238,56 @@ namespace niwa {
             using geom::aabb;
             using math::vec3f;
 
-            KdTree::~KdTree() {
-                if(triangles_) {
-                    _mm_free(const_cast<Triangle*>(triangles_));
+            /**
+             * Builds a subtree; see the private build.
+             */
+            class KdTree::BuildTask : public system::TaskScheduler::Task {
+            public:
+                BuildTask(
+                        Triangle const*const baseTriangles,
+                        std::vector<vec3f> const& baseVertices,
+                        std::vector<size_t> const& activeTriangles, int depth,
+                        system::TaskScheduler* scheduler)
+                    : baseTriangles_(baseTriangles), baseVertices_(baseVertices),
+                      activeTriangles_(activeTriangles), depth_(depth),
+                      scheduler_(scheduler), result_(NULL) {
+                    // ignored
+                }
+
+                void __fastcall run() {
+                    // Tasks cannot throw across threads; a failed
+                    // build is reported by the NULL result instead.
+                    try {
+                        result_ = build(
+                            baseTriangles_, baseVertices_, activeTriangles_, depth_,
+                            scheduler_);
+                    } catch(std::bad_alloc const&) {
+                        result_ = NULL;
+                    }
+                }
+
+                /**
+                 * @return The subtree, or NULL if the build failed.
+                 */
+                KdTree* getResult() const {
+                    return result_;
                 }
+
+            private: // prevent copying
+                BuildTask(BuildTask const&);
+                BuildTask& operator = (BuildTask const&);
+
+            private:
+                Triangle const*const baseTriangles_;
+                std::vector<vec3f> const& baseVertices_;
+                std::vector<size_t> const& activeTriangles_;
+                int const depth_;
+                system::TaskScheduler* const scheduler_;
+                KdTree* result_;
+            };
+
+            KdTree::~KdTree() {
+                system::AlignedMemory::free(const_cast<Triangle*>(triangles_));
                 delete left_;
                 delete right_;
             }
@@ -239,20 +295,34 @@ namespace niwa {
             KdTree* KdTree::build(
                     size_t nBaseTriangles,
                     Triangle const*const baseTriangles,
-                    std::vector<vec3f> const& baseVertices) {
+                    std::vector<vec3f> const& baseVertices,
+                    system::TaskScheduler* scheduler) {
                 std::vector<size_t> activeTriangles;
 
                 for(size_t i=0; i<nBaseTriangles; ++i) {
                     activeTriangles.push_back(i);
                 }
 
-                return build(baseTriangles, baseVertices, activeTriangles, 0);
+                if(!scheduler) {
+                    return build(baseTriangles, baseVertices, activeTriangles, 0, NULL);
+                }
+
+                BuildTask task(baseTriangles, baseVertices, activeTriangles, 0, scheduler);
+
+                scheduler->run(task);
+
+                if(!task.getResult()) {
+                    throw std::bad_alloc();
+                }
+
+                return task.getResult();
             }
 
             KdTree* KdTree::build(
                     Triangle const*const baseTriangles,
                     std::vector<vec3f> const& baseVertices,
-                    std::vector<size_t> const& activeTriangles, int depth) {
+                    std::vector<size_t> const& activeTriangles, int depth,
+                    system::TaskScheduler* scheduler) {
                 const size_t nActiveTriangles = activeTriangles.size();
 
                 if(nActiveTriangles == 0) {
@@ -271,7 +341,8 @@ namespace niwa {
 
                 if(depth >= MAX_DEPTH || nActiveTriangles <= MAX_LEAF_TRIANGLES) {
                     Triangle* const leafTriangles = static_cast<Triangle*>(
-                        _mm_malloc(nActiveTriangles * sizeof(Triangle), 16));
+                        system::AlignedMemory::allocate(
+                            nActiveTriangles * sizeof(Triangle), 16, system::MEMORY_RAYTRACE));
 
                     for(size_t i=0; i<nActiveTriangles; ++i) {
                         leafTriangles[i] = baseTriangles[activeTriangles[i]];
@@ -311,13 +382,37 @@ namespace niwa {
                     }
                 }
 
-                KdTree* left(
-                    build(baseTriangles, baseVertices, leftTriangles, 1+depth));
+                if(!scheduler || nActiveTriangles < MIN_PARALLEL_TRIANGLES) {
+                    KdTree* left(
+                        build(baseTriangles, baseVertices, leftTriangles, 1+depth, scheduler));
 
-                KdTree* right(
-                    build(baseTriangles, baseVertices, rightTriangles, 1+depth));
+                    KdTree* right(
+                        build(baseTriangles, baseVertices, rightTriangles, 1+depth, scheduler));
+
+                    return new KdTree(bounds, splitDimension, splitPosition, left, right);
+                }
+
+                BuildTask leftTask(baseTriangles, baseVertices, leftTriangles, 1+depth, scheduler);
+                BuildTask rightTask(baseTriangles, baseVertices, rightTriangles, 1+depth, scheduler);
+
+                {
+                    system::TaskScheduler::TaskGroup group(*scheduler);
+
+                    group.spawn(leftTask);
+
+                    rightTask.run();
+                } // syncs
+
+                if(!leftTask.getResult() || !rightTask.getResult()) {
+                    delete leftTask.getResult();
+                    delete rightTask.getResult();
+
+                    throw std::bad_alloc();
+                }
 
-                return new KdTree(bounds, splitDimension, splitPosition, left, right);
+                return new KdTree(
+                    bounds, splitDimension, splitPosition,
+                    leftTask.getResult(), rightTask.getResult());
             }
 
             KdTree::KdTree(aabb const& bounds, size_t nTriangles, Triangle const*const triangles)
@@ -19,6 +19,10 @@ namespace niwa {
         class vec3f;
     }
 
+    namespace system {
+        class TaskScheduler;
+    }
+
     namespace raytrace {
         class ray3f;
         class HitInfo;
@@ -34,12 +38,16 @@ namespace niwa {
                 /**
                  * @param baseTriangles Ownership is not passed.
                  *
+                 * @param scheduler Builds large subtrees in parallel;
+                 *                  NULL to build them serially.
+                 *
                  * @return The resulting KD-tree, never null.
                  */
                 static KdTree* build(
                     size_t nBaseTriangles,
                     Triangle const*const baseTriangles,
-                    std::vector<math::vec3f> const& baseVertices);
+                    std::vector<math::vec3f> const& baseVertices,
+                    system::TaskScheduler* scheduler);
 
                 bool __fastcall raytrace(ray3f const& ray, HitInfo& hitInfo) const;
 
@@ -65,11 +73,15 @@ namespace niwa {
                 KdTree(geom::aabb const& bounds, int splitDimension, float splitPosition, 
                     KdTree const* left, KdTree const* right);
 
+            private:
+                class BuildTask;
+
             private:
                 static KdTree* build(
                     Triangle const*const baseTriangles,
                     std::vector<math::vec3f> const& baseVertices,
-                    std::vector<size_t> const& activeTriangles, int depth);
+                    std::vector<size_t> const& activeTriangles, int depth,
+                    system::TaskScheduler* scheduler);
 
                 void __fastcall raytrace(
                     ray3f const& ray, HitInfo& hitInfo, bool& hitFound) const;
@@ -17,7 +17,11 @@
 
 #include "niwa/logging/Logger.h"
 
+#include "niwa/system/AlignedMemory.h"
+#include "niwa/system/TaskScheduler.h"
+
 #include <algorithm>
+#include <memory>
 
 namespace niwa {
     namespace raytrace {
@@ -124,8 +128,8 @@ namespace niwa {
                     }
                 }
 
-                Triangle *const triangles = static_cast<Triangle*>(
-                    _mm_malloc(nFaces_ * sizeof(Triangle), 16));
+                Triangle *const triangles = static_cast<Triangle*>(system::AlignedMemory::allocate(
+                    nFaces_ * sizeof(Triangle), 16, system::MEMORY_RAYTRACE));
 
                 for(int i=0; i<nFaces_; ++i) {
                     vec3f corners[3];
@@ -137,9 +141,14 @@ namespace niwa {
                     triangles[i] = Triangle(corners);
                 }
 
-                tree_ = KdTree::build(nFaces_, triangles, vertices);
+                // Meshes are loaded before rendering starts, so
+                // the build can have the processors to itself.
+                std::auto_ptr<system::TaskScheduler> scheduler(
+                    system::TaskScheduler::create());
+
+                tree_ = KdTree::build(nFaces_, triangles, vertices, scheduler.get());
 
-                _mm_free(triangles);
+                system::AlignedMemory::free(triangles);
             }
 
             Mesh::~Mesh() {
@@ -23,6 +23,10 @@ namespace niwa {
         namespace objects {
             class KdTree;
 
+            /**
+             * A triangle mesh. The triangles are diffuse, so the
+             * mesh has no caustic bounds (see ITraceable).
+             */
             class Mesh : public AbstractTraceable {
             public:
                 /**
@@ -11,6 +11,8 @@
 #include "niwa/raytrace/ray3f.h"
 #include "niwa/raytrace/Constants.h"
 
+#include "niwa/geom/aabb.h"
+
 #include "niwa/math/vec3f.h"
 
 using niwa::math::vec3f;
@@ -168,6 +170,13 @@ namespace niwa {
                 }
             }
 
+            void Ring::getCausticBounds(std::vector<geom::aabb>& bounds) const {
+                vec3f const extent(boundingRadius, boundingRadius, boundingRadius);
+
+                bounds.push_back(geom::aabb(
+                    spherePosition_ - extent, spherePosition_ + extent));
+            }
+
             void Ring::computeRotation( float timeSeconds ) {
                 float t = timeSeconds * .5f;
 
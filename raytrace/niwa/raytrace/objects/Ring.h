@@ -30,6 +30,12 @@ namespace niwa {
 
                 bool __fastcall raytrace(ray3f const& ray, HitInfo& hitInfo) const;
 
+                /**
+                 * The ring is specular; its bounds are
+                 * those of its bounding sphere.
+                 */
+                void getCausticBounds(std::vector<geom::aabb>& bounds) const;
+
                 void computeRotation(float timeSeconds);
             private:
                 /**
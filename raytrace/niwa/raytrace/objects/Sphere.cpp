@@ -12,6 +12,8 @@
 #include "niwa/raytrace/ray3f.h"
 #include "niwa/raytrace/packed_ray3f.h"
 
+#include "niwa/geom/aabb.h"
+
 #include "niwa/math/Constants.h"
 
 #include <xmmintrin.h>
@@ -215,6 +217,18 @@ namespace niwa {
 
                 return _mm_and_ps(andMask, _mm_or_ps(orMask1, orMask2));
            }
+
+            void Sphere::getCausticBounds(std::vector<geom::aabb>& bounds) const {
+                Material::Type const type = outsideMaterial_.getType();
+
+                if(type == Material::MATERIAL_SPECULAR
+                        || type == Material::MATERIAL_DIELECTRIC) {
+                    vec3f const extent(radius_, radius_, radius_);
+
+                    bounds.push_back(geom::aabb(
+                        position_ - extent, position_ + extent));
+                }
+            }
         }
     }
 }
\ No newline at end of file
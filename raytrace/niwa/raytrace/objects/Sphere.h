@@ -15,7 +15,10 @@
 
 namespace niwa {
     namespace math {
-        class packed_vec3f;
+        template<int N>
+        class packed_vec3;
+
+        typedef packed_vec3<4> packed_vec3f;
     }
 
     namespace raytrace {
@@ -48,6 +51,12 @@ namespace niwa {
                 __m128 __fastcall raytraceShadow(
                     packed_ray3f const& ray, __m128 cutoffDistance, ILight const* light) const;
 
+                /**
+                 * Adds the bounding box of the sphere
+                 * if its material is specular or dielectric.
+                 */
+                void getCausticBounds(std::vector<geom::aabb>& bounds) const;
+
             private:
                 /**
                  * Updates the auxiliary radiance
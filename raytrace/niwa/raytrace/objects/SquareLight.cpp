@@ -368,9 +368,7 @@ namespace niwa {
                     packedScore = _mm_add_ps(packedScore, contribution);
                 }
 
-                for(size_t i=0; i<4; ++i) {
-                    score += packedScore.m128_f32[i];
-                }
+                score += math::horizontalSum(math::simd<float, 4>(packedScore));
 
                 for(size_t i=packedSampleCount * 4; i<sampleCount_; ++i) {
                     float u = param1.nextf();
@@ -12,6 +12,8 @@
 
 #include "niwa/levelset/ILevelSet.h"
 
+#include "niwa/geom/aabb.h"
+
 #include "niwa/math/vec3f.h"
 
 namespace {
@@ -80,6 +82,22 @@ namespace niwa {
 
                 return false;
             }
+
+            void TraceableLevelSet::getCausticBounds(
+                    std::vector<geom::aabb>& bounds) const {
+                Material::Type const type = material_.getType();
+
+                if(type != Material::MATERIAL_SPECULAR
+                        && type != Material::MATERIAL_DIELECTRIC) {
+                    return;
+                }
+
+                geom::aabb surfaceBounds(vec3f(0,0,0));
+
+                if(levelSet_->getSurfaceBounds(surfaceBounds)) {
+                    bounds.push_back(surfaceBounds);
+                }
+            }
         }
     }
 }
\ No newline at end of file
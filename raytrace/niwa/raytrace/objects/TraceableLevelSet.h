@@ -39,6 +39,12 @@ namespace niwa {
             public: // from ITraceable
                 bool __fastcall raytrace(ray3f const& ray, HitInfo& hitInfo) const;
 
+                /**
+                 * Uses the surface bounds of the level set; a level
+                 * set without known bounds receives no caustic photons.
+                 */
+                void getCausticBounds(std::vector<geom::aabb>& bounds) const;
+
             private:
                 boost::shared_ptr<levelset::ILevelSet> levelSet_;
 
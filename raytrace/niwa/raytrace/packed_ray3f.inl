@@ -57,9 +57,7 @@ namespace niwa {
 
             __m128 xyz = _mm_mul_ps(dx, _mm_mul_ps(dy, dz));
 
-            for(size_t j=0; j<4; ++j) {
-                xyz.m128_f32[j] = 1 / xyz.m128_f32[j];
-            }
+            xyz = _mm_div_ps(_mm_set_ps1(1.0f), xyz);
 
             inv[0] = _mm_mul_ps(_mm_mul_ps(dir[1], dir[2]), xyz);
             inv[1] = _mm_mul_ps(_mm_mul_ps(dir[0], dir[2]), xyz);
@@ -31,9 +31,7 @@ namespace niwa {
 #if NIWA_RAYTRACE_RAY3F_SSE_RCP
             directionInverses_ = _mm_rcp_ps(direction_);
 #else
-            for(int i=0; i<3; ++i) {
-                directionInverses_.m128_f32[i] = 1 / direction_.m128_f32[i];
-            }
+            directionInverses_ = _mm_div_ps(_mm_set_ps1(1.0f), direction_);
 #endif
         }
 
@@ -0,0 +1,288 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/AlignedMemory.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <ostream>
+
+#include <xmmintrin.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/**
+ * Blocks at least this large are mapped on their own
+ * and may be backed by huge pages; the size of an x86
+ * huge page.
+ */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+namespace niwa {
+    namespace system {
+        namespace {
+            enum Backing {
+                BACKING_HEAP,
+                BACKING_MAPPED,
+                BACKING_LARGE_PAGES
+            };
+
+            /**
+             * Stored right before each block.
+             */
+            struct Header {
+                /**
+                 * The heap block, or the mapping once its
+                 * alignment slack has been unmapped.
+                 */
+                void* base;
+
+                std::size_t mappedBytes;
+
+                std::size_t bytes;
+
+                int category;
+
+                int backing;
+            };
+
+            static std::atomic<int> gPolicy(HUGE_PAGES_TRANSPARENT);
+
+            static std::atomic<std::size_t> gAllocatedBytes[MEMORY_CATEGORY_COUNT];
+
+            static std::atomic<std::size_t> gPeakBytes[MEMORY_CATEGORY_COUNT];
+
+            /**
+             * @return The mapping, or NULL.
+             */
+            static void* fMapHugePages(std::size_t bytes, HugePagePolicy policy, Backing& backing) {
+#if defined(_WIN32)
+                if(policy == HUGE_PAGES_EXPLICIT) {
+                    SIZE_T const largePage = GetLargePageMinimum();
+
+                    if(largePage != 0 && bytes % largePage == 0) {
+                        void* memory = VirtualAlloc(
+                            NULL, bytes,
+                            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                            PAGE_READWRITE);
+
+                        if(memory) {
+                            backing = BACKING_LARGE_PAGES;
+                            return memory;
+                        }
+                    }
+                }
+
+                void* memory = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+                backing = BACKING_MAPPED;
+
+                return memory;
+#elif defined(__linux__)
+                void* memory = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+                if(policy == HUGE_PAGES_EXPLICIT) {
+                    memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+                    backing = BACKING_LARGE_PAGES;
+                }
+#endif
+
+                if(memory == MAP_FAILED) {
+                    // Transparent huge pages only back aligned ranges,
+                    // but mmap aligns to ordinary pages; so map a huge
+                    // page more, and unmap the slack around the aligned part.
+                    char* const padded = static_cast<char*>(mmap(
+                        NULL, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+                    if(padded == MAP_FAILED) {
+                        return NULL;
+                    }
+
+                    std::size_t const headSlack = (HUGE_PAGE_SIZE
+                        - reinterpret_cast<std::uintptr_t>(padded) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+
+                    if(headSlack != 0) {
+                        munmap(padded, headSlack);
+                    }
+
+                    munmap(padded + headSlack + bytes, HUGE_PAGE_SIZE - headSlack);
+
+                    memory = padded + headSlack;
+
+#ifdef MADV_HUGEPAGE
+                    // Only a hint; ignored if the kernel lacks THP.
+                    madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+
+                    backing = BACKING_MAPPED;
+                }
+
+                return memory;
+#else
+                (void)bytes;
+                (void)policy;
+                (void)backing;
+                return NULL;
+#endif
+            }
+
+            static void fUnmap(void* memory, std::size_t bytes) {
+#if defined(_WIN32)
+                (void)bytes;
+                VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+                munmap(memory, bytes);
+#else
+                (void)memory;
+                (void)bytes;
+#endif
+            }
+        }
+
+        void* AlignedMemory::allocate(
+                std::size_t bytes, std::size_t alignment, MemoryCategory category) {
+            assert(alignment >= 16 && (alignment & (alignment-1)) == 0);
+
+            // The header fills whole alignment units before the block.
+            std::size_t const headerBytes =
+                (sizeof(Header) + alignment - 1) & ~(alignment - 1);
+
+            std::size_t const totalBytes = headerBytes + bytes;
+
+            HugePagePolicy const policy = static_cast<HugePagePolicy>(gPolicy.load());
+
+            void* base = NULL;
+
+            std::size_t mappedBytes = 0;
+
+            Backing backing = BACKING_HEAP;
+
+            if(policy != HUGE_PAGES_NONE && totalBytes >= HUGE_PAGE_SIZE) {
+                // Whole huge pages; the mapping is aligned to a
+                // huge page, which covers any sensible alignment.
+                mappedBytes = (totalBytes + HUGE_PAGE_SIZE - 1) & ~std::size_t(HUGE_PAGE_SIZE - 1);
+
+                base = fMapHugePages(mappedBytes, policy, backing);
+            }
+
+            if(!base) {
+                backing = BACKING_HEAP;
+
+                base = _mm_malloc(totalBytes, alignment);
+
+                if(!base) {
+                    throw std::bad_alloc();
+                }
+            }
+
+            char* memory = static_cast<char*>(base) + headerBytes;
+
+            Header* header = reinterpret_cast<Header*>(memory) - 1;
+
+            header->base = base;
+            header->mappedBytes = mappedBytes;
+            header->bytes = bytes;
+            header->category = category;
+            header->backing = backing;
+
+            std::size_t const allocated = gAllocatedBytes[category].fetch_add(bytes) + bytes;
+
+            std::size_t peak = gPeakBytes[category].load();
+
+            while(allocated > peak && !gPeakBytes[category].compare_exchange_weak(peak, allocated)) {
+                // peak is reloaded on failure
+            }
+
+            return memory;
+        }
+
+        void AlignedMemory::free(void* memory) {
+            if(!memory) {
+                return;
+            }
+
+            Header const header = *(static_cast<Header*>(memory) - 1);
+
+            gAllocatedBytes[header.category].fetch_sub(header.bytes);
+
+            if(header.backing == BACKING_HEAP) {
+                _mm_free(header.base);
+            } else {
+                fUnmap(header.base, header.mappedBytes);
+            }
+        }
+
+        void AlignedMemory::setHugePagePolicy(HugePagePolicy policy) {
+            gPolicy.store(policy);
+        }
+
+        std::size_t AlignedMemory::getAllocatedBytes(MemoryCategory category) {
+            return gAllocatedBytes[category].load();
+        }
+
+        std::size_t AlignedMemory::getPeakBytes(MemoryCategory category) {
+            return gPeakBytes[category].load();
+        }
+
+        char const* AlignedMemory::getCategoryName(MemoryCategory category) {
+            switch(category) {
+            case MEMORY_GENERAL:
+                return "general";
+            case MEMORY_LEVELSET:
+                return "levelset";
+            case MEMORY_PHOTONMAP:
+                return "photonmap";
+            case MEMORY_RAYTRACE:
+                return "raytrace";
+            case MEMORY_DYNAMICS:
+                return "dynamics";
+            default:
+                return "unknown";
+            }
+        }
+
+        MemoryStatistics AlignedMemory::getStatistics() {
+            MemoryStatistics statistics;
+
+            for(int i=0; i<MEMORY_CATEGORY_COUNT; ++i) {
+                MemoryCategory const category = static_cast<MemoryCategory>(i);
+
+                statistics.allocatedBytes[i] = getAllocatedBytes(category);
+                statistics.peakBytes[i] = getPeakBytes(category);
+            }
+
+            return statistics;
+        }
+
+        std::ostream& operator << (std::ostream& out, MemoryStatistics const& statistics) {
+            for(int i=0; i<MEMORY_CATEGORY_COUNT; ++i) {
+                MemoryCategory const category = static_cast<MemoryCategory>(i);
+
+                if(i > 0) {
+                    out << "; ";
+                }
+
+                out << AlignedMemory::getCategoryName(category)
+                    << ": " << statistics.allocatedBytes[i] / 1024
+                    << " kB, peak " << statistics.peakBytes[i] / 1024 << " kB";
+            }
+
+            return out;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_ALIGNEDMEMORY_H
+#define NIWA_SYSTEM_ALIGNEDMEMORY_H
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace niwa {
+    namespace system {
+        /**
+         * The subsystem an allocation is accounted to.
+         */
+        enum MemoryCategory {
+            MEMORY_GENERAL,
+            MEMORY_LEVELSET,
+            MEMORY_PHOTONMAP,
+            MEMORY_RAYTRACE,
+            MEMORY_DYNAMICS,
+            MEMORY_CATEGORY_COUNT
+        };
+
+        /**
+         * How large blocks are backed.
+         */
+        enum HugePagePolicy {
+            /**
+             * Ordinary pages only.
+             */
+            HUGE_PAGES_NONE,
+
+            /**
+             * Large blocks are mapped on their own and the
+             * kernel is asked to back them with transparent
+             * huge pages (Linux); elsewhere, ordinary pages.
+             */
+            HUGE_PAGES_TRANSPARENT,
+
+            /**
+             * Large blocks are first tried from the reserved
+             * huge pages (MAP_HUGETLB; MEM_LARGE_PAGES on Windows,
+             * which needs the lock-pages privilege), then
+             * as with HUGE_PAGES_TRANSPARENT.
+             */
+            HUGE_PAGES_EXPLICIT
+        };
+
+        /**
+         * A snapshot of the bytes accounted to each category,
+         * indexed by MemoryCategory. Can be written to a log.
+         */
+        struct MemoryStatistics {
+            /**
+             * See AlignedMemory::getAllocatedBytes.
+             */
+            std::size_t allocatedBytes[MEMORY_CATEGORY_COUNT];
+
+            /**
+             * See AlignedMemory::getPeakBytes.
+             */
+            std::size_t peakBytes[MEMORY_CATEGORY_COUNT];
+        };
+
+        /**
+         * Writes the allocated and peak kilobytes of
+         * every category on a single line.
+         */
+        std::ostream& operator << (std::ostream& out, MemoryStatistics const& statistics);
+
+        /**
+         * Aligned allocation for large SIMD arrays, with
+         * byte accounting per subsystem. Blocks of at least
+         * a huge page (2 MB) can be backed by huge pages, which
+         * cuts TLB misses when such arrays are walked.
+         *
+         * Thread-safe.
+         */
+        class AlignedMemory {
+        public:
+            /**
+             * @param alignment A power of two, at least 16.
+             *
+             * @return Uninitialized memory; never NULL.
+             *
+             * @throws std::bad_alloc If the memory
+             *         cannot be allocated.
+             */
+            static void* allocate(
+                std::size_t bytes, std::size_t alignment, MemoryCategory category);
+
+            /**
+             * Frees memory from allocate; NULL is ignored.
+             */
+            static void free(void* memory);
+
+            /**
+             * Affects later allocations only. The default
+             * is HUGE_PAGES_TRANSPARENT.
+             */
+            static void setHugePagePolicy(HugePagePolicy policy);
+
+            /**
+             * @return The bytes currently allocated to the
+             *         category, not counting alignment and pages.
+             */
+            static std::size_t getAllocatedBytes(MemoryCategory category);
+
+            /**
+             * @return The most bytes ever allocated
+             *         to the category at once.
+             */
+            static std::size_t getPeakBytes(MemoryCategory category);
+
+            static char const* getCategoryName(MemoryCategory category);
+
+            /**
+             * @return The counters of all categories; each is
+             *         read atomically, but not all at once.
+             */
+            static MemoryStatistics getStatistics();
+
+        private:
+            AlignedMemory();
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_ARENAALLOCATOR_H
+#define NIWA_SYSTEM_ARENAALLOCATOR_H
+
+#include "FrameArena.h"
+
+#include <cstddef>
+
+namespace niwa {
+    namespace system {
+        /**
+         * A standard allocator over a frame arena, for
+         * transient containers, e.g.:
+         *
+         *     FrameArena::Scope scope(FrameArena::forThread());
+         *
+         *     std::vector<float, ArenaAllocator<float> > values(
+         *         n, 0.0f, ArenaAllocator<float>(FrameArena::forThread()));
+         *
+         * Deallocation does nothing; the container must not
+         * outlive the scope of its allocations.
+         */
+        template<typename T>
+        class ArenaAllocator {
+        public:
+            typedef T value_type;
+            typedef T* pointer;
+            typedef T const* const_pointer;
+            typedef T& reference;
+            typedef T const& const_reference;
+            typedef std::size_t size_type;
+            typedef std::ptrdiff_t difference_type;
+
+            template<typename U>
+            struct rebind {
+                typedef ArenaAllocator<U> other;
+            };
+
+        public:
+            explicit ArenaAllocator(FrameArena& arena);
+
+            template<typename U>
+            ArenaAllocator(ArenaAllocator<U> const& other);
+
+            pointer allocate(size_type count, void const* hint = 0);
+
+            void deallocate(pointer p, size_type count);
+
+            void construct(pointer p, T const& value);
+
+            void destroy(pointer p);
+
+            size_type max_size() const;
+
+            pointer address(reference value) const;
+
+            const_pointer address(const_reference value) const;
+
+            FrameArena& getArena() const;
+
+        private:
+            FrameArena* arena_;
+        };
+
+        template<typename T, typename U>
+        bool operator == (ArenaAllocator<T> const& lhs, ArenaAllocator<U> const& rhs);
+
+        template<typename T, typename U>
+        bool operator != (ArenaAllocator<T> const& lhs, ArenaAllocator<U> const& rhs);
+    }
+}
+
+#include "ArenaAllocator.inl"
+
+#endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_ARENAALLOCATOR_INL
+#define NIWA_SYSTEM_ARENAALLOCATOR_INL
+
+#include <new>
+
+namespace niwa {
+    namespace system {
+        template<typename T>
+        ArenaAllocator<T>::ArenaAllocator(FrameArena& arena) : arena_(&arena) {
+            // ignored
+        }
+
+        template<typename T>
+        template<typename U>
+        ArenaAllocator<T>::ArenaAllocator(ArenaAllocator<U> const& other)
+            : arena_(&other.getArena()) {
+            // ignored
+        }
+
+        template<typename T>
+        typename ArenaAllocator<T>::pointer ArenaAllocator<T>::allocate(
+                size_type count, void const* /*hint*/) {
+            // At least SSE alignment, for types like Spectrum.
+            size_type const alignment = __alignof(T) > 16 ? __alignof(T) : 16;
+
+            return static_cast<pointer>(arena_->allocate(count * sizeof(T), alignment));
+        }
+
+        template<typename T>
+        void ArenaAllocator<T>::deallocate(pointer /*p*/, size_type /*count*/) {
+            // ignored
+        }
+
+        template<typename T>
+        void ArenaAllocator<T>::construct(pointer p, T const& value) {
+            new(static_cast<void*>(p)) T(value);
+        }
+
+        template<typename T>
+        void ArenaAllocator<T>::destroy(pointer p) {
+            p->~T();
+        }
+
+        template<typename T>
+        typename ArenaAllocator<T>::size_type ArenaAllocator<T>::max_size() const {
+            return static_cast<size_type>(-1) / sizeof(T);
+        }
+
+        template<typename T>
+        typename ArenaAllocator<T>::pointer ArenaAllocator<T>::address(reference value) const {
+            return &value;
+        }
+
+        template<typename T>
+        typename ArenaAllocator<T>::const_pointer ArenaAllocator<T>::address(
+                const_reference value) const {
+            return &value;
+        }
+
+        template<typename T>
+        FrameArena& ArenaAllocator<T>::getArena() const {
+            return *arena_;
+        }
+
+        template<typename T, typename U>
+        bool operator == (ArenaAllocator<T> const& lhs, ArenaAllocator<U> const& rhs) {
+            return &lhs.getArena() == &rhs.getArena();
+        }
+
+        template<typename T, typename U>
+        bool operator != (ArenaAllocator<T> const& lhs, ArenaAllocator<U> const& rhs) {
+            return !(lhs == rhs);
+        }
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,422 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/CpuTopology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define SYSFS_CPU "/sys/devices/system/cpu/"
+#define SYSFS_NODE "/sys/devices/system/node/"
+
+#define MAX_CACHE_INDEX 8
+
+namespace {
+    using niwa::system::CpuTopology;
+
+    /**
+     * @return The first line of the file, or
+     *         an empty string if it can't be read.
+     */
+    static std::string fReadLine(std::string const& path) {
+        std::string line;
+
+        FILE* file = fopen(path.c_str(), "r");
+
+        if(file) {
+            char buffer[1024];
+
+            if(fgets(buffer, sizeof(buffer), file)) {
+                line = buffer;
+
+                while(!line.empty() && (line[line.size()-1] == '\n'
+                        || line[line.size()-1] == '\r')) {
+                    line.erase(line.size()-1);
+                }
+            }
+
+            fclose(file);
+        }
+
+        return line;
+    }
+
+    static int fReadInt(std::string const& path, int defaultValue) {
+        std::string line = fReadLine(path);
+
+        return line.empty() ? defaultValue : atoi(line.c_str());
+    }
+
+    /**
+     * Parses a list such as "0-3,8,10-11".
+     */
+    static std::vector<int> fParseList(std::string const& list) {
+        std::vector<int> result;
+
+        char const* p = list.c_str();
+
+        while(*p) {
+            char* next;
+
+            long first = strtol(p, &next, 10);
+
+            if(next == p) {
+                break;
+            }
+
+            long last = first;
+
+            p = next;
+
+            if(*p == '-') {
+                last = strtol(p+1, &next, 10);
+                p = next;
+            }
+
+            for(long i=first; i<=last; ++i) {
+                result.push_back(static_cast<int>(i));
+            }
+
+            if(*p == ',') {
+                ++p;
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Parses a size such as "32K".
+     */
+    static std::size_t fParseSize(std::string const& size) {
+        std::size_t value = static_cast<std::size_t>(atol(size.c_str()));
+
+        if(size.find('K') != std::string::npos) {
+            value *= 1024;
+        } else if(size.find('M') != std::string::npos) {
+            value *= 1024 * 1024;
+        }
+
+        return value;
+    }
+
+    static std::string fCpuPath(int id) {
+        char buffer[64];
+
+        sprintf(buffer, SYSFS_CPU "cpu%d/", id);
+
+        return buffer;
+    }
+
+    struct CompactOrder {
+        bool operator () (
+                CpuTopology::Processor const& lhs,
+                CpuTopology::Processor const& rhs) const {
+            if(lhs.node != rhs.node) {
+                return lhs.node < rhs.node;
+            } else if(lhs.socket != rhs.socket) {
+                return lhs.socket < rhs.socket;
+            } else if(lhs.core != rhs.core) {
+                return lhs.core < rhs.core;
+            } else {
+                return lhs.smtIndex < rhs.smtIndex;
+            }
+        }
+    };
+}
+
+namespace niwa {
+    namespace system {
+        CpuTopology::CpuTopology() : nCores_(0), nSockets_(0), nNodes_(0) {
+            // ignored
+        }
+
+        CpuTopology CpuTopology::create() {
+            CpuTopology topology;
+
+            std::vector<int> ids = fParseList(fReadLine(SYSFS_CPU "online"));
+
+            if(ids.empty()) {
+                // No sysfs: assume a flat topology.
+                int n = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+                for(int i=0; i<n; ++i) {
+                    Processor processor = { i, 0, i, 0, 0 };
+
+                    topology.processors_.push_back(processor);
+                }
+
+                topology.nCores_ = n;
+                topology.nSockets_ = 1;
+                topology.nNodes_ = 1;
+
+                return topology;
+            }
+
+            std::vector<int> nodeOf(ids.back() + 1, 0);
+
+            std::vector<int> nodes = fParseList(fReadLine(SYSFS_NODE "online"));
+
+            for(size_t i=0; i<nodes.size(); ++i) {
+                char buffer[64];
+
+                sprintf(buffer, SYSFS_NODE "node%d/cpulist", nodes[i]);
+
+                std::vector<int> cpus = fParseList(fReadLine(buffer));
+
+                for(size_t j=0; j<cpus.size(); ++j) {
+                    if(cpus[j] < static_cast<int>(nodeOf.size())) {
+                        nodeOf[cpus[j]] = nodes[i];
+                    }
+                }
+            }
+
+            std::set<std::pair<int,int> > cores;
+            std::set<int> sockets;
+
+            for(size_t i=0; i<ids.size(); ++i) {
+                std::string path = fCpuPath(ids[i]) + "topology/";
+
+                Processor processor;
+
+                processor.id = ids[i];
+                processor.socket = fReadInt(path + "physical_package_id", 0);
+                processor.core = fReadInt(path + "core_id", ids[i]);
+                processor.node = nodeOf[ids[i]];
+
+                // The siblings are listed in id order.
+                std::vector<int> siblings = fParseList(
+                    fReadLine(path + "thread_siblings_list"));
+
+                processor.smtIndex = static_cast<int>(
+                    std::find(siblings.begin(), siblings.end(), ids[i])
+                        - siblings.begin());
+
+                if(processor.smtIndex == static_cast<int>(siblings.size())) {
+                    processor.smtIndex = 0;
+                }
+
+                topology.processors_.push_back(processor);
+
+                cores.insert(std::make_pair(processor.socket, processor.core));
+                sockets.insert(processor.socket);
+            }
+
+            for(int i=0; i<MAX_CACHE_INDEX; ++i) {
+                char buffer[32];
+
+                sprintf(buffer, "cache/index%d/", i);
+
+                std::string path = fCpuPath(ids[0]) + buffer;
+
+                std::string type = fReadLine(path + "type");
+
+                if(type.empty()) {
+                    break;
+                }
+
+                if(type == "Instruction") {
+                    continue;
+                }
+
+                Cache cache;
+
+                cache.level = fReadInt(path + "level", 0);
+                cache.sizeBytes = fParseSize(fReadLine(path + "size"));
+                cache.lineSize = fReadInt(path + "coherency_line_size", 64);
+                cache.sharedBy = std::max(1, static_cast<int>(
+                    fParseList(fReadLine(path + "shared_cpu_list")).size()));
+
+                topology.caches_.push_back(cache);
+            }
+
+            topology.nCores_ = static_cast<int>(cores.size());
+            topology.nSockets_ = static_cast<int>(sockets.size());
+            topology.nNodes_ = std::max(1, static_cast<int>(nodes.size()));
+
+            return topology;
+        }
+
+        int CpuTopology::getProcessorCount() const {
+            return static_cast<int>(processors_.size());
+        }
+
+        CpuTopology::Processor const& CpuTopology::getProcessor(int index) const {
+            return processors_[index];
+        }
+
+        int CpuTopology::getCoreCount() const {
+            return nCores_;
+        }
+
+        int CpuTopology::getSocketCount() const {
+            return nSockets_;
+        }
+
+        int CpuTopology::getNodeCount() const {
+            return nNodes_;
+        }
+
+        std::vector<CpuTopology::Cache> const& CpuTopology::getCaches() const {
+            return caches_;
+        }
+
+        std::vector<int> CpuTopology::getPlacement(PinningPolicy policy, int nThreads) const {
+            std::vector<int> placement;
+
+            if(policy == PIN_NONE || processors_.empty()) {
+                return placement;
+            }
+
+            std::vector<Processor> order(processors_);
+
+            std::sort(order.begin(), order.end(), CompactOrder());
+
+            if(policy == PIN_SCATTER) {
+                // Deal the compact order out by SMT index,
+                // then by the rank of the core in its socket,
+                // then by socket.
+                std::vector<std::pair<std::pair<int,int>, std::pair<int,int> > > keys;
+
+                int rank = 0;
+
+                for(size_t i=0; i<order.size(); ++i) {
+                    if(i > 0 && order[i].socket != order[i-1].socket) {
+                        rank = 0;
+                    } else if(i > 0 && order[i].core != order[i-1].core) {
+                        ++rank;
+                    }
+
+                    keys.push_back(std::make_pair(
+                        std::make_pair(order[i].smtIndex, rank),
+                        std::make_pair(order[i].socket, order[i].id)));
+                }
+
+                std::sort(keys.begin(), keys.end());
+
+                for(int i=0; i<nThreads; ++i) {
+                    placement.push_back(keys[i % keys.size()].second.second);
+                }
+            } else {
+                for(int i=0; i<nThreads; ++i) {
+                    placement.push_back(order[i % order.size()].id);
+                }
+            }
+
+            return placement;
+        }
+
+        bool CpuTopology::pinCurrentThread(int processorId) {
+#if defined(_WIN32)
+            if(processorId < 0 || processorId >= static_cast<int>(8 * sizeof(DWORD_PTR))) {
+                return false;
+            }
+
+            return SetThreadAffinityMask(
+                GetCurrentThread(), static_cast<DWORD_PTR>(1) << processorId) != 0;
+#elif defined(__linux__)
+            if(processorId < 0 || processorId >= CPU_SETSIZE) {
+                return false;
+            }
+
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+            CPU_SET(processorId, &set);
+
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            return false;
+#endif
+        }
+
+        int CpuTopology::getCurrentNode() {
+#if defined(_WIN32)
+            UCHAR node = 0;
+
+            if(GetNumaProcessorNode(static_cast<UCHAR>(GetCurrentProcessorNumber()), &node)) {
+                return node;
+            }
+            return 0;
+#elif defined(__linux__)
+            unsigned int cpu = 0;
+            unsigned int node = 0;
+
+            if(syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+                return static_cast<int>(node);
+            }
+            return 0;
+#else
+            return 0;
+#endif
+        }
+
+        void* CpuTopology::allocateOnNode(std::size_t bytes, int node) {
+#if defined(_WIN32)
+            return VirtualAllocExNuma(
+                GetCurrentProcess(), NULL, bytes,
+                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                static_cast<DWORD>(node));
+#elif defined(__linux__)
+            void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if(memory == MAP_FAILED) {
+                return NULL;
+            }
+
+            if(node >= 0 && node < static_cast<int>(8 * sizeof(unsigned long))) {
+                unsigned long mask = 1UL << node;
+
+                // Pages are placed on first touch; failure
+                // leaves the default (local) policy.
+                syscall(SYS_mbind, memory, bytes, MPOL_PREFERRED,
+                    &mask, 8 * sizeof(mask), 0);
+            }
+
+            return memory;
+#else
+            (void)node;
+            return malloc(bytes);
+#endif
+        }
+
+        void CpuTopology::freeOnNode(void* memory, std::size_t bytes) {
+            if(!memory) {
+                return;
+            }
+
+#if defined(_WIN32)
+            (void)bytes;
+            VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+            munmap(memory, bytes);
+#else
+            (void)bytes;
+            free(memory);
+#endif
+        }
+    }
+}
\ No newline at end of file
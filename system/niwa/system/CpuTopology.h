@@ -0,0 +1,152 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_CPUTOPOLOGY_H
+#define NIWA_SYSTEM_CPUTOPOLOGY_H
+
+#include <cstddef>
+#include <vector>
+
+namespace niwa {
+    namespace system {
+        /**
+         * How worker threads are placed on logical processors.
+         */
+        enum PinningPolicy {
+            /**
+             * The threads are not pinned.
+             */
+            PIN_NONE,
+
+            /**
+             * Fills the SMT siblings of a core, then the cores
+             * of a socket, before moving on; keeps the threads
+             * close to share caches.
+             */
+            PIN_COMPACT,
+
+            /**
+             * One thread per core, round robin over the sockets,
+             * before using SMT siblings; maximizes the cache
+             * and memory bandwidth per thread.
+             */
+            PIN_SCATTER
+        };
+
+        /**
+         * The layout of the logical processors: sockets, cores,
+         * SMT siblings, caches and NUMA nodes. Read from /sys on
+         * Linux; elsewhere, each logical processor is assumed to
+         * be a core of its own on a single socket and node.
+         */
+        class CpuTopology {
+        public:
+            struct Processor {
+                /**
+                 * The operating system's index of the processor.
+                 */
+                int id;
+
+                int socket;
+
+                /**
+                 * Core index, unique within the socket.
+                 */
+                int core;
+
+                /**
+                 * Index among the SMT siblings of the core.
+                 */
+                int smtIndex;
+
+                int node;
+            };
+
+            struct Cache {
+                int level;
+
+                std::size_t sizeBytes;
+
+                int lineSize;
+
+                /**
+                 * The number of logical processors sharing the cache.
+                 */
+                int sharedBy;
+            };
+
+        public:
+            static CpuTopology create();
+
+            int getProcessorCount() const;
+
+            Processor const& getProcessor(int index) const;
+
+            int getCoreCount() const;
+
+            int getSocketCount() const;
+
+            int getNodeCount() const;
+
+            /**
+             * @return The data and unified caches
+             *         of the first processor, by level.
+             */
+            std::vector<Cache> const& getCaches() const;
+
+            /**
+             * @return The processor ids for the given number of
+             *         threads, in placement order; empty for PIN_NONE.
+             *         If there are more threads than processors,
+             *         the placement wraps around.
+             */
+            std::vector<int> getPlacement(PinningPolicy policy, int nThreads) const;
+
+            /**
+             * @return Whether the calling thread could be
+             *         pinned to the given processor.
+             */
+            static bool pinCurrentThread(int processorId);
+
+            /**
+             * @return The NUMA node of the processor
+             *         running the calling thread.
+             */
+            static int getCurrentNode();
+
+            /**
+             * Allocates page-aligned memory that prefers the given
+             * NUMA node. Falls back to ordinary pages when NUMA
+             * placement is not supported.
+             *
+             * @return The memory, or NULL on failure.
+             */
+            static void* allocateOnNode(std::size_t bytes, int node);
+
+            /**
+             * Frees memory from allocateOnNode.
+             *
+             * @param bytes The size of the allocation.
+             */
+            static void freeOnNode(void* memory, std::size_t bytes);
+
+        private:
+            CpuTopology();
+
+        private:
+            std::vector<Processor> processors_;
+
+            std::vector<Cache> caches_;
+
+            int nCores_;
+            int nSockets_;
+            int nNodes_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
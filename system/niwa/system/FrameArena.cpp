@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+#include <xmmintrin.h>
+
+/**
+ * Blocks are aligned to cache lines,
+ * which is the largest alignment offered.
+ */
+#define BLOCK_ALIGNMENT 64
+
+/**
+ * The first block size of the per-thread arenas.
+ */
+#define THREAD_BLOCK_SIZE (256 * 1024)
+
+namespace niwa {
+    namespace system {
+        FrameArena::Scope::Scope(FrameArena& arena)
+            : arena_(arena),
+              block_(arena.block_),
+              offset_(arena.offset_) {
+            // ignored
+        }
+
+        FrameArena::Scope::~Scope() {
+            arena_.rewind(block_, offset_);
+        }
+
+        FrameArena::FrameArena(size_t blockSize)
+            : block_(0),
+              offset_(0) {
+            Block block;
+
+            block.data = static_cast<char*>(_mm_malloc(blockSize, BLOCK_ALIGNMENT));
+            block.size = blockSize;
+
+            if(!block.data) {
+                throw std::bad_alloc();
+            }
+
+            blocks_.push_back(block);
+        }
+
+        FrameArena::~FrameArena() {
+            for(size_t i=0; i<blocks_.size(); ++i) {
+                _mm_free(blocks_[i].data);
+            }
+        }
+
+        void* FrameArena::allocate(size_t bytes, size_t alignment) {
+            assert(alignment > 0 && alignment <= BLOCK_ALIGNMENT);
+            assert((alignment & (alignment-1)) == 0);
+
+            size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+
+            if(start + bytes > blocks_[block_].size) {
+                // Blocks left over from an earlier scope are reused
+                // if large enough; otherwise a block is added.
+                size_t const next = block_ + 1;
+
+                if(next == blocks_.size() || blocks_[next].size < bytes) {
+                    Block block;
+
+                    block.size = std::max(bytes, blocks_.back().size * 2);
+                    block.data = static_cast<char*>(_mm_malloc(block.size, BLOCK_ALIGNMENT));
+
+                    if(!block.data) {
+                        throw std::bad_alloc();
+                    }
+
+                    blocks_.insert(blocks_.begin() + next, block);
+                }
+
+                block_ = next;
+                start = 0;
+            }
+
+            offset_ = start + bytes;
+
+            return blocks_[block_].data + start;
+        }
+
+        void FrameArena::rewind(size_t block, size_t offset) {
+            if(block == 0 && offset == 0) {
+                reset();
+            } else {
+                block_ = block;
+                offset_ = offset;
+            }
+        }
+
+        void FrameArena::reset() {
+            if(blocks_.size() > 1) {
+                size_t const capacity = getCapacity();
+
+                char* data = static_cast<char*>(_mm_malloc(capacity, BLOCK_ALIGNMENT));
+
+                // Merging is an optimization; keep
+                // the blocks if it cannot be done.
+                if(data) {
+                    for(size_t i=0; i<blocks_.size(); ++i) {
+                        _mm_free(blocks_[i].data);
+                    }
+
+                    blocks_.resize(1);
+
+                    blocks_[0].data = data;
+                    blocks_[0].size = capacity;
+                }
+            }
+
+            block_ = 0;
+            offset_ = 0;
+        }
+
+        size_t FrameArena::getUsedBytes() const {
+            size_t used = offset_;
+
+            for(size_t i=0; i<block_; ++i) {
+                used += blocks_[i].size;
+            }
+
+            return used;
+        }
+
+        size_t FrameArena::getCapacity() const {
+            size_t capacity = 0;
+
+            for(size_t i=0; i<blocks_.size(); ++i) {
+                capacity += blocks_[i].size;
+            }
+
+            return capacity;
+        }
+
+        FrameArena& FrameArena::forThread() {
+            thread_local FrameArena arena(THREAD_BLOCK_SIZE);
+
+            return arena;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_FRAMEARENA_H
+#define NIWA_SYSTEM_FRAMEARENA_H
+
+#include <cstddef>
+#include <vector>
+
+namespace niwa {
+    namespace system {
+        /**
+         * A bump allocator for transient memory. Allocation
+         * advances a pointer; nothing is freed individually.
+         * Instead, a Scope gives back everything allocated
+         * during its lifetime, and reset gives back everything.
+         *
+         * When a block runs out, another is added; once the
+         * arena is empty again, the blocks are merged into
+         * one, so in a steady frame loop the arena stops
+         * touching the heap after the first frames.
+         *
+         * Not thread-safe: each thread uses an arena
+         * of its own (see forThread).
+         */
+        class FrameArena {
+        public:
+            /**
+             * Gives back the allocations made during its lifetime.
+             * Scopes must be nested.
+             */
+            class Scope {
+            public:
+                explicit Scope(FrameArena& arena);
+
+                ~Scope();
+
+            private: // prevent copying
+                Scope(Scope const&);
+                Scope& operator = (Scope const&);
+
+            private:
+                FrameArena& arena_;
+
+                size_t block_;
+
+                size_t offset_;
+            };
+
+        public:
+            /**
+             * @param blockSize Size of the first block, in bytes.
+             */
+            explicit FrameArena(size_t blockSize);
+
+            ~FrameArena();
+
+            /**
+             * @param alignment A power of two, at most 64.
+             *
+             * @return Uninitialized memory, valid until the enclosing
+             *         scope ends or the arena is reset.
+             *
+             * @throws std::bad_alloc If a block cannot be added.
+             */
+            void* allocate(size_t bytes, size_t alignment);
+
+            /**
+             * Gives back all allocations. No scope may be open.
+             */
+            void reset();
+
+            /**
+             * @return The number of bytes in use, counting the
+             *         blocks before the current one as full.
+             */
+            size_t getUsedBytes() const;
+
+            size_t getCapacity() const;
+
+            /**
+             * The arena of the calling thread, created on first
+             * use. The engine resets the arena of the main thread
+             * at the end of each frame; other threads should only
+             * allocate within scopes.
+             */
+            static FrameArena& forThread();
+
+        private:
+            void rewind(size_t block, size_t offset);
+
+        private: // prevent copying
+            FrameArena(FrameArena const&);
+            FrameArena& operator = (FrameArena const&);
+
+        private:
+            struct Block {
+                char* data; // owned
+
+                size_t size;
+            };
+
+            std::vector<Block> blocks_;
+
+            /**
+             * The block being allocated from.
+             */
+            size_t block_;
+
+            /**
+             * The first free byte in the current block.
+             */
+            size_t offset_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/Futex.h"
+
+#include <climits>
+#include <thread>
+
+#include <xmmintrin.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * The number of spins before sleeping; a few microseconds,
+ * about the cost of a round-trip to the kernel.
+ */
+#define SPIN_COUNT 200
+
+namespace niwa {
+    namespace system {
+        Futex::Futex(int value) : value_(value), nSleepers_(0) {
+            // ignored
+        }
+
+        int Futex::load() const {
+            return value_.load();
+        }
+
+        void Futex::store(int value) {
+            value_.store(value);
+        }
+
+        int Futex::fetchAdd(int term) {
+            return value_.fetch_add(term);
+        }
+
+        void Futex::wait(int expected) {
+            for(int i=0; i<SPIN_COUNT; ++i) {
+                if(value_.load(std::memory_order_relaxed) != expected) {
+                    return;
+                }
+                _mm_pause();
+            }
+
+            nSleepers_.fetch_add(1);
+
+            // The kernel re-checks the value, so a wake
+            // between the spin and the sleep is not lost.
+#if defined(_WIN32)
+            WaitOnAddress(&value_, &expected, sizeof(expected), INFINITE);
+#elif defined(__linux__)
+            syscall(SYS_futex, reinterpret_cast<int*>(&value_),
+                FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+            std::this_thread::yield();
+#endif
+
+            nSleepers_.fetch_sub(1);
+        }
+
+        void Futex::wakeAll() {
+            if(nSleepers_.load() == 0) {
+                return;
+            }
+
+#if defined(_WIN32)
+            WakeByAddressAll(&value_);
+#elif defined(__linux__)
+            syscall(SYS_futex, reinterpret_cast<int*>(&value_),
+                FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_FUTEX_H
+#define NIWA_SYSTEM_FUTEX_H
+
+#include <atomic>
+
+namespace niwa {
+    namespace system {
+        /**
+         * An atomic integer that threads can wait on.
+         * Waiting first spins for a while, so short waits
+         * cost no system calls; then the thread sleeps in
+         * the kernel (futex on Linux, WaitOnAddress on Windows).
+         */
+        class Futex {
+        public:
+            explicit Futex(int value);
+
+            int load() const;
+
+            void store(int value);
+
+            /**
+             * @return The value before the addition.
+             */
+            int fetchAdd(int term);
+
+            /**
+             * Blocks while the value equals the expected value.
+             * May return spuriously, so callers re-check the value.
+             */
+            void wait(int expected);
+
+            /**
+             * Wakes all threads waiting on the value.
+             * Must be called after changing the value.
+             */
+            void wakeAll();
+
+        private: // prevent copying
+            Futex(Futex const&);
+            Futex& operator = (Futex const&);
+
+        private:
+            std::atomic<int> value_;
+
+            /**
+             * The number of threads sleeping in the kernel;
+             * waking is free when there are none.
+             */
+            std::atomic<int> nSleepers_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
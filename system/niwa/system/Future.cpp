@@ -0,0 +1,186 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/Future.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace niwa {
+    namespace system {
+        /**
+         * The stage thread and its queue of futures.
+         */
+        class Future::Stage {
+        public:
+            /**
+             * @return The stage, or NULL if its
+             *         thread could not be started.
+             */
+            static Stage* global();
+
+            /**
+             * Queues the future for the stage thread.
+             */
+            void submit(Future* future);
+
+            /**
+             * Blocks until the future has been called.
+             */
+            void wait(Future const* future);
+
+            /**
+             * @return Whether the calling thread is the stage thread.
+             */
+            bool isCurrentThread() const;
+
+        private:
+            Stage();
+
+            /**
+             * @return The stage, or NULL if its
+             *         thread could not be started.
+             */
+            static Stage* create();
+
+            void run();
+
+        private: // prevent copying
+            Stage(Stage const&);
+            Stage& operator = (Stage const&);
+
+        private:
+            std::mutex mutex_;
+
+            std::condition_variable queued_;
+
+            /**
+             * Owned by the stage rather than the futures, since
+             * a future may be destroyed as soon as it is ready.
+             */
+            std::condition_variable called_;
+
+            std::deque<Future*> queue_;
+
+            std::thread thread_;
+        };
+
+        Future::ICallable::~ICallable() {
+            // ignored
+        }
+
+        Future::Future(ICallable& callable)
+            : callable_(callable),
+              isReady_(false),
+              stage_(Stage::global()) {
+            if(stage_ && !stage_->isCurrentThread()) {
+                stage_->submit(this);
+            } else {
+                // Waiting on the stage from the stage
+                // itself would never return.
+                stage_ = NULL;
+                run();
+            }
+        }
+
+        Future::~Future() {
+            wait();
+        }
+
+        void Future::wait() {
+            if(stage_) {
+                stage_->wait(this);
+            }
+        }
+
+        bool Future::isReady() const {
+            return isReady_.load(std::memory_order_acquire);
+        }
+
+        void Future::run() {
+            callable_.call();
+
+            isReady_.store(true, std::memory_order_release);
+        }
+
+        Future::Stage* Future::Stage::global() {
+            // Never destroyed, so the thread need not be joined
+            // while other modules run their static destructors.
+            static Stage* const instance = create();
+
+            return instance;
+        }
+
+        Future::Stage* Future::Stage::create() {
+            Stage* self = new Stage();
+
+            try {
+                self->thread_ = std::thread(&Stage::run, self);
+            } catch(std::system_error const&) {
+                delete self;
+                return NULL;
+            }
+
+            return self;
+        }
+
+        Future::Stage::Stage() {
+            // ignored
+        }
+
+        void Future::Stage::submit(Future* future) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                queue_.push_back(future);
+            }
+
+            queued_.notify_one();
+        }
+
+        void Future::Stage::wait(Future const* future) {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            while(!future->isReady()) {
+                called_.wait(lock);
+            }
+        }
+
+        bool Future::Stage::isCurrentThread() const {
+            return thread_.get_id() == std::this_thread::get_id();
+        }
+
+        void Future::Stage::run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            for(;;) {
+                while(queue_.empty()) {
+                    queued_.wait(lock);
+                }
+
+                Future* future = queue_.front();
+                queue_.pop_front();
+
+                lock.unlock();
+
+                future->callable_.call();
+
+                lock.lock();
+
+                // Set under the lock, so that a waiter cannot
+                // miss the notification; after this, the future
+                // may be destroyed at any time.
+                future->isReady_.store(true, std::memory_order_release);
+
+                called_.notify_all();
+            }
+        }
+    }
+}
\ No newline at end of file
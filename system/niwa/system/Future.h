@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_FUTURE_H
+#define NIWA_SYSTEM_FUTURE_H
+
+#include <atomic>
+
+namespace niwa {
+    namespace system {
+        /**
+         * Calls a callable on the stage thread, so that
+         * whole stages can overlap; each stage may still use
+         * a parallelizer of its own for its loops. The result
+         * is left where the callable puts it.
+         *
+         * The stage thread is started once and then sleeps
+         * between calls; concurrent futures are called in the
+         * order they were created. A future created on the
+         * stage thread itself is called right away.
+         */
+        class Future {
+        public:
+            class ICallable {
+            public:
+                virtual ~ICallable();
+
+                /**
+                 * Must not throw.
+                 */
+                virtual void call() = 0;
+            };
+
+        public:
+            /**
+             * Queues the callable for the stage thread. If the
+             * thread cannot be started, calls it on the calling thread.
+             *
+             * @param callable Must stay alive until the call
+             *                 has been waited for.
+             */
+            explicit Future(ICallable& callable);
+
+            /**
+             * Waits for the call.
+             */
+            ~Future();
+
+            /**
+             * Blocks until the call has returned.
+             */
+            void wait();
+
+            /**
+             * @return Whether the call has returned.
+             */
+            bool isReady() const;
+
+        private:
+            class Stage;
+
+            void run();
+
+        private: // prevent copying
+            Future(Future const&);
+            Future& operator = (Future const&);
+
+        private:
+            ICallable& callable_;
+
+            std::atomic<bool> isReady_;
+
+            /**
+             * The stage that calls the callable,
+             * or NULL if it was called in place.
+             */
+            Stage* stage_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
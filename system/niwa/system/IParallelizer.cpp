@@ -16,5 +16,20 @@ namespace niwa {
         IParallelizer::ICallback::~ICallback() {
             // ignored
         }
+
+        IParallelizer::IRangeCallback::~IRangeCallback() {
+            // ignored
+        }
+
+        IParallelizer::CallbackAdapter::CallbackAdapter(ICallback& callback)
+            : callback_(callback) {
+            // ignored
+        }
+
+        void IParallelizer::CallbackAdapter::invokeRange(int begin, int end) {
+            for(int i=begin; i<end; ++i) {
+                callback_.invoke(i);
+            }
+        }
     }
 }
\ No newline at end of file
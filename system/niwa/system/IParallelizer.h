@@ -33,6 +33,39 @@ namespace niwa {
                 virtual void __fastcall invoke(int index) = 0;
             };
 
+            /**
+             * Callback to a for loop that handles
+             * a contiguous range of indices per call,
+             * so the loop body can be inlined and vectorized.
+             */
+            class IRangeCallback {
+            public:
+                virtual ~IRangeCallback();
+
+                /**
+                 * Invokes the for loop at the indices
+                 * from begin (inclusive) to end (exclusive).
+                 */
+                virtual void __fastcall invokeRange(int begin, int end) = 0;
+            };
+
+            /**
+             * Runs an index callback over ranges.
+             */
+            class CallbackAdapter : public IRangeCallback {
+            public:
+                explicit CallbackAdapter(ICallback& callback);
+
+                void __fastcall invokeRange(int begin, int end);
+
+            private: // prevent copying
+                CallbackAdapter(CallbackAdapter const&);
+                CallbackAdapter& operator = (CallbackAdapter const&);
+
+            private:
+                ICallback& callback_;
+            };
+
             virtual ~IParallelizer();
 
             /**
@@ -57,6 +90,20 @@ namespace niwa {
              * @param stride Granularity for parallelization (default 1).
              */
             virtual void loop(ICallback& callback, int start, int end, int stride) = 0;
+
+            /**
+             * Automatically parallelized for loop over ranges.
+             * Generally not thread-safe: must be invoked from
+             * a single thread only.
+             *
+             * @param callback Callback to the for loop.
+             * @param start Start index of the loop (inclusive).
+             * @param end End index of the loop (exclusive).
+             * @param stride Granularity for parallelization; how
+             *               the ranges relate to it depends on
+             *               the parallelizer.
+             */
+            virtual void loopRange(IRangeCallback& callback, int start, int end, int stride) = 0;
         };
     }
 };
@@ -0,0 +1,58 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/KernelDispatch.h"
+
+#include <atomic>
+
+namespace niwa {
+    namespace system {
+        namespace {
+            /**
+             * The detected level, or -1 until detected. Detection is
+             * idempotent, so racing threads may both store it.
+             */
+            static std::atomic<int> gDetectedLevel(-1);
+
+            static std::atomic<int> gMaxLevel(SIMD_LEVEL_COUNT - 1);
+        }
+
+        SimdLevel KernelDispatch::getSimdLevel() {
+            int detected = gDetectedLevel.load();
+
+            if(detected < 0) {
+                detected = ProcessorInfo::create().getSimdLevel();
+                gDetectedLevel.store(detected);
+            }
+
+            int const maxLevel = gMaxLevel.load();
+
+            return static_cast<SimdLevel>(detected < maxLevel ? detected : maxLevel);
+        }
+
+        void KernelDispatch::setMaxSimdLevel(SimdLevel level) {
+            gMaxLevel.store(level);
+        }
+
+        char const* KernelDispatch::getSimdLevelName(SimdLevel level) {
+            switch(level) {
+            case SIMD_SSE2:
+                return "SSE2";
+            case SIMD_SSE41:
+                return "SSE4.1";
+            case SIMD_AVX:
+                return "AVX";
+            case SIMD_AVX2:
+                return "AVX2";
+            case SIMD_AVX512:
+                return "AVX-512";
+            default:
+                return "unknown";
+            }
+        }
+    }
+}
\ No newline at end of file
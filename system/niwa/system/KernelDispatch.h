@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_KERNELDISPATCH_H
+#define NIWA_SYSTEM_KERNELDISPATCH_H
+
+#include "ProcessorInfo.h"
+
+namespace niwa {
+    namespace system {
+        /**
+         * The SIMD level kernels are dispatched at,
+         * detected once per process.
+         */
+        class KernelDispatch {
+        public:
+            /**
+             * @return The processor's SIMD level,
+             *         capped by setMaxSimdLevel.
+             */
+            static SimdLevel getSimdLevel();
+
+            /**
+             * Caps the level of kernels selected from now on,
+             * e.g., to compare variants. Tables that have
+             * already selected keep their kernel.
+             */
+            static void setMaxSimdLevel(SimdLevel level);
+
+            static char const* getSimdLevelName(SimdLevel level);
+
+        private:
+            KernelDispatch();
+        };
+
+        /**
+         * Variants of one kernel for different SIMD levels,
+         * e.g., a function pointer type. The widest variant
+         * the processor can run is selected once, and then
+         * called through a plain pointer:
+         *
+         *     static Gather const gather = KernelTable<Gather>(gatherSse2)
+         *         .set(SIMD_AVX, gatherAvx)
+         *         .select();
+         *
+         * Variants above SSE2 must live in translation units compiled
+         * for their level (e.g., /arch:AVX), and nothing from those
+         * units may run unless selected here.
+         */
+        template<class Kernel>
+        class KernelTable {
+        public:
+            /**
+             * @param sse2Kernel The baseline, which every
+             *                   supported processor can run.
+             */
+            explicit KernelTable(Kernel sse2Kernel);
+
+            /**
+             * @return This table, for chaining.
+             */
+            KernelTable& set(SimdLevel level, Kernel kernel);
+
+            /**
+             * @return The variant of the widest level at
+             *         most KernelDispatch::getSimdLevel().
+             */
+            Kernel select() const;
+
+            /**
+             * @return The variant of the widest level at most maxLevel.
+             */
+            Kernel select(SimdLevel maxLevel) const;
+
+        private:
+            Kernel kernels_[SIMD_LEVEL_COUNT];
+
+            bool isSet_[SIMD_LEVEL_COUNT];
+        };
+    }
+}
+
+#include "KernelDispatch.inl"
+
+#endif
\ No newline at end of file
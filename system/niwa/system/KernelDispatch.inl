@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_KERNELDISPATCH_INL
+#define NIWA_SYSTEM_KERNELDISPATCH_INL
+
+namespace niwa {
+    namespace system {
+        template<class Kernel>
+        KernelTable<Kernel>::KernelTable(Kernel sse2Kernel) {
+            for(int i=0; i<SIMD_LEVEL_COUNT; ++i) {
+                kernels_[i] = sse2Kernel;
+                isSet_[i] = false;
+            }
+
+            isSet_[SIMD_SSE2] = true;
+        }
+
+        template<class Kernel>
+        KernelTable<Kernel>& KernelTable<Kernel>::set(SimdLevel level, Kernel kernel) {
+            kernels_[level] = kernel;
+            isSet_[level] = true;
+            return *this;
+        }
+
+        template<class Kernel>
+        Kernel KernelTable<Kernel>::select() const {
+            return select(KernelDispatch::getSimdLevel());
+        }
+
+        template<class Kernel>
+        Kernel KernelTable<Kernel>::select(SimdLevel maxLevel) const {
+            for(int level = maxLevel; level > SIMD_SSE2; --level) {
+                if(isSet_[level]) {
+                    return kernels_[level];
+                }
+            }
+
+            return kernels_[SIMD_SSE2];
+        }
+    }
+}
+
+#endif
\ No newline at end of file
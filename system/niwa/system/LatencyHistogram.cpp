@@ -0,0 +1,80 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace niwa {
+    namespace system {
+        LatencyHistogram::LatencyHistogram() {
+            reset();
+        }
+
+        void LatencyHistogram::add(double seconds) {
+            double const nanoseconds = seconds * 1e9;
+
+            int bucket = 0;
+
+            if(nanoseconds > 1) {
+                bucket = static_cast<int>(
+                    std::log(nanoseconds) / std::log(2.0) * BUCKETS_PER_OCTAVE);
+
+                if(bucket >= BUCKET_COUNT) {
+                    bucket = BUCKET_COUNT - 1;
+                }
+            }
+
+            ++buckets_[bucket];
+            ++count_;
+        }
+
+        void LatencyHistogram::merge(LatencyHistogram const& other) {
+            for(int i=0; i<BUCKET_COUNT; ++i) {
+                buckets_[i] += other.buckets_[i];
+            }
+
+            count_ += other.count_;
+        }
+
+        long LatencyHistogram::getCount() const {
+            return count_;
+        }
+
+        double LatencyHistogram::getPercentile(double fraction) const {
+            if(count_ == 0) {
+                return 0;
+            }
+
+            // The rank of the percentile, counting from one.
+            double const rank = std::max(1.0, std::ceil(fraction * count_));
+
+            long nBelow = 0;
+
+            int bucket = 0;
+
+            for(; bucket < BUCKET_COUNT-1; ++bucket) {
+                nBelow += buckets_[bucket];
+
+                if(nBelow >= rank) {
+                    break;
+                }
+            }
+
+            return std::pow(2.0, (bucket + 1) / static_cast<double>(BUCKETS_PER_OCTAVE)) * 1e-9;
+        }
+
+        void LatencyHistogram::reset() {
+            for(int i=0; i<BUCKET_COUNT; ++i) {
+                buckets_[i] = 0;
+            }
+
+            count_ = 0;
+        }
+    }
+}
\ No newline at end of file
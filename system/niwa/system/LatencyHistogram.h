@@ -0,0 +1,58 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_LATENCYHISTOGRAM_H
+#define NIWA_SYSTEM_LATENCYHISTOGRAM_H
+
+namespace niwa {
+    namespace system {
+        /**
+         * A histogram of durations with logarithmic buckets,
+         * four per octave from a nanosecond up; percentiles
+         * are accurate to about 20%. Not thread-safe: keep
+         * one per thread and merge them.
+         */
+        class LatencyHistogram {
+        public:
+            LatencyHistogram();
+
+            void add(double seconds);
+
+            void merge(LatencyHistogram const& other);
+
+            long getCount() const;
+
+            /**
+             * @param fraction The percentile as a
+             *                 fraction, e.g. 0.99.
+             *
+             * @return The upper bound of the bucket holding
+             *         the percentile, in seconds; zero if
+             *         the histogram is empty.
+             */
+            double getPercentile(double fraction) const;
+
+            void reset();
+
+        private:
+            enum {
+                BUCKETS_PER_OCTAVE = 4,
+
+                /**
+                 * Up to 2^40 nanoseconds, about 18 minutes.
+                 */
+                BUCKET_COUNT = 40 * BUCKETS_PER_OCTAVE
+            };
+
+            long buckets_[BUCKET_COUNT];
+
+            long count_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/LockStatistics.h"
+
+namespace niwa {
+    namespace system {
+        LockStatistics::LockStatistics()
+            : nAcquisitions_(0),
+              nContended_(0),
+              nSpins_(0),
+              waitNanoseconds_(0) {
+            // ignored
+        }
+
+        void LockStatistics::addAcquisition() {
+            nAcquisitions_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void LockStatistics::addContendedAcquisition(long spinCount, double waitSeconds) {
+            nAcquisitions_.fetch_add(1, std::memory_order_relaxed);
+            nContended_.fetch_add(1, std::memory_order_relaxed);
+            nSpins_.fetch_add(spinCount, std::memory_order_relaxed);
+            waitNanoseconds_.fetch_add(
+                static_cast<long long>(waitSeconds * 1e9), std::memory_order_relaxed);
+        }
+
+        long LockStatistics::getAcquisitionCount() const {
+            return nAcquisitions_.load(std::memory_order_relaxed);
+        }
+
+        long LockStatistics::getContendedCount() const {
+            return nContended_.load(std::memory_order_relaxed);
+        }
+
+        long long LockStatistics::getSpinCount() const {
+            return nSpins_.load(std::memory_order_relaxed);
+        }
+
+        double LockStatistics::getWaitSeconds() const {
+            return waitNanoseconds_.load(std::memory_order_relaxed) * 1e-9;
+        }
+
+        void LockStatistics::reset() {
+            nAcquisitions_.store(0);
+            nContended_.store(0);
+            nSpins_.store(0);
+            waitNanoseconds_.store(0);
+        }
+
+        std::ostream& operator << (std::ostream& out, LockStatistics const& statistics) {
+            out << "acquisitions: " << statistics.getAcquisitionCount()
+                << ", contended: " << statistics.getContendedCount()
+                << ", pauses: " << statistics.getSpinCount()
+                << ", wait: " << statistics.getWaitSeconds() * 1e3 << " ms";
+
+            return out;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_LOCKSTATISTICS_H
+#define NIWA_SYSTEM_LOCKSTATISTICS_H
+
+#include <atomic>
+#include <ostream>
+
+namespace niwa {
+    namespace system {
+        /**
+         * Contention counters of a lock, for finding hot locks.
+         * An uncontended acquisition costs one atomic increment;
+         * the wait of a contended one is also timed.
+         */
+        class LockStatistics {
+        public:
+            LockStatistics();
+
+            /**
+             * Records an acquisition that did not have to wait.
+             */
+            void addAcquisition();
+
+            /**
+             * Records an acquisition that had to wait.
+             *
+             * @param spinCount The number of pause
+             *                  instructions executed.
+             */
+            void addContendedAcquisition(long spinCount, double waitSeconds);
+
+            long getAcquisitionCount() const;
+
+            long getContendedCount() const;
+
+            long long getSpinCount() const;
+
+            double getWaitSeconds() const;
+
+            /**
+             * Not thread-safe with respect to the lock.
+             */
+            void reset();
+
+        private: // prevent copying
+            LockStatistics(LockStatistics const&);
+            LockStatistics& operator = (LockStatistics const&);
+
+        private:
+            std::atomic<long> nAcquisitions_;
+
+            std::atomic<long> nContended_;
+
+            std::atomic<long long> nSpins_;
+
+            std::atomic<long long> waitNanoseconds_;
+        };
+
+        std::ostream& operator << (std::ostream& out, LockStatistics const& statistics);
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "LockTestSuite.h"
+
+#include "niwa/testing/ITestCase.h"
+#include "niwa/testing/ITestContext.h"
+
+using niwa::testing::ITestCase;
+using niwa::testing::ITestContext;
+
+#include "LockStatistics.h"
+#include "McsLock.h"
+#include "SpinLock.h"
+#include "TicketLock.h"
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+namespace niwa {
+    namespace system {
+        /**
+         * Threads increment a plain counter under a lock; no
+         * increment may be lost, and no two threads may hold
+         * the lock at once.
+         */
+        template <typename Lock>
+        class MutualExclusion : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(MutualExclusion<Lock>);
+            }
+
+            void test(ITestContext& context) const {
+                static const int N_THREADS = 4;
+                static const int N_ROUNDS = 20000;
+
+                Lock lock;
+
+                LockStatistics statistics;
+
+                lock.setStatistics(&statistics);
+
+                Counter counter(lock, N_ROUNDS);
+
+                std::vector<std::thread> threads;
+
+                for(int i=0; i<N_THREADS; ++i) {
+                    threads.push_back(std::thread(&Counter::run, &counter));
+                }
+
+                for(size_t i=0; i<threads.size(); ++i) {
+                    threads[i].join();
+                }
+
+                context.assertEquals<long>(N_THREADS * N_ROUNDS, counter.count,
+                    "increments lost");
+                context.assertEquals<int>(0, counter.nOverlaps.load(),
+                    "lock held by two threads");
+                context.assertEquals<long>(N_THREADS * N_ROUNDS,
+                    statistics.getAcquisitionCount(), "acquisitions not counted");
+                context.assertEquals<bool>(true,
+                    statistics.getContendedCount() <= statistics.getAcquisitionCount(),
+                    "more contended acquisitions than acquisitions");
+            }
+
+        private:
+            class Counter {
+            public:
+                Counter(Lock& lock, int nRounds)
+                    : count(0), nOverlaps(0), lock_(lock), nRounds_(nRounds), nHolders_(0) {
+                    // ignored
+                }
+
+                void run() {
+                    for(int i=0; i<nRounds_; ++i) {
+                        lock_.acquire();
+
+                        if(nHolders_.fetch_add(1) != 0) {
+                            nOverlaps.fetch_add(1);
+                        }
+
+                        ++count;
+
+                        nHolders_.fetch_sub(1);
+
+                        lock_.release();
+                    }
+                }
+
+                long count;
+
+                std::atomic<int> nOverlaps;
+
+            private: // prevent copying
+                Counter(Counter const&);
+                Counter& operator = (Counter const&);
+
+            private:
+                Lock& lock_;
+                int const nRounds_;
+                std::atomic<int> nHolders_;
+            };
+        };
+
+        /**
+         * A thread holds several queue locks at once, each on
+         * a node of its own, and releases them out of order;
+         * the nodes are reused from the pool afterwards.
+         */
+        class McsLockNesting : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(McsLockNesting);
+            }
+
+            void test(ITestContext& context) const {
+                static const int N_ROUNDS = 10000;
+
+                McsLock first;
+                McsLock second;
+
+                LockStatistics statistics;
+
+                first.setStatistics(&statistics);
+                second.setStatistics(&statistics);
+
+                for(int i=0; i<N_ROUNDS; ++i) {
+                    first.acquire();
+                    second.acquire();
+
+                    first.release();
+                    second.release();
+                }
+
+                context.assertEquals<long>(2 * N_ROUNDS,
+                    statistics.getAcquisitionCount(), "acquisitions not counted");
+                context.assertEquals<long>(0, statistics.getContendedCount(),
+                    "uncontended acquisition counted as contended");
+
+                // Another thread queues behind the first lock
+                // while this one holds both.
+                long count = 0;
+
+                first.acquire();
+                second.acquire();
+
+                Incrementer incrementer(first, count);
+
+                std::thread thread(&Incrementer::run, &incrementer);
+
+                // Let the other thread queue up, if it can.
+                std::this_thread::yield();
+
+                context.assertEquals<long>(0, count, "lock acquired while held");
+
+                first.release();
+                second.release();
+
+                thread.join();
+
+                context.assertEquals<long>(1, count, "waiter never acquired the lock");
+            }
+
+        private:
+            class Incrementer {
+            public:
+                Incrementer(McsLock& lock, long& count) : lock_(lock), count_(count) {
+                    // ignored
+                }
+
+                void run() {
+                    lock_.acquire();
+                    ++count_;
+                    lock_.release();
+                }
+
+            private: // prevent copying
+                Incrementer(Incrementer const&);
+                Incrementer& operator = (Incrementer const&);
+
+            private:
+                McsLock& lock_;
+                long& count_;
+            };
+        };
+
+        std::type_info const& LockTestSuite::getType() const {
+            return typeid(LockTestSuite);
+        }
+
+        size_t LockTestSuite::nCases() const {
+            return 4;
+        }
+
+        ITestCase* LockTestSuite::newCase(size_t index) const {
+            switch(index) {
+            case 0:
+                return new MutualExclusion<SpinLock>();
+            case 1:
+                return new MutualExclusion<TicketLock>();
+            case 2:
+                return new MutualExclusion<McsLock>();
+            case 3:
+                return new McsLockNesting();
+            default:
+                assert(false);
+                return 0;
+            }
+        }
+    }
+}
\ No newline at end of file
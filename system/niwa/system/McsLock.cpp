@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/McsLock.h"
+
+#include "niwa/system/LockStatistics.h"
+
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+#include <xmmintrin.h>
+
+/**
+ * Waiters yield the processor after this many pauses,
+ * so that a preempted holder can run when the
+ * machine is oversubscribed.
+ */
+#define YIELD_SPINS 4096
+
+namespace niwa {
+    namespace system {
+        struct McsLock::Node {
+            std::atomic<Node*> next;
+
+            std::atomic<bool> isWaiting;
+
+            /**
+             * Link in the free list of the pool.
+             */
+            Node* nextFree;
+        };
+
+        namespace {
+            /**
+             * The queue nodes of a thread. A node is free
+             * again once the lock it queued for is released.
+             */
+            class NodePool {
+            public:
+                NodePool() : free_(NULL) {
+                    // ignored
+                }
+
+                ~NodePool() {
+                    while(free_) {
+                        McsLock::Node* node = free_;
+                        free_ = node->nextFree;
+                        delete node;
+                    }
+                }
+
+                McsLock::Node* get() {
+                    if(!free_) {
+                        return new McsLock::Node();
+                    }
+
+                    McsLock::Node* node = free_;
+                    free_ = node->nextFree;
+                    return node;
+                }
+
+                void put(McsLock::Node* node) {
+                    node->nextFree = free_;
+                    free_ = node;
+                }
+
+            private: // prevent copying
+                NodePool(NodePool const&);
+                NodePool& operator = (NodePool const&);
+
+            private:
+                McsLock::Node* free_;
+            };
+
+            thread_local NodePool tNodePool;
+        }
+
+        McsLock::McsLock() : tail_(NULL), holder_(NULL), statistics_(0) {
+            // ignored
+        }
+
+        void McsLock::acquire() {
+            Node* node = tNodePool.get();
+
+            node->next.store(NULL, std::memory_order_relaxed);
+            node->isWaiting.store(true, std::memory_order_relaxed);
+
+            Node* predecessor = tail_.exchange(node, std::memory_order_acq_rel);
+
+            if(!predecessor) {
+                holder_ = node;
+
+                if(statistics_) {
+                    statistics_->addAcquisition();
+                }
+                return;
+            }
+
+            std::chrono::steady_clock::time_point startTime;
+
+            if(statistics_) {
+                startTime = std::chrono::steady_clock::now();
+            }
+
+            predecessor->next.store(node, std::memory_order_release);
+
+            long nSpins = 0;
+
+            while(node->isWaiting.load(std::memory_order_acquire)) {
+                if(nSpins < YIELD_SPINS) {
+                    _mm_pause();
+                    ++nSpins;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+
+            holder_ = node;
+
+            if(statistics_) {
+                std::chrono::duration<double> waitTime =
+                    std::chrono::steady_clock::now() - startTime;
+
+                statistics_->addContendedAcquisition(nSpins, waitTime.count());
+            }
+        }
+
+        void McsLock::release() {
+            Node* node = holder_;
+
+            Node* successor = node->next.load(std::memory_order_acquire);
+
+            if(!successor) {
+                Node* expected = node;
+
+                if(tail_.compare_exchange_strong(
+                        expected, NULL, std::memory_order_acq_rel)) {
+                    tNodePool.put(node);
+                    return;
+                }
+
+                // A thread has queued but not yet linked itself.
+                while(!(successor = node->next.load(std::memory_order_acquire))) {
+                    std::this_thread::yield();
+                }
+            }
+
+            successor->isWaiting.store(false, std::memory_order_release);
+
+            tNodePool.put(node);
+        }
+
+        void McsLock::setStatistics(LockStatistics* statistics) {
+            statistics_ = statistics;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_MCSLOCK_H
+#define NIWA_SYSTEM_MCSLOCK_H
+
+#include "ILock.h"
+
+#include <atomic>
+
+namespace niwa {
+    namespace system {
+        class LockStatistics;
+
+        /**
+         * A non-reentrant, fair queue lock (Mellor-Crummey and
+         * Scott). Each waiter spins on a flag of its own, so a
+         * release touches only the next waiter's cache line, no
+         * matter how many threads wait. The queue nodes come
+         * from a per-thread pool, so the lock must be released
+         * by the thread that acquired it.
+         */
+        class McsLock : public ILock {
+        public:
+            /**
+             * Queue entry of a thread; defined privately.
+             */
+            struct Node;
+
+        public:
+            McsLock();
+
+            void acquire();
+
+            void release();
+
+            /**
+             * @param statistics The counters to update, or
+             *                   NULL (the default) for none.
+             *                   Must outlive the lock's use.
+             */
+            void setStatistics(LockStatistics* statistics);
+
+        private: // prevent copying
+            McsLock(McsLock const&);
+            McsLock& operator = (McsLock const&);
+
+        private:
+            /**
+             * The last thread in the queue, or NULL if unlocked.
+             */
+            std::atomic<Node*> tail_;
+
+            /**
+             * The node of the holder; only the holder uses it.
+             */
+            Node* holder_;
+
+            LockStatistics* statistics_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -7,58 +7,115 @@
 
 #include "niwa/system/NiwaParallelizer.h"
 
+#include "niwa/system/CpuTopology.h"
 #include "niwa/system/SingleThreadedParallelizer.h"
-#include "niwa/system/ProcessorInfo.h"
 
 #include "niwa/logging/Logger.h"
 
-#include <winnt.h>
-
 #include <algorithm>
+#include <chrono>
 #include <limits>
 #include <cmath>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
 
-namespace {
-    /**
-     * Some MSVC distributions don't have InterlockedAdd,
-     * so we'll define our own.
-     */
-    static __forceinline DWORD NiwaInterlockedAdd(LONG volatile* addend, LONG term) {
-        LONG v;
+/**
+ * Each chunk takes this fraction of the remaining
+ * indices divided by the number of threads.
+ */
+#define GUIDED_DIVISOR 2
 
-        do {
-            v = *addend;
-        } while(v != InterlockedCompareExchange(addend, v+term, v));
+/**
+ * Chunks should take at least this long,
+ * so that the shared counter is not contended.
+ */
+#define MIN_CHUNK_NANOSECONDS 20000.0
 
-        return v + term;
-    }
-}
+/**
+ * Weight of the latest measurement in the cost history.
+ */
+#define COST_SMOOTHING 0.5
 
 namespace niwa {
     namespace system {
         static logging::Logger logger(typeid(NiwaParallelizer));
 
+        namespace {
+            static double fSecondsBetween(
+                    std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end) {
+                return std::chrono::duration<double>(end - start).count();
+            }
+        }
+
+        struct NiwaParallelizer::Counters {
+            Counters();
+
+            /**
+             * Allocates counters on pages of their own on the
+             * NUMA node of the calling thread, which touches
+             * them first; so the counters of different threads
+             * never share a cache line. Falls back to the heap
+             * if the pages cannot be mapped.
+             */
+            static Counters* create();
+
+            /**
+             * Frees counters from create(); NULL is ignored.
+             */
+            static void destroy(Counters* counters);
+
+            void reset();
+
+            /**
+             * Whether the counters are on pages
+             * of their own rather than the heap.
+             */
+            bool isMapped;
+
+            long nIterations;
+
+            long nChunks;
+
+            double busySeconds;
+
+            double idleSeconds;
+
+            LatencyHistogram chunkTimes;
+        };
+
         class NiwaParallelizer::WorkerTask {
         public:
-            WorkerTask(ICallback& callback, int start, int end, int stride);
+            /**
+             * @param minChunk The smallest chunk handed out.
+             *
+             * @param nThreads Number of threads running the task.
+             */
+            WorkerTask(
+                IRangeCallback& callback, int start, int end,
+                int minChunk, int nThreads);
 
             /**
-             * @return The number of iterations completed.
+             * Takes chunks until the loop is done.
              */
-            long run();
+            void run(Counters& counters);
 
         private: // prevent copying
             WorkerTask(WorkerTask const&);
             WorkerTask& operator = (WorkerTask const&);
 
         private:
-            ICallback& callback_;
+            IRangeCallback& callback_;
 
-            LONG volatile position_;
+            std::atomic<int> position_;
 
             int end_;
 
-            int stride_;
+            int minChunk_;
+
+            int nThreads_;
         };
 
         class NiwaParallelizer::Worker {
@@ -69,22 +126,26 @@ namespace niwa {
             /**
              * Second-phase construction.
              *
+             * @param index The index of the worker; its counters
+             *              are the parent's counters_[1+index].
+             *
+             * @param processorId The processor to pin the
+             *                    thread to, or -1 for none.
+             *
              * @return Whether the worker could be constructed.
              */
-            bool construct(NiwaParallelizer* parent);
+            bool construct(NiwaParallelizer* parent, int index, int processorId);
 
             void run();
 
-            static DWORD WINAPI runStatic(void* worker);
-
-            int getIterationsCompleted() const;
         private:
             NiwaParallelizer* parent_;
 
-            HANDLE thread_;
-            DWORD threadId_;
+            int index_;
+
+            int processorId_;
 
-            long nIterationsCompleted_;
+            std::thread thread_;
         };
 
         void NiwaParallelizer::loop(ICallback& callback, int start, int end) {
@@ -92,23 +153,105 @@ namespace niwa {
         }
 
         void NiwaParallelizer::loop(ICallback& callback, int start, int end, int stride) {
-            WorkerTask task(callback, start, end, stride);
+            CallbackAdapter adapter(callback);
+
+            loopRange(adapter, start, end, stride, typeid(callback));
+        }
+
+        void NiwaParallelizer::loopRange(IRangeCallback& callback, int start, int end, int stride) {
+            loopRange(callback, start, end, stride, typeid(callback));
+        }
+
+        bool NiwaParallelizer::SiteLess::operator () (
+                std::type_info const* lhs, std::type_info const* rhs) const {
+            return lhs->before(*rhs) != 0;
+        }
+
+        void NiwaParallelizer::loopRange(
+                IRangeCallback& callback, int start, int end, int stride,
+                std::type_info const& site) {
+            if(start >= end) {
+                return;
+            }
+
+            int const nThreads = 1 + nWorkers_;
+
+            int const nIndices = end - start;
+
+            int minChunk = std::max(stride, 1);
+
+            std::map<std::type_info const*, double, SiteLess>::iterator cost =
+                siteCosts_.find(&site);
+
+            if(cost != siteCosts_.end() && cost->second > 0) {
+                // Never beyond the first guided chunk, to keep the loop parallel.
+                double const costChunk = std::min(
+                    MIN_CHUNK_NANOSECONDS / cost->second,
+                    static_cast<double>(nIndices / (GUIDED_DIVISOR * nThreads)));
+
+                minChunk = std::max(minChunk, static_cast<int>(costChunk));
+            }
+
+            WorkerTask task(callback, start, end, minChunk, nThreads);
+
+            std::chrono::steady_clock::time_point const startTime =
+                std::chrono::steady_clock::now();
+
+            dispatch(&task);
+
+            double const seconds = fSecondsBetween(
+                startTime, std::chrono::steady_clock::now());
+
+            loopTimes_.add(seconds);
+
+            double const nanoseconds = seconds * 1e9;
+
+            // Wall time over all threads; includes the dispatch.
+            double const indexCost = nanoseconds * nThreads / nIndices;
+
+            if(cost != siteCosts_.end()) {
+                cost->second += COST_SMOOTHING * (indexCost - cost->second);
+            } else {
+                siteCosts_[&site] = indexCost;
+            }
+        }
+
+        void NiwaParallelizer::dispatch(WorkerTask* task) {
+            currentTask_.store(task);
+            nActiveWorkers_.store(nWorkers_);
+
+            taskGeneration_.fetchAdd(1);
+            taskGeneration_.wakeAll();
+
+            std::chrono::steady_clock::time_point const runTime =
+                std::chrono::steady_clock::now();
+
+            if(task) {
+                task->run(*counters_[0]); // Let calling thread participate in task.
+            }
 
-            currentTask_ = &task;
-            nActiveWorkers_ = nWorkers_;
+            std::chrono::steady_clock::time_point const waitTime =
+                std::chrono::steady_clock::now();
 
-            SetEvent(taskRunningEvent_);
+            int nActive;
 
-            nIterationsCompleted_ += task.run(); // Let calling thread participate in task.
+            while((nActive = nActiveWorkers_.load()) != 0) {
+                nActiveWorkers_.wait(nActive);
+            }
 
-            WaitForSingleObject(taskCompletedEvent_, INFINITE);
-            ResetEvent(taskCompletedEvent_);
+            counters_[0]->busySeconds += fSecondsBetween(runTime, waitTime);
+            counters_[0]->idleSeconds += fSecondsBetween(
+                waitTime, std::chrono::steady_clock::now());
         }
 
         IParallelizer* NiwaParallelizer::create() {
+            return create(PIN_NONE);
+        }
+
+        IParallelizer* NiwaParallelizer::create(PinningPolicy policy) {
             NiwaParallelizer* self = new NiwaParallelizer();
 
-            if(self->construct()) {
+            if(self->construct(policy)) {
                 return self;
             } else {
                 delete self;
@@ -117,147 +260,271 @@ namespace niwa {
         }
 
         NiwaParallelizer::NiwaParallelizer() 
-            : taskRunningEvent_(0),
-              taskCompletedEvent_(0),
-              nIterationsCompleted_(0) {
-            ProcessorInfo info = ProcessorInfo::create();
+            : taskGeneration_(0),
+              nActiveWorkers_(0),
+              currentTask_(NULL) {
+            // Zero if the count is unknown.
+            int nProcessors = static_cast<int>(std::thread::hardware_concurrency());
 
-            nWorkers_ = info.getLogicalProcessorCount() - 1;
+            nWorkers_ = std::max(nProcessors, 1) - 1;
 
             workers_ = new NiwaParallelizer::Worker[nWorkers_];
+
+            counters_ = new Counters*[1 + nWorkers_];
+
+            std::fill(counters_, counters_ + 1 + nWorkers_, static_cast<Counters*>(NULL));
         }
 
         NiwaParallelizer::~NiwaParallelizer() {
             // Run a poison pill task.
+            dispatch(NULL);
 
-            currentTask_ = NULL;
-            nActiveWorkers_ = nWorkers_;
-            SetEvent(taskRunningEvent_);
-
-            WaitForSingleObject(taskCompletedEvent_, INFINITE);
-            ResetEvent(taskCompletedEvent_);
-
-            // Log balance factor before deleting workers.
-            logger.debug() << "balance factor: " << getBalanceFactor();
+            // Log the statistics before deleting workers.
+            logger.debug() << getStatistics();
 
             delete[] workers_;
 
-            if(taskRunningEvent_) {
-                CloseHandle(taskRunningEvent_);
-            }
-            if(taskCompletedEvent_) {
-                CloseHandle(taskCompletedEvent_);
+            for(int i=0; i<1+nWorkers_; ++i) {
+                Counters::destroy(counters_[i]);
             }
+
+            delete[] counters_;
         }
 
-        bool NiwaParallelizer::construct() {
-            // Manual reset, initially not set.
-            taskRunningEvent_ = CreateEvent(0, TRUE, FALSE, 0);
+        bool NiwaParallelizer::construct(PinningPolicy policy) {
+            // Slot zero of the placement is the calling thread's.
+            std::vector<int> placement = CpuTopology::create().getPlacement(
+                policy, nWorkers_ + 1);
 
-            // Manual reset, initially not set.
-            taskCompletedEvent_ = CreateEvent(0, TRUE, FALSE, 0);
+            counters_[0] = Counters::create();
 
-            for(int i=0; i<nWorkers_; ++i) {
-                if(!workers_[i].construct(this)) {
-                    return false;
+            bool isConstructed = true;
+
+            // The workers count themselves down once their
+            // counters are allocated; reuses the rendezvous.
+            for(int i=0; i<nWorkers_ && isConstructed; ++i) {
+                int processorId = placement.empty() ? -1 : placement[i+1];
+
+                nActiveWorkers_.fetchAdd(1);
+
+                if(!workers_[i].construct(this, i, processorId)) {
+                    nActiveWorkers_.fetchAdd(-1);
+
+                    // Only the started workers take the poison pill.
+                    nWorkers_ = i;
+                    isConstructed = false;
                 }
             }
 
-            return taskRunningEvent_ && taskCompletedEvent_;
-        }
+            int nActive;
+
+            while((nActive = nActiveWorkers_.load()) != 0) {
+                nActiveWorkers_.wait(nActive);
+            }
 
-        DWORD WINAPI NiwaParallelizer::Worker::runStatic(void* worker) {
-            static_cast<Worker*>(worker)->run();
-            return 0;
+            return isConstructed;
         }
 
         NiwaParallelizer::Worker::Worker() 
-            : parent_(0), thread_(0),
-              nIterationsCompleted_(0) {
+            : parent_(0),
+              index_(0),
+              processorId_(-1) {
             // ignored
         }
 
-        bool NiwaParallelizer::Worker::construct(NiwaParallelizer* parent) {
+        bool NiwaParallelizer::Worker::construct(
+                NiwaParallelizer* parent, int index, int processorId) {
             parent_ = parent;
+            index_ = index;
+            processorId_ = processorId;
 
             // It's best to create the thread last:
             // this way non-successful construction
             // implies that the thread is never started.
-            thread_ = CreateThread(
-                0, // security
-                0, // stack size
-                Worker::runStatic, // thread function
-                this, // thread function argument
-                0,
-                &threadId_);
-
-            return thread_ != 0;
+            try {
+                thread_ = std::thread(&Worker::run, this);
+            } catch(std::system_error const&) {
+                return false;
+            }
+
+            return true;
         }
 
         NiwaParallelizer::Worker::~Worker() {
-            if(thread_) {
-                WaitForSingleObject(thread_, INFINITE);
-
-                CloseHandle(thread_);
+            if(thread_.joinable()) {
+                thread_.join();
             }
         }
 
         void NiwaParallelizer::Worker::run() {
+            if(processorId_ >= 0 && !CpuTopology::pinCurrentThread(processorId_)) {
+                logger.warn() << "could not pin worker to processor " << processorId_;
+            }
+
+            // Allocated after pinning, to land on the worker's node.
+            Counters* counters = Counters::create();
+
+            parent_->counters_[1+index_] = counters;
+
+            if(parent_->nActiveWorkers_.fetchAdd(-1) == 1) {
+                parent_->nActiveWorkers_.wakeAll();
+            }
+
+            int generation = 0;
+
             bool isRunning = true;
 
+            std::chrono::steady_clock::time_point idleTime =
+                std::chrono::steady_clock::now();
+
             while(isRunning) {
-                // TODO: this used to be WaitForSingleObject, but it lead to crashes
-                // XXX: it's WaitForSingleObject again, since WaitForMultipleObjects didn't compile
-                WaitForSingleObject(parent_->taskRunningEvent_, INFINITE); // error ignored
+                int nextGeneration;
+
+                while((nextGeneration = parent_->taskGeneration_.load()) == generation) {
+                    parent_->taskGeneration_.wait(generation);
+                }
+
+                generation = nextGeneration;
 
-                if(parent_->currentTask_ != NULL) {
-                    nIterationsCompleted_ += parent_->currentTask_->run();
+                std::chrono::steady_clock::time_point const runTime =
+                    std::chrono::steady_clock::now();
+
+                counters->idleSeconds += fSecondsBetween(idleTime, runTime);
+
+                WorkerTask* task = parent_->currentTask_.load();
+
+                if(task != NULL) {
+                    task->run(*counters);
                 } else {
                     // poison pill
                     isRunning = false;
                 }
 
-                if( InterlockedDecrement(&parent_->nActiveWorkers_) == 0 ) {
-                    parent_->currentTask_ = NULL;
+                idleTime = std::chrono::steady_clock::now();
+
+                // The counters must be written before the
+                // rendezvous, after which they may be read.
+                counters->busySeconds += fSecondsBetween(runTime, idleTime);
 
-                    ResetEvent(parent_->taskRunningEvent_);
-                    SetEvent(parent_->taskCompletedEvent_);
+                if(parent_->nActiveWorkers_.fetchAdd(-1) == 1) {
+                    parent_->nActiveWorkers_.wakeAll();
                 }
             }
         }
 
-        NiwaParallelizer::WorkerTask::WorkerTask(ICallback& callback, int start, int end, int stride)
-            : callback_(callback), position_(start - stride), end_(end), stride_(stride) {
+        NiwaParallelizer::WorkerTask::WorkerTask(
+                IRangeCallback& callback, int start, int end,
+                int minChunk, int nThreads)
+            : callback_(callback), position_(start), end_(end),
+              minChunk_(minChunk), nThreads_(nThreads) {
             // ignored
         }
 
-        long NiwaParallelizer::WorkerTask::run() {
-            long nIterationsCompleted = 0;
+        void NiwaParallelizer::WorkerTask::run(Counters& counters) {
+            int next = position_.load();
 
-            LONG next;
+            while(next < end_) {
+                int const chunk = std::max(
+                    minChunk_, (end_ - next) / (GUIDED_DIVISOR * nThreads_));
 
-            while((next = NiwaInterlockedAdd(&position_,stride_)) < end_) {
-                int jEnd = std::min<LONG>(end_, next + stride_);
+                int const chunkEnd = std::min(end_, next + chunk);
 
-                for(int j=next; j<jEnd; ++j) {
-                    callback_.invoke(j);
+                // On failure, next is updated to the current position.
+                if(position_.compare_exchange_weak(next, chunkEnd)) {
+                    std::chrono::steady_clock::time_point const chunkTime =
+                        std::chrono::steady_clock::now();
+
+                    callback_.invokeRange(next, chunkEnd);
+
+                    counters.chunkTimes.add(fSecondsBetween(
+                        chunkTime, std::chrono::steady_clock::now()));
+
+                    counters.nIterations += chunkEnd - next;
+                    ++counters.nChunks;
+
+                    next = position_.load();
                 }
+            }
+        }
+
+        NiwaParallelizer::Counters::Counters() 
+            : isMapped(false) {
+            reset();
+        }
+
+        NiwaParallelizer::Counters* NiwaParallelizer::Counters::create() {
+            void* memory = CpuTopology::allocateOnNode(
+                sizeof(Counters), CpuTopology::getCurrentNode());
+
+            if(!memory) {
+                Counters* counters = new Counters();
+                counters->isMapped = false;
+                return counters;
+            }
+
+            Counters* counters = new (memory) Counters();
+            counters->isMapped = true;
+            return counters;
+        }
+
+        void NiwaParallelizer::Counters::destroy(Counters* counters) {
+            if(!counters) {
+                return;
+            }
+
+            if(counters->isMapped) {
+                counters->~Counters();
+
+                CpuTopology::freeOnNode(counters, sizeof(Counters));
+            } else {
+                delete counters;
+            }
+        }
+
+        void NiwaParallelizer::Counters::reset() {
+            nIterations = 0;
+            nChunks = 0;
+            busySeconds = 0;
+            idleSeconds = 0;
+            chunkTimes.reset();
+        }
+
+        ParallelizerStatistics NiwaParallelizer::getStatistics() const {
+            ParallelizerStatistics statistics;
+
+            statistics.loopTimes = loopTimes_;
+
+            for(int i=0; i<1+nWorkers_; ++i) {
+                ThreadStatistics thread;
+
+                thread.nIterations = counters_[i]->nIterations;
+                thread.nChunks = counters_[i]->nChunks;
+                thread.busySeconds = counters_[i]->busySeconds;
+                thread.idleSeconds = counters_[i]->idleSeconds;
 
-                ++nIterationsCompleted;
+                statistics.threads.push_back(thread);
+
+                statistics.chunkTimes.merge(counters_[i]->chunkTimes);
             }
 
-            return nIterationsCompleted;
+            statistics.balanceFactor = getBalanceFactor();
+
+            return statistics;
         }
 
-        int NiwaParallelizer::Worker::getIterationsCompleted() const {
-            return nIterationsCompleted_;
+        void NiwaParallelizer::resetStatistics() {
+            for(int i=0; i<1+nWorkers_; ++i) {
+                counters_[i]->reset();
+            }
+
+            loopTimes_.reset();
         }
 
         double NiwaParallelizer::getBalanceFactor() const {
-            long nTotalIterations = nIterationsCompleted_;
+            long nTotalIterations = 0;
 
-            for(int i=0; i<nWorkers_; ++i) {
-                nTotalIterations += workers_[i].getIterationsCompleted();
+            for(int i=0; i<1+nWorkers_; ++i) {
+                nTotalIterations += counters_[i]->nIterations;
             }
 
             if(nTotalIterations == 0) {
@@ -266,16 +533,8 @@ namespace niwa {
 
             double entropy = 0;
 
-            if(nIterationsCompleted_ != 0) {
-                double p = 
-                    nIterationsCompleted_ 
-                    / static_cast<double>(nTotalIterations);
-
-                entropy -= p * log(p);
-            }
-
-            for(int i=0; i<nWorkers_; ++i) {
-                double p = workers_[i].getIterationsCompleted()
+            for(int i=0; i<1+nWorkers_; ++i) {
+                double p = counters_[i]->nIterations
                     / static_cast<double>(nTotalIterations);
 
                 if(p != 0) {
@@ -7,6 +7,8 @@
 
 #include "niwa/system/OpenMpParallelizer.h"
 
+#include <algorithm>
+
 namespace niwa {
     namespace system {
         OpenMpParallelizer::OpenMpParallelizer() {
@@ -34,5 +36,17 @@ namespace niwa {
                 callback.invoke(i);
             }
         }
+
+        void OpenMpParallelizer::loopRange(
+                IRangeCallback& callback, int start, int end, int stride) {
+            int const nRanges = (end - start + stride - 1) / stride;
+
+#pragma omp parallel for
+            for(int i=0; i<nRanges; ++i) {
+                int const begin = start + i * stride;
+
+                callback.invokeRange(begin, std::min(end, begin + stride));
+            }
+        }
     }
 }
\ No newline at end of file
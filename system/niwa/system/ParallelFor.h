@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PARALLELFOR_H
+#define NIWA_SYSTEM_PARALLELFOR_H
+
+#include "IParallelizer.h"
+
+namespace niwa {
+    namespace system {
+        /**
+         * Runs body(i) for each index in parallel. Only one
+         * virtual call is made per range; within a range, the
+         * body is called directly and can be inlined, e.g.:
+         *
+         *     parallelFor(parallelizer, 0, n, 64, [&](int i) {
+         *         y[i] += a * x[i];
+         *     });
+         *
+         * @param start Start index of the loop (inclusive).
+         * @param end End index of the loop (exclusive).
+         * @param stride Granularity for parallelization.
+         * @param body Called with each index, possibly
+         *             from several threads at once.
+         */
+        template<typename Body>
+        void parallelFor(
+            IParallelizer& parallelizer,
+            int start, int end, int stride,
+            Body const& body);
+
+        /**
+         * Runs body(begin, end) for ranges covering
+         * the indices in parallel, for bodies that
+         * handle a range better than single indices.
+         *
+         * @param stride Granularity for parallelization; the
+         *               range lengths depend on the parallelizer
+         *               (see IParallelizer::loopRange). The task
+         *               scheduler and the single-threaded
+         *               parallelizer give ranges of at most stride
+         *               indices; NiwaParallelizer gives guided
+         *               ranges of at least stride indices, except
+         *               at the end of the loop.
+         */
+        template<typename Body>
+        void parallelForRange(
+            IParallelizer& parallelizer,
+            int start, int end, int stride,
+            Body const& body);
+    }
+}
+
+#include "ParallelFor.inl"
+
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PARALLELFOR_INL
+#define NIWA_SYSTEM_PARALLELFOR_INL
+
+namespace niwa {
+    namespace system {
+        template<typename Body>
+        class ParallelForCallback : public IParallelizer::IRangeCallback {
+        public:
+            explicit ParallelForCallback(Body const& body) : body_(body) {
+                // ignored
+            }
+
+            void __fastcall invokeRange(int begin, int end) {
+                for(int i=begin; i<end; ++i) {
+                    body_(i);
+                }
+            }
+
+        private: // prevent copying
+            ParallelForCallback(ParallelForCallback const&);
+            ParallelForCallback& operator = (ParallelForCallback const&);
+
+        private:
+            Body const& body_;
+        };
+
+        template<typename Body>
+        class ParallelForRangeCallback : public IParallelizer::IRangeCallback {
+        public:
+            explicit ParallelForRangeCallback(Body const& body) : body_(body) {
+                // ignored
+            }
+
+            void __fastcall invokeRange(int begin, int end) {
+                body_(begin, end);
+            }
+
+        private: // prevent copying
+            ParallelForRangeCallback(ParallelForRangeCallback const&);
+            ParallelForRangeCallback& operator = (ParallelForRangeCallback const&);
+
+        private:
+            Body const& body_;
+        };
+
+        template<typename Body>
+        void parallelFor(
+                IParallelizer& parallelizer,
+                int start, int end, int stride,
+                Body const& body) {
+            ParallelForCallback<Body> callback(body);
+
+            parallelizer.loopRange(callback, start, end, stride);
+        }
+
+        template<typename Body>
+        void parallelForRange(
+                IParallelizer& parallelizer,
+                int start, int end, int stride,
+                Body const& body) {
+            ParallelForRangeCallback<Body> callback(body);
+
+            parallelizer.loopRange(callback, start, end, stride);
+        }
+    }
+}
+
+#endif
\ No newline at end of file
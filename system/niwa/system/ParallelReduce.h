@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PARALLELREDUCE_H
+#define NIWA_SYSTEM_PARALLELREDUCE_H
+
+#include "IParallelizer.h"
+
+namespace niwa {
+    namespace system {
+        /**
+         * Reduces the indices in parallel. The indices are split
+         * into blocks of exactly stride indices (the last block
+         * may be shorter; strides below one count as one); each
+         * block is reduced by a single call to the body, and the
+         * block results are combined in index order. So the result
+         * depends on the stride but not on the parallelizer or the
+         * thread timing, even for non-associative operations like
+         * floating-point sums:
+         *
+         *     float dot = parallelReduce(parallelizer, 0, n, 1024, 0.0f,
+         *         DotBody(x, y), std::plus<float>());
+         *
+         * @param identity The identity element of the combination.
+         * @param body Called as body(begin, end) and returns the
+         *             reduction of the block, possibly from several
+         *             threads at once.
+         * @param combine Called as combine(lhs, rhs), where lhs
+         *                covers the indices before rhs.
+         */
+        template<typename T, typename Body, typename Combine>
+        T parallelReduce(
+            IParallelizer& parallelizer,
+            int start, int end, int stride,
+            T const& identity,
+            Body const& body,
+            Combine const& combine);
+
+        /**
+         * An exclusive prefix scan in two passes over blocks of
+         * stride indices, for example for compacting output:
+         * the first pass counts the items of each block, and the
+         * second writes them at the offset of the block.
+         *
+         * The block reductions are scanned in index order, so the
+         * prefixes are deterministic like those of parallelReduce.
+         *
+         * @param body Called as body(begin, end) and returns the
+         *             reduction of the block.
+         * @param scan Called as scan(begin, end, prefix), where the
+         *             prefix is the reduction of the indices from
+         *             start to begin (exclusive).
+         *
+         * @return The reduction of all indices.
+         */
+        template<typename T, typename Body, typename Combine, typename Scan>
+        T parallelScan(
+            IParallelizer& parallelizer,
+            int start, int end, int stride,
+            T const& identity,
+            Body const& body,
+            Combine const& combine,
+            Scan const& scan);
+    }
+}
+
+#include "ParallelReduce.inl"
+
+#endif
\ No newline at end of file
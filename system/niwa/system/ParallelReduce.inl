@@ -0,0 +1,185 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PARALLELREDUCE_INL
+#define NIWA_SYSTEM_PARALLELREDUCE_INL
+
+#include <algorithm>
+#include <vector>
+
+namespace niwa {
+    namespace system {
+        /**
+         * The padding keeps the partials a cache line
+         * apart, so that no two blocks write the same line.
+         */
+        template<typename T>
+        struct PaddedPartial {
+            T value;
+
+            char padding[64];
+        };
+
+        /**
+         * Stores the reduction of each block.
+         */
+        template<typename T, typename Body>
+        class ParallelReduceCallback : public IParallelizer::IRangeCallback {
+        public:
+            ParallelReduceCallback(
+                    Body const& body, int start, int end, int stride,
+                    std::vector<PaddedPartial<T> >& partials)
+                : body_(body),
+                  start_(start),
+                  end_(end),
+                  stride_(stride),
+                  partials_(partials) {
+                // ignored
+            }
+
+            void __fastcall invokeRange(int begin, int end) {
+                for(int i=begin; i<end; ++i) {
+                    int blockBegin = start_ + i * stride_;
+                    int blockEnd = end_ - blockBegin > stride_ ? blockBegin + stride_ : end_;
+
+                    partials_[i].value = body_(blockBegin, blockEnd);
+                }
+            }
+
+        private: // prevent copying
+            ParallelReduceCallback(ParallelReduceCallback const&);
+            ParallelReduceCallback& operator = (ParallelReduceCallback const&);
+
+        private:
+            Body const& body_;
+
+            int start_;
+            int end_;
+            int stride_;
+
+            std::vector<PaddedPartial<T> >& partials_;
+        };
+
+        /**
+         * Scans each block from its prefix.
+         */
+        template<typename T, typename Scan>
+        class ParallelScanCallback : public IParallelizer::IRangeCallback {
+        public:
+            ParallelScanCallback(
+                    Scan const& scan, int start, int end, int stride,
+                    std::vector<PaddedPartial<T> > const& prefixes)
+                : scan_(scan),
+                  start_(start),
+                  end_(end),
+                  stride_(stride),
+                  prefixes_(prefixes) {
+                // ignored
+            }
+
+            void __fastcall invokeRange(int begin, int end) {
+                for(int i=begin; i<end; ++i) {
+                    int blockBegin = start_ + i * stride_;
+                    int blockEnd = end_ - blockBegin > stride_ ? blockBegin + stride_ : end_;
+
+                    scan_(blockBegin, blockEnd, prefixes_[i].value);
+                }
+            }
+
+        private: // prevent copying
+            ParallelScanCallback(ParallelScanCallback const&);
+            ParallelScanCallback& operator = (ParallelScanCallback const&);
+
+        private:
+            Scan const& scan_;
+
+            int start_;
+            int end_;
+            int stride_;
+
+            std::vector<PaddedPartial<T> > const& prefixes_;
+        };
+
+        template<typename T, typename Body, typename Combine>
+        T parallelReduce(
+                IParallelizer& parallelizer,
+                int start, int end, int stride,
+                T const& identity,
+                Body const& body,
+                Combine const& combine) {
+            if(end <= start) {
+                return identity;
+            }
+
+            stride = std::max(stride, 1);
+
+            int nBlocks = (end - start + stride - 1) / stride;
+
+            PaddedPartial<T> initial;
+            initial.value = identity;
+
+            std::vector<PaddedPartial<T> > partials(nBlocks, initial);
+
+            ParallelReduceCallback<T, Body> callback(body, start, end, stride, partials);
+
+            parallelizer.loopRange(callback, 0, nBlocks, 1);
+
+            T result = identity;
+
+            for(int i=0; i<nBlocks; ++i) {
+                result = combine(result, partials[i].value);
+            }
+
+            return result;
+        }
+
+        template<typename T, typename Body, typename Combine, typename Scan>
+        T parallelScan(
+                IParallelizer& parallelizer,
+                int start, int end, int stride,
+                T const& identity,
+                Body const& body,
+                Combine const& combine,
+                Scan const& scan) {
+            if(end <= start) {
+                return identity;
+            }
+
+            stride = std::max(stride, 1);
+
+            int nBlocks = (end - start + stride - 1) / stride;
+
+            PaddedPartial<T> initial;
+            initial.value = identity;
+
+            std::vector<PaddedPartial<T> > partials(nBlocks, initial);
+
+            ParallelReduceCallback<T, Body> reduceCallback(body, start, end, stride, partials);
+
+            parallelizer.loopRange(reduceCallback, 0, nBlocks, 1);
+
+            // Turn the block reductions into exclusive prefixes.
+            T total = identity;
+
+            for(int i=0; i<nBlocks; ++i) {
+                T blockValue = partials[i].value;
+
+                partials[i].value = total;
+
+                total = combine(total, blockValue);
+            }
+
+            ParallelScanCallback<T, Scan> scanCallback(scan, start, end, stride, partials);
+
+            parallelizer.loopRange(scanCallback, 0, nBlocks, 1);
+
+            return total;
+        }
+    }
+}
+
+#endif
\ No newline at end of file
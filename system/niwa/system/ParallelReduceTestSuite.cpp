@@ -0,0 +1,298 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "ParallelReduceTestSuite.h"
+
+#include "niwa/testing/ITestCase.h"
+#include "niwa/testing/ITestContext.h"
+
+using niwa::testing::ITestCase;
+using niwa::testing::ITestContext;
+
+#include "ParallelReduce.h"
+#include "NiwaParallelizer.h"
+#include "SingleThreadedParallelizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace {
+    /**
+     * Records the end of the block that starts at each index,
+     * and reduces a block to its length.
+     */
+    class BlockBody {
+    public:
+        BlockBody(int start, std::vector<int>& blockEnds)
+            : start_(start), blockEnds_(blockEnds) {
+            // ignored
+        }
+
+        int operator () (int begin, int end) const {
+            blockEnds_[begin - start_] = end;
+            return end - begin;
+        }
+
+    private:
+        int start_;
+
+        std::vector<int>& blockEnds_;
+    };
+
+    /**
+     * Sums a block of values.
+     */
+    template<typename T>
+    class SumBody {
+    public:
+        explicit SumBody(std::vector<T> const& values) : values_(values) {
+            // ignored
+        }
+
+        T operator () (int begin, int end) const {
+            T sum = 0;
+
+            for(int i=begin; i<end; ++i) {
+                sum += values_[i];
+            }
+
+            return sum;
+        }
+
+    private:
+        std::vector<T> const& values_;
+    };
+
+    /**
+     * Writes the exclusive prefix sums of a block.
+     */
+    class PrefixScan {
+    public:
+        PrefixScan(std::vector<int> const& values, std::vector<int>& prefixes)
+            : values_(values), prefixes_(prefixes) {
+            // ignored
+        }
+
+        void operator () (int begin, int end, int prefix) const {
+            for(int i=begin; i<end; ++i) {
+                prefixes_[i] = prefix;
+                prefix += values_[i];
+            }
+        }
+
+    private:
+        std::vector<int> const& values_;
+
+        std::vector<int>& prefixes_;
+    };
+}
+
+namespace niwa {
+    namespace system {
+        /**
+         * Empty and reversed ranges reduce to the identity
+         * without calling the body or the scan.
+         */
+        class ReduceEmptyRange : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(ReduceEmptyRange);
+            }
+
+            void test(ITestContext& context) const {
+                std::auto_ptr<IParallelizer> parallelizer(
+                    SingleThreadedParallelizer::create());
+
+                std::vector<int> blockEnds(1, -1);
+                std::vector<int> prefixes(1, -1);
+
+                BlockBody const body(0, blockEnds);
+                PrefixScan const scan(blockEnds, prefixes);
+
+                context.assertEquals<int>(7, parallelReduce(
+                    *parallelizer, 5, 5, 4, 7, body, std::plus<int>()),
+                    "empty reduction not the identity");
+
+                context.assertEquals<int>(7, parallelReduce(
+                    *parallelizer, 5, 2, 4, 7, body, std::plus<int>()),
+                    "reversed reduction not the identity");
+
+                context.assertEquals<int>(7, parallelScan(
+                    *parallelizer, 5, 5, 4, 7, body, std::plus<int>(), scan),
+                    "empty scan not the identity");
+
+                context.assertEquals<int>(-1, blockEnds[0], "body called");
+                context.assertEquals<int>(-1, prefixes[0], "scan called");
+            }
+        };
+
+        /**
+         * The blocks are exactly stride indices long, but for
+         * a shorter last block; strides below one count as one.
+         */
+        class ReduceBlocks : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(ReduceBlocks);
+            }
+
+            void test(ITestContext& context) const {
+                std::auto_ptr<IParallelizer> parallelizer(NiwaParallelizer::create());
+
+                // The last block has four indices.
+                testBlocks(context, *parallelizer, 3, 103, 16, 16);
+
+                // The last block is full.
+                testBlocks(context, *parallelizer, 0, 96, 16, 16);
+
+                testBlocks(context, *parallelizer, 3, 20, 0, 1);
+                testBlocks(context, *parallelizer, 3, 20, -5, 1);
+
+                // A single, short block.
+                testBlocks(context, *parallelizer, 3, 5, 100, 100);
+            }
+
+        private:
+            static void testBlocks(
+                    ITestContext& context, IParallelizer& parallelizer,
+                    int start, int end, int stride, int expectedStride) {
+                std::vector<int> blockEnds(end - start, -1);
+
+                int const nIndices = parallelReduce(
+                    parallelizer, start, end, stride, 0,
+                    BlockBody(start, blockEnds), std::plus<int>());
+
+                context.assertEquals<int>(end - start, nIndices,
+                    "blocks do not cover the indices");
+
+                for(int i=start; i<end; ++i) {
+                    int const expected = (i - start) % expectedStride == 0
+                        ? std::min(i + expectedStride, end) : -1;
+
+                    context.assertEquals<int>(expected, blockEnds[i - start],
+                        "wrong block boundaries");
+                }
+            }
+        };
+
+        /**
+         * The scan gives each index the sum of the
+         * values before it, and returns the total.
+         */
+        class ScanExclusivePrefixes : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(ScanExclusivePrefixes);
+            }
+
+            void test(ITestContext& context) const {
+                std::auto_ptr<IParallelizer> parallelizer(NiwaParallelizer::create());
+
+                static const int N = 10007;
+
+                std::vector<int> values(N);
+
+                for(int i=0; i<N; ++i) {
+                    values[i] = (i * 7919) % 13;
+                }
+
+                std::vector<int> prefixes(N, -1);
+
+                int const total = parallelScan(
+                    *parallelizer, 0, N, 100, 0,
+                    SumBody<int>(values), std::plus<int>(),
+                    PrefixScan(values, prefixes));
+
+                int expected = 0;
+
+                for(int i=0; i<N; ++i) {
+                    context.assertEquals<int>(expected, prefixes[i],
+                        "wrong exclusive prefix");
+
+                    expected += values[i];
+                }
+
+                context.assertEquals<int>(expected, total, "wrong total");
+            }
+        };
+
+        /**
+         * Float sums round differently in different orders;
+         * the block results must be combined in index order,
+         * whatever the parallelizer.
+         */
+        class ReduceDeterministicSum : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(ReduceDeterministicSum);
+            }
+
+            void test(ITestContext& context) const {
+                std::auto_ptr<IParallelizer> singleThreaded(
+                    SingleThreadedParallelizer::create());
+
+                std::auto_ptr<IParallelizer> niwa(NiwaParallelizer::create());
+
+                static const int N = 100000;
+
+                std::vector<float> values(N);
+
+                // Magnitudes over many octaves, so that
+                // the rounding depends on the order.
+                for(int i=0; i<N; ++i) {
+                    values[i] = static_cast<float>((i * 7919) % 1000 + 1)
+                        * (i % 3 == 0 ? 1e-4f : 1e3f);
+                }
+
+                SumBody<float> const body(values);
+
+                float expected = 0;
+
+                for(int i=0; i<N; i+=1024) {
+                    expected += body(i, std::min(i + 1024, N));
+                }
+
+                for(int i=0; i<3; ++i) {
+                    context.assertEquals<float>(expected, parallelReduce(
+                        *singleThreaded, 0, N, 1024, 0.0f, body, std::plus<float>()),
+                        "single-threaded sum not in index order");
+
+                    context.assertEquals<float>(expected, parallelReduce(
+                        *niwa, 0, N, 1024, 0.0f, body, std::plus<float>()),
+                        "parallel sum not in index order");
+                }
+            }
+        };
+
+        std::type_info const& ParallelReduceTestSuite::getType() const {
+            return typeid(ParallelReduceTestSuite);
+        }
+
+        size_t ParallelReduceTestSuite::nCases() const {
+            return 4;
+        }
+
+        ITestCase* ParallelReduceTestSuite::newCase(size_t index) const {
+            switch(index) {
+            case 0:
+                return new ReduceEmptyRange();
+            case 1:
+                return new ReduceBlocks();
+            case 2:
+                return new ScanExclusivePrefixes();
+            case 3:
+                return new ReduceDeterministicSum();
+            default:
+                assert(false);
+                return 0;
+            }
+        }
+    }
+}
\ No newline at end of file
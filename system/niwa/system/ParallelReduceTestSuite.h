@@ -0,0 +1,26 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PARALLELREDUCETESTSUITE_H
+#define NIWA_SYSTEM_PARALLELREDUCETESTSUITE_H
+
+#include "niwa/testing/ITestSuite.h"
+
+namespace niwa {
+    namespace system {
+        class ParallelReduceTestSuite : public niwa::testing::ITestSuite {
+        public:
+            std::type_info const& getType() const;
+
+            size_t nCases() const;
+
+            niwa::testing::ITestCase* newCase(size_t index) const;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
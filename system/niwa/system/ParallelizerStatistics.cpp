@@ -0,0 +1,37 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/ParallelizerStatistics.h"
+
+#include <ostream>
+
+namespace niwa {
+    namespace system {
+        std::ostream& operator << (std::ostream& out, ParallelizerStatistics const& statistics) {
+            out << "loops: " << statistics.loopTimes.getCount()
+                << ", loop p50/p99: "
+                << statistics.loopTimes.getPercentile(0.5) * 1e6 << "/"
+                << statistics.loopTimes.getPercentile(0.99) * 1e6 << " us"
+                << ", chunk p50/p99: "
+                << statistics.chunkTimes.getPercentile(0.5) * 1e6 << "/"
+                << statistics.chunkTimes.getPercentile(0.99) * 1e6 << " us"
+                << ", balance: " << statistics.balanceFactor;
+
+            for(size_t i=0; i<statistics.threads.size(); ++i) {
+                ThreadStatistics const& thread = statistics.threads[i];
+
+                out << "; thread " << i
+                    << ": " << thread.nIterations << " iterations"
+                    << " in " << thread.nChunks << " chunks"
+                    << ", busy " << thread.busySeconds << " s"
+                    << ", idle " << thread.idleSeconds << " s";
+            }
+
+            return out;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PARALLELIZERSTATISTICS_H
+#define NIWA_SYSTEM_PARALLELIZERSTATISTICS_H
+
+#include "LatencyHistogram.h"
+
+#include <iosfwd>
+#include <vector>
+
+namespace niwa {
+    namespace system {
+        /**
+         * The work of a single thread of a parallelizer.
+         */
+        struct ThreadStatistics {
+            long nIterations;
+
+            /**
+             * The number of ranges taken.
+             */
+            long nChunks;
+
+            /**
+             * Time spent running loop bodies
+             * and taking chunks.
+             */
+            double busySeconds;
+
+            /**
+             * Time spent waiting for work.
+             */
+            double idleSeconds;
+        };
+
+        /**
+         * A snapshot of how a parallelizer has spread its work,
+         * for diagnosing poor scaling. Can be written to a log.
+         */
+        struct ParallelizerStatistics {
+            /**
+             * The first thread is the one that runs the loops.
+             */
+            std::vector<ThreadStatistics> threads;
+
+            /**
+             * Wall time of each loop, including the dispatch.
+             */
+            LatencyHistogram loopTimes;
+
+            /**
+             * Time of each chunk on any thread.
+             */
+            LatencyHistogram chunkTimes;
+
+            /**
+             * See NiwaParallelizer::getBalanceFactor.
+             */
+            double balanceFactor;
+        };
+
+        /**
+         * Writes the statistics on a single line.
+         */
+        std::ostream& operator << (std::ostream& out, ParallelizerStatistics const& statistics);
+    }
+}
+
+#endif
\ No newline at end of file
@@ -2,15 +2,25 @@
  * @file
  * @author Mikko Kauppila
  *
- * Capability code is mostly copied from Microsoft's example.
+ * The MMX/SSE/SSE2 OS checks are mostly copied from Microsoft's example.
  *
  * Copyright (C) Mikko Kauppila 2009.
  */
 
 #include "niwa/system/ProcessorInfo.h"
 
+#if defined(_WIN32)
 #define NOMINMAX
 #include <windows.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#include <thread>
+#endif
 
 #include <algorithm>
 
@@ -18,14 +28,113 @@
 #define _CPU_FEATURE_SSE    0x0002
 #define _CPU_FEATURE_SSE2   0x0004
 
-// This namespace is mostly copied from Microsoft's example.
+/**
+ * Whether the features are probed with 32-bit inline assembly,
+ * which can also catch processors without CPUID or an OS that
+ * does not save the SSE state. Everywhere else, and on every
+ * x64 processor, CPUID, MMX, SSE and SSE2 are always present.
+ */
+#if defined(_MSC_VER) && defined(_M_IX86)
+#define NIWA_SYSTEM_PROBE_LEGACY_FEATURES
+#endif
+
 namespace {
-    // These are the bit flags that get set on calling cpuid
-    // with register eax set to 1
+    // These are the bit flags that get set in edx
+    // on calling cpuid with register eax set to 1
     #define _MMX_FEATURE_BIT        0x00800000
     #define _SSE_FEATURE_BIT        0x02000000
     #define _SSE2_FEATURE_BIT       0x04000000
 
+    // These are the bit flags that get set in ecx
+    // on calling cpuid with register eax set to 1
+    #define _SSE3_FEATURE_BIT       0x00000001
+    #define _SSSE3_FEATURE_BIT      0x00000200
+    #define _FMA_FEATURE_BIT        0x00001000
+    #define _SSE41_FEATURE_BIT      0x00080000
+    #define _SSE42_FEATURE_BIT      0x00100000
+    #define _OSXSAVE_FEATURE_BIT    0x08000000
+    #define _AVX_FEATURE_BIT        0x10000000
+
+    // These are the bit flags that get set in ebx
+    // on calling cpuid with eax set to 7 and ecx to 0
+    #define _AVX2_FEATURE_BIT       0x00000020
+    #define _AVX512F_FEATURE_BIT    0x00010000
+    #define _AVX512DQ_FEATURE_BIT   0x00020000
+    #define _AVX512CD_FEATURE_BIT   0x10000000
+    #define _AVX512BW_FEATURE_BIT   0x40000000
+    #define _AVX512VL_FEATURE_BIT   0x80000000
+
+    #define _AVX512_FEATURE_BITS \
+        (_AVX512F_FEATURE_BIT | _AVX512DQ_FEATURE_BIT | _AVX512CD_FEATURE_BIT \
+        | _AVX512BW_FEATURE_BIT | _AVX512VL_FEATURE_BIT)
+
+    // XCR0 bits for the OS saving the SSE and AVX state
+    #define _XCR0_SSE_AVX_STATE     0x00000006
+
+    // XCR0 bits for the OS also saving the opmask
+    // and the upper halves of the 512-bit registers
+    #define _XCR0_AVX512_STATE      0x000000E6
+
+    /**
+     * Bits of ProcessorInfo::features_.
+     */
+    enum Feature {
+        FEATURE_MMX     = 1 << 0,
+        FEATURE_SSE     = 1 << 1,
+        FEATURE_SSE2    = 1 << 2,
+        FEATURE_SSE3    = 1 << 3,
+        FEATURE_SSSE3   = 1 << 4,
+        FEATURE_SSE41   = 1 << 5,
+        FEATURE_SSE42   = 1 << 6,
+        FEATURE_AVX     = 1 << 7,
+        FEATURE_FMA     = 1 << 8,
+        FEATURE_AVX2    = 1 << 9,
+        FEATURE_AVX512  = 1 << 10
+    };
+
+    /**
+     * @param registers Receives eax, ebx, ecx and edx.
+     */
+    static void fCpuid(unsigned leaf, unsigned subleaf, unsigned registers[4]) {
+#if defined(_MSC_VER)
+        int values[4];
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+
+        for(int i=0; i<4; ++i) {
+            registers[i] = static_cast<unsigned>(values[i]);
+        }
+#else
+        __cpuid_count(leaf, subleaf,
+            registers[0], registers[1], registers[2], registers[3]);
+#endif
+    }
+
+    /**
+     * @param ecxFeatures The ecx register of cpuid
+     *                    with register eax set to 1.
+     *
+     * @return The low half of XCR0, or zero if
+     *         the OS has not enabled XGETBV.
+     */
+    static unsigned fGetEnabledStates(unsigned ecxFeatures) {
+        // XGETBV may only be used if the OS has enabled it.
+        if(!(ecxFeatures & _OSXSAVE_FEATURE_BIT)) {
+            return 0;
+        }
+
+#if defined(_MSC_VER)
+        return static_cast<unsigned>(_xgetbv(0));
+#else
+        unsigned eax, edx;
+        __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return eax;
+#endif
+    }
+}
+
+#ifdef NIWA_SYSTEM_PROBE_LEGACY_FEATURES
+// This namespace is mostly copied from Microsoft's example.
+namespace {
     static bool isCpuidSupported() {
         __try {
             _asm {
@@ -77,14 +186,26 @@ namespace {
         return true;
     }
 }
+#else
+namespace {
+    static bool isCpuidSupported() {
+        return true;
+    }
+
+    static bool _os_support(int /*feature*/) {
+        return true;
+    }
+}
+#endif
 
 namespace {
+#if defined(_WIN32)
     static int getLogicalProcessorCount() {
         HANDLE handle = GetCurrentProcess();
 
         if(handle) {
-            DWORD processAffinity;
-            DWORD systemAffinity;
+            DWORD_PTR processAffinity;
+            DWORD_PTR systemAffinity;
 
             if(GetProcessAffinityMask(handle, 
                 &processAffinity, 
@@ -108,67 +229,164 @@ namespace {
         // let's use the default.
         return 1;
     }
+#else
+    static int getLogicalProcessorCount() {
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+#endif
 }
 
 namespace niwa {
     namespace system {
-        ProcessorInfo::ProcessorInfo(
-                bool supportsMmx,
-                bool supportsSse,
-                bool supportsSse2,
-                int logicalProcessorCount) 
-                : supportsMmx_(supportsMmx),
-                  supportsSse_(supportsSse),
-                  supportsSse2_(supportsSse2),
+        ProcessorInfo::ProcessorInfo(unsigned features, int logicalProcessorCount) 
+                : features_(features),
                   logicalProcessorCount_(logicalProcessorCount) {
             // ignored
         }
 
         ProcessorInfo ProcessorInfo::create() {
-            DWORD dwFeature = 0;
-
             if (!isCpuidSupported()) {
-                return ProcessorInfo(false, false, false, 
-                    ::getLogicalProcessorCount());
+                return ProcessorInfo(0, ::getLogicalProcessorCount());
             }
 
-            DWORD maxStandardLevel;
+            unsigned registers[4];
 
-            _asm {
-                mov eax, 0
-                cpuid
-                mov maxStandardLevel, eax
-            }
+            fCpuid(0, 0, registers);
+
+            unsigned const maxStandardLevel = registers[0];
 
             if(maxStandardLevel < 1) {
-                return ProcessorInfo(false, false, false, 
-                    ::getLogicalProcessorCount());
+                return ProcessorInfo(0, ::getLogicalProcessorCount());
             }
 
-            _asm {
-                // get the Standard bits
-                mov eax, 1
-                cpuid
-                mov dwFeature, edx
+            fCpuid(1, 0, registers);
+
+            unsigned const ecxFeatures = registers[2];
+            unsigned const edxFeatures = registers[3];
+
+            unsigned extendedFeatures = 0;
+
+            if(maxStandardLevel >= 7) {
+                fCpuid(7, 0, registers);
+                extendedFeatures = registers[1];
+            }
+
+            unsigned const states = fGetEnabledStates(ecxFeatures);
+
+            bool const isAvxStateSaved =
+                (states & _XCR0_SSE_AVX_STATE) == _XCR0_SSE_AVX_STATE;
+
+            bool const isAvx512StateSaved =
+                (states & _XCR0_AVX512_STATE) == _XCR0_AVX512_STATE;
+
+            unsigned features = 0;
+
+            if((edxFeatures&_MMX_FEATURE_BIT) && _os_support(_CPU_FEATURE_MMX)) {
+                features |= FEATURE_MMX;
+            }
+
+            if((edxFeatures&_SSE_FEATURE_BIT) && _os_support(_CPU_FEATURE_SSE)) {
+                features |= FEATURE_SSE;
+            }
+
+            if((edxFeatures&_SSE2_FEATURE_BIT) && _os_support(_CPU_FEATURE_SSE2)) {
+                features |= FEATURE_SSE2;
+
+                // The later SSE extensions use the same registers,
+                // so they are usable whenever SSE2 is.
+                if(ecxFeatures&_SSE3_FEATURE_BIT) {
+                    features |= FEATURE_SSE3;
+                }
+
+                if(ecxFeatures&_SSSE3_FEATURE_BIT) {
+                    features |= FEATURE_SSSE3;
+                }
+
+                if(ecxFeatures&_SSE41_FEATURE_BIT) {
+                    features |= FEATURE_SSE41;
+                }
+
+                if(ecxFeatures&_SSE42_FEATURE_BIT) {
+                    features |= FEATURE_SSE42;
+                }
             }
 
-            return ProcessorInfo(
-                (dwFeature&_MMX_FEATURE_BIT) && _os_support(_CPU_FEATURE_MMX),
-                (dwFeature&_SSE_FEATURE_BIT) && _os_support(_CPU_FEATURE_SSE),
-                (dwFeature&_SSE2_FEATURE_BIT) && _os_support(_CPU_FEATURE_SSE2),
-                ::getLogicalProcessorCount());
+            if((ecxFeatures&_AVX_FEATURE_BIT) && isAvxStateSaved) {
+                features |= FEATURE_AVX;
+
+                if(ecxFeatures&_FMA_FEATURE_BIT) {
+                    features |= FEATURE_FMA;
+                }
+
+                if(extendedFeatures&_AVX2_FEATURE_BIT) {
+                    features |= FEATURE_AVX2;
+                }
+
+                if((extendedFeatures&_AVX512_FEATURE_BITS) == _AVX512_FEATURE_BITS
+                        && isAvx512StateSaved) {
+                    features |= FEATURE_AVX512;
+                }
+            }
+
+            return ProcessorInfo(features, ::getLogicalProcessorCount());
         }
 
         bool ProcessorInfo::supportsMmx() const {
-            return supportsMmx_;
+            return (features_ & FEATURE_MMX) != 0;
         }
 
         bool ProcessorInfo::supportsSse() const {
-            return supportsSse_;
+            return (features_ & FEATURE_SSE) != 0;
         }
 
         bool ProcessorInfo::supportsSse2() const {
-            return supportsSse2_;
+            return (features_ & FEATURE_SSE2) != 0;
+        }
+
+        bool ProcessorInfo::supportsSse3() const {
+            return (features_ & FEATURE_SSE3) != 0;
+        }
+
+        bool ProcessorInfo::supportsSsse3() const {
+            return (features_ & FEATURE_SSSE3) != 0;
+        }
+
+        bool ProcessorInfo::supportsSse41() const {
+            return (features_ & FEATURE_SSE41) != 0;
+        }
+
+        bool ProcessorInfo::supportsSse42() const {
+            return (features_ & FEATURE_SSE42) != 0;
+        }
+
+        bool ProcessorInfo::supportsAvx() const {
+            return (features_ & FEATURE_AVX) != 0;
+        }
+
+        bool ProcessorInfo::supportsFma() const {
+            return (features_ & FEATURE_FMA) != 0;
+        }
+
+        bool ProcessorInfo::supportsAvx2() const {
+            return (features_ & FEATURE_AVX2) != 0;
+        }
+
+        bool ProcessorInfo::supportsAvx512() const {
+            return (features_ & FEATURE_AVX512) != 0;
+        }
+
+        SimdLevel ProcessorInfo::getSimdLevel() const {
+            if(!supportsSse3() || !supportsSsse3() || !supportsSse41()) {
+                return SIMD_SSE2;
+            } else if(!supportsAvx() || !supportsFma()) {
+                return SIMD_SSE41;
+            } else if(!supportsAvx2()) {
+                return SIMD_AVX;
+            } else if(!supportsAvx512()) {
+                return SIMD_AVX2;
+            } else {
+                return SIMD_AVX512;
+            }
         }
 
         int ProcessorInfo::getLogicalProcessorCount() const {
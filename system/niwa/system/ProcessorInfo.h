@@ -10,6 +10,38 @@
 
 namespace niwa {
     namespace system {
+        /**
+         * The instruction set levels SIMD kernels
+         * are written for, from narrowest to widest.
+         * Each level implies the ones below it.
+         */
+        enum SimdLevel {
+            SIMD_SSE2,
+
+            /**
+             * SSE3, SSSE3 and SSE4.1.
+             */
+            SIMD_SSE41,
+
+            /**
+             * AVX together with FMA3; every AVX
+             * kernel here uses fused multiply-adds.
+             */
+            SIMD_AVX,
+
+            /**
+             * AVX2 (256-bit integer operations).
+             */
+            SIMD_AVX2,
+
+            /**
+             * AVX-512 F, CD, BW, DQ and VL.
+             */
+            SIMD_AVX512,
+
+            SIMD_LEVEL_COUNT
+        };
+
         /**
          * Information about processor capabilities,
          * including OS support for the available processor features.
@@ -38,22 +70,71 @@ namespace niwa {
              */
             bool supportsSse2() const;
 
+            /**
+             * @return Whether the processor supports SSE3.
+             */
+            bool supportsSse3() const;
+
+            /**
+             * @return Whether the processor supports SSSE3.
+             */
+            bool supportsSsse3() const;
+
+            /**
+             * @return Whether the processor supports SSE4.1.
+             */
+            bool supportsSse41() const;
+
+            /**
+             * @return Whether the processor supports SSE4.2.
+             */
+            bool supportsSse42() const;
+
+            /**
+             * @return Whether both the processor and the OS support
+             *         the AVX instruction set (i.e., the OS saves
+             *         the 256-bit registers on context switches).
+             */
+            bool supportsAvx() const;
+
+            /**
+             * @return Whether both the processor and the OS support
+             *         the FMA3 instruction set.
+             */
+            bool supportsFma() const;
+
+            /**
+             * @return Whether both the processor and the OS support
+             *         the AVX2 instruction set.
+             */
+            bool supportsAvx2() const;
+
+            /**
+             * @return Whether both the processor and the OS support
+             *         AVX-512 F, CD, BW, DQ and VL (i.e., the OS
+             *         also saves the opmask and 512-bit registers).
+             */
+            bool supportsAvx512() const;
+
+            /**
+             * @return The widest level all of whose
+             *         features are supported.
+             */
+            SimdLevel getSimdLevel() const;
+
             /**
              * @return The number of logical processors.
              */
             int getLogicalProcessorCount() const;
 
         private:
-            ProcessorInfo(
-                bool supportsMmx,
-                bool supportsSse,
-                bool supportsSse2,
-                int logicalProcessorCount);
+            ProcessorInfo(unsigned features, int logicalProcessorCount);
 
         private:
-            bool supportsMmx_;
-            bool supportsSse_;
-            bool supportsSse2_;
+            /**
+             * Bitwise or of the FEATURE_ flags in ProcessorInfo.cpp.
+             */
+            unsigned features_;
 
             int logicalProcessorCount_;
         };
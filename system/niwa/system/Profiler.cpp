@@ -0,0 +1,276 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/Profiler.h"
+
+#include "niwa/system/ScopedAcquire.h"
+#include "niwa/system/SpinLock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <vector>
+
+/**
+ * The number of zones kept per thread; the
+ * oldest zones are overwritten first.
+ */
+#define RING_CAPACITY 65536
+
+/**
+ * Zones nested deeper are not recorded.
+ */
+#define MAX_DEPTH 64
+
+namespace niwa {
+    namespace system {
+        namespace {
+            struct ZoneRecord {
+                char const* name;
+
+                long long beginNanoseconds;
+
+                long long endNanoseconds;
+            };
+
+            /**
+             * The recorded zones of a thread. Written only by
+             * the thread that holds it. Allocated when a thread
+             * first records a zone; when the thread exits, the
+             * timeline is kept, zones and all, for the next
+             * thread to record into.
+             */
+            class Timeline {
+            public:
+                explicit Timeline(int threadId)
+                    : threadId(threadId),
+                      records(RING_CAPACITY),
+                      nRecords(0) {
+                    // ignored
+                }
+
+                int const threadId;
+
+                std::vector<ZoneRecord> records;
+
+                /**
+                 * The number of zones ever recorded.
+                 */
+                std::atomic<long long> nRecords;
+
+            private: // prevent copying
+                Timeline(Timeline const&);
+                Timeline& operator = (Timeline const&);
+            };
+
+            /**
+             * The open zones of a thread, and
+             * its timeline once it has recorded.
+             */
+            class ThreadZones {
+            public:
+                ThreadZones();
+
+                /**
+                 * Hands the timeline to the next thread.
+                 */
+                ~ThreadZones();
+
+                /**
+                 * NULL until the thread records a zone.
+                 */
+                Timeline* timeline;
+
+                int depth;
+
+                char const* openNames[MAX_DEPTH];
+
+                long long openBegins[MAX_DEPTH];
+
+            private: // prevent copying
+                ThreadZones(ThreadZones const&);
+                ThreadZones& operator = (ThreadZones const&);
+            };
+
+            static std::chrono::steady_clock::time_point const gEpoch =
+                std::chrono::steady_clock::now();
+
+            static std::atomic<bool> gIsRecording(false);
+
+            /**
+             * Guards gTimelines and gFreeTimelines.
+             */
+            static SpinLock gLock;
+
+            /**
+             * Elements owned.
+             */
+            static std::vector<Timeline*> gTimelines;
+
+            /**
+             * The timelines of exited threads; not owned.
+             */
+            static std::vector<Timeline*> gFreeTimelines;
+
+            ThreadZones::ThreadZones()
+                : timeline(NULL),
+                  depth(0) {
+                // ignored
+            }
+
+            ThreadZones::~ThreadZones() {
+                if(timeline) {
+                    ScopedAcquire acquire(&gLock);
+
+                    gFreeTimelines.push_back(timeline);
+                }
+            }
+
+            static long long fNow() {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - gEpoch).count();
+            }
+
+            static ThreadZones& fGetThreadZones() {
+                thread_local ThreadZones zones;
+
+                return zones;
+            }
+
+            static Timeline& fGetTimeline(ThreadZones& zones) {
+                if(!zones.timeline) {
+                    ScopedAcquire acquire(&gLock);
+
+                    if(!gFreeTimelines.empty()) {
+                        zones.timeline = gFreeTimelines.back();
+
+                        gFreeTimelines.pop_back();
+                    } else {
+                        zones.timeline = new Timeline(static_cast<int>(gTimelines.size()));
+
+                        gTimelines.push_back(zones.timeline);
+                    }
+                }
+
+                return *zones.timeline;
+            }
+
+            static void fWriteEscaped(std::ostream& out, char const* str) {
+                for(; *str; ++str) {
+                    if(*str == '"' || *str == '\\') {
+                        out << '\\';
+                    }
+                    out << *str;
+                }
+            }
+        }
+
+        void Profiler::start() {
+            gIsRecording.store(true);
+        }
+
+        void Profiler::stop() {
+            gIsRecording.store(false);
+        }
+
+        bool Profiler::isRecording() {
+            return gIsRecording.load(std::memory_order_relaxed);
+        }
+
+        void Profiler::clear() {
+            ScopedAcquire acquire(&gLock);
+
+            for(size_t i=0; i<gTimelines.size(); ++i) {
+                gTimelines[i]->nRecords.store(0);
+            }
+        }
+
+        void Profiler::beginZone(char const* name) {
+            ThreadZones& zones = fGetThreadZones();
+
+            // The nesting is tracked while not recording
+            // too, so that every end meets its begin.
+            if(zones.depth < MAX_DEPTH) {
+                zones.openNames[zones.depth] = name;
+                zones.openBegins[zones.depth] = fNow();
+            }
+
+            ++zones.depth;
+        }
+
+        void Profiler::endZone() {
+            ThreadZones& zones = fGetThreadZones();
+
+            --zones.depth;
+
+            if(zones.depth >= MAX_DEPTH || !isRecording()) {
+                return;
+            }
+
+            Timeline& timeline = fGetTimeline(zones);
+
+            long long const n = timeline.nRecords.load(std::memory_order_relaxed);
+
+            ZoneRecord& record = timeline.records[static_cast<size_t>(n % RING_CAPACITY)];
+
+            record.name = zones.openNames[zones.depth];
+            record.beginNanoseconds = zones.openBegins[zones.depth];
+            record.endNanoseconds = fNow();
+
+            timeline.nRecords.store(n+1, std::memory_order_release);
+        }
+
+        bool Profiler::writeChromeTrace(char const* path) {
+            std::ofstream out(path);
+
+            if(!out) {
+                return false;
+            }
+
+            ScopedAcquire acquire(&gLock);
+
+            // Microseconds, to nanosecond precision.
+            out << std::fixed;
+            out.precision(3);
+
+            out << "{\"traceEvents\":[";
+
+            bool isFirst = true;
+
+            for(size_t i=0; i<gTimelines.size(); ++i) {
+                Timeline const& timeline = *gTimelines[i];
+
+                long long const n = timeline.nRecords.load(std::memory_order_acquire);
+
+                long long const first = n > RING_CAPACITY ? n - RING_CAPACITY : 0;
+
+                for(long long j=first; j<n; ++j) {
+                    ZoneRecord const& record =
+                        timeline.records[static_cast<size_t>(j % RING_CAPACITY)];
+
+                    out << (isFirst ? "\n" : ",\n");
+
+                    isFirst = false;
+
+                    // Complete events.
+                    out << "{\"name\":\"";
+                    fWriteEscaped(out, record.name);
+                    out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << timeline.threadId
+                        << ",\"ts\":" << record.beginNanoseconds * 1e-3
+                        << ",\"dur\":"
+                        << (record.endNanoseconds - record.beginNanoseconds) * 1e-3
+                        << "}";
+                }
+            }
+
+            out << "\n]}\n";
+
+            return !out.fail();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_PROFILER_H
+#define NIWA_SYSTEM_PROFILER_H
+
+//#define NIWA_SYSTEM_PROFILING
+
+namespace niwa {
+    namespace system {
+        /**
+         * Records nested zones into a ring buffer per thread,
+         * keeping the latest zones of each thread, and writes
+         * them as a timeline per thread in the Chrome trace
+         * format (chrome://tracing).
+         *
+         * Zones are marked with NIWA_PROFILE_ZONE, which
+         * compiles to nothing unless NIWA_SYSTEM_PROFILING
+         * is defined.
+         */
+        class Profiler {
+        public:
+            /**
+             * Starts recording zones; zones that end
+             * while not recording are dropped.
+             */
+            static void start();
+
+            static void stop();
+
+            static bool isRecording();
+
+            /**
+             * Forgets the recorded zones. Call while not recording.
+             */
+            static void clear();
+
+            /**
+             * Writes the recorded zones as Chrome trace_event
+             * JSON. Call while not recording.
+             *
+             * @return Whether the file could be written.
+             */
+            static bool writeChromeTrace(char const* path);
+
+            /**
+             * Opens a zone on the calling thread.
+             *
+             * @param name Must stay valid until the zones have
+             *             been written, e.g., a string literal.
+             */
+            static void beginZone(char const* name);
+
+            /**
+             * Closes the innermost zone of the calling thread.
+             */
+            static void endZone();
+
+        private:
+            Profiler();
+        };
+
+        /**
+         * RAII zone; see NIWA_PROFILE_ZONE.
+         */
+        class ScopedZone {
+        public:
+            explicit ScopedZone(char const* name) {
+                Profiler::beginZone(name);
+            }
+
+            ~ScopedZone() {
+                Profiler::endZone();
+            }
+
+        private: // prevent copying
+            ScopedZone(ScopedZone const&);
+            ScopedZone& operator = (ScopedZone const&);
+        };
+    }
+}
+
+#define NIWA_PROFILE_CONCAT_(a, b) a##b
+#define NIWA_PROFILE_CONCAT(a, b) NIWA_PROFILE_CONCAT_(a, b)
+
+#ifdef NIWA_SYSTEM_PROFILING
+/**
+ * Records the rest of the enclosing scope as a zone.
+ *
+ * @param name A string literal.
+ */
+#define NIWA_PROFILE_ZONE(name) \
+    ::niwa::system::ScopedZone NIWA_PROFILE_CONCAT(niwaProfileZone, __LINE__)(name)
+#else
+#define NIWA_PROFILE_ZONE(name)
+#endif
+
+#endif
\ No newline at end of file
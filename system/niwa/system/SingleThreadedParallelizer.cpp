@@ -27,6 +27,13 @@ namespace niwa {
             }
         }
 
+        void SingleThreadedParallelizer::loopRange(
+                IRangeCallback& callback, int start, int end, int stride) {
+            for(int i=start; i<end; i+=stride) {
+                callback.invokeRange(i, std::min(end, i + stride));
+            }
+        }
+
         SingleThreadedParallelizer* SingleThreadedParallelizer::create() {
             return new SingleThreadedParallelizer();
         }
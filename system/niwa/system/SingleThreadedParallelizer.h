@@ -22,6 +22,8 @@ namespace niwa {
 
             void loop(ICallback& callback, int start, int end, int stride);
 
+            void loopRange(IRangeCallback& callback, int start, int end, int stride);
+
             static SingleThreadedParallelizer* create();
 
         private: // prevent copying
@@ -7,18 +7,86 @@
 
 #include "niwa/system/SpinLock.h"
 
+#include "niwa/system/LockStatistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <xmmintrin.h>
+
+/**
+ * The maximum number of pauses between attempts;
+ * about a microsecond.
+ */
+#define MAX_BACKOFF 64
+
+/**
+ * Waiters yield the processor after this many pauses,
+ * so that a preempted holder can run when the
+ * machine is oversubscribed.
+ */
+#define YIELD_SPINS 4096
+
 namespace niwa {
     namespace system {
-        SpinLock::SpinLock() : isLocked_(0) {
+        SpinLock::SpinLock() : isLocked_(0), statistics_(0) {
             // ignored
         }
 
         void SpinLock::acquire() {
-            while(InterlockedCompareExchange(&isLocked_, 1, 0));
+            if(!isLocked_.exchange(1, std::memory_order_acquire)) {
+                if(statistics_) {
+                    statistics_->addAcquisition();
+                }
+                return;
+            }
+
+            std::chrono::steady_clock::time_point startTime;
+
+            if(statistics_) {
+                startTime = std::chrono::steady_clock::now();
+            }
+
+            long nSpins = 0;
+
+            int backoff = 1;
+
+            do {
+                for(int i=0; i<backoff; ++i) {
+                    _mm_pause();
+                }
+
+                nSpins += backoff;
+
+                backoff = std::min(backoff * 2, MAX_BACKOFF);
+
+                // Test before the exchange: reads keep the
+                // cache line shared while the lock is held.
+                while(isLocked_.load(std::memory_order_relaxed)) {
+                    if(nSpins < YIELD_SPINS) {
+                        _mm_pause();
+                        ++nSpins;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            } while(isLocked_.exchange(1, std::memory_order_acquire));
+
+            if(statistics_) {
+                std::chrono::duration<double> waitTime =
+                    std::chrono::steady_clock::now() - startTime;
+
+                statistics_->addContendedAcquisition(nSpins, waitTime.count());
+            }
         }
 
         void SpinLock::release() {
-            InterlockedExchange(&isLocked_, 0);
+            isLocked_.store(0, std::memory_order_release);
+        }
+
+        void SpinLock::setStatistics(LockStatistics* statistics) {
+            statistics_ = statistics;
         }
     }
 }
\ No newline at end of file
@@ -10,13 +10,18 @@
 
 #include "ILock.h"
 
-#define NOMINMAX
-#include <windows.h>
+#include <atomic>
 
 namespace niwa {
     namespace system {
+        class LockStatistics;
+
         /**
-         * A non-reentrant spin lock.
+         * A non-reentrant spin lock. Waiters only read the lock
+         * until it looks free, and back off exponentially after
+         * each lost race, so contention does not flood the
+         * interconnect. Unfair; see TicketLock and McsLock for
+         * heavily contended locks.
          */
         class SpinLock : public ILock {
         public:
@@ -26,12 +31,21 @@ namespace niwa {
 
             void release();
 
+            /**
+             * @param statistics The counters to update, or
+             *                   NULL (the default) for none.
+             *                   Must outlive the lock's use.
+             */
+            void setStatistics(LockStatistics* statistics);
+
         private: // prevent copying
             SpinLock(SpinLock const&);
             SpinLock& operator = (SpinLock const&);
 
         private:
-            LONG volatile isLocked_;
+            std::atomic<int> isLocked_;
+
+            LockStatistics* statistics_;
         };
     }
 }
@@ -0,0 +1,413 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/TaskScheduler.h"
+
+#include "niwa/system/WorkStealingDeque.h"
+
+#include <algorithm>
+#include <system_error>
+#include <thread>
+
+/**
+ * Capacity of each deque; a task that does not
+ * fit is run immediately by the spawning thread.
+ */
+#define DEQUE_CAPACITY 4096
+
+/**
+ * The automatic grain gives each thread
+ * this many tasks of a loop on average.
+ */
+#define TASKS_PER_THREAD 8
+
+namespace niwa {
+    namespace system {
+        class TaskScheduler::Worker {
+        public:
+            Worker();
+            ~Worker();
+
+            /**
+             * Second-phase construction.
+             *
+             * @return Whether the worker could be constructed.
+             */
+            bool construct(TaskScheduler* parent, int threadIndex);
+
+            void run();
+
+            unsigned int& getSeed();
+
+        private:
+            TaskScheduler* parent_;
+
+            int threadIndex_;
+
+            unsigned int seed_;
+
+            std::thread thread_;
+        };
+
+        /**
+         * Runs a loop range, splitting it in halves
+         * until the halves are no larger than the grain.
+         */
+        class TaskScheduler::RangeTask : public TaskScheduler::Task {
+        public:
+            RangeTask(
+                TaskScheduler& scheduler, IRangeCallback& callback,
+                int start, int end, int grain);
+
+            void __fastcall run();
+
+        private: // prevent copying
+            RangeTask(RangeTask const&);
+            RangeTask& operator = (RangeTask const&);
+
+        private:
+            TaskScheduler& scheduler_;
+            IRangeCallback& callback_;
+            int start_;
+            int end_;
+            int const grain_;
+        };
+
+        namespace {
+            /**
+             * The scheduler whose worker the calling thread
+             * is, or NULL for threads that are not workers.
+             */
+            static thread_local TaskScheduler const* tScheduler = NULL;
+
+            /**
+             * Thread index of the calling worker.
+             */
+            static thread_local int tThreadIndex = 0;
+
+            /**
+             * The scheduler that the calling thread has
+             * entered through run without being a worker.
+             */
+            static thread_local TaskScheduler const* tEntered = NULL;
+
+            /**
+             * Marks the calling thread as entered for a scope.
+             */
+            class EnteredScope {
+            public:
+                explicit EnteredScope(TaskScheduler const* scheduler) {
+                    tEntered = scheduler;
+                }
+
+                ~EnteredScope() {
+                    tEntered = NULL;
+                }
+
+            private: // prevent copying
+                EnteredScope(EnteredScope const&);
+                EnteredScope& operator = (EnteredScope const&);
+            };
+        }
+
+        TaskScheduler::Task::Task() : group_(NULL) {
+            // ignored
+        }
+
+        TaskScheduler::Task::~Task() {
+            // ignored
+        }
+
+        TaskScheduler::TaskGroup::TaskGroup(TaskScheduler& scheduler)
+            : scheduler_(scheduler), nPending_(0) {
+            // ignored
+        }
+
+        TaskScheduler::TaskGroup::~TaskGroup() {
+            sync();
+        }
+
+        void TaskScheduler::TaskGroup::spawn(Task& task) {
+            task.group_ = this;
+
+            nPending_.fetch_add(1);
+
+            int const threadIndex = scheduler_.getThreadIndex();
+
+            if(scheduler_.deques_[threadIndex]->push(&task)) {
+                scheduler_.workEpoch_.fetchAdd(1);
+                scheduler_.workEpoch_.wakeAll();
+            } else {
+                execute(&task);
+            }
+        }
+
+        void TaskScheduler::TaskGroup::sync() {
+            int const threadIndex = scheduler_.getThreadIndex();
+
+            while(nPending_.load() > 0) {
+                Task* task = scheduler_.findTask(threadIndex);
+
+                if(task) {
+                    execute(task);
+                    continue;
+                }
+
+                // The pending tasks run on other threads; sleep
+                // until some group completes. Reading the epoch
+                // first means a completion in between is not
+                // slept through.
+                int const epoch = scheduler_.completionEpoch_.load();
+
+                if(nPending_.load() > 0) {
+                    scheduler_.completionEpoch_.wait(epoch);
+                }
+            }
+        }
+
+        TaskScheduler* TaskScheduler::create() {
+            return new TaskScheduler();
+        }
+
+        TaskScheduler::TaskScheduler()
+            : workEpoch_(0), completionEpoch_(0),
+              isStopping_(false), ownerSeed_(1) {
+            // Zero if the count is unknown.
+            int nProcessors = static_cast<int>(std::thread::hardware_concurrency());
+
+            nWorkers_ = std::max(nProcessors, 1) - 1;
+
+            deques_ = new WorkStealingDeque*[1 + nWorkers_];
+
+            for(int i=0; i<1+nWorkers_; ++i) {
+                deques_[i] = new WorkStealingDeque(DEQUE_CAPACITY);
+            }
+
+            workers_ = new Worker[nWorkers_];
+
+            for(int i=0; i<nWorkers_; ++i) {
+                if(!workers_[i].construct(this, 1+i)) {
+                    // Thieves only visit the deques of running threads.
+                    nWorkers_ = i;
+                    break;
+                }
+            }
+        }
+
+        TaskScheduler::~TaskScheduler() {
+            isStopping_.store(true);
+
+            workEpoch_.fetchAdd(1);
+            workEpoch_.wakeAll();
+
+            delete[] workers_;
+
+            for(int i=0; i<1+nWorkers_; ++i) {
+                delete deques_[i];
+            }
+            delete[] deques_;
+        }
+
+        void TaskScheduler::run(Task& task) {
+            if(tScheduler == this || tEntered == this) {
+                task.run();
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(entryMutex_);
+
+            EnteredScope entered(this);
+
+            task.run();
+        }
+
+        int TaskScheduler::getThreadCount() const {
+            return 1 + nWorkers_;
+        }
+
+        int TaskScheduler::getThreadIndex() const {
+            if(tScheduler == this) {
+                return tThreadIndex;
+            } else {
+                return 0;
+            }
+        }
+
+        unsigned int& TaskScheduler::getSeed(int threadIndex) {
+            if(threadIndex == 0) {
+                return ownerSeed_;
+            } else {
+                return workers_[threadIndex-1].getSeed();
+            }
+        }
+
+        TaskScheduler::Task* TaskScheduler::findTask(int threadIndex) {
+            void* item = deques_[threadIndex]->pop();
+
+            if(item) {
+                return static_cast<Task*>(item);
+            }
+
+            int const nThreads = 1 + nWorkers_;
+
+            if(nThreads == 1) {
+                return NULL;
+            }
+
+            // Start from a random victim (xorshift).
+            unsigned int& seed = getSeed(threadIndex);
+
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+
+            int const first = static_cast<int>(seed % nThreads);
+
+            for(int i=0; i<nThreads; ++i) {
+                int const victim = (first + i) % nThreads;
+
+                if(victim != threadIndex) {
+                    item = deques_[victim]->steal();
+
+                    if(item) {
+                        return static_cast<Task*>(item);
+                    }
+                }
+            }
+
+            return NULL;
+        }
+
+        void TaskScheduler::execute(Task* task) {
+            TaskGroup* group = task->group_;
+
+            TaskScheduler& scheduler = group->scheduler_;
+
+            task->run();
+
+            // The task and the group may be destroyed once
+            // the group sees this; the scheduler outlives them.
+            if(group->nPending_.fetch_sub(1) == 1) {
+                scheduler.completionEpoch_.fetchAdd(1);
+                scheduler.completionEpoch_.wakeAll();
+            }
+        }
+
+        void TaskScheduler::loop(ICallback& callback, int start, int end) {
+            int const grain = (end - start) / (TASKS_PER_THREAD * getThreadCount());
+
+            loop(callback, start, end, std::max(grain, 1));
+        }
+
+        void TaskScheduler::loop(ICallback& callback, int start, int end, int stride) {
+            CallbackAdapter adapter(callback);
+
+            loopRange(adapter, start, end, stride);
+        }
+
+        void TaskScheduler::loopRange(IRangeCallback& callback, int start, int end, int stride) {
+            if(start >= end) {
+                return;
+            }
+
+            RangeTask task(*this, callback, start, end, std::max(stride, 1));
+
+            run(task);
+        }
+
+        TaskScheduler::Worker::Worker()
+            : parent_(NULL), threadIndex_(0), seed_(0) {
+            // ignored
+        }
+
+        TaskScheduler::Worker::~Worker() {
+            if(thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        bool TaskScheduler::Worker::construct(TaskScheduler* parent, int threadIndex) {
+            parent_ = parent;
+            threadIndex_ = threadIndex;
+
+            // Any non-zero seed will do.
+            seed_ = 2654435761U * static_cast<unsigned int>(threadIndex);
+
+            // It's best to create the thread last:
+            // this way non-successful construction
+            // implies that the thread is never started.
+            try {
+                thread_ = std::thread(&Worker::run, this);
+            } catch(std::system_error const&) {
+                return false;
+            }
+
+            return true;
+        }
+
+        unsigned int& TaskScheduler::Worker::getSeed() {
+            return seed_;
+        }
+
+        void TaskScheduler::Worker::run() {
+            tScheduler = parent_;
+            tThreadIndex = threadIndex_;
+
+            while(!parent_->isStopping_.load()) {
+                Task* task = parent_->findTask(threadIndex_);
+
+                if(task) {
+                    execute(task);
+                    continue;
+                }
+
+                // Re-check after reading the epoch, so that
+                // a spawn in between is not slept through.
+                int const epoch = parent_->workEpoch_.load();
+
+                task = parent_->findTask(threadIndex_);
+
+                if(task) {
+                    execute(task);
+                } else if(!parent_->isStopping_.load()) {
+                    parent_->workEpoch_.wait(epoch);
+                }
+            }
+        }
+
+        TaskScheduler::RangeTask::RangeTask(
+                TaskScheduler& scheduler, IRangeCallback& callback,
+                int start, int end, int grain)
+            : scheduler_(scheduler), callback_(callback),
+              start_(start), end_(end), grain_(grain) {
+            // ignored
+        }
+
+        void TaskScheduler::RangeTask::run() {
+            if(end_ - start_ <= grain_) {
+                callback_.invokeRange(start_, end_);
+                return;
+            }
+
+            int const middle = start_ + (end_ - start_) / 2;
+
+            // Leave the upper half for thieves,
+            // and continue with the lower half.
+            RangeTask upper(scheduler_, callback_, middle, end_, grain_);
+
+            TaskGroup group(scheduler_);
+
+            group.spawn(upper);
+
+            RangeTask lower(scheduler_, callback_, start_, middle, grain_);
+
+            lower.run();
+
+            group.sync();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_TASKSCHEDULER_H
+#define NIWA_SYSTEM_TASKSCHEDULER_H
+
+#include "IParallelizer.h"
+#include "Futex.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace niwa {
+    namespace system {
+        class WorkStealingDeque;
+
+        /**
+         * A work-stealing fork-join scheduler. Each thread owns
+         * a deque of spawned tasks; it runs its own tasks newest
+         * first, and idle threads steal the oldest tasks of others.
+         * Tasks may spawn and sync tasks of their own, so recursive
+         * algorithms parallelize without oversubscription.
+         *
+         * Creates N-1 worker threads, where N is the number of
+         * logical processors; the thread that owns the scheduler
+         * is the N:th one. Threads other than the workers enter
+         * the scheduler (through run or the loops) one at a time,
+         * and may then use task groups; tasks may use it freely.
+         */
+        class TaskScheduler : public IParallelizer {
+        public:
+            class TaskGroup;
+
+            /**
+             * A unit of work. The task must stay alive
+             * until its group has been synced.
+             */
+            class Task {
+            public:
+                Task();
+
+                virtual ~Task();
+
+                virtual void __fastcall run() = 0;
+
+            private:
+                friend class TaskScheduler;
+                friend class TaskGroup;
+
+                TaskGroup* group_;
+            };
+
+            /**
+             * A set of spawned tasks that are waited for together.
+             * Only usable within tasks or within run.
+             */
+            class TaskGroup {
+            public:
+                explicit TaskGroup(TaskScheduler& scheduler);
+
+                /**
+                 * Syncs the group.
+                 */
+                ~TaskGroup();
+
+                /**
+                 * Makes the task available for running in parallel.
+                 */
+                void spawn(Task& task);
+
+                /**
+                 * Waits until all spawned tasks have been run;
+                 * meanwhile, the calling thread runs other tasks,
+                 * and sleeps when there are none.
+                 */
+                void sync();
+
+            private: // prevent copying
+                TaskGroup(TaskGroup const&);
+                TaskGroup& operator = (TaskGroup const&);
+
+            private:
+                friend class TaskScheduler;
+
+                TaskScheduler& scheduler_;
+
+                std::atomic<int> nPending_;
+            };
+
+        public:
+            /**
+             * @return The scheduler. If worker threads cannot be
+             *         started, the scheduler runs with fewer of them.
+             */
+            static TaskScheduler* create();
+
+            ~TaskScheduler();
+
+            /**
+             * Runs the task, and the tasks it spawns, on the
+             * scheduler. Thread-safe: threads that are not workers
+             * wait until no other such thread is inside.
+             */
+            void run(Task& task);
+
+            /**
+             * Splits the range recursively into tasks of
+             * roughly (end - start) / (8 N) indices.
+             */
+            void loop(ICallback& callback, int start, int end);
+
+            /**
+             * Splits the range recursively into
+             * tasks of at most stride indices.
+             */
+            void loop(ICallback& callback, int start, int end, int stride);
+
+            /**
+             * Splits the range recursively into
+             * ranges of at most stride indices.
+             */
+            void loopRange(IRangeCallback& callback, int start, int end, int stride);
+
+            /**
+             * @return The number of threads running
+             *         tasks, including the owner thread.
+             */
+            int getThreadCount() const;
+
+        private:
+            TaskScheduler();
+
+            class Worker;
+
+            class RangeTask;
+
+            /**
+             * @return Zero for the owner thread,
+             *         or one plus the worker index.
+             */
+            int getThreadIndex() const;
+
+            /**
+             * @return The steal seed of the given thread.
+             */
+            unsigned int& getSeed(int threadIndex);
+
+            /**
+             * @return A task from the deque of the given thread,
+             *         or a stolen task; NULL if none was found.
+             */
+            Task* findTask(int threadIndex);
+
+            static void execute(Task* task);
+
+        private: // prevent copying
+            TaskScheduler(TaskScheduler const&);
+            TaskScheduler& operator = (TaskScheduler const&);
+
+        private:
+            int nWorkers_;
+
+            Worker* workers_; // owned
+
+            /**
+             * Deques of the owner thread (first) and the workers.
+             */
+            WorkStealingDeque** deques_; // owned
+
+            /**
+             * Incremented whenever tasks are spawned;
+             * idle workers sleep on it.
+             */
+            Futex workEpoch_;
+
+            /**
+             * Incremented whenever a task group completes;
+             * syncing threads without work sleep on it.
+             */
+            Futex completionEpoch_;
+
+            /**
+             * Held by the thread that has entered the
+             * scheduler without being one of its workers.
+             */
+            std::mutex entryMutex_;
+
+            std::atomic<bool> isStopping_;
+
+            /**
+             * Steal seed of the owner thread.
+             */
+            unsigned int ownerSeed_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,429 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "TaskSchedulerTestSuite.h"
+
+#include "niwa/testing/ITestCase.h"
+#include "niwa/testing/ITestContext.h"
+
+using niwa::testing::ITestCase;
+using niwa::testing::ITestContext;
+
+#include "TaskScheduler.h"
+#include "WorkStealingDeque.h"
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace niwa {
+    namespace system {
+        /**
+         * Pushes, pops and steals the last element of a deque,
+         * where the owner and the thieves race for the same item.
+         */
+        class DequeLastElement : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(DequeLastElement);
+            }
+
+            void test(ITestContext& context) const {
+                WorkStealingDeque deque(4);
+
+                int items[2];
+
+                context.assertEquals<void*>(NULL, deque.pop(), "pop from empty deque");
+                context.assertEquals<void*>(NULL, deque.steal(), "steal from empty deque");
+
+                deque.push(&items[0]);
+                context.assertEquals<void*>(&items[0], deque.pop(), "pop of the last item");
+                context.assertEquals<void*>(NULL, deque.steal(), "steal after pop");
+
+                deque.push(&items[0]);
+                context.assertEquals<void*>(&items[0], deque.steal(), "steal of the last item");
+                context.assertEquals<void*>(NULL, deque.pop(), "pop after steal");
+
+                // Pops are LIFO and steals FIFO.
+                deque.push(&items[0]);
+                deque.push(&items[1]);
+                context.assertEquals<void*>(&items[0], deque.steal(), "steal not FIFO");
+                context.assertEquals<void*>(&items[1], deque.pop(), "pop not LIFO");
+                context.assertEquals<void*>(NULL, deque.pop(), "deque not empty");
+
+                testRace(context);
+            }
+
+        private:
+            /**
+             * The owner pushes one item at a time and pops it
+             * while a thief steals; exactly one of them may
+             * get each item.
+             */
+            static void testRace(ITestContext& context) {
+                static const int N_ROUNDS = 20000;
+
+                WorkStealingDeque deque(4);
+
+                std::vector<int> items(N_ROUNDS);
+
+                std::atomic<int> round(-1);
+                std::atomic<int> nStolen(0);
+                std::atomic<bool> isDone(false);
+
+                Thief thief(deque, nStolen, isDone);
+
+                std::thread thread(&Thief::run, &thief);
+
+                int nPopped = 0;
+
+                for(int i=0; i<N_ROUNDS; ++i) {
+                    deque.push(&items[i]);
+
+                    if(deque.pop()) {
+                        ++nPopped;
+                    }
+                }
+
+                isDone.store(true);
+
+                thread.join();
+
+                context.assertEquals<int>(N_ROUNDS, nPopped + nStolen.load(),
+                    "items lost or duplicated");
+            }
+
+            class Thief {
+            public:
+                Thief(
+                        WorkStealingDeque& deque,
+                        std::atomic<int>& nStolen,
+                        std::atomic<bool>& isDone)
+                    : deque_(deque), nStolen_(nStolen), isDone_(isDone) {
+                    // ignored
+                }
+
+                void run() {
+                    while(!isDone_.load()) {
+                        if(deque_.steal()) {
+                            nStolen_.fetch_add(1);
+                        }
+                    }
+
+                    // The owner has stopped; nothing is left.
+                    if(deque_.steal()) {
+                        nStolen_.fetch_add(1);
+                    }
+                }
+
+            private: // prevent copying
+                Thief(Thief const&);
+                Thief& operator = (Thief const&);
+
+            private:
+                WorkStealingDeque& deque_;
+                std::atomic<int>& nStolen_;
+                std::atomic<bool>& isDone_;
+            };
+        };
+
+        /**
+         * A task that counts its runs.
+         */
+        class CountingTask : public TaskScheduler::Task {
+        public:
+            CountingTask() : nRuns_(0) {
+                // ignored
+            }
+
+            void __fastcall run() {
+                nRuns_.fetch_add(1);
+            }
+
+            int getRunCount() const {
+                return nRuns_.load();
+            }
+
+        private:
+            std::atomic<int> nRuns_;
+        };
+
+        /**
+         * A full deque rejects pushes; the scheduler then runs
+         * the spawned task immediately on the spawning thread.
+         */
+        class DequeOverflow : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(DequeOverflow);
+            }
+
+            void test(ITestContext& context) const {
+                WorkStealingDeque deque(4);
+
+                int items[5];
+
+                for(int i=0; i<4; ++i) {
+                    context.assertEquals<bool>(true, deque.push(&items[i]),
+                        "push to non-full deque");
+                }
+
+                context.assertEquals<bool>(false, deque.push(&items[4]),
+                    "push to full deque");
+
+                for(int i=3; i>=0; --i) {
+                    context.assertEquals<void*>(&items[i], deque.pop(),
+                        "pop after overflow");
+                }
+
+                std::auto_ptr<TaskScheduler> scheduler(TaskScheduler::create());
+
+                // More than the deque capacity (4096).
+                SpawnTask task(*scheduler, 10000);
+
+                scheduler->run(task);
+
+                for(size_t i=0; i<task.tasks.size(); ++i) {
+                    context.assertEquals<int>(1, task.tasks[i].getRunCount(),
+                        "spawned task not run exactly once");
+                }
+            }
+
+        private:
+            /**
+             * Spawns the given number of tasks in one group.
+             */
+            class SpawnTask : public TaskScheduler::Task {
+            public:
+                SpawnTask(TaskScheduler& scheduler, size_t nTasks)
+                    : tasks(nTasks), scheduler_(scheduler) {
+                    // ignored
+                }
+
+                void __fastcall run() {
+                    TaskScheduler::TaskGroup group(scheduler_);
+
+                    for(size_t i=0; i<tasks.size(); ++i) {
+                        group.spawn(tasks[i]);
+                    }
+
+                    group.sync();
+                }
+
+                std::vector<CountingTask> tasks;
+
+            private: // prevent copying
+                SpawnTask(SpawnTask const&);
+                SpawnTask& operator = (SpawnTask const&);
+
+            private:
+                TaskScheduler& scheduler_;
+            };
+        };
+
+        /**
+         * Computes Fibonacci numbers with nested task groups:
+         * every task spawns and syncs a group of its own.
+         */
+        class NestedSync : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(NestedSync);
+            }
+
+            void test(ITestContext& context) const {
+                std::auto_ptr<TaskScheduler> scheduler(TaskScheduler::create());
+
+                FibonacciTask task(*scheduler, 20);
+
+                scheduler->run(task);
+
+                context.assertEquals<int>(6765, task.result, "wrong Fibonacci number");
+
+                // The scheduler is reusable.
+                FibonacciTask again(*scheduler, 15);
+
+                scheduler->run(again);
+
+                context.assertEquals<int>(610, again.result, "wrong Fibonacci number");
+            }
+
+        private:
+            class FibonacciTask : public TaskScheduler::Task {
+            public:
+                FibonacciTask(TaskScheduler& scheduler, int n)
+                    : result(0), scheduler_(scheduler), n_(n) {
+                    // ignored
+                }
+
+                void __fastcall run() {
+                    if(n_ < 2) {
+                        result = n_;
+                        return;
+                    }
+
+                    FibonacciTask left(scheduler_, n_ - 1);
+                    FibonacciTask right(scheduler_, n_ - 2);
+
+                    TaskScheduler::TaskGroup group(scheduler_);
+
+                    group.spawn(left);
+
+                    right.run();
+
+                    group.sync();
+
+                    result = left.result + right.result;
+                }
+
+                int result;
+
+            private: // prevent copying
+                FibonacciTask(FibonacciTask const&);
+                FibonacciTask& operator = (FibonacciTask const&);
+
+            private:
+                TaskScheduler& scheduler_;
+                int const n_;
+            };
+        };
+
+        /**
+         * Sums the indices of loops; every index must be visited
+         * exactly once, and ranges may not exceed the stride.
+         */
+        class LoopSums : public ITestCase {
+        public:
+            std::type_info const& getType() const {
+                return typeid(LoopSums);
+            }
+
+            void test(ITestContext& context) const {
+                std::auto_ptr<TaskScheduler> scheduler(TaskScheduler::create());
+
+                static const int N = 100000;
+
+                {
+                    SumCallback callback(N);
+
+                    scheduler->loop(callback, 0, N);
+
+                    testCounts(context, callback, 0, N);
+                }
+
+                {
+                    SumCallback callback(N);
+
+                    scheduler->loop(callback, 17, N, 1000);
+
+                    testCounts(context, callback, 17, N);
+                }
+
+                {
+                    SumCallback callback(N);
+
+                    scheduler->loopRange(callback, 3, N, 333);
+
+                    testCounts(context, callback, 3, N);
+
+                    context.assertEquals<bool>(true, callback.maxRange.load() <= 333,
+                        "range longer than the stride");
+                }
+
+                {
+                    SumCallback callback(N);
+
+                    scheduler->loop(callback, 5, 5);
+                    scheduler->loop(callback, 10, 5, 4);
+                    scheduler->loopRange(callback, 5, 5, 4);
+
+                    testCounts(context, callback, 0, 0);
+                }
+            }
+
+        private:
+            class SumCallback : public IParallelizer::ICallback,
+                                public IParallelizer::IRangeCallback {
+            public:
+                explicit SumCallback(int n) : counts(n), sum(0), maxRange(0) {
+                    // ignored
+                }
+
+                void __fastcall invoke(int index) {
+                    counts[index].fetch_add(1);
+                    sum.fetch_add(index);
+                }
+
+                void __fastcall invokeRange(int begin, int end) {
+                    for(int i=begin; i<end; ++i) {
+                        invoke(i);
+                    }
+
+                    int range = maxRange.load();
+
+                    while(end - begin > range
+                        && !maxRange.compare_exchange_weak(range, end - begin)) {
+                        // retry
+                    }
+                }
+
+                std::vector<std::atomic<int> > counts;
+
+                std::atomic<long long> sum;
+
+                std::atomic<int> maxRange;
+            };
+
+            static void testCounts(
+                    ITestContext& context, SumCallback const& callback,
+                    int start, int end) {
+                long long expected = 0;
+
+                for(int i=start; i<end; ++i) {
+                    expected += i;
+                }
+
+                context.assertEquals<long long>(expected, callback.sum.load(),
+                    "wrong sum of indices");
+
+                for(size_t i=0; i<callback.counts.size(); ++i) {
+                    int const visits = static_cast<int>(i) >= start
+                        && static_cast<int>(i) < end ? 1 : 0;
+
+                    context.assertEquals<int>(visits, callback.counts[i].load(),
+                        "index not visited exactly once");
+                }
+            }
+        };
+
+        std::type_info const& TaskSchedulerTestSuite::getType() const {
+            return typeid(TaskSchedulerTestSuite);
+        }
+
+        size_t TaskSchedulerTestSuite::nCases() const {
+            return 4;
+        }
+
+        ITestCase* TaskSchedulerTestSuite::newCase(size_t index) const {
+            switch(index) {
+            case 0:
+                return new DequeLastElement();
+            case 1:
+                return new DequeOverflow();
+            case 2:
+                return new NestedSync();
+            case 3:
+                return new LoopSums();
+            default:
+                assert(false);
+                return 0;
+            }
+        }
+    }
+}
\ No newline at end of file
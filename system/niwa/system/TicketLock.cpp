@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/TicketLock.h"
+
+#include "niwa/system/LockStatistics.h"
+
+#include <chrono>
+#include <thread>
+
+#include <xmmintrin.h>
+
+/**
+ * Pauses per waiter ahead in the queue; roughly
+ * the length of a short critical section.
+ */
+#define PAUSES_PER_WAITER 16
+
+/**
+ * Waiters yield the processor after this many pauses,
+ * so that a preempted holder can run when the
+ * machine is oversubscribed.
+ */
+#define YIELD_SPINS 4096
+
+namespace niwa {
+    namespace system {
+        TicketLock::TicketLock() 
+            : nextTicket_(0), 
+              nowServing_(0), 
+              statistics_(0) {
+            // ignored
+        }
+
+        void TicketLock::acquire() {
+            unsigned int const ticket = nextTicket_.fetch_add(1, std::memory_order_relaxed);
+
+            unsigned int serving = nowServing_.load(std::memory_order_acquire);
+
+            if(serving == ticket) {
+                if(statistics_) {
+                    statistics_->addAcquisition();
+                }
+                return;
+            }
+
+            std::chrono::steady_clock::time_point startTime;
+
+            if(statistics_) {
+                startTime = std::chrono::steady_clock::now();
+            }
+
+            long nSpins = 0;
+
+            while(serving != ticket) {
+                // Unsigned difference handles wrap-around.
+                int const nPauses = static_cast<int>(ticket - serving) * PAUSES_PER_WAITER;
+
+                if(nSpins < YIELD_SPINS) {
+                    for(int i=0; i<nPauses; ++i) {
+                        _mm_pause();
+                    }
+
+                    nSpins += nPauses;
+                } else {
+                    std::this_thread::yield();
+                }
+
+                serving = nowServing_.load(std::memory_order_acquire);
+            }
+
+            if(statistics_) {
+                std::chrono::duration<double> waitTime =
+                    std::chrono::steady_clock::now() - startTime;
+
+                statistics_->addContendedAcquisition(nSpins, waitTime.count());
+            }
+        }
+
+        void TicketLock::release() {
+            // Only the holder writes nowServing_.
+            nowServing_.store(
+                nowServing_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+        }
+
+        void TicketLock::setStatistics(LockStatistics* statistics) {
+            statistics_ = statistics;
+        }
+    }
+}
\ No newline at end of file
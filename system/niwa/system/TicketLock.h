@@ -0,0 +1,55 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_TICKETLOCK_H
+#define NIWA_SYSTEM_TICKETLOCK_H
+
+#include "ILock.h"
+
+#include <atomic>
+
+namespace niwa {
+    namespace system {
+        class LockStatistics;
+
+        /**
+         * A non-reentrant, fair spin lock: threads acquire
+         * the lock in the order they arrived. Waiters back off
+         * in proportion to their place in the queue. All waiters
+         * still read the same line, so with many waiters,
+         * prefer McsLock.
+         */
+        class TicketLock : public ILock {
+        public:
+            TicketLock();
+
+            void acquire();
+
+            void release();
+
+            /**
+             * @param statistics The counters to update, or
+             *                   NULL (the default) for none.
+             *                   Must outlive the lock's use.
+             */
+            void setStatistics(LockStatistics* statistics);
+
+        private: // prevent copying
+            TicketLock(TicketLock const&);
+            TicketLock& operator = (TicketLock const&);
+
+        private:
+            std::atomic<unsigned int> nextTicket_;
+
+            std::atomic<unsigned int> nowServing_;
+
+            LockStatistics* statistics_;
+        };
+    }
+}
+
+#endif
\ No newline at end of file
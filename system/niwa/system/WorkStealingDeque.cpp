@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#include "niwa/system/WorkStealingDeque.h"
+
+#include <cassert>
+#include <cstddef>
+
+namespace niwa {
+    namespace system {
+        WorkStealingDeque::WorkStealingDeque(int capacity)
+            : top_(0), bottom_(0), mask_(capacity - 1) {
+            assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+            items_ = new std::atomic<void*>[capacity];
+        }
+
+        WorkStealingDeque::~WorkStealingDeque() {
+            delete[] items_;
+        }
+
+        bool WorkStealingDeque::push(void* item) {
+            long b = bottom_.load(std::memory_order_relaxed);
+            long t = top_.load(std::memory_order_acquire);
+
+            if(b - t > mask_) {
+                return false;
+            }
+
+            items_[b & mask_].store(item, std::memory_order_release);
+
+            std::atomic_thread_fence(std::memory_order_release);
+
+            bottom_.store(b + 1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        void* WorkStealingDeque::pop() {
+            long b = bottom_.load(std::memory_order_relaxed) - 1;
+
+            bottom_.store(b, std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            long t = top_.load(std::memory_order_relaxed);
+
+            if(t > b) {
+                // empty
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return NULL;
+            }
+
+            void* item = items_[b & mask_].load(std::memory_order_relaxed);
+
+            if(t == b) {
+                // The last item: race against the thieves.
+                if(!top_.compare_exchange_strong(t, t + 1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = NULL;
+                }
+
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+
+            return item;
+        }
+
+        void* WorkStealingDeque::steal() {
+            long t = top_.load(std::memory_order_acquire);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            long b = bottom_.load(std::memory_order_acquire);
+
+            if(t >= b) {
+                return NULL;
+            }
+
+            void* item = items_[t & mask_].load(std::memory_order_acquire);
+
+            if(!top_.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return NULL;
+            }
+
+            return item;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @author Mikko Kauppila
+ *
+ * Copyright (C) Mikko Kauppila 2010.
+ */
+
+#ifndef NIWA_SYSTEM_WORKSTEALINGDEQUE_H
+#define NIWA_SYSTEM_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+
+namespace niwa {
+    namespace system {
+        /**
+         * A bounded Chase-Lev work-stealing deque of pointers.
+         * The owner thread pushes and pops at the bottom (LIFO),
+         * and other threads steal from the top (FIFO).
+         * See Le, Pop, Cohen and Zappa Nardelli, "Correct and
+         * Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+         */
+        class WorkStealingDeque {
+        public:
+            /**
+             * @param capacity Must be a power of two.
+             */
+            explicit WorkStealingDeque(int capacity);
+
+            ~WorkStealingDeque();
+
+            /**
+             * Owner thread only.
+             *
+             * @return False if the deque is full.
+             */
+            bool push(void* item);
+
+            /**
+             * Owner thread only.
+             *
+             * @return The most recently pushed item, or NULL if empty.
+             */
+            void* pop();
+
+            /**
+             * Thread-safe.
+             *
+             * @return The least recently pushed item, or NULL if
+             *         empty or if another thread won the race.
+             */
+            void* steal();
+
+        private: // prevent copying
+            WorkStealingDeque(WorkStealingDeque const&);
+            WorkStealingDeque& operator = (WorkStealingDeque const&);
+
+        private:
+            std::atomic<long> top_;
+
+            std::atomic<long> bottom_;
+
+            long const mask_;
+
+            std::atomic<void*>* items_; // owned
+        };
+    }
+}
+
+#endif
\ No newline at end of file
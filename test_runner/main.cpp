@@ -8,6 +8,10 @@
 #include "niwa/testing/ITestSuite.h"
 
 #include "niwa/geom/HilbertTestSuite.h"
+#include "niwa/photonmap/PhotonMapTestSuite.h"
+#include "niwa/system/LockTestSuite.h"
+#include "niwa/system/ParallelReduceTestSuite.h"
+#include "niwa/system/TaskSchedulerTestSuite.h"
 
 using namespace niwa::testing;
 
@@ -94,5 +98,21 @@ int main(int /*argc*/, char** /*argv*/) {
 
     test(hilbert);
 
+    niwa::photonmap::PhotonMapTestSuite photonMap;
+
+    test(photonMap);
+
+    niwa::system::LockTestSuite lock;
+
+    test(lock);
+
+    niwa::system::TaskSchedulerTestSuite taskScheduler;
+
+    test(taskScheduler);
+
+    niwa::system::ParallelReduceTestSuite parallelReduce;
+
+    test(parallelReduce);
+
     return 0;
 }
\ No newline at end of file